@@ -0,0 +1,36 @@
+/**
+ * @file session_replay.c
+ *
+ * @brief Replay of a recorded session as a timed workload
+ *
+ * Reruns the database operations of a session recorded with
+ * @c main @c --record @c FILE (see @a session_replay()) on a copy of
+ * each database and prints the time taken by every event.
+ *
+ * Usage: @c session_replay @c FILE
+ *
+ * @note Needs a GDK display to initialize GTK; nothing is shown, so it
+ *       runs headless with e.g. @c xvfb-run or @c GDK_BACKEND=broadway
+ */
+
+/* System includes */
+#include <stdio.h>
+
+/* External includes */
+#include <gtk/gtk.h>
+
+/* Project includes */
+#include <session.h>
+
+
+/* Main entry */
+int main(int argc, char **argv)
+{
+    gtk_init(&argc, &argv);
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s SESSION_FILE\n", argv[0]);
+        return 2;
+    }
+
+    return (session_replay(argv[1], stdout) == 0) ? 0 : 1;
+}
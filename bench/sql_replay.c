@@ -0,0 +1,65 @@
+/**
+ * @file sql_replay.c
+ *
+ * @brief Replay of a production SQL statement log
+ *
+ * Runs the statements of a log (format in @e workload.h) against a
+ * copy of a database on concurrent connections and prints their
+ * latency distributions and lock contention.
+ *
+ * Usage: @c sql_replay @c [-c @c connections] @c [-s @c speed]
+ * @c log @c database, where @e connections bounds the sessions of the
+ * log, each replayed on its own connection (default
+ * @e WORKLOAD_MAX_CONNS), and @e speed scales the recorded pace (the
+ * default, 1, is the recorded pace and 0 replays without waits).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* System includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Project includes */
+#include <workload.h>
+
+
+/* Main entry */
+int main(int argc, char **argv)
+{
+    int nconns = WORKLOAD_MAX_CONNS;
+    double speed = 1.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:s:")) != -1) {
+        switch (opt) {
+            case 'c':
+                nconns = atoi(optarg);
+                break;
+            case 's':
+                speed = atof(optarg);
+                break;
+            default:
+                optind = argc + 1;  /* Force the usage message */
+                break;
+        }
+    }
+    if (optind != argc - 2 || speed < 0.0) {
+        fprintf(stderr, "Usage: %s [-c connections] [-s speed] "
+                "LOG DATABASE\n", argv[0]);
+        return 2;
+    }
+
+    int rc = workload_replay(argv[optind], argv[optind + 1], nconns,
+            speed, stdout);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Replay failed: %s\n", sqlite3_errstr(rc));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,299 @@
+/**
+ * @file ui_bench.c
+ *
+ * @brief Offscreen rendering benchmark of the rows view
+ *
+ * Builds the UI with @a ui_build(), moves it into an offscreen window
+ * and, for every table of a database, measures the table switch
+ * (query, model attach and column setup), the first frame drawn after
+ * it and the frames drawn while scrolling the rows view.
+ *
+ * Usage: @c ui_bench @c [database] (without argument a temporary
+ * database with tables of various shapes is generated).
+ *
+ * @note Needs a GDK display; run it headless with e.g. @c xvfb-run or
+ *       @c GDK_BACKEND=broadway
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* System includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project includes */
+#include <context.h>
+#include <db.h>
+#include <thumb.h>
+#include <ui.h>
+
+
+#define BENCH_SCROLL_FRAMES (60)        /**< Scroll steps per table */
+#define BENCH_FRAME_TIMEOUT (2000000)   /**< Frame wait limit (us) */
+#define BENCH_BLOB_BYTES (65536)        /**< Size of generated BLOBs */
+
+
+/**
+ * @struct s_bench_td
+ *
+ * @brief Frame timing state
+ */
+typedef struct {
+    GtkWidget *view;    /**< Rows view */
+    gint64 drawn;       /**< Monotonic time of the last rows view draw */
+} s_bench_td;
+
+
+/**
+ * @brief Handler run after the rows view has drawn a frame
+ *
+ * @param w        The rows view (unused)
+ * @param cr       Cairo context (unused)
+ * @param userdata Frame timing state (@e s_bench_td *)
+ *
+ * @return @c FALSE to let other handlers run
+ */
+static gboolean s_on_draw(GtkWidget *w, cairo_t *cr, gpointer userdata)
+{
+    (void) w;
+    (void) cr;
+    s_bench_td *b = userdata;
+
+    b->drawn = g_get_monotonic_time();
+
+    return FALSE;
+}
+
+
+/**
+ * @brief Run the main loop until the rows view draws a frame
+ *
+ * @param b     Frame timing state
+ * @param since Monotonic time the frame was requested at
+ *
+ * @return Microseconds until the frame was drawn, or -1 on timeout
+ */
+static gint64 s_wait_frame(s_bench_td *b, gint64 since)
+{
+    gtk_widget_queue_draw(b->view);
+    while (b->drawn < since) {
+        if (g_get_monotonic_time() - since > BENCH_FRAME_TIMEOUT) {
+            return -1;
+        }
+        if (!g_main_context_iteration(NULL, FALSE)) {
+            g_usleep(100);
+        }
+    }
+
+    return b->drawn - since;
+}
+
+
+/**
+ * @brief Compare two durations (for @a qsort())
+ *
+ * @param a First duration (@e gint64 *)
+ * @param b Second duration (@e gint64 *)
+ *
+ * @return Negative, zero or positive as @e a is less, equal or greater
+ */
+static int s_cmp_time(const void *a, const void *b)
+{
+    gint64 x = *(const gint64*) a;
+    gint64 y = *(const gint64*) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Create a database with tables of various shapes
+ *
+ * @param path Database file to create (replaced if it exists)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_make_db(const char *path)
+{
+    sqlite3 *db = NULL;
+    remove(path);
+    int rc = sqlite3_open(path, &db);
+
+    /* Narrow: many short rows */
+    sqlite3_str *str = sqlite3_str_new(db);
+    sqlite3_str_appendall(str, "BEGIN;"
+            "CREATE TABLE narrow(id INTEGER PRIMARY KEY, name TEXT);"
+            "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 "
+            "FROM n WHERE x < 10000) "
+            "INSERT INTO narrow SELECT x, 'row ' || x FROM n;");
+
+    /* Wide: 200 numeric and text columns */
+    sqlite3_str_appendall(str, "CREATE TABLE wide(");
+    for (int i = 0; i < 200; ++i) {
+        sqlite3_str_appendf(str, "%sc%d", (i) ? ", " : "", i);
+    }
+    sqlite3_str_appendall(str, ");"
+            "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 "
+            "FROM n WHERE x < 1000) INSERT INTO wide SELECT ");
+    for (int i = 0; i < 200; ++i) {
+        sqlite3_str_appendf(str, (i % 2) ? "%s'v' || x * %d" : "%sx * %d",
+                (i) ? ", " : "", i);
+    }
+    sqlite3_str_appendall(str, " FROM n;");
+
+    /* Long text and image-like BLOBs */
+    sqlite3_str_appendf(str, "CREATE TABLE longtext(a, b, c);"
+            "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 "
+            "FROM n WHERE x < 1000) INSERT INTO longtext "
+            "SELECT x, hex(randomblob(1024)), hex(randomblob(64)) FROM n;"
+            "CREATE TABLE blobs(id INTEGER PRIMARY KEY, data);"
+            "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 "
+            "FROM n WHERE x < 1000) INSERT INTO blobs "
+            "SELECT x, x'89504E470D0A1A0A' || randomblob(%d) FROM n;"
+            "COMMIT;", BENCH_BLOB_BYTES);
+
+    char *sql = sqlite3_str_finish(str);
+    if (rc == SQLITE_OK) {
+        rc = (sql) ? sqlite3_exec(db, sql, NULL, NULL, NULL)
+            : SQLITE_NOMEM;
+    }
+    sqlite3_free(sql);
+    sqlite3_close(db);
+
+    return rc;
+}
+
+
+/**
+ * @brief Move the UI built by @a ui_build() into an offscreen window
+ *
+ * @param s Pointer to the application context
+ */
+static void s_go_offscreen(context_td *s)
+{
+    GtkWidget *child = gtk_bin_get_child(GTK_BIN(s->win));
+
+    g_signal_handlers_disconnect_by_func(s->win,
+            G_CALLBACK(gtk_main_quit), NULL);
+    g_object_ref(child);
+    gtk_container_remove(GTK_CONTAINER(s->win), child);
+    gtk_widget_destroy(s->win);
+
+    s->win = gtk_offscreen_window_new();
+    gtk_window_set_default_size(GTK_WINDOW(s->win), 900, 600);
+    gtk_container_add(GTK_CONTAINER(s->win), child);
+    g_object_unref(child);
+    gtk_widget_show_all(s->win);
+}
+
+
+/**
+ * @brief Benchmark one table: switch, first frame and scroll frames
+ *
+ * @param s     Pointer to the application context
+ * @param b     Frame timing state
+ * @param iter  Row of the table in the tables list
+ */
+static void s_bench_table(context_td *s, s_bench_td *b, GtkTreeIter *iter)
+{
+    GtkTreeSelection *sel =
+        gtk_tree_view_get_selection(GTK_TREE_VIEW(s->tables_view));
+    GtkAdjustment *adj =
+        gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(s->rows_view));
+    gint64 times[BENCH_SCROLL_FRAMES];
+    int nframes = 0;
+
+    /* Query, model attach and column setup run in the handler */
+    gint64 t0 = g_get_monotonic_time();
+    gtk_tree_selection_select_iter(sel, iter);
+    gint64 t1 = g_get_monotonic_time();
+    gint64 first = s_wait_frame(b, t1);
+
+    for (int i = 0; i < BENCH_SCROLL_FRAMES; ++i) {
+        double lower = gtk_adjustment_get_lower(adj);
+        double top = gtk_adjustment_get_upper(adj)
+            - gtk_adjustment_get_page_size(adj);
+        double value = gtk_adjustment_get_value(adj)
+            + gtk_adjustment_get_page_size(adj) / 4.0;
+        if (top <= lower) {
+            break;  /* Nothing to scroll */
+        }
+        gint64 t = g_get_monotonic_time();
+        gtk_adjustment_set_value(adj, (value > top) ? lower : value);
+        gint64 dt = s_wait_frame(b, t);
+        if (dt >= 0) {
+            times[nframes++] = dt;
+        }
+    }
+
+    qsort(times, (size_t) nframes, sizeof(gint64), s_cmp_time);
+    printf("%-16s %5d %9.2f %9.2f",
+            (s->current_tablename) ? s->current_tablename : "?",
+            s->current_ncols, (double) (t1 - t0) / 1000.0,
+            (double) first / 1000.0);
+    if (nframes > 0) {
+        printf(" %9.2f %9.2f %9.2f\n",
+                (double) times[nframes / 2] / 1000.0,
+                (double) times[nframes * 95 / 100] / 1000.0,
+                (double) times[nframes - 1] / 1000.0);
+    } else {
+        printf(" %9s %9s %9s\n", "-", "-", "-");
+    }
+}
+
+
+/* Main entry */
+int main(int argc, char **argv)
+{
+    gtk_init(&argc, &argv);
+    context_td state;
+    s_bench_td bench;
+    char *path = NULL;
+
+    memset(&state, 0, sizeof(state));
+    memset(&bench, 0, sizeof(bench));
+    if (argc > 1) {
+        path = g_strdup(argv[1]);
+    } else {
+        path = g_build_filename(g_get_tmp_dir(), "sqliteview-bench.db",
+                NULL);
+        if (s_make_db(path) != SQLITE_OK) {
+            fprintf(stderr, "Cannot create '%s'\n", path);
+            g_free(path);
+            return 1;
+        }
+    }
+
+    ui_build(&state);
+    s_go_offscreen(&state);
+    bench.view = state.rows_view;
+    g_signal_connect_after(state.rows_view, "draw",
+            G_CALLBACK(s_on_draw), &bench);
+
+    if (!db_is_sqlite(path) || db_open(&state, path) != SQLITE_OK
+            || db_fill_table_list(&state) != SQLITE_OK) {
+        fprintf(stderr, "Cannot open '%s'\n", path);
+    } else {
+        printf("%-16s %5s %9s %9s %9s %9s %9s\n", "table", "cols",
+                "switch", "first", "scroll50", "scroll95", "scrollmax");
+        GtkTreeModel *tables = GTK_TREE_MODEL(state.tables_store);
+        GtkTreeIter iter;
+        gboolean valid = gtk_tree_model_get_iter_first(tables, &iter);
+        for (; valid; valid = gtk_tree_model_iter_next(tables, &iter)) {
+            s_bench_table(&state, &bench, &iter);
+        }
+        printf("(times in ms)\n");
+    }
+
+    gtk_widget_destroy(state.win);
+    db_free_columns(&state);
+    db_close(&state);
+    thumb_cache_free(state.thumbs);
+    if (argc <= 1) {
+        remove(path);
+    }
+    g_free(path);
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file complete.h
+ *
+ * @brief Index of schema names for SQL autocompletion
+ *
+ * Names of tables, views, columns, SQL functions and keywords are kept
+ * in a prefix trie (case insensitive), so completing a prefix costs
+ * the length of the prefix plus the number of matches, whatever the
+ * size of the schema.
+ *
+ * The index follows the schema of a connection: @a complete_refresh()
+ * does nothing while @c PRAGMA @c schema_version is unchanged and,
+ * when it changes, only re-reads the columns of the tables and views
+ * whose definition changed.
+ */
+
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+/* External includes */
+#include <sqlite3.h>
+
+
+#define COMPLETE_MAX_NAME (256)     /**< Longest name indexed (bytes) */
+
+
+/**
+ * @enum complete_kind_td
+ *
+ * @brief Kinds of names, as bits of @e complete_match_td::kinds
+ */
+typedef enum {
+    COMPLETE_KEYWORD = 1 << 0,  /**< SQL keyword */
+    COMPLETE_FUNCTION = 1 << 1, /**< SQL function */
+    COMPLETE_TABLE = 1 << 2,    /**< Table */
+    COMPLETE_VIEW = 1 << 3,     /**< View */
+    COMPLETE_COLUMN = 1 << 4    /**< Column of a table or view */
+} complete_kind_td;
+
+/**
+ * @struct complete_match_td
+ *
+ * @brief Name found by @a complete_lookup()
+ */
+typedef struct {
+    const char *name;   /**< Name (valid until the next refresh) */
+    unsigned kinds;     /**< Kinds of the name (@e complete_kind_td) */
+} complete_match_td;
+
+/**
+ * @struct complete_td
+ *
+ * @brief Opaque completion index
+ */
+typedef struct complete_td complete_td;
+
+
+/* Public interface */
+/**
+ * @brief Create an empty completion index
+ *
+ * @return New index (release with @a complete_free())
+ */
+complete_td *complete_new(void);
+
+/**
+ * @brief Release a completion index
+ *
+ * @param c Index (may be @c NULL)
+ */
+void complete_free(complete_td *c);
+
+/**
+ * @brief Bring the index up to date with the schema of a connection
+ *
+ * Cheap when the schema did not change, so it can run before every
+ * lookup.  A different connection or database file resets the index.
+ *
+ * @param c  Index
+ * @param db Open connection
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int complete_refresh(complete_td *c, sqlite3 *db);
+
+/**
+ * @brief Find the names starting with a prefix
+ *
+ * Matches come in alphabetical order, shorter names first, or in table
+ * order for the columns of a qualifier.
+ *
+ * @param c      Index
+ * @param table  Qualifier typed before the prefix (as in
+ *               @c table.col), to complete only the columns of that
+ *               table or view, or @c NULL
+ * @param prefix Prefix to complete (case insensitive)
+ * @param max    Maximum number of matches
+ * @param out    Where to store the matches (@e max entries)
+ *
+ * @return Number of matches stored
+ */
+int complete_lookup(complete_td *c, const char *table, const char *prefix,
+        int max, complete_match_td *out);
+
+
+#endif  /* ! COMPLETE_H */
@@ -16,6 +16,17 @@
 #include <gtk/gtk.h>
 #include <sqlite3.h>
 
+/* Project includes */
+#include <complete.h>
+#include <history.h>
+#include <job.h>
+#include <json.h>
+#include <overlay.h>
+#include <query.h>
+#include <session.h>
+#include <thumb.h>
+#include <timeline.h>
+
 
 /**
  * @struct context_td
@@ -25,13 +36,37 @@
  */
 typedef struct {
     sqlite3 *db;                /**< SQLite database handle */
+    char *filename;             /**< Path of the open database file */
     GtkWidget *win;             /**< Main application window */
     GtkWidget *tables_view;     /**< 'GtkTreeView' showing table names */
     GtkWidget *rows_view;       /**< 'GtkTreeView' showing rows of table */
     GtkListStore *tables_store; /**< 'GtkListStore' backing 'tables_view' */
-    int current_ncols;          /**< Number of columns in current model */
-    char **current_colnames;    /**< Array of column name strings */
+    int current_ncols;          /**< Number of table columns in model */
+    int current_nextra;         /**< JSON path columns in model after them */
+    char **current_colnames;    /**< Names of the columns of the model */
     char *current_tablename;    /**< Name of current table */
+    thumb_cache_td *thumbs;     /**< Thumbnails of image BLOB cells */
+    session_td *session;        /**< Session recorder (or @c NULL) */
+    history_td *history;        /**< Query history (or @c NULL) */
+    complete_td *names;         /**< Schema names for autocompletion */
+    GPtrArray *json_columns;    /**< JSON paths shown (@e json_column_td) */
+    char *row_filter;           /**< Condition on the rows shown, or NULL */
+    char *seek_column;          /**< Column the rows shown are ordered by,
+                                     from @e seek_from on, or NULL */
+    char *seek_from;            /**< SQL literal of its first value shown */
+    GtkWidget *timeline_area;   /**< Timeline strip above the rows view */
+    timeline_td *timeline;      /**< Timeline of the table, or NULL */
+    job_td *timeline_job;       /**< Job counting its rows, or NULL */
+    GtkWidget *filter_entry;    /**< Entry of the condition on the rows */
+    GtkWidget *estimate_label;  /**< Estimate of the condition typed */
+    guint estimate_timer;       /**< Pending estimate (source id), or 0 */
+    int overlay_mode;           /**< Whether files are opened read-only,
+                                     edits going to an overlay */
+    overlay_td *overlay;        /**< Overlay of the open file, or NULL */
+    query_stats_td rows_stats;  /**< Counters of the last fill of the
+                                     rows view */
+    int rows_cached;            /**< Whether it came from cached rows */
+    GtkWidget *rows_stats_label;    /**< Shows @e rows_stats */
 } context_td;
 
 
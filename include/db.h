@@ -17,6 +17,8 @@
 
 
 #define SQL_QUERY_MAX_LIMIT (100)   /**< Maximum limit for SQL queries */
+#define DB_RECORD_MAX_VALUE (1024)  /**< Bytes shown of a record value */
+#define DB_JOB_BUSY_TIMEOUT (5000) /**< Lock wait of job connections (ms) */
 
 
 /* Public interface */
@@ -34,6 +36,11 @@ int db_is_sqlite(const char *filename);
 /**
  * @brief Open an SQLite database and store the handle in the context
  *
+ * The connection, as those of @a db_open_reader() and
+ * @a db_open_writer(), gets the @c REGEXP operator (see @e regexp.h).
+ * With @e s->overlay_mode set, the file is opened read-only and its
+ * overlay (see @e overlay.h) is opened into @e s->overlay.
+ *
  * @param s        Pointer to the application context (must not be @c NULL)
  * @param filename Path to the SQLite database file to open
  *
@@ -44,13 +51,64 @@ int db_is_sqlite(const char *filename);
  */
 int db_open(context_td *s, const char *filename);
 
+/**
+ * @brief Open an additional read-only connection to a database file
+ *
+ * Used by background jobs, which must never share @e s->db with the
+ * UI thread.  The connection waits on locks held by other connections
+ * instead of failing immediately.
+ *
+ * @param filename Path to the SQLite database file to open
+ * @param out      Where to store the new handle (set to @c NULL on
+ *                 failure)
+ *
+ * @return @e SQLITE_OK on success, or an SQLite error code otherwise
+ *
+ * @note Caller must close the handle with @a sqlite3_close()
+ */
+int db_open_reader(const char *filename, sqlite3 **out);
+
+/**
+ * @brief Open an additional read-write connection to a database file
+ *
+ * Same as @a db_open_reader() but for background jobs that modify the
+ * database; they should hold their write transactions briefly, since
+ * @e s->db waits on them as any other connection.
+ *
+ * @param filename Path to the SQLite database file to open
+ * @param out      Where to store the new handle (set to @c NULL on
+ *                 failure)
+ *
+ * @return @e SQLITE_OK on success, or an SQLite error code otherwise
+ *
+ * @note Caller must close the handle with @a sqlite3_close()
+ */
+int db_open_writer(const char *filename, sqlite3 **out);
+
+/**
+ * @brief Copy a database to a new temporary file
+ *
+ * The copy is made with the online backup API, so it is consistent
+ * even if other connections write to the database meanwhile.  Used by
+ * the replay tools, which must never modify the original.
+ *
+ * @param filename Path to the SQLite database file to copy
+ * @param copy     Where to store the path of the copy (set to @c NULL
+ *                 on failure; free with @a g_free())
+ *
+ * @return @e SQLITE_OK on success, or an SQLite error code otherwise
+ *
+ * @note Caller must remove the copy when done with it
+ */
+int db_copy_to_temp(const char *filename, char **copy);
+
 /**
  * @brief Close the SQLite database in the context and clear the handle
  * 
  * @param s Pointer to the application context.
  *
  * @note Safe to call with a @c NULL context pointer
- * @note After return @e s->db will be @c NULL
+ * @note After return @e s->db and @e s->filename will be @c NULL
 */
 void db_close(context_td *s);
 
@@ -79,21 +137,43 @@ int db_fill_table_list(context_td *s);
  */
 void db_free_columns(context_td *s);
 
+/**
+ * @brief Drop the JSON path columns, the row filter and the seek of the
+ *        rows view
+ *
+ * @param s Pointer to the application context
+ *
+ * @note Done by @a db_populate_rows() when the table changes and by
+ *       @a db_close()
+ */
+void db_reset_view(context_td *s);
+
 /**
  * @brief Populate the rows view for a given table by selecting rows
  *        from the database
  *
  * Creates a @e GtkListStore with string columns matching the result set
  * (rowid included), fills it with up to 100 rows and assigns the model
- * to @e s->rows_view.
+ * to @e s->rows_view.  The paths of @e s->json_columns are selected
+ * after the table columns and only rows matching @e s->row_filter are
+ * listed (see @e json.h).  With @e s->seek_column set, rows are listed
+ * in its order from @e s->seek_from on (see @e timeline.h).  Cells
+ * edited in @e s->overlay are shown over the base values.  The rows,
+ * time, statement counters and plan of the fill are stored in
+ * @e s->rows_stats (see @a query_collect()), and @e s->rows_cached
+ * tells whether the rows came from the row cache instead.
  *
  * @param s     Pointer to the application context
  * @param table Name of the table to query (must not be NULL).
  *
  * @return @e SQLITE_OK on success or an SQLite error code on failure
- *         (or @e SQLITE_MISUSE for invalid inputs)
+ *         (or @e SQLITE_MISUSE for invalid inputs); a failure while
+ *         reading the rows (e.g. @e SQLITE_CORRUPT) leaves the rows
+ *         read before it in the view
  *
  * @note Context must have open @e s->db and a valid @e s->rows_view
+ * @note View columns are not touched: the UI matches its columns to
+ *       @e s->current_colnames
  */
 int db_populate_rows(context_td *s, const char *table);
 
@@ -102,7 +182,8 @@ int db_populate_rows(context_td *s, const char *table);
  *
  * Generates and executes an UPDATE statement that sets the given column
  * to new_text for the row identified by rowid_text. Column index
- * 0 (rowid) is ignored (no-op).
+ * 0 (rowid) is ignored (no-op).  In overlay mode the edit goes to
+ * @e s->overlay instead, and the database is not written to.
  * 
  * @param s          Pointer to the application context
  * @param colidx     Column index in the current model
@@ -118,5 +199,61 @@ int db_populate_rows(context_td *s, const char *table);
 int db_apply_update_cell(context_td *s, int colidx, const char *rowid_text,
         const char *new_text);
 
+/**
+ * @brief Insert a row with default values into the current table and
+ *        append it to the rows view model
+ *
+ * @param s    Pointer to the application context
+ * @param iter Where to store the position of the new row in the model
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ *         (or @e SQLITE_MISUSE for invalid inputs)
+ *
+ * @note The model is updated in place; the table is not reloaded
+ */
+int db_insert_row(context_td *s, GtkTreeIter *iter);
+
+/**
+ * @brief Delete rows of the current table in a single transaction
+ *
+ * One prepared statement is reused for every row, so deleting
+ * thousands of rows costs one commit.  Nothing is deleted if any row
+ * fails.
+ *
+ * @param s      Pointer to the application context
+ * @param rowids Rowids of the rows to delete
+ * @param n      Number of entries in @e rowids
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ *         (or @e SQLITE_MISUSE for invalid inputs)
+ *
+ * @note The caller removes the rows from the model on success
+ */
+int db_delete_rows(context_td *s, const sqlite3_int64 *rowids, int n);
+
+/**
+ * @brief Fetch a group of columns of a row of the current table
+ *
+ * Text and BLOB values longer than @e maxlen bytes are read partially,
+ * so fetching a group stays cheap however wide or large the row is.
+ * BLOBs are described by their size instead of their content.
+ *
+ * @param s      Pointer to the application context
+ * @param rowid  Row to fetch
+ * @param first  Index of the first column in @e s->current_colnames
+ *               (at least 1, since 0 is @e rowid)
+ * @param n      Number of columns to fetch
+ * @param maxlen Maximum number of bytes shown of a value (e.g.
+ *               @e DB_RECORD_MAX_VALUE)
+ * @param out    Where to store @e n display strings (each may be
+ *               @c NULL on error; caller must @a free() them)
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_NOTFOUND if the row does
+ *         not exist, or an SQLite error code on failure (or
+ *         @e SQLITE_MISUSE for invalid inputs)
+ */
+int db_fetch_record(context_td *s, sqlite3_int64 rowid, int first, int n,
+        int maxlen, char **out);
+
 
 #endif  /* ! DB_H */
@@ -0,0 +1,81 @@
+/**
+ * @file dup.h
+ *
+ * @brief Duplicate-row detection over a set of columns
+ *
+ * Rows are hashed by the chosen columns in @e rowid range partitions,
+ * each partition on its own read-only connection and thread.  The
+ * sorted hash lists are merged and only rows whose hashes collide are
+ * read again and compared value by value, so no @c GROUP @c BY over
+ * the whole table is needed.
+ */
+
+#ifndef DUP_H
+#define DUP_H
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Project includes */
+#include <job.h>
+
+
+#define DUP_MAX_PARTITIONS (8)  /**< Upper bound of scanning threads */
+
+
+/**
+ * @struct dup_group_td
+ *
+ * @brief Set of rows holding the same values in the chosen columns
+ */
+typedef struct {
+    sqlite3_int64 *rowids;  /**< Rowids of the rows, ascending */
+    int nrowids;            /**< Number of rows in the group (>= 2) */
+} dup_group_td;
+
+/**
+ * @struct dup_result_td
+ *
+ * @brief Outcome of a duplicate search
+ */
+typedef struct {
+    dup_group_td *groups;       /**< Duplicate groups by first rowid */
+    int ngroups;                /**< Number of groups */
+    sqlite3_int64 nscanned;     /**< Rows hashed */
+    sqlite3_int64 ncandidates;  /**< Rows with colliding hashes */
+} dup_result_td;
+
+
+/* Public interface */
+/**
+ * @brief Find rows of a table with equal values in the given columns
+ *
+ * @param job      Running job for progress and cancellation (may be
+ *                 @c NULL)
+ * @param filename Path of the database file (opened read-only)
+ * @param table    Name of the table to scan
+ * @param cols     Names of the columns to compare
+ * @param ncols    Number of entries in @e cols (must be > 0)
+ * @param nparts   Number of partitions/threads (clamped to
+ *                 [1, @e DUP_MAX_PARTITIONS])
+ * @param out      Where to store the result (release it with
+ *                 @a dup_result_free())
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_INTERRUPT if the job was
+ *         cancelled, or an SQLite error code otherwise
+ *
+ * @note Values compare by storage class and bytes (integral reals
+ *       equal integers); text uses binary collation
+ */
+int dup_find(job_td *job, const char *filename, const char *table,
+        char **cols, int ncols, int nparts, dup_result_td *out);
+
+/**
+ * @brief Free memory held by a duplicate search result
+ *
+ * @param r Result to clear (may be @c NULL)
+ */
+void dup_result_free(dup_result_td *r);
+
+
+#endif  /* ! DUP_H */
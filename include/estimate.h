@@ -0,0 +1,82 @@
+/**
+ * @file estimate.h
+ *
+ * @brief Estimate of the rows a filter matches, without running it
+ *
+ * The plan comes from @c EXPLAIN @c QUERY @c PLAN, so nothing is read
+ * but the schema and the statistics of @c ANALYZE.  The filter is split
+ * into the terms joined by @c AND; a term comparing a column with a
+ * literal (@c =, @c <, @c <=, @c >, @c >=, @c BETWEEN, @c IN,
+ * @c IS @c NULL) is estimated from the samples of @c sqlite_stat4 for
+ * an index on that column, or from the average rows per value of
+ * @c sqlite_stat1, and a range on the rowid from its first and last
+ * values.  Other terms are assumed to keep a quarter of the rows, as
+ * SQLite's planner does for terms it knows nothing about.  Terms are
+ * taken as independent.
+ */
+
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+/* External includes */
+#include <sqlite3.h>
+
+
+/**
+ * @enum estimate_basis_td
+ *
+ * @brief What an estimate is based on, from the least to the most
+ *        reliable
+ */
+typedef enum {
+    ESTIMATE_GUESS,     /**< No statistics for some term */
+    ESTIMATE_STAT1,     /**< Average rows per value (@c sqlite_stat1) */
+    ESTIMATE_STAT4      /**< Samples of the index (@c sqlite_stat4), or
+                             the range of the rowid */
+} estimate_basis_td;
+
+/**
+ * @struct estimate_td
+ *
+ * @brief Estimate of a filter on a table
+ */
+typedef struct {
+    double total;               /**< Rows of the table (from
+                                     @c sqlite_stat1, else the largest
+                                     rowid), or -1 if unknown */
+    double rows;                /**< Rows matching, or -1 if unknown */
+    double visited;             /**< Rows read to find the first ones
+                                     listed, or -1 if unknown */
+    estimate_basis_td basis;    /**< Least reliable source used */
+    int full_scan;              /**< Whether the table is scanned */
+    char *index;                /**< Index searched, or @c NULL */
+    char *plan;                 /**< Query plan */
+} estimate_td;
+
+
+/* Public interface */
+/**
+ * @brief Estimate the rows of a table matching a condition
+ *
+ * @param db        Open connection
+ * @param table     Table
+ * @param condition SQL condition (as in a @c WHERE clause)
+ * @param limit     Rows listed at most (for @e visited)
+ * @param out       Where to store the estimate (release with
+ *                  @a estimate_clear(), also on failure)
+ *
+ * @return @e SQLITE_OK on success, or the SQLite error code of
+ *         preparing the query (message with @a sqlite3_errmsg())
+ */
+int estimate_filter(sqlite3 *db, const char *table, const char *condition,
+        int limit, estimate_td *out);
+
+/**
+ * @brief Release the contents of an estimate
+ *
+ * @param e Estimate
+ */
+void estimate_clear(estimate_td *e);
+
+
+#endif  /* ! ESTIMATE_H */
@@ -0,0 +1,67 @@
+/**
+ * @file extract.h
+ *
+ * @brief Parallel extraction of the BLOBs of a column to files
+ *
+ * The @e rowid range of the table is split in partitions, each one
+ * handled by its own thread on its own read-only connection.  Every
+ * BLOB is streamed with @a sqlite3_blob_read() in fixed size chunks to
+ * a file named after its @e rowid, so memory stays bounded and the
+ * threads keep several writes in flight.
+ */
+
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Project includes */
+#include <job.h>
+
+
+#define EXTRACT_MAX_THREADS (8)     /**< Upper bound of writer threads */
+#define EXTRACT_CHUNK (262144)      /**< Bytes per read and write */
+
+
+/**
+ * @struct extract_result_td
+ *
+ * @brief Outcome of an extraction
+ */
+typedef struct {
+    sqlite3_int64 nfiles;   /**< Files written */
+    sqlite3_int64 nbytes;   /**< Bytes written */
+    sqlite3_int64 nfailed;  /**< BLOBs that could not be read */
+    double seconds;         /**< Elapsed wall time */
+} extract_result_td;
+
+
+/* Public interface */
+/**
+ * @brief Write every BLOB of a column to a file in a directory
+ *
+ * Files are named @c <rowid>.<ext>, where the extension comes from the
+ * detected image format (see @a thumb_sniff()) or is @c bin.  Values
+ * of other types are skipped.
+ *
+ * @param job      Running job for progress and cancellation (may be
+ *                 @c NULL)
+ * @param filename Database file (opened read-only)
+ * @param table    Table holding the BLOBs (must have a @e rowid)
+ * @param column   Column holding the BLOBs
+ * @param dir      Existing directory to write to (files are replaced)
+ * @param nthreads Number of threads (clamped to
+ *                 [1, @e EXTRACT_MAX_THREADS])
+ * @param out      Where to store the outcome
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_INTERRUPT if cancelled,
+ *         @e SQLITE_CANTOPEN or @e SQLITE_IOERR if a file cannot be
+ *         written, or an SQLite error code otherwise
+ */
+int extract_blobs(job_td *job, const char *filename, const char *table,
+        const char *column, const char *dir, int nthreads,
+        extract_result_td *out);
+
+
+#endif  /* ! EXTRACT_H */
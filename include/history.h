@@ -0,0 +1,108 @@
+/**
+ * @file history.h
+ *
+ * @brief Persistent history of the ad-hoc queries
+ *
+ * Every run of the query editor is stored, with its timings, row
+ * count, virtual machine steps and query plan, in an SQLite database
+ * of its own under the user data directory.  Searches show, for each
+ * run, how its time compares with the previous run of the same SQL on
+ * the same database file and whether the plan changed, which points at
+ * queries that got slower after a data or schema change.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/* External includes */
+#include <gtk/gtk.h>
+
+/* Project includes */
+#include <query.h>
+
+
+#define HISTORY_MAX_RUNS (10000)    /**< Runs kept (oldest dropped) */
+
+
+/**
+ * @enum history_col_td
+ *
+ * @brief Columns of the store filled by @a history_search()
+ */
+typedef enum {
+    HISTORY_COL_WHEN,       /**< Local date and time of the run */
+    HISTORY_COL_DB,         /**< Database file */
+    HISTORY_COL_MS,         /**< Run time (ms, as text) */
+    HISTORY_COL_CHANGE,     /**< Time change since the previous run */
+    HISTORY_COL_ROWS,       /**< Rows returned (as text) */
+    HISTORY_COL_STEPS,      /**< Virtual machine steps (as text) */
+    HISTORY_COL_SQL,        /**< SQL text */
+    HISTORY_COL_PLAN,       /**< Query plan or error message */
+    HISTORY_NCOLS           /**< Number of columns */
+} history_col_td;
+
+
+/**
+ * @struct history_td
+ *
+ * @brief Opaque query history
+ */
+typedef struct history_td history_td;
+
+
+/* Public interface */
+/**
+ * @brief Open (creating it if needed) a query history
+ *
+ * @param path History database, or @c NULL for @c history.db in the
+ *             @c sqliteview directory of the user data directory
+ *
+ * @return History (release with @a history_close()), or @c NULL if it
+ *         cannot be opened
+ */
+history_td *history_open(const char *path);
+
+/**
+ * @brief Close a query history
+ *
+ * @param h History (may be @c NULL)
+ */
+void history_close(history_td *h);
+
+/**
+ * @brief Store a run of a query
+ *
+ * @param h        History (may be @c NULL, then it is a no-op)
+ * @param filename Database file the query ran on
+ * @param sql      SQL text
+ * @param stats    Measurements of the run
+ * @param error    Error message if the run failed, @c NULL otherwise
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int history_add(history_td *h, const char *filename, const char *sql,
+        const query_stats_td *stats, const char *error);
+
+/**
+ * @brief Create a store for @a history_search()
+ *
+ * @return New store with @e HISTORY_NCOLS string columns
+ */
+GtkListStore *history_store_new(void);
+
+/**
+ * @brief Find the runs whose SQL contains a text, newest first
+ *
+ * @param h     History
+ * @param text  Text to look for (case insensitive; empty or @c NULL
+ *              matches every run)
+ * @param limit Maximum number of runs
+ * @param store Store created by @a history_store_new() (cleared)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int history_search(history_td *h, const char *text, int limit,
+        GtkListStore *store);
+
+
+#endif  /* ! HISTORY_H */
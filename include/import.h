@@ -0,0 +1,50 @@
+/**
+ * @file import.h
+ *
+ * @brief Import of a file into a BLOB cell with incremental writes
+ *
+ * The cell is first resized with @c zeroblob(N), which allocates the
+ * space without building the value in memory, and the file is then
+ * streamed in with @a sqlite3_blob_write() in fixed size chunks, so
+ * memory use does not depend on the size of the file.
+ */
+
+#ifndef IMPORT_H
+#define IMPORT_H
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Project includes */
+#include <job.h>
+
+
+#define IMPORT_CHUNK (262144)   /**< Bytes per read and write */
+
+
+/* Public interface */
+/**
+ * @brief Replace the value of a cell with the content of a file
+ *
+ * Runs in one write transaction on its own connection: the cell keeps
+ * its old value if the import fails or is cancelled.
+ *
+ * @param job      Running job for progress and cancellation (may be
+ *                 @c NULL)
+ * @param filename Database file
+ * @param table    Table of the cell (must have a @e rowid)
+ * @param column   Column of the cell
+ * @param rowid    Row of the cell
+ * @param path     File to import
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_INTERRUPT if cancelled,
+ *         @e SQLITE_CANTOPEN or @e SQLITE_IOERR if the file cannot be
+ *         read, @e SQLITE_TOOBIG if it exceeds the length limit,
+ *         @e SQLITE_NOTFOUND if the row does not exist, or an SQLite
+ *         error code otherwise
+ */
+int import_blob_file(job_td *job, const char *filename, const char *table,
+        const char *column, sqlite3_int64 rowid, const char *path);
+
+
+#endif  /* ! IMPORT_H */
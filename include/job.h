@@ -0,0 +1,106 @@
+/**
+ * @file job.h
+ *
+ * @brief Background jobs running on a worker thread
+ *
+ * A job runs a function on its own thread, publishes its progress
+ * under a lock, and hands its result back to the GTK main loop through
+ * a completion callback.  Long database operations (scans, copies,
+ * extractions) run as jobs so the UI stays responsive.
+ *
+ * @note Workers must use their own database connections (see
+ *       @a db_open_reader()); the context handle belongs to the UI
+ */
+
+#ifndef JOB_H
+#define JOB_H
+
+/* External includes */
+#include <glib.h>
+
+
+/**
+ * @struct job_td
+ *
+ * @brief Opaque handle of a running background job
+ */
+typedef struct job_td job_td;
+
+/**
+ * @brief Job body, runs on the worker thread
+ *
+ * @param job  Handle of the running job (for progress and cancellation)
+ * @param data User data given to @a job_start()
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+typedef int (*job_run_fn)(job_td *job, void *data);
+
+/**
+ * @brief Completion callback, runs on the GTK main loop
+ *
+ * @param job  Handle of the finished job (freed after return)
+ * @param rc   Value returned by the job body
+ * @param data User data given to @a job_start()
+ */
+typedef void (*job_done_fn)(job_td *job, int rc, void *data);
+
+
+/* Public interface */
+/**
+ * @brief Start a background job on a new worker thread
+ *
+ * @param name Short name of the job (used for the thread name)
+ * @param run  Job body, executed on the worker thread
+ * @param done Completion callback executed on the main loop (may be
+ *             @c NULL)
+ * @param data User data passed to both callbacks
+ *
+ * @return Handle of the job, valid until @e done returns
+ */
+job_td *job_start(const char *name, job_run_fn run, job_done_fn done,
+        void *data);
+
+/**
+ * @brief Publish the progress of a job (thread-safe)
+ *
+ * @param job      Job handle (may be @c NULL, then it is a no-op)
+ * @param fraction Completed fraction in the range [0, 1]
+ * @param fmt      @c printf-like format of the status text (may be
+ *                 @c NULL to keep the previous text)
+ */
+void job_report(job_td *job, double fraction, const char *fmt, ...)
+    G_GNUC_PRINTF(3, 4);
+
+/**
+ * @brief Read the last published progress of a job (thread-safe)
+ *
+ * @param job  Job handle
+ * @param text Where to store a copy of the status text (caller must
+ *             @a g_free(); may be @c NULL)
+ *
+ * @return Completed fraction in the range [0, 1]
+ */
+double job_progress(job_td *job, char **text);
+
+/**
+ * @brief Request cancellation of a job (thread-safe)
+ *
+ * @param job Job handle
+ *
+ * @note The job body decides when to stop; the completion callback is
+ *       still called
+ */
+void job_cancel(job_td *job);
+
+/**
+ * @brief Check whether cancellation has been requested (thread-safe)
+ *
+ * @param job Job handle (may be @c NULL)
+ *
+ * @return 1 if the job should stop, 0 otherwise
+ */
+int job_is_cancelled(job_td *job);
+
+
+#endif  /* ! JOB_H */
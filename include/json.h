@@ -0,0 +1,144 @@
+/**
+ * @file json.h
+ *
+ * @brief Exploration of JSON cells with the JSON functions of SQLite
+ *
+ * A JSON cell is shown as a tree filled one level at a time: expanding
+ * a node runs @c json_each() on the path of the node, so only the
+ * levels looked at are parsed out of the cell and sent to the UI.
+ *
+ * A path can also be shown as a column of the rows view or used to
+ * filter it: both are @c json_extract() expressions pushed into the
+ * @c SELECT of the rows view, so SQLite evaluates them (and can use an
+ * index on the expression, which @a json_suggest_index() proposes when
+ * the filter has to scan the table).
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+/* External includes */
+#include <gtk/gtk.h>
+#include <sqlite3.h>
+
+
+#define JSON_MAX_CHILDREN (1000)    /**< Children listed per node */
+
+
+/**
+ * @enum json_col_td
+ *
+ * @brief Columns of the store filled by @a json_expand()
+ */
+typedef enum {
+    JSON_COL_KEY,       /**< Object key or array index */
+    JSON_COL_TYPE,      /**< JSON type, as given by @c json_each() */
+    JSON_COL_VALUE,     /**< Value, or size of an array or object */
+    JSON_COL_PATH,      /**< Full path (@c NULL on placeholder rows) */
+    JSON_NCOLS          /**< Number of columns */
+} json_col_td;
+
+/**
+ * @struct json_column_td
+ *
+ * @brief JSON path shown as a column of the rows view
+ */
+typedef struct {
+    char *column;   /**< Column holding the JSON */
+    char *path;     /**< Path in it (e.g. @c $.a.b[0]) */
+} json_column_td;
+
+
+/* Public interface */
+/**
+ * @brief Create a JSON path column
+ *
+ * @param column Column holding the JSON
+ * @param path   Path in it
+ *
+ * @return New path column (release with @a json_column_free())
+ */
+json_column_td *json_column_new(const char *column, const char *path);
+
+/**
+ * @brief Release a JSON path column
+ *
+ * @param data Path column (@e json_column_td *, may be @c NULL)
+ */
+void json_column_free(void *data);
+
+/**
+ * @brief Build the @c SELECT item of a JSON path column
+ *
+ * @param c Path column
+ *
+ * @return @c json_extract() expression named after the column and
+ *         path (free with @a sqlite3_free()), or @c NULL on allocation
+ *         error
+ */
+char *json_column_sql(const json_column_td *c);
+
+/**
+ * @brief Build a condition matching the rows whose JSON path holds a
+ *        value
+ *
+ * @param column Column holding the JSON
+ * @param path   Path in it
+ * @param type   JSON type of the value, as given by @c json_each()
+ * @param value  Value (as shown in @e JSON_COL_VALUE)
+ *
+ * @return Condition (free with @a sqlite3_free()), or @c NULL for
+ *         arrays, objects or on allocation error
+ */
+char *json_filter_sql(const char *column, const char *path,
+        const char *type, const char *value);
+
+/**
+ * @brief Create a store for @a json_expand()
+ *
+ * @return New tree store with @e JSON_NCOLS string columns
+ */
+GtkTreeStore *json_store_new(void);
+
+/**
+ * @brief List the children of a node of a JSON cell
+ *
+ * Arrays and objects get a placeholder child, replaced by their
+ * children when they are expanded; nodes already expanded are left
+ * as they are.  At most @e JSON_MAX_CHILDREN children are listed.
+ *
+ * @param db     Connection
+ * @param table  Table of the cell
+ * @param column Column of the cell
+ * @param rowid  Row of the cell
+ * @param store  Store created by @a json_store_new()
+ * @param parent Node to expand, or @c NULL for the top level (the
+ *               store is cleared)
+ *
+ * @return @e SQLITE_OK on success (a @c NULL cell or a missing row has
+ *         no children) or an SQLite error code (e.g. malformed JSON)
+ */
+int json_expand(sqlite3 *db, const char *table, const char *column,
+        sqlite3_int64 rowid, GtkTreeStore *store, GtkTreeIter *parent);
+
+/**
+ * @brief Propose an index for filtering a table by a JSON path
+ *
+ * Asks the query planner (without running anything) how the filter of
+ * @a json_filter_sql() would be run.
+ *
+ * @param db     Connection
+ * @param table  Table
+ * @param column Column holding the JSON
+ * @param path   Path in it
+ * @param sql    Where to store the @c CREATE @c INDEX statement (free
+ *               with @a sqlite3_free()), or @c NULL if the filter can
+ *               already use an index
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int json_suggest_index(sqlite3 *db, const char *table, const char *column,
+        const char *path, char **sql);
+
+
+#endif  /* ! JSON_H */
@@ -0,0 +1,148 @@
+/**
+ * @file overlay.h
+ *
+ * @brief Copy-on-write edits kept beside a read-only database
+ *
+ * In overlay mode the database is opened read-only, so browsing never
+ * takes a write lock, and edited cells are stored in a side database,
+ * the file named after it with @e OVERLAY_SUFFIX.  The rows view shows
+ * each edited cell over the base value, matched by table, column and
+ * rowid; filters and sorting still see the base values.
+ *
+ * Edits stay in the side file, across sessions, until applied: one
+ * @c BEGIN @c IMMEDIATE transaction on the base updates every edited
+ * cell, provided the cell still holds the value it had when first
+ * edited.  A cell changed (or a row deleted) by someone else meanwhile
+ * is a conflict, and the whole apply is rolled back.
+ */
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+/* External includes */
+#include <sqlite3.h>
+
+
+#define OVERLAY_SUFFIX "-overlay"   /**< Name of the side database after
+                                         the base one */
+
+
+/**
+ * @struct overlay_td
+ *
+ * @brief Opaque overlay of a database
+ */
+typedef struct overlay_td overlay_td;
+
+
+/* Public interface */
+/**
+ * @brief Open (or create) the overlay of a database file
+ *
+ * @param filename Base database file
+ * @param out      Where to store the overlay (release with
+ *                 @a overlay_close())
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int overlay_open(const char *filename, overlay_td **out);
+
+/**
+ * @brief Close an overlay, keeping its edits in the side file
+ *
+ * @param o Overlay (may be @c NULL)
+ */
+void overlay_close(overlay_td *o);
+
+/**
+ * @brief Get the message of the last error of the side database
+ *
+ * @param o Overlay
+ *
+ * @return Message
+ */
+const char *overlay_errmsg(const overlay_td *o);
+
+/**
+ * @brief Edit a cell
+ *
+ * The first edit of a cell also records its base value, against which
+ * @a overlay_apply() checks for conflicts.
+ *
+ * @param o      Overlay
+ * @param base   Read-only connection to the base database
+ * @param table  Table
+ * @param column Column
+ * @param rowid  Row
+ * @param text   New value (stored as text, as a direct edit would be)
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_NOTFOUND if there is no
+ *         such row, or an SQLite error code on failure
+ */
+int overlay_set_cell(overlay_td *o, sqlite3 *base, const char *table,
+        const char *column, sqlite3_int64 rowid, const char *text);
+
+/**
+ * @brief Tell whether a table has edited cells
+ *
+ * @param o     Overlay
+ * @param table Table
+ *
+ * @return Non-zero if it has
+ */
+int overlay_has_table(overlay_td *o, const char *table);
+
+/**
+ * @brief Get the edited value of a cell
+ *
+ * @param o      Overlay
+ * @param table  Table
+ * @param column Column
+ * @param rowid  Row
+ * @param text   Where to store the value (free with @a g_free())
+ *
+ * @return @e SQLITE_ROW if the cell is edited, @e SQLITE_DONE if not,
+ *         or an SQLite error code on failure
+ */
+int overlay_get_cell(overlay_td *o, const char *table, const char *column,
+        sqlite3_int64 rowid, char **text);
+
+/**
+ * @brief Count the edited cells
+ *
+ * @param o Overlay
+ *
+ * @return Number of cells, or -1 on error
+ */
+sqlite3_int64 overlay_count(overlay_td *o);
+
+/**
+ * @brief Write every edited cell to the base database in one
+ *        transaction, then forget the edits
+ *
+ * @param o         Overlay
+ * @param filename  Base database file
+ * @param applied   Where to store the number of cells written
+ * @param conflicts Where to store the number of cells changed in the
+ *                  base since they were first edited
+ * @param errmsg    Where to store the error message (free with
+ *                  @a g_free(); may be @c NULL)
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_ABORT if there were
+ *         conflicts (nothing is written), or an SQLite error code on
+ *         failure (e.g. @e SQLITE_BUSY if the base stayed locked)
+ */
+int overlay_apply(overlay_td *o, const char *filename, int *applied,
+        int *conflicts, char **errmsg);
+
+/**
+ * @brief Forget every edited cell
+ *
+ * @param o Overlay
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int overlay_discard(overlay_td *o);
+
+
+#endif  /* ! OVERLAY_H */
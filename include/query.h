@@ -0,0 +1,124 @@
+/**
+ * @file query.h
+ *
+ * @brief Execution of ad-hoc SQL typed in the query editor
+ *
+ * Every statement of the text is run in order; the rows of the last
+ * one returning columns are loaded into a list store of strings, and
+ * into a typed result cache to sort them by (see @e result.h).  Run
+ * time, rows returned, virtual machine steps and the query plan are
+ * collected for the query history (see @e history.h).
+ *
+ * The counters of @a sqlite3_stmt_status() (full scan steps, sorts,
+ * automatic indexes, virtual machine steps and statement memory) are
+ * collected too, by any code stepping statements for a view, with
+ * @a query_collect().  Built with @c SQLITE_ENABLE_STMT_SCANSTATUS
+ * (@c make @c SCANSTATUS=1, for a library built with it), the loops of
+ * each statement are listed with the rows they visited.
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+/* External includes */
+#include <gtk/gtk.h>
+#include <sqlite3.h>
+
+/* Project includes */
+#include <result.h>
+
+
+#define QUERY_MAX_ROWS (100000)     /**< Rows loaded into the result */
+
+
+/**
+ * @struct query_stats_td
+ *
+ * @brief Measurements of one run of a query
+ */
+typedef struct {
+    gint64 usec;            /**< Run time of all the statements (us) */
+    sqlite3_int64 nrows;    /**< Rows returned by the result statement */
+    sqlite3_int64 vm_steps; /**< Virtual machine steps of all of them */
+    sqlite3_int64 fullscan_steps;   /**< Steps of full table scans */
+    sqlite3_int64 sorts;    /**< Sort operations */
+    sqlite3_int64 autoindexes;  /**< Rows put in automatic indexes */
+    sqlite3_int64 memused;  /**< Memory of the largest statement */
+    char *plan;             /**< Query plan (free with @a g_free()) */
+    char *loops;            /**< Rows visited by each loop, or @c NULL
+                                 without scan status (free with
+                                 @a g_free()) */
+} query_stats_td;
+
+
+/* Public interface */
+/**
+ * @brief Add the counters of a statement to the measurements
+ *
+ * Call once the statement is done with, before finalizing it.
+ *
+ * @param stmt  Statement
+ * @param stats Measurements to add to
+ */
+void query_collect(sqlite3_stmt *stmt, query_stats_td *stats);
+
+/**
+ * @brief Describe the counters of the measurements in one line
+ *
+ * @param stats Measurements
+ * @param buf   Where to store the text
+ * @param len   Size of @e buf
+ */
+void query_describe_stats(const query_stats_td *stats, char *buf,
+        size_t len);
+
+/**
+ * @brief Release the texts of the measurements
+ *
+ * @param stats Measurements (zeroed)
+ */
+void query_stats_clear(query_stats_td *stats);
+
+/**
+ * @brief Describe the query plan of every statement of an SQL text
+ *
+ * Uses @c EXPLAIN @c QUERY @c PLAN, so nothing is executed.  Lines
+ * are indented to show the nesting of the plan; plans of several
+ * statements are separated by a blank line.
+ *
+ * @param db  Open connection
+ * @param sql SQL text
+ * @param out Where to store the plan (free with @a g_free())
+ *
+ * @return @e SQLITE_OK on success, or an SQLite error code if a
+ *         statement cannot be prepared
+ */
+int query_plan(sqlite3 *db, const char *sql, char **out);
+
+/**
+ * @brief Run the statements of an SQL text
+ *
+ * The plan is taken before running, so it matches what ran even if a
+ * statement changes the schema.  Statements stop at the first error;
+ * its message is available with @a sqlite3_errmsg().
+ *
+ * @param db     Open connection
+ * @param sql    SQL text
+ * @param store  Where to store the rows of the last statement that
+ *               returns columns (@c NULL if none does; one string
+ *               column per result column, at most @e QUERY_MAX_ROWS
+ *               rows)
+ * @param result Where to store the same rows with their types (@c NULL
+ *               if none; free with @a result_free())
+ * @param names  Where to store the names of the result columns (a
+ *               @c NULL terminated vector, free with @a g_strfreev())
+ * @param stats  Where to store the measurements (release with
+ *               @a query_stats_clear(), also on failure)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int query_run(sqlite3 *db, const char *sql, GtkListStore **store,
+        result_td **result, char ***names, query_stats_td *stats);
+
+
+#endif  /* ! QUERY_H */
@@ -0,0 +1,67 @@
+/**
+ * @file recover.h
+ *
+ * @brief Recovery of damaged databases into a new file
+ *
+ * When built with the SQLite recovery extension (@c RECOVER_DIR, see
+ * the Makefile) the whole file is handed to @a sqlite3_recover, which
+ * also finds orphaned pages.  Otherwise a built-in salvage copies the
+ * schema and then every table in @e rowid batches, stepping over the
+ * ranges that fail with @e SQLITE_CORRUPT.
+ *
+ * @note Both run as background jobs and report what could not be read
+ */
+
+#ifndef RECOVER_H
+#define RECOVER_H
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Project includes */
+#include <job.h>
+
+
+#define RECOVER_BATCH_ROWS (2000)   /**< Rows copied per transaction */
+
+
+/**
+ * @struct recover_result_td
+ *
+ * @brief Outcome of a recovery
+ */
+typedef struct {
+    sqlite3_int64 nrows;    /**< Rows written to the new database */
+    int ntables;            /**< Tables (fully or partly) recovered */
+    int nlost;              /**< Unreadable ranges or schema objects */
+    char *report;           /**< Human-readable report (may be @c NULL) */
+} recover_result_td;
+
+
+/* Public interface */
+/**
+ * @brief Recover the readable content of a database into a new file
+ *
+ * @param job Running job for progress and cancellation (may be
+ *            @c NULL)
+ * @param src Path of the damaged database (opened read-only)
+ * @param dst Path of the database to create (replaced if it exists)
+ * @param out Where to store the result (release it with
+ *            @a recover_result_free())
+ *
+ * @return @e SQLITE_OK if a database was written (even partially),
+ *         @e SQLITE_INTERRUPT if cancelled, or an SQLite error code
+ *         otherwise (@e out->report may explain it)
+ */
+int recover_database(job_td *job, const char *src, const char *dst,
+        recover_result_td *out);
+
+/**
+ * @brief Free memory held by a recovery result
+ *
+ * @param r Result to clear (may be @c NULL)
+ */
+void recover_result_free(recover_result_td *r);
+
+
+#endif  /* ! RECOVER_H */
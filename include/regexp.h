@@ -0,0 +1,36 @@
+/**
+ * @file regexp.h
+ *
+ * @brief @c REGEXP operator for SQLite connections
+ *
+ * SQLite parses <tt>X REGEXP Y</tt> as a call to @c regexp(Y, X) but
+ * defines no such function.  This one uses GLib's Perl-compatible
+ * regular expressions (unanchored, as @c grep), compiled with
+ * @c G_REGEX_OPTIMIZE so PCRE can JIT-compile them.  A constant pattern
+ * is compiled once per statement and kept with
+ * @a sqlite3_set_auxdata() for the following rows.
+ */
+
+#ifndef REGEXP_H
+#define REGEXP_H
+
+/* External includes */
+#include <sqlite3.h>
+
+
+/* Public interface */
+/**
+ * @brief Register the @c regexp() function on a connection
+ *
+ * The pattern is the first argument and the text the second; either
+ * being @c NULL gives @c NULL.  An invalid pattern fails the statement
+ * with the message of the regular expression compiler.
+ *
+ * @param db Open connection
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int regexp_register(sqlite3 *db);
+
+
+#endif  /* ! REGEXP_H */
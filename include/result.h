@@ -0,0 +1,128 @@
+/**
+ * @file result.h
+ *
+ * @brief Typed cache of the rows of a query result, sortable by column
+ *
+ * Rows are copied from the statement as they are stepped into blocks
+ * of @e RESULT_BLOCK_ROWS rows holding the SQLite type and value of
+ * each cell (text and BLOBs in a byte arena per block), so a result
+ * can be sorted again without running its query.
+ *
+ * Sorting never compares display strings: each row gets a 64-bit key
+ * (its storage class and an order-preserving prefix of its value) and
+ * only keys and row indices are moved.  Parts of the rows are radix
+ * sorted by key on their own threads and merged pairwise, also in
+ * parallel; runs of equal keys are then sorted by the next bytes of
+ * their text or BLOBs, or by value, the only time values are looked
+ * up.  The order is the one of SQLite's @c ORDER @c BY with the
+ * @c BINARY collation, ties kept in result order.
+ */
+
+#ifndef RESULT_H
+#define RESULT_H
+
+/* External includes */
+#include <glib.h>
+#include <sqlite3.h>
+
+
+#define RESULT_BLOCK_ROWS (4096)        /**< Rows of a block */
+#define RESULT_MAX_PARTITIONS (8)       /**< Upper bound of sort threads */
+#define RESULT_MIN_PARTITION (32768)    /**< Rows worth a sort thread */
+
+
+/**
+ * @struct result_td
+ *
+ * @brief Opaque typed result cache
+ */
+typedef struct result_td result_td;
+
+
+/* Public interface */
+/**
+ * @brief Create an empty result cache
+ *
+ * @param ncols Number of columns
+ *
+ * @return New cache (release with @a result_free())
+ */
+result_td *result_new(int ncols);
+
+/**
+ * @brief Release a result cache
+ *
+ * @param r Cache (may be @c NULL)
+ */
+void result_free(result_td *r);
+
+/**
+ * @brief Copy the current row of a statement to the end of the cache
+ *
+ * @param r    Cache
+ * @param stmt Statement on a row, with as many columns as the cache
+ */
+void result_append(result_td *r, sqlite3_stmt *stmt);
+
+/**
+ * @brief Get the number of rows of the cache
+ *
+ * @param r Cache
+ *
+ * @return Number of rows
+ */
+guint32 result_count(const result_td *r);
+
+/**
+ * @brief Get the memory held by the cache
+ *
+ * @param r Cache
+ *
+ * @return Bytes
+ */
+size_t result_size(const result_td *r);
+
+/**
+ * @brief Get the SQLite type of a cell
+ *
+ * @param r   Cache
+ * @param row Row, less than @a result_count()
+ * @param col Column
+ *
+ * @return @e SQLITE_INTEGER, @e SQLITE_FLOAT, @e SQLITE_TEXT,
+ *         @e SQLITE_BLOB or @e SQLITE_NULL
+ */
+int result_type(const result_td *r, guint32 row, int col);
+
+/**
+ * @brief Get a cell as text, as @a sqlite3_column_text() gives it
+ *
+ * @param r   Cache
+ * @param row Row, less than @a result_count()
+ * @param col Column
+ *
+ * @return Text (free with @a g_free()), or @c NULL for @c NULL
+ */
+char *result_text(const result_td *r, guint32 row, int col);
+
+/**
+ * @brief Sort the rows of the cache by a column
+ *
+ * The cache itself is not changed: the order is given as row indices.
+ *
+ * @param r          Cache
+ * @param col        Column
+ * @param descending Non-zero for descending order (@c NULL values last)
+ * @param nparts     Threads to sort with (clamped to [1,
+ *                   @e RESULT_MAX_PARTITIONS]; fewer for small results)
+ * @param order      Where to store the indices of the rows in sorted
+ *                   order (@a result_count() entries)
+ *
+ * @return @e SQLITE_OK on success, or @e SQLITE_MISUSE for invalid
+ *         inputs
+ */
+int result_sort(const result_td *r, int col, int descending, int nparts,
+        guint32 *order);
+
+
+#endif  /* ! RESULT_H */
@@ -0,0 +1,126 @@
+/**
+ * @file rowcache.h
+ *
+ * @brief Blocks of rows shared by every view of the same database file
+ *
+ * A block is the typed result (see @e result.h) of a query on a file,
+ * found again by the query text and the identity of the file: its
+ * device and inode, so that any path or connection to it finds the
+ * same blocks, and its version.  The version is the file change
+ * counter of the database header, which every commit in rollback
+ * journal mode increments, along with the size and modification time
+ * of the database and of its @c -wal file, which commits in WAL mode
+ * change instead.
+ *
+ * Once a file is seen with another version, all of its blocks are
+ * dropped at once, whichever view finds out.  Blocks in use stay
+ * valid until released; the least recently used ones are dropped
+ * beyond @e ROWCACHE_MAX_BYTES.  Queries are taken as deterministic: a
+ * condition calling @c random() gets the rows of its first run until
+ * the file changes.
+ *
+ * All functions are thread-safe.
+ */
+
+#ifndef ROWCACHE_H
+#define ROWCACHE_H
+
+/* System includes */
+#include <stddef.h>
+
+/* External includes */
+#include <glib.h>
+
+/* Project includes */
+#include <result.h>
+
+
+#define ROWCACHE_MAX_BYTES (32 << 20)   /**< Memory held by blocks */
+
+
+/**
+ * @struct rowcache_id_td
+ *
+ * @brief Identity and version of a database file
+ */
+typedef struct {
+    guint64 dev;            /**< Device */
+    guint64 ino;            /**< Inode */
+    guint32 counter;        /**< File change counter of the header */
+    gint64 size;            /**< Size of the database */
+    gint64 mtime;           /**< Its modification time (ns) */
+    gint64 wal_size;        /**< Size of the @c -wal file, or -1 */
+    gint64 wal_mtime;       /**< Its modification time (ns), or 0 */
+} rowcache_id_td;
+
+/**
+ * @struct rowcache_block_td
+ *
+ * @brief Opaque reference to a cached block
+ */
+typedef struct rowcache_block_td rowcache_block_td;
+
+
+/* Public interface */
+/**
+ * @brief Read the identity and version of a database file
+ *
+ * @param filename Database file
+ * @param id       Where to store them
+ *
+ * @return @e SQLITE_OK on success, or @e SQLITE_CANTOPEN if the file
+ *         cannot be read
+ */
+int rowcache_identify(const char *filename, rowcache_id_td *id);
+
+/**
+ * @brief Find the block of a query on a file
+ *
+ * @param id  Identity and version of the file
+ * @param key Query text
+ *
+ * @return Reference to the block (release with @a rowcache_unref()),
+ *         or @c NULL if it is not cached for this version
+ */
+rowcache_block_td *rowcache_get(const rowcache_id_td *id, const char *key);
+
+/**
+ * @brief Cache the block of a query on a file
+ *
+ * A block cached for the same query and version meanwhile is
+ * replaced.  Nothing is cached when another version of the file was
+ * seen since @e id was read.
+ *
+ * @param id   Identity and version of the file
+ * @param key  Query text
+ * @param rows Rows of the query (owned by the cache from then on)
+ *
+ * @return Reference to the block (release with @a rowcache_unref()),
+ *         or @c NULL if it was not cached (@e rows are freed)
+ */
+rowcache_block_td *rowcache_put(const rowcache_id_td *id, const char *key,
+        result_td *rows);
+
+/**
+ * @brief Get the rows of a block
+ *
+ * @param b Block
+ *
+ * @return Rows (valid until the block is released)
+ */
+const result_td *rowcache_rows(const rowcache_block_td *b);
+
+/**
+ * @brief Release a reference to a block
+ *
+ * @param b Block (may be @c NULL)
+ */
+void rowcache_unref(rowcache_block_td *b);
+
+/**
+ * @brief Drop every block not in use
+ */
+void rowcache_clear(void);
+
+
+#endif  /* ! ROWCACHE_H */
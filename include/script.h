@@ -0,0 +1,72 @@
+/**
+ * @file script.h
+ *
+ * @brief Streaming execution of SQL script files
+ *
+ * The script is mapped into memory and walked one statement at a time
+ * with the tail pointer of @a sqlite3_prepare_v2(), which is given a
+ * small window of the file that only grows for statements longer than
+ * it.  Pages already executed are released from the mapping, so memory
+ * use does not depend on the size of the script but on its longest
+ * statement.
+ *
+ * Statements run in batches of @e SCRIPT_BATCH per transaction, unless
+ * the script manages its own transactions: batches are committed
+ * before @c BEGIN, @c COMMIT, @c SAVEPOINT, @c VACUUM, @c ATTACH,
+ * @c PRAGMA and similar statements, and none is opened while a
+ * transaction of the script is open.
+ */
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Project includes */
+#include <job.h>
+
+
+#define SCRIPT_BATCH (10000)    /**< Statements per batch transaction */
+#define SCRIPT_WINDOW (4096)    /**< First bytes given to the parser */
+
+
+/**
+ * @struct script_result_td
+ *
+ * @brief Outcome of a script run
+ */
+typedef struct {
+    sqlite3_int64 nstatements;  /**< Statements executed */
+    sqlite3_int64 offset;       /**< Bytes executed (or failing offset) */
+    sqlite3_int64 size;         /**< Size of the script */
+    sqlite3_int64 line;         /**< Line of the failing statement */
+    double seconds;             /**< Elapsed wall time */
+    char error[256];            /**< Message of the failure */
+} script_result_td;
+
+
+/* Public interface */
+/**
+ * @brief Execute every statement of an SQL script file
+ *
+ * Runs on its own read-write connection.  Execution stops at the first
+ * failing statement; its batch is rolled back, earlier batches stay
+ * committed and @e out tells where it stopped.  A transaction the
+ * script leaves open is rolled back, as in the @c sqlite3 shell.
+ *
+ * @param job      Running job for progress and cancellation (may be
+ *                 @c NULL)
+ * @param filename Database file
+ * @param path     SQL script file
+ * @param out      Where to store the outcome
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_INTERRUPT if cancelled,
+ *         @e SQLITE_CANTOPEN or @e SQLITE_IOERR if the script cannot be
+ *         read, or the error code of the failing statement
+ */
+int script_run_file(job_td *job, const char *filename, const char *path,
+        script_result_td *out);
+
+
+#endif  /* ! SCRIPT_H */
@@ -0,0 +1,57 @@
+/**
+ * @file serve.h
+ *
+ * @brief Read-only HTTP/JSON access to a database, without a window
+ *
+ * Started with @c --serve @c FILE @c [PORT], the viewer answers @c GET
+ * requests on the loopback interface only:
+ *
+ *   - @c /tables lists the tables and views;
+ *   - @c /tables/NAME/schema gives the columns and @c CREATE statement;
+ *   - @c /tables/NAME/rows?after=ROWID&limit=N gives up to @e N rows
+ *     (at most @e SERVE_PAGE_MAX) with a rowid greater than @e ROWID,
+ *     and the @c after of the next page, or @c null on the last one.
+ *
+ * Pages are found by rowid (keyset paging), so any page costs the same
+ * however deep it is.  Bodies are streamed in chunks as rows are
+ * stepped, so a page is never held whole in memory.  Requests are
+ * answered concurrently, each on a read-only connection taken from a
+ * pool of @e SERVE_POOL_SIZE.
+ *
+ * Every response carries an @c ETag that changes whenever the database
+ * is committed to, taken from the version of the file that every
+ * connection shares (see @e rowcache.h); a request with a matching
+ * @c If-None-Match gets @c 304 without a body.
+ */
+
+#ifndef SERVE_H
+#define SERVE_H
+
+/* External includes */
+#include <glib.h>
+
+
+#define SERVE_DEFAULT_PORT (8642)   /**< Port used if none is given */
+#define SERVE_POOL_SIZE (4)         /**< Read-only connections */
+#define SERVE_MAX_THREADS (16)      /**< Requests handled at once */
+#define SERVE_PAGE_DEFAULT (100)    /**< Rows of a page by default */
+#define SERVE_PAGE_MAX (1000)       /**< Maximum rows of a page */
+
+
+/* Public interface */
+/**
+ * @brief Answer HTTP requests on a database until interrupted
+ *
+ * Listens on @c 127.0.0.1 and returns on @c SIGINT or @c SIGTERM.
+ *
+ * @param filename Database file
+ * @param port     TCP port (0 for any free one, printed on start)
+ *
+ * @return @e SQLITE_OK after an interruption, @e SQLITE_CANTOPEN if the
+ *         port cannot be listened on, or the SQLite error code of
+ *         opening the database
+ */
+int serve_run(const char *filename, guint16 port);
+
+
+#endif  /* ! SERVE_H */
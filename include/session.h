@@ -0,0 +1,87 @@
+/**
+ * @file session.h
+ *
+ * @brief Recording of user sessions and their replay as workloads
+ *
+ * A session file has one event per line: the milliseconds since the
+ * recording started, the operation and its arguments, separated by
+ * tabs and escaped with @a g_strescape().  Operations are @c open
+ * (file), @c table (name), @c scroll (first visible row), @c edit
+ * (column index, rowid, text), @c insert, @c delete (rowids),
+ * @c fetch (rowid, first column, number of columns), @c filter
+ * (condition on the rows, empty for none) and @c seek (column and SQL
+ * literal of the first value, both empty for none).  A @c filter or
+ * @c seek applies to the rows shown by the @c table event that
+ * follows it.
+ *
+ * The replayer reruns the database operations behind each event on a
+ * copy of the database and reports how long each one took.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+/* System includes */
+#include <stdio.h>
+
+/* External includes */
+#include <glib.h>
+
+
+/**
+ * @struct session_td
+ *
+ * @brief Opaque session recorder
+ */
+typedef struct session_td session_td;
+
+
+/* Public interface */
+/**
+ * @brief Start recording a session to a file
+ *
+ * @param path File to write (replaced if it exists)
+ *
+ * @return New recorder (release with @a session_close()), or @c NULL
+ *         if the file cannot be created
+ */
+session_td *session_record(const char *path);
+
+/**
+ * @brief Stop recording and close the session file
+ *
+ * @param ss Recorder (may be @c NULL)
+ */
+void session_close(session_td *ss);
+
+/**
+ * @brief Append an event to the session file
+ *
+ * @param ss Recorder (may be @c NULL, then it is a no-op)
+ * @param op Operation name
+ * @param ... Arguments as strings, terminated by @c NULL
+ */
+void session_log(session_td *ss, const char *op, ...)
+    G_GNUC_NULL_TERMINATED;
+
+/**
+ * @brief Replay the database operations of a session file with timing
+ *
+ * Every database the session opens is first copied to a temporary
+ * file, so edits, insertions and deletions do not touch the original.
+ * One line per event and a summary per operation are written to
+ * @e out.
+ *
+ * @param path Session file
+ * @param out  Where to write the timings (e.g. @c stdout)
+ *
+ * @return @e SQLITE_OK if every event replayed, or the first SQLite
+ *         error code otherwise (replay goes on after errors)
+ *
+ * @note Needs GTK initialized, as the rows are loaded into a (hidden)
+ *       rows view exactly as in the application
+ */
+int session_replay(const char *path, FILE *out);
+
+
+#endif  /* ! SESSION_H */
@@ -0,0 +1,196 @@
+/**
+ * @file spatial.h
+ *
+ * @brief Browsing of spatial tables by bounding-box window
+ *
+ * Rows are read through an R*Tree: either the table is an R*Tree
+ * virtual table, or it has coordinate columns (@c x/y, @c lon/lat,
+ * @c lng/lat or @c longitude/latitude) indexed by an R*Tree named
+ * @c <table>_rtree, which @a spatial_build_index() creates and keeps up
+ * to date with triggers.
+ *
+ * Only the items of the window shown are kept.  Moving the window
+ * queries the R*Tree for the strips it uncovers (at most four) and
+ * drops the items it leaves; zooming in queries nothing.  The cost of
+ * a pan is then the number of new items, not of the items shown or in
+ * the table.  Windows holding more than @e SPATIAL_MAX_ITEMS items are
+ * truncated and read whole again when zoomed into, and any change to
+ * the database makes the next move read the window whole.
+ *
+ * R*Tree coordinates are 32-bit floats rounded outwards, so items just
+ * outside a window may be listed.
+ */
+
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Project includes */
+#include <job.h>
+
+
+#define SPATIAL_MAX_ITEMS (200000)  /**< Items kept for a window */
+
+
+/**
+ * @struct spatial_box_td
+ *
+ * @brief Bounding box (closed intervals)
+ */
+typedef struct {
+    double x0;  /**< Minimum X */
+    double x1;  /**< Maximum X */
+    double y0;  /**< Minimum Y */
+    double y1;  /**< Maximum Y */
+} spatial_box_td;
+
+/**
+ * @struct spatial_item_td
+ *
+ * @brief Item of a window
+ */
+typedef struct {
+    sqlite3_int64 id;   /**< R*Tree id (rowid of a table with columns) */
+    spatial_box_td box; /**< Bounding box (a point for coordinates) */
+} spatial_item_td;
+
+/**
+ * @struct spatial_source_td
+ *
+ * @brief Where the items of a table are read from
+ */
+typedef struct {
+    char *table;    /**< Table browsed */
+    char *rtree;    /**< R*Tree queried, or @c NULL until one is built */
+    char *cols[4];  /**< Its minimum X, maximum X, minimum Y and maximum
+                         Y columns */
+    int ndims;      /**< Dimensions of the R*Tree (2 or more) */
+    int integer;    /**< Non-zero for an @c rtree_i32 */
+    char *xcol;     /**< X column of a table with coordinates, or @c NULL
+                         for an R*Tree table */
+    char *ycol;     /**< Y column of a table with coordinates */
+} spatial_source_td;
+
+/**
+ * @struct spatial_td
+ *
+ * @brief Opaque window over a spatial source
+ */
+typedef struct spatial_td spatial_td;
+
+
+/* Public interface */
+/**
+ * @brief Find how a table can be browsed spatially
+ *
+ * @param db    Connection
+ * @param table Table
+ * @param src   Where to describe the source (release with
+ *              @a spatial_source_clear())
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_NOTFOUND if the table is
+ *         neither an R*Tree nor has coordinate columns, or an SQLite
+ *         error code
+ */
+int spatial_find_source(sqlite3 *db, const char *table,
+        spatial_source_td *src);
+
+/**
+ * @brief Release the strings of a spatial source
+ *
+ * @param src Source (may be @c NULL)
+ */
+void spatial_source_clear(spatial_source_td *src);
+
+/**
+ * @brief Create the R*Tree index of a table with coordinate columns
+ *
+ * Creates @c <table>_rtree, fills it from the rows with both
+ * coordinates in one transaction on its own read-write connection, and
+ * adds triggers keeping it up to date with inserts, updates and
+ * deletes.
+ *
+ * @param job      Running job for progress and cancellation (may be
+ *                 @c NULL)
+ * @param filename Database file
+ * @param src      Source found by @a spatial_find_source() with
+ *                 @e src->xcol set
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_INTERRUPT if cancelled
+ *         (nothing is created), or an SQLite error code
+ */
+int spatial_build_index(job_td *job, const char *filename,
+        const spatial_source_td *src);
+
+/**
+ * @brief Create an (empty) window over a spatial source
+ *
+ * @param db  Connection (used by the window until it is released)
+ * @param src Source with @e src->rtree set (copied)
+ * @param out Where to store the window (release with
+ *            @a spatial_free())
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int spatial_new(sqlite3 *db, const spatial_source_td *src,
+        spatial_td **out);
+
+/**
+ * @brief Release a window
+ *
+ * @param sp Window (may be @c NULL)
+ */
+void spatial_free(spatial_td *sp);
+
+/**
+ * @brief Get the bounding box of every item of the source
+ *
+ * Read from the root node of the R*Tree, without scanning it.
+ *
+ * @param sp  Window
+ * @param out Where to store the box
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_NOTFOUND if the source is
+ *         empty, or an SQLite error code
+ */
+int spatial_extent(spatial_td *sp, spatial_box_td *out);
+
+/**
+ * @brief Move the window, reading only what it uncovers
+ *
+ * @param sp  Window
+ * @param win New window
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ *         (the window is then empty)
+ */
+int spatial_window(spatial_td *sp, const spatial_box_td *win);
+
+/**
+ * @brief Get the items of the window
+ *
+ * @param sp       Window
+ * @param n        Where to store the number of items
+ * @param complete Where to store whether they are all the items of the
+ *                 window (0 if truncated at @e SPATIAL_MAX_ITEMS), or
+ *                 @c NULL
+ *
+ * @return Items (valid until the window moves)
+ */
+const spatial_item_td *spatial_items(const spatial_td *sp, int *n,
+        int *complete);
+
+/**
+ * @brief Get the cost of the last move of the window
+ *
+ * @param sp       Window
+ * @param nqueries Where to store the number of R*Tree queries run
+ * @param nread    Where to store the number of items read
+ */
+void spatial_last_cost(const spatial_td *sp, int *nqueries,
+        sqlite3_int64 *nread);
+
+
+#endif  /* ! SPATIAL_H */
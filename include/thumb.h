@@ -0,0 +1,113 @@
+/**
+ * @file thumb.h
+ *
+ * @brief Thumbnails of image BLOB cells decoded on a worker pool
+ *
+ * Image cells are recognized from a short prefix of the BLOB (magic
+ * bytes) while the rows are loaded, and marked in the cache.  The
+ * thumbnail of a marked cell is decoded the first time the cell is
+ * drawn: a worker thread streams the BLOB with @a sqlite3_blob_read()
+ * into a pixbuf loader scaled to @e THUMB_SIZE, and the result lands
+ * in a bounded LRU cache on the main loop.  Workers reuse reader
+ * connections to the file between decodes, rather than opening one
+ * (and parsing the schema) per thumbnail.
+ */
+
+#ifndef THUMB_H
+#define THUMB_H
+
+/* External includes */
+#include <gtk/gtk.h>
+#include <sqlite3.h>
+
+
+#define THUMB_SIZE (64)             /**< Thumbnail bounding box (px) */
+#define THUMB_CACHE_CAPACITY (256)  /**< Thumbnails kept in memory */
+#define THUMB_MAX_WORKERS (4)       /**< Upper bound of decoding threads */
+#define THUMB_SNIFF_BYTES (16)      /**< Prefix read to detect images */
+
+
+/**
+ * @struct thumb_cache_td
+ *
+ * @brief Opaque thumbnail cache and decoding pool
+ */
+typedef struct thumb_cache_td thumb_cache_td;
+
+/**
+ * @brief Callback run on the main loop when new thumbnails are ready
+ *
+ * @param data User data given to @a thumb_cache_new()
+ */
+typedef void (*thumb_ready_fn)(void *data);
+
+
+/* Public interface */
+/**
+ * @brief Create a thumbnail cache with its decoding pool
+ *
+ * @param ready Callback run when thumbnails are ready (e.g. to redraw
+ *              the rows view; may be @c NULL)
+ * @param data  User data for @e ready
+ *
+ * @return New cache (release with @a thumb_cache_free())
+ */
+thumb_cache_td *thumb_cache_new(thumb_ready_fn ready, void *data);
+
+/**
+ * @brief Free the cache, waiting for running decodes to finish
+ *
+ * @param c Cache (may be @c NULL)
+ *
+ * @note Call only after the main loop has stopped
+ */
+void thumb_cache_free(thumb_cache_td *c);
+
+/**
+ * @brief Forget all thumbnails and marks and start a new table
+ *
+ * @param c        Cache (may be @c NULL)
+ * @param filename Database file of the table
+ * @param table    Table whose cells will be marked
+ * @param colnames Column names of the rows view (index 0 is @e rowid)
+ * @param ncols    Number of entries in @e colnames
+ *
+ * @note Decodes still running for the previous table are discarded
+ */
+void thumb_cache_reset(thumb_cache_td *c, const char *filename,
+        const char *table, char **colnames, int ncols);
+
+/**
+ * @brief Detect an image format from the first bytes of a BLOB
+ *
+ * @param prefix First bytes of the BLOB
+ * @param n      Number of bytes in @e prefix
+ *
+ * @return Format name (e.g. @c "PNG") or @c NULL if not an image
+ */
+const char *thumb_sniff(const unsigned char *prefix, int n);
+
+/**
+ * @brief Mark a cell as holding an image
+ *
+ * @param c      Cache (may be @c NULL)
+ * @param colidx Column index in the rows view
+ * @param rowid  Row holding the image
+ */
+void thumb_cache_mark(thumb_cache_td *c, int colidx, sqlite3_int64 rowid);
+
+/**
+ * @brief Get the thumbnail of a cell, scheduling its decode if needed
+ *
+ * @param c      Cache (may be @c NULL)
+ * @param colidx Column index in the rows view
+ * @param rowid  Row of the cell
+ *
+ * @return Borrowed pixbuf, or @c NULL if the cell is not an image or
+ *         its thumbnail is not ready (yet)
+ */
+GdkPixbuf *thumb_cache_get(thumb_cache_td *c, int colidx,
+        sqlite3_int64 rowid);
+
+
+#endif  /* ! THUMB_H */
@@ -0,0 +1,149 @@
+/**
+ * @file timeline.h
+ *
+ * @brief Row density over time of a table with an indexed timestamp
+ *
+ * A timestamp column is the first column of an index (not a partial
+ * one) declared as @c DATE, @c DATETIME or @c TIMESTAMP, or named like
+ * one (@c time, @c date, @c stamp, @c ts, @c ..._at).  Its values are
+ * either ISO-8601 text or numbers: Unix time in seconds, milliseconds,
+ * microseconds or nanoseconds, or Julian day numbers.
+ *
+ * The range of the column is read with two index seeks, so a timeline
+ * is created at once whatever the size of the table.  The histogram of
+ * its @e TIMELINE_BUCKETS buckets is counted by @a timeline_count()
+ * (a job body) with one index range count per bucket, coarsely spread
+ * buckets first, so it takes shape long before it is complete.
+ *
+ * The rows view is moved to a point of the timeline by the condition
+ * @a timeline_seek() gives, which SQLite answers with an index range
+ * seek however many rows come before it.
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+/* System includes */
+#include <stddef.h>
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Project includes */
+#include <job.h>
+
+
+#define TIMELINE_BUCKETS (240)  /**< Buckets of the histogram */
+
+
+/**
+ * @struct timeline_td
+ *
+ * @brief Opaque timeline of a table
+ */
+typedef struct timeline_td timeline_td;
+
+
+/* Public interface */
+/**
+ * @brief Find the timestamp column of a table
+ *
+ * Columns with a date or time declared type win over those that only
+ * have a timestamp-like name.
+ *
+ * @param db     Open connection
+ * @param table  Table
+ * @param column Where to store the column name (@c NULL if the table
+ *               has none; free with @a g_free())
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+int timeline_find_column(sqlite3 *db, const char *table, char **column);
+
+/**
+ * @brief Create the timeline of a timestamp column
+ *
+ * @param db     Open connection
+ * @param table  Table
+ * @param column Timestamp column (see @a timeline_find_column())
+ * @param out    Where to store the timeline (release with
+ *               @a timeline_free()), with no bucket counted
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_EMPTY if the column has
+ *         no values, @e SQLITE_MISMATCH if they are not timestamps, or
+ *         an SQLite error code on failure
+ */
+int timeline_new(sqlite3 *db, const char *table, const char *column,
+        timeline_td **out);
+
+/**
+ * @brief Release a timeline
+ *
+ * @param t Timeline (may be @c NULL)
+ */
+void timeline_free(timeline_td *t);
+
+/**
+ * @brief Count the rows of every bucket (job body)
+ *
+ * Runs on its own read-only connection.  Counts are published as they
+ * are known (see @a timeline_counts()); a cancelled job leaves the
+ * remaining buckets uncounted.
+ *
+ * @param job      Job handle (for progress and cancellation; may be
+ *                 @c NULL)
+ * @param filename Database file
+ * @param t        Timeline
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_INTERRUPT if cancelled,
+ *         or an SQLite error code on failure
+ */
+int timeline_count(job_td *job, const char *filename, timeline_td *t);
+
+/**
+ * @brief Get the counts of the buckets known so far (thread-safe)
+ *
+ * @param t      Timeline
+ * @param counts Where to store the @e TIMELINE_BUCKETS counts, -1 for
+ *               buckets not counted yet
+ *
+ * @return Largest count
+ */
+sqlite3_int64 timeline_counts(timeline_td *t, sqlite3_int64 *counts);
+
+/**
+ * @brief Get the timestamp column of a timeline
+ *
+ * @param t Timeline
+ *
+ * @return Column name (owned by the timeline)
+ */
+const char *timeline_column(const timeline_td *t);
+
+/**
+ * @brief Describe the time at a point of a timeline
+ *
+ * @param t    Timeline
+ * @param frac Point, from 0 (first value) to 1 (last value)
+ * @param buf  Where to store the text (UTC, to the minute)
+ * @param len  Size of @e buf
+ */
+void timeline_describe(const timeline_td *t, double frac, char *buf,
+        size_t len);
+
+/**
+ * @brief Get the value at a point of a timeline as an SQL literal
+ *
+ * Rows from that point on are those where the timestamp column is
+ * greater than or equal to it.
+ *
+ * @param t    Timeline
+ * @param frac Point, from 0 (first value) to 1 (last value)
+ *
+ * @return Literal (free with @a sqlite3_free()), or @c NULL if out of
+ *         memory
+ */
+char *timeline_seek(const timeline_td *t, double frac);
+
+
+#endif  /* ! TIMELINE_H */
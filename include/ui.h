@@ -25,7 +25,7 @@
 void ui_build(context_td *s);
 
 /**
- * @brief Shutdown UI and release any resources (currently no-op)
+ * @brief Shutdown UI and release any resources
  *
  * @param s Pointer to the application context
  */
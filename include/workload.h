@@ -0,0 +1,69 @@
+/**
+ * @file workload.h
+ *
+ * @brief Concurrent replay of SQL statement logs
+ *
+ * A statement log has one statement per line, with tab separated
+ * fields escaped with @a g_strescape():
+ *
+ *     ms  session  sql  [param ...]
+ *
+ * where @e ms is the time the statement started (milliseconds since
+ * any origin), @e session identifies the client connection that ran
+ * it and every parameter is typed by its prefix: @c i:42, @c r:1.5,
+ * @c t:text, @c x:CAFE (BLOB in hex) or @c null.  Empty lines and
+ * lines starting with @c # are ignored.
+ *
+ * Every session gets a connection of its own, running its statements
+ * in log order, so their transactions keep their meaning: a connection
+ * shared by two sessions would run the writes of one inside the open
+ * transaction of the other.
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+/* System includes */
+#include <stdio.h>
+
+
+#define WORKLOAD_MAX_CONNS (64)     /**< Upper bound of connections */
+
+
+/* Public interface */
+/**
+ * @brief Replay a statement log on concurrent connections with timing
+ *
+ * The log is loaded first, then the database is copied to a temporary
+ * file (see @a db_copy_to_temp()) and the statements of each session are
+ * run on a read-write connection to the copy of its own, each one in
+ * its own thread.  Statements are released at their recorded time divided by
+ * @e speed, or as fast as the connections take them if @e speed is 0.
+ *
+ * Writes per statement text the number of runs, errors, latency
+ * percentiles and the time spent waiting on locks, followed by the
+ * totals: wall time, throughput, statements that failed with
+ * @e SQLITE_BUSY or @e SQLITE_LOCKED and the dispatch lag: how late
+ * statements started compared with their scheduled time or, if
+ * @e speed is 0, how long they queued for their connection.
+ *
+ * @param log      Statement log
+ * @param filename Database file (never modified)
+ * @param nconns   Most connections allowed (clamped to
+ *                 [1, @e WORKLOAD_MAX_CONNS])
+ * @param speed    Pace factor (1 is the recorded pace, 2 twice as
+ *                 fast, 0 no waits)
+ * @param out      Where to write the report (e.g. @c stdout)
+ *
+ * @return @e SQLITE_OK if the replay ran (statement errors are part of
+ *         the report), @e SQLITE_CANTOPEN if the log cannot be read,
+ *         @e SQLITE_FORMAT (with the line written to @e stderr) if a
+ *         line is malformed, @e SQLITE_RANGE (also told on @e stderr)
+ *         if the log has more sessions than @e nconns, or an SQLite
+ *         error code if the database cannot be copied or opened
+ */
+int workload_replay(const char *log, const char *filename, int nconns,
+        double speed, FILE *out);
+
+
+#endif  /* ! WORKLOAD_H */
@@ -0,0 +1,502 @@
+/**
+ * @file complete.c
+ *
+ * @brief Implementation of the index of schema names for SQL
+ *        autocompletion
+ */
+
+/* System includes */
+#include <string.h>
+
+/* External includes */
+#include <glib.h>
+
+/* Local includes */
+#include <complete.h>
+
+
+#define COMPLETE_NKINDS (5)     /**< Number of kinds of names */
+#define COMPLETE_NONE (0)   /**< No node (node 0, the root, is no child) */
+
+
+/**
+ * @struct s_node_td
+ *
+ * @brief Node of the trie, with its children as a list of siblings
+ *        sorted by byte
+ */
+typedef struct {
+    guint32 child;      /**< First child, or @e COMPLETE_NONE */
+    guint32 sibling;    /**< Next sibling, or @e COMPLETE_NONE */
+    gint32 entry;       /**< Name ending at this node, or -1 */
+    guchar byte;        /**< Byte (lowercase) leading to this node */
+} s_node_td;
+
+/**
+ * @struct s_entry_td
+ *
+ * @brief Name in the trie, with how many times it is used as each kind
+ */
+typedef struct {
+    char *name;                 /**< Name as first seen */
+    int refs[COMPLETE_NKINDS];  /**< Uses by kind (bit index) */
+} s_entry_td;
+
+/**
+ * @struct s_object_td
+ *
+ * @brief Table or view of the schema
+ */
+typedef struct {
+    char *sql;          /**< Definition in @c sqlite_master */
+    unsigned kind;      /**< @e COMPLETE_TABLE or @e COMPLETE_VIEW */
+    char *name;         /**< Name */
+    char **columns;     /**< Column names (@c NULL terminated) */
+    guint generation;   /**< Refresh that last saw it */
+} s_object_td;
+
+/**
+ * @struct complete_td
+ *
+ * @brief Completion index
+ */
+struct complete_td {
+    GArray *nodes;          /**< Nodes (@e s_node_td), root first */
+    GPtrArray *entries;     /**< Names (@e s_entry_td *) */
+    GHashTable *objects;    /**< Lowercase name to @e s_object_td * */
+    sqlite3 *db;            /**< Connection indexed */
+    char *filename;         /**< Database file indexed */
+    int schema_version;     /**< Schema version indexed, -1 if none */
+    guint generation;       /**< Number of schema reads */
+};
+
+
+/**
+ * @brief Release a table or view of the schema
+ *
+ * @param data Object (@e s_object_td *)
+ */
+static void s_object_free(gpointer data)
+{
+    s_object_td *obj = data;
+
+    g_free(obj->sql);
+    g_free(obj->name);
+    g_strfreev(obj->columns);
+    g_free(obj);
+}
+
+
+/**
+ * @brief Release a name of the trie
+ *
+ * @param data Entry (@e s_entry_td *)
+ */
+static void s_entry_free(gpointer data)
+{
+    s_entry_td *e = data;
+
+    g_free(e->name);
+    g_free(e);
+}
+
+
+/**
+ * @brief Empty the index, leaving only the root of the trie
+ *
+ * @param c Index
+ */
+static void s_reset(complete_td *c)
+{
+    s_node_td root = { COMPLETE_NONE, COMPLETE_NONE, -1, 0 };
+
+    g_array_set_size(c->nodes, 0);
+    g_array_append_val(c->nodes, root);
+    g_ptr_array_set_size(c->entries, 0);
+    g_hash_table_remove_all(c->objects);
+    g_free(c->filename);
+    c->filename = NULL;
+    c->db = NULL;
+    c->schema_version = -1;
+}
+
+
+/**
+ * @brief Find the child of a node for a byte, creating it if asked
+ *
+ * @param c      Index
+ * @param parent Parent node
+ * @param byte   Byte (lowercase)
+ * @param create Non-zero to create the child if missing
+ *
+ * @return Child node, or @e COMPLETE_NONE if missing and not created
+ */
+static guint32 s_child(complete_td *c, guint32 parent, guchar byte,
+        int create)
+{
+    guint32 prev = COMPLETE_NONE;
+    guint32 n = g_array_index(c->nodes, s_node_td, parent).child;
+
+    while (n != COMPLETE_NONE
+            && g_array_index(c->nodes, s_node_td, n).byte < byte) {
+        prev = n;
+        n = g_array_index(c->nodes, s_node_td, n).sibling;
+    }
+    if (n != COMPLETE_NONE
+            && g_array_index(c->nodes, s_node_td, n).byte == byte) {
+        return n;
+    }
+    if (!create) {
+        return COMPLETE_NONE;
+    }
+
+    /* Keep the siblings sorted, for alphabetical matches */
+    s_node_td node = { COMPLETE_NONE, n, -1, byte };
+    guint32 added = c->nodes->len;
+    g_array_append_val(c->nodes, node);
+    if (prev == COMPLETE_NONE) {
+        g_array_index(c->nodes, s_node_td, parent).child = added;
+    } else {
+        g_array_index(c->nodes, s_node_td, prev).sibling = added;
+    }
+
+    return added;
+}
+
+
+/**
+ * @brief Count a use of a name as a kind, or drop one
+ *
+ * Names whose uses drop to zero stay in the trie but are no longer
+ * matched, so dropping never moves nodes.
+ *
+ * @param c     Index
+ * @param name  Name
+ * @param kind  Kind of use (one @e complete_kind_td bit)
+ * @param delta 1 to add a use, -1 to drop one
+ */
+static void s_count(complete_td *c, const char *name, unsigned kind,
+        int delta)
+{
+    guint32 n = 0;
+    size_t len = (name) ? strlen(name) : 0;
+
+    if (len == 0 || len > COMPLETE_MAX_NAME) {
+        return;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        n = s_child(c, n, (guchar) g_ascii_tolower(name[i]), delta > 0);
+        if (n == COMPLETE_NONE) {
+            return;
+        }
+    }
+
+    s_node_td *node = &g_array_index(c->nodes, s_node_td, n);
+    if (node->entry < 0) {
+        if (delta < 0) {
+            return;
+        }
+        s_entry_td *e = g_new0(s_entry_td, 1);
+        e->name = g_strdup(name);
+        node->entry = (gint32) c->entries->len;
+        g_ptr_array_add(c->entries, e);
+    }
+    s_entry_td *e = g_ptr_array_index(c->entries, node->entry);
+    int k = g_bit_nth_lsf(kind, -1);
+    e->refs[k] = MAX(e->refs[k] + delta, 0);
+}
+
+
+/**
+ * @brief Count (or drop) the names of a table or view
+ *
+ * @param c     Index
+ * @param obj   Table or view
+ * @param delta 1 to add its names, -1 to drop them
+ */
+static void s_count_object(complete_td *c, const s_object_td *obj,
+        int delta)
+{
+    s_count(c, obj->name, obj->kind, delta);
+    for (int i = 0; obj->columns && obj->columns[i]; ++i) {
+        s_count(c, obj->columns[i], COMPLETE_COLUMN, delta);
+    }
+}
+
+
+/**
+ * @brief Index the SQL keywords and the functions of a connection
+ *
+ * @param c  Index
+ * @param db Connection
+ */
+static void s_load_builtins(complete_td *c, sqlite3 *db)
+{
+    for (int i = 0; i < sqlite3_keyword_count(); ++i) {
+        const char *kw = NULL;
+        int len = 0;
+        if (sqlite3_keyword_name(i, &kw, &len) == SQLITE_OK) {
+            char *name = g_strndup(kw, (gsize) len);
+            s_count(c, name, COMPLETE_KEYWORD, 1);
+            g_free(name);
+        }
+    }
+
+    /* Missing before SQLite 3.30: then only keywords are indexed */
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, "SELECT DISTINCT name "
+                "FROM pragma_function_list;", -1, &stmt, NULL)
+            == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            s_count(c, (const char*) sqlite3_column_text(stmt, 0),
+                    COMPLETE_FUNCTION, 1);
+        }
+    }
+    sqlite3_finalize(stmt);
+}
+
+
+/**
+ * @brief Read the column names of a table or view
+ *
+ * @param stmt Prepared @c pragma_table_info query (reset on return)
+ * @param name Table or view
+ *
+ * @return Column names (@c NULL terminated; empty if they cannot be
+ *         read, as for a view referring to a dropped table)
+ */
+static char **s_read_columns(sqlite3_stmt *stmt, const char *name)
+{
+    GPtrArray *cols = g_ptr_array_new();
+
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        g_ptr_array_add(cols,
+                g_strdup((const char*) sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_reset(stmt);
+    g_ptr_array_add(cols, NULL);
+
+    return (char**) g_ptr_array_free(cols, FALSE);
+}
+
+
+/**
+ * @brief Update the tables and views of the index from the schema
+ *
+ * Only objects whose definition changed (and views, whose columns may
+ * follow the tables they select from) have their columns read again.
+ *
+ * @param c  Index
+ * @param db Connection
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_load_schema(complete_td *c, sqlite3 *db)
+{
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_stmt *info = NULL;
+    int rc = sqlite3_prepare_v2(db, "SELECT name, type, sql "
+            "FROM sqlite_master WHERE type IN ('table', 'view');", -1,
+            &stmt, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db, "SELECT name "
+                "FROM pragma_table_info(?1);", -1, &info, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return rc;
+    }
+
+    c->generation++;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *name = (const char*) sqlite3_column_text(stmt, 0);
+        const char *sql = (const char*) sqlite3_column_text(stmt, 2);
+        unsigned kind = (strcmp((const char*) sqlite3_column_text(stmt, 1),
+                    "view") == 0) ? COMPLETE_VIEW : COMPLETE_TABLE;
+        if (!name) {
+            continue;
+        }
+
+        char *key = g_ascii_strdown(name, -1);
+        s_object_td *obj = g_hash_table_lookup(c->objects, key);
+        if (obj && obj->kind == kind && kind != COMPLETE_VIEW
+                && g_strcmp0(obj->sql, sql) == 0) {
+            obj->generation = c->generation;
+            g_free(key);
+            continue;
+        }
+        if (obj) {
+            s_count_object(c, obj, -1);
+        }
+        obj = g_new0(s_object_td, 1);
+        obj->sql = g_strdup(sql);
+        obj->kind = kind;
+        obj->name = g_strdup(name);
+        obj->columns = s_read_columns(info, name);
+        obj->generation = c->generation;
+        s_count_object(c, obj, 1);
+        g_hash_table_replace(c->objects, key, obj);
+    }
+    sqlite3_finalize(info);
+    sqlite3_finalize(stmt);
+
+    /* Dropped tables and views */
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, c->objects);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        s_object_td *obj = value;
+        if (obj->generation != c->generation) {
+            s_count_object(c, obj, -1);
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+
+    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+
+
+/* Create an empty completion index */
+complete_td *complete_new(void)
+{
+    complete_td *c = g_new0(complete_td, 1);
+
+    c->nodes = g_array_new(FALSE, FALSE, sizeof(s_node_td));
+    c->entries = g_ptr_array_new_with_free_func(s_entry_free);
+    c->objects = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            s_object_free);
+    s_reset(c);
+
+    return c;
+}
+
+
+/* Release a completion index */
+void complete_free(complete_td *c)
+{
+    if (!c) {
+        return;
+    }
+
+    g_array_free(c->nodes, TRUE);
+    g_ptr_array_free(c->entries, TRUE);
+    g_hash_table_destroy(c->objects);
+    g_free(c->filename);
+    g_free(c);
+}
+
+
+/* Bring the index up to date with the schema of a connection */
+int complete_refresh(complete_td *c, sqlite3 *db)
+{
+    if (!c || !db) {
+        return SQLITE_MISUSE;
+    }
+
+    const char *filename = sqlite3_db_filename(db, "main");
+    if (db != c->db || g_strcmp0(filename, c->filename) != 0) {
+        s_reset(c);
+        c->db = db;
+        c->filename = g_strdup(filename);
+        s_load_builtins(c, db);
+    }
+
+    /* Read from the database header: cheap while nothing changed */
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, "PRAGMA schema_version;", -1, &stmt,
+            NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    rc = sqlite3_step(stmt);
+    int version = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_ROW) {
+        return rc;
+    }
+    if (version == c->schema_version) {
+        return SQLITE_OK;
+    }
+
+    /* A change after reading the version is caught by the next call */
+    rc = s_load_schema(c, db);
+    if (rc == SQLITE_OK) {
+        c->schema_version = version;
+    }
+
+    return rc;
+}
+
+
+/**
+ * @brief Collect the names of a subtree of the trie, node first and
+ *        children in byte order
+ *
+ * @param c   Index
+ * @param n   Root of the subtree
+ * @param max Maximum number of matches
+ * @param out Where to store the matches
+ * @param got Matches stored so far (updated)
+ */
+static void s_collect(const complete_td *c, guint32 n, int max,
+        complete_match_td *out, int *got)
+{
+    const s_node_td *node = &g_array_index(c->nodes, s_node_td, n);
+
+    if (node->entry >= 0) {
+        const s_entry_td *e = g_ptr_array_index(c->entries, node->entry);
+        unsigned kinds = 0;
+        for (int k = 0; k < COMPLETE_NKINDS; ++k) {
+            kinds |= (e->refs[k] > 0) ? 1u << k : 0;
+        }
+        if (kinds) {
+            out[*got].name = e->name;
+            out[*got].kinds = kinds;
+            (*got)++;
+        }
+    }
+    for (guint32 ch = node->child; ch != COMPLETE_NONE && *got < max;
+            ch = g_array_index(c->nodes, s_node_td, ch).sibling) {
+        s_collect(c, ch, max, out, got);
+    }
+}
+
+
+/* Find the names starting with a prefix */
+int complete_lookup(complete_td *c, const char *table, const char *prefix,
+        int max, complete_match_td *out)
+{
+    int got = 0;
+
+    if (!c || !prefix || !out || max <= 0) {
+        return 0;
+    }
+
+    /* Columns of a qualifier, in table order */
+    if (table) {
+        char *key = g_ascii_strdown(table, -1);
+        const s_object_td *obj = g_hash_table_lookup(c->objects, key);
+        size_t len = strlen(prefix);
+        g_free(key);
+        for (int i = 0; obj && obj->columns[i] && got < max; ++i) {
+            if (g_ascii_strncasecmp(obj->columns[i], prefix, len) == 0) {
+                out[got].name = obj->columns[i];
+                out[got].kinds = COMPLETE_COLUMN;
+                got++;
+            }
+        }
+        return got;
+    }
+
+    guint32 n = 0;
+    for (const char *p = prefix; *p; ++p) {
+        n = s_child(c, n, (guchar) g_ascii_tolower(*p), 0);
+        if (n == COMPLETE_NONE) {
+            return 0;
+        }
+    }
+    s_collect(c, n, max, out, &got);
+
+    return got;
+}
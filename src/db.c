@@ -10,6 +10,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+/* Project includes */
+#include <overlay.h>
+#include <query.h>
+#include <regexp.h>
+#include <rowcache.h>
 
 /* Local includes */
 #include <db.h>
@@ -17,39 +24,298 @@
 
 /**
  * @brief Build a safe @c SELECT statement for rowid and all columns
- *        with a limit
  *
- * @param table Table name to include in the query (quoted in the SQL)
+ * BLOB values are replaced by empty BLOBs: @c typeof() does not load
+ * the content, so large BLOBs are never read just to list the rows.
+ * Their size and first bytes are read later with @a sqlite3_blob_read().
+ *
+ * @param table    Table name to include in the query (quoted in the SQL)
+ * @param colnames Names of the table columns (as returned by @c *)
+ * @param ncols    Number of entries in @e colnames
+ * @param json     JSON paths selected after the columns
+ *                 (@e json_column_td *), or @c NULL
+ * @param tail     Clause following the table (e.g. @c "LIMIT 100")
  *
  * @return Dynamically allocated SQL string on success (caller must
- *         free) or @c NULL on allocation/formatting error
+ *         @a sqlite3_free()) or @c NULL on allocation error
+ */
+static char *s_make_select_rowid_all(const char *table, char **colnames,
+        int ncols, const GPtrArray *json, const char *tail)
+{
+    sqlite3_str *str = sqlite3_str_new(NULL);
+
+    sqlite3_str_appendall(str, "SELECT rowid");
+    for (int i = 0; i < ncols; ++i) {
+        sqlite3_str_appendf(str, ", CASE WHEN typeof(\"%w\") = 'blob' "
+                "THEN zeroblob(0) ELSE \"%w\" END AS \"%w\"",
+                colnames[i], colnames[i], colnames[i]);
+    }
+    for (guint i = 0; json && i < json->len; ++i) {
+        char *item = json_column_sql(g_ptr_array_index(json, i));
+        sqlite3_str_appendf(str, ", %s", item);
+        sqlite3_free(item);
+    }
+    sqlite3_str_appendf(str, " FROM \"%w\" %s;", table, tail);
+
+    return sqlite3_str_finish(str);
+}
+
+
+/**
+ * @brief Get the names of the columns selected by @c * on a table
  *
- * @note If the returned string points to a static buffer copy it must
- *       be freed by the caller
+ * @param db     Database handle
+ * @param table  Table name
+ * @param out    Where to store the names (free each and the array)
+ * @param nout   Where to store the number of names
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
  */
-static char *s_make_select_rowid_all(const char *table)
+static int s_table_columns(sqlite3 *db, const char *table, char ***out,
+        int *nout)
 {
-    char buf[256];
-    int needed = snprintf(buf, sizeof(buf),
-            "SELECT rowid, * FROM \"%s\" LIMIT %d;", table,
-            SQL_QUERY_MAX_LIMIT);
+    char *sql = sqlite3_mprintf("SELECT * FROM \"%w\" LIMIT 0;", table);
+    sqlite3_stmt *stmt = NULL;
+    int rc = (sql) ? sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
 
-    if (needed < 0) {
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    int n = sqlite3_column_count(stmt);
+    char **names = calloc((size_t) n + 1, sizeof(char*));
+    if (!names) {
+        sqlite3_finalize(stmt);
+        return SQLITE_NOMEM;
+    }
+    for (int i = 0; i < n; ++i) {
+        const char *name = sqlite3_column_name(stmt, i);
+        names[i] = strdup((name) ? name : "");
+    }
+    sqlite3_finalize(stmt);
+    *out = names;
+    *nout = n;
+
+    return SQLITE_OK;
+}
+
+
+/**
+ * @brief Describe a BLOB cell from its size and first bytes
+ *
+ * Reads only @e THUMB_SNIFF_BYTES bytes of the BLOB through an
+ * incremental BLOB handle (reopened on each row) and marks image cells
+ * in the thumbnail cache.
+ *
+ * @param s      Pointer to the application context
+ * @param blob   BLOB handle for the column (opened on first use)
+ * @param colidx Column index in the rows view
+ * @param rowid  Row of the cell
+ * @param buf    Where to write the description
+ * @param len    Size of @e buf
+ */
+static void s_describe_blob(context_td *s, sqlite3_blob **blob,
+        int colidx, sqlite3_int64 rowid, char *buf, size_t len)
+{
+    int rc = (*blob)
+        ? sqlite3_blob_reopen(*blob, rowid)
+        : sqlite3_blob_open(s->db, "main", s->current_tablename,
+                s->current_colnames[colidx], rowid, 0, blob);
+
+    if (rc != SQLITE_OK) {
+        snprintf(buf, len, "[BLOB]");
+        return;
+    }
+
+    unsigned char prefix[THUMB_SNIFF_BYTES];
+    int size = sqlite3_blob_bytes(*blob);
+    int n = (size < THUMB_SNIFF_BYTES) ? size : THUMB_SNIFF_BYTES;
+    const char *format = (n > 0
+            && sqlite3_blob_read(*blob, prefix, n, 0) == SQLITE_OK)
+        ? thumb_sniff(prefix, n) : NULL;
+
+    if (format) {
+        thumb_cache_mark(s->thumbs, colidx, rowid);
+        snprintf(buf, len, "[%s image, %d bytes]", format, size);
+    } else {
+        snprintf(buf, len, "[BLOB, %d bytes]", size);
+    }
+}
+
+
+/**
+ * @brief Append the current result row of a rows query to the model
+ *
+ * @param s     Pointer to the application context
+ * @param stmt  Statement built by @a s_make_select_rowid_all(), on a row
+ * @param store Model of the rows view
+ * @param iter  Where to store the position of the new model row
+ * @param blobs One BLOB handle per column (opened on first use)
+ */
+static void s_append_row(context_td *s, sqlite3_stmt *stmt,
+        GtkListStore *store, GtkTreeIter *iter, sqlite3_blob **blobs)
+{
+    int ncol = sqlite3_column_count(stmt);
+    sqlite3_int64 rowid = sqlite3_column_int64(stmt, 0);
+
+    gtk_list_store_append(store, iter);
+    for (int i = 0; i < ncol; ++i) {
+        char desc[64];
+        const char *sval = desc;
+        if (i > 0 && sqlite3_column_type(stmt, i) == SQLITE_BLOB) {
+            s_describe_blob(s, &blobs[i], i, rowid, desc, sizeof(desc));
+        } else {
+            const unsigned char *txt = sqlite3_column_text(stmt, i);
+            sval = (txt) ? (const char*) txt : "";
+        }
+        gtk_list_store_set(store, iter, i, sval, -1);
+    }
+}
+
+
+/**
+ * @brief Append a cached row of a rows query to the model
+ *
+ * Cells are shown as @a s_append_row() shows them; BLOB cells, cached
+ * empty, are described from the file again.
+ *
+ * @param s     Pointer to the application context
+ * @param rows  Cached rows of the query
+ * @param row   Row to append
+ * @param store Model of the rows view
+ * @param iter  Where to store the position of the new model row
+ * @param blobs One BLOB handle per column (opened on first use)
+ */
+static void s_append_cached_row(context_td *s, const result_td *rows,
+        guint32 row, GtkListStore *store, GtkTreeIter *iter,
+        sqlite3_blob **blobs)
+{
+    int ncol = s->current_ncols + s->current_nextra;
+    char *id = result_text(rows, row, 0);
+    sqlite3_int64 rowid = (id) ? g_ascii_strtoll(id, NULL, 10) : 0;
+
+    gtk_list_store_append(store, iter);
+    for (int i = 0; i < ncol; ++i) {
+        char desc[64];
+        char *text = NULL;
+        if (i > 0 && result_type(rows, row, i) == SQLITE_BLOB) {
+            s_describe_blob(s, &blobs[i], i, rowid, desc, sizeof(desc));
+        } else {
+            text = result_text(rows, row, i);
+        }
+        gtk_list_store_set(store, iter, i, (text) ? text
+                : (i > 0 && result_type(rows, row, i) == SQLITE_BLOB)
+                ? desc : "", -1);
+        g_free(text);
+    }
+    g_free(id);
+}
+
+
+/**
+ * @brief Show the edited cells of the overlay over the rows of the
+ *        model, matched by rowid
+ *
+ * @param s     Pointer to the application context, in overlay mode
+ * @param store Model of the rows view, filled
+ */
+static void s_merge_overlay(context_td *s, GtkListStore *store)
+{
+    GtkTreeModel *model = GTK_TREE_MODEL(store);
+    GtkTreeIter iter;
+
+    for (gboolean ok = gtk_tree_model_get_iter_first(model, &iter); ok;
+            ok = gtk_tree_model_iter_next(model, &iter)) {
+        gchar *id = NULL;
+        gtk_tree_model_get(model, &iter, 0, &id, -1);
+        sqlite3_int64 rowid = (id) ? g_ascii_strtoll(id, NULL, 10) : 0;
+        for (int i = 1; id && i < s->current_ncols; ++i) {
+            char *text = NULL;
+            if (overlay_get_cell(s->overlay, s->current_tablename,
+                        s->current_colnames[i], rowid, &text)
+                    == SQLITE_ROW) {
+                gtk_list_store_set(store, &iter, i, (text) ? text : "",
+                        -1);
+            }
+            g_free(text);
+        }
+        g_free(id);
+    }
+}
+
+
+/**
+ * @brief Close the BLOB handles used while filling the model
+ *
+ * @param blobs One BLOB handle per column (entries may be @c NULL)
+ * @param ncol  Number of entries in @e blobs
+ */
+static void s_close_blobs(sqlite3_blob **blobs, int ncol)
+{
+    for (int i = 0; i < ncol; ++i) {
+        if (blobs[i]) {
+            sqlite3_blob_close(blobs[i]);
+        }
+    }
+    free(blobs);
+}
+
+
+/**
+ * @brief Describe a text or BLOB cell of a record from its first bytes
+ *
+ * Only up to @e maxlen bytes are read, through an incremental BLOB
+ * handle (which also works on text), so huge values are not loaded.
+ *
+ * @param s      Pointer to the application context
+ * @param colidx Column index in @e s->current_colnames
+ * @param rowid  Row of the cell
+ * @param text   Non-zero for a text value, zero for a BLOB
+ * @param maxlen Maximum number of bytes to show
+ *
+ * @return Description (caller must @a free()) or @c NULL on error
+ */
+static char *s_describe_long(context_td *s, int colidx,
+        sqlite3_int64 rowid, int text, int maxlen)
+{
+    sqlite3_blob *blob = NULL;
+    if (sqlite3_blob_open(s->db, "main", s->current_tablename,
+                s->current_colnames[colidx], rowid, 0, &blob)
+            != SQLITE_OK) {
+        sqlite3_blob_close(blob);
         return NULL;
     }
-    if ((size_t) needed >= sizeof(buf)) {
-        size_t len = (size_t) needed + 1;
-        char *p = malloc(len);
-        if (!p) {
-            return NULL;
+
+    int size = sqlite3_blob_bytes(blob);
+    int n = MIN(size, maxlen);
+    char *buf = malloc((size_t) n + 1);
+    char *desc = NULL;
+    if (buf && sqlite3_blob_read(blob, buf, n, 0) == SQLITE_OK) {
+        if (!text) {
+            const char *format =
+                thumb_sniff((const unsigned char*) buf, n);
+            desc = (format)
+                ? sqlite3_mprintf("[%s image, %d bytes]", format, size)
+                : sqlite3_mprintf("[BLOB, %d bytes]", size);
+        } else if (n < size) {
+            /* Do not cut a UTF-8 sequence in half */
+            const char *end = NULL;
+            g_utf8_validate(buf, n, &end);
+            desc = sqlite3_mprintf("%.*s... (%d bytes)",
+                    (int) (end - buf), buf, size);
+        } else {
+            buf[n] = '\0';
+            desc = sqlite3_mprintf("%s", buf);
         }
-        snprintf(p, len,
-                "SELECT rowid, * FROM \"%s\" LIMIT %d;", table,
-                SQL_QUERY_MAX_LIMIT);
-        return p;
-    } else {
-        return strdup(buf);
     }
+    free(buf);
+    sqlite3_blob_close(blob);
+
+    char *out = (desc) ? strdup(desc) : NULL;
+    sqlite3_free(desc);
+
+    return out;
 }
 
 
@@ -91,8 +357,109 @@ int db_open(context_td *s, const char *filename)
         sqlite3_close(s->db);
         s->db = NULL;
     }
+    free(s->filename);
+    s->filename = filename ? strdup(filename) : NULL;
+
+    overlay_close(s->overlay);
+    s->overlay = NULL;
+
+    /* In overlay mode nothing ever writes to the file */
+    int rc = (s->overlay_mode) ? sqlite3_open_v2(filename, &s->db,
+            SQLITE_OPEN_READONLY, NULL) : sqlite3_open(filename, &s->db);
+    if (rc == SQLITE_OK) {
+        rc = regexp_register(s->db);
+    }
+    if (rc == SQLITE_OK && s->overlay_mode) {
+        rc = overlay_open(filename, &s->overlay);
+    }
 
-    return sqlite3_open(filename, &s->db);
+    return rc;
+}
+
+
+/**
+ * @brief Open an additional connection for a background job
+ *
+ * @param filename Path to the SQLite database file to open
+ * @param flags    Open flags (read-only or read-write)
+ * @param out      Where to store the new handle
+ *
+ * @return @e SQLITE_OK on success, or an SQLite error code otherwise
+ */
+static int s_open_side(const char *filename, int flags, sqlite3 **out)
+{
+    if (!filename || !out) {
+        return SQLITE_MISUSE;
+    }
+
+    *out = NULL;
+    int rc = sqlite3_open_v2(filename, out, flags | SQLITE_OPEN_NOMUTEX,
+            NULL);
+    if (rc == SQLITE_OK) {
+        rc = regexp_register(*out);
+    }
+    if (rc != SQLITE_OK) {
+        if (*out) sqlite3_close(*out);
+        *out = NULL;
+        return rc;
+    }
+    sqlite3_busy_timeout(*out, DB_JOB_BUSY_TIMEOUT);
+
+    return SQLITE_OK;
+}
+
+
+/* Open an additional read-only connection to a database file */
+int db_open_reader(const char *filename, sqlite3 **out)
+{
+    return s_open_side(filename, SQLITE_OPEN_READONLY, out);
+}
+
+
+/* Open an additional read-write connection to a database file */
+int db_open_writer(const char *filename, sqlite3 **out)
+{
+    return s_open_side(filename, SQLITE_OPEN_READWRITE, out);
+}
+
+
+/* Copy a database to a new temporary file */
+int db_copy_to_temp(const char *filename, char **copy)
+{
+    if (!filename || !copy) {
+        return SQLITE_MISUSE;
+    }
+
+    int fd = g_file_open_tmp("sqliteview-XXXXXX.db", copy, NULL);
+    if (fd < 0) {
+        *copy = NULL;
+        return SQLITE_CANTOPEN;
+    }
+    close(fd);
+
+    sqlite3 *src = NULL;
+    sqlite3 *dst = NULL;
+    int rc = db_open_reader(filename, &src);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_open(*copy, &dst);
+    }
+    if (rc == SQLITE_OK) {
+        sqlite3_backup *b = sqlite3_backup_init(dst, "main", src, "main");
+        rc = (b) ? sqlite3_backup_step(b, -1) : sqlite3_errcode(dst);
+        rc = (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+        if (b) {
+            sqlite3_backup_finish(b);
+        }
+    }
+    sqlite3_close(dst);
+    sqlite3_close(src);
+    if (rc != SQLITE_OK) {
+        remove(*copy);
+        g_free(*copy);
+        *copy = NULL;
+    }
+
+    return rc;
 }
 
 
@@ -107,6 +474,33 @@ void db_close(context_td *s)
         sqlite3_close(s->db);
         s->db = NULL;
     }
+    overlay_close(s->overlay);
+    s->overlay = NULL;
+    query_stats_clear(&s->rows_stats);
+    s->rows_cached = 0;
+    free(s->filename);
+    s->filename = NULL;
+    db_reset_view(s);
+}
+
+
+/* Drop the JSON path columns, row filter and seek of the rows view */
+void db_reset_view(context_td *s)
+{
+    if (!s) {
+        return;
+    }
+
+    if (s->json_columns) {
+        g_ptr_array_free(s->json_columns, TRUE);
+        s->json_columns = NULL;
+    }
+    sqlite3_free(s->row_filter);
+    s->row_filter = NULL;
+    sqlite3_free(s->seek_column);
+    sqlite3_free(s->seek_from);
+    s->seek_column = NULL;
+    s->seek_from = NULL;
 }
 
 
@@ -152,15 +546,17 @@ void db_free_columns(context_td *s)
         free(s->current_tablename);
         s->current_tablename = NULL;
         s->current_ncols = 0;
+        s->current_nextra = 0;
         return;
     }
 
-    for (int i = 0; i < s->current_ncols; ++i) {
+    for (int i = 0; i < s->current_ncols + s->current_nextra; ++i) {
         free(s->current_colnames[i]);
     }
     free(s->current_colnames);
     s->current_colnames = NULL;
     s->current_ncols = 0;
+    s->current_nextra = 0;
     free(s->current_tablename);
     s->current_tablename = NULL;
 }
@@ -177,37 +573,65 @@ int db_populate_rows(context_td *s, const char *table)
         return SQLITE_MISUSE;
     }
 
+    /* JSON path columns and filters belong to the table they were set on */
+    if (!s->current_tablename || strcmp(s->current_tablename, table) != 0) {
+        db_reset_view(s);
+    }
     db_free_columns(s);
     s->current_tablename = strdup(table);
 
     GtkTreeView *tv = GTK_TREE_VIEW(s->rows_view);
     GtkListStore *store = NULL;
 
-    /* Clear previous model and columns */
+    /* Clear previous model; the UI keeps and reuses the columns */
     gtk_tree_view_set_model(tv, NULL);
-    GList *cols = gtk_tree_view_get_columns(tv);
-    for (GList *l = cols; l; l = l->next) {
-        gtk_tree_view_remove_column(tv, GTK_TREE_VIEW_COLUMN(l->data));
-    }
-    g_list_free(cols);
 
-    char *sql = s_make_select_rowid_all(table);
+    char **names = NULL;
+    int nnames = 0;
+    int rc = s_table_columns(s->db, table, &names, &nnames);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    /* A seek is a range on an indexed column, in its order: qualified,
+     * as ORDER BY would otherwise bind to the selected expression of the
+     * same name and sort the range */
+    sqlite3_str *str = sqlite3_str_new(NULL);
+    if (s->row_filter) {
+        sqlite3_str_appendf(str, "WHERE (%s) ", s->row_filter);
+    }
+    if (s->seek_column) {
+        sqlite3_str_appendf(str, "%s \"%w\".\"%w\" >= %s "
+                "ORDER BY \"%w\".\"%w\" ",
+                (s->row_filter) ? "AND" : "WHERE", table, s->seek_column,
+                s->seek_from, table, s->seek_column);
+    }
+    sqlite3_str_appendf(str, "LIMIT %d", SQL_QUERY_MAX_LIMIT);
+    char *tail = sqlite3_str_finish(str);
+    char *sql = (tail) ? s_make_select_rowid_all(table, names, nnames,
+            s->json_columns, tail) : NULL;
+    sqlite3_free(tail);
+    for (int i = 0; i < nnames; ++i) {
+        free(names[i]);
+    }
+    free(names);
     if (!sql) {
         return SQLITE_NOMEM;
     }
 
     sqlite3_stmt *stmt = NULL;
-    int rc = sqlite3_prepare_v2(s->db, sql, -1, &stmt, NULL);
-    free(sql);
+    rc = sqlite3_prepare_v2(s->db, sql, -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
+        sqlite3_free(sql);
         return rc;
     }
 
     int ncol = sqlite3_column_count(stmt);
-    s->current_ncols = ncol;
+    s->current_nextra = (s->json_columns) ? (int) s->json_columns->len : 0;
+    s->current_ncols = ncol - s->current_nextra;
     s->current_colnames = calloc((size_t) ncol, sizeof(char*));
     if (!s->current_colnames) {
         sqlite3_finalize(stmt);
+        sqlite3_free(sql);
         return SQLITE_NOMEM;
     }
 
@@ -218,36 +642,74 @@ int db_populate_rows(context_td *s, const char *table)
     store = gtk_list_store_newv(ncol, types);
     g_free(types);
 
-    /* Create columns with placeholders for renderer setup in UI (UI will
-     * connect signals) */
     for (int i = 0; i < ncol; ++i) {
         const char *colname = sqlite3_column_name(stmt, i);
         s->current_colnames[i] = strdup((colname) ? colname : "");
-        /* Create a simple column; UI may reconfigure/renderers later */
-        GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
-        GtkTreeViewColumn *col = gtk_tree_view_column_new_with_attributes(
-                (colname)
-                ? colname
-                : "", renderer, "text", i, NULL);
-        gtk_tree_view_append_column(tv, col);
     }
 
-    /* Fill rows */
-    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-        GtkTreeIter iter;
-        gtk_list_store_append(store, &iter);
-        for (int i = 0; i < ncol; ++i) {
-            const unsigned char *txt = sqlite3_column_text(stmt, i);
-            const char *sval = (txt) ? (const char*) txt : "";
-            gtk_list_store_set(store, &iter, i, sval, -1);
+    thumb_cache_reset(s->thumbs, s->filename, table, s->current_colnames,
+            s->current_ncols);
+    sqlite3_blob **blobs = calloc((size_t) ncol, sizeof(sqlite3_blob*));
+    if (!blobs) {
+        g_object_unref(store);
+        sqlite3_finalize(stmt);
+        sqlite3_free(sql);
+        return SQLITE_NOMEM;
+    }
+
+    /* Fill rows, from the blocks shared by the views of the file if the
+     * same rows were read since it last changed */
+    query_stats_clear(&s->rows_stats);
+    gint64 t0 = g_get_monotonic_time();
+    rowcache_id_td id;
+    int cacheable = (rowcache_identify(s->filename, &id) == SQLITE_OK);
+    rowcache_block_td *block = (cacheable) ? rowcache_get(&id, sql) : NULL;
+    int cached = (block != NULL);
+    if (block) {
+        const result_td *rows = rowcache_rows(block);
+        for (guint32 i = 0; i < result_count(rows); ++i) {
+            GtkTreeIter iter;
+            s_append_cached_row(s, rows, i, store, &iter, blobs);
         }
+        s->rows_stats.nrows = result_count(rows);
+    } else {
+        result_td *rows = (cacheable) ? result_new(ncol) : NULL;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            GtkTreeIter iter;
+            if (rows) {
+                result_append(rows, stmt);
+            }
+            s_append_row(s, stmt, store, &iter, blobs);
+            s->rows_stats.nrows++;
+        }
+        query_collect(stmt, &s->rows_stats);
+        if (rows && rc == SQLITE_DONE) {
+            block = rowcache_put(&id, sql, rows);
+        } else {
+            result_free(rows);
+        }
+    }
+    s->rows_stats.usec = g_get_monotonic_time() - t0;
+    s->rows_cached = cached;
+
+    /* A read error (e.g. corruption met while stepping) is returned
+     * with the rows read before it; its message stays on the handle */
+    rc = (cached || rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    if (!cached && rc == SQLITE_OK) {
+        query_plan(s->db, sql, &s->rows_stats.plan);
+    }
+    rowcache_unref(block);
+    if (overlay_has_table(s->overlay, table)) {
+        s_merge_overlay(s, store);
     }
 
+    s_close_blobs(blobs, ncol);
     gtk_tree_view_set_model(tv, GTK_TREE_MODEL(store));
     g_object_unref(store);
     sqlite3_finalize(stmt);
+    sqlite3_free(sql);
 
-    return SQLITE_OK;
+    return rc;
 }
 
 
@@ -262,10 +724,17 @@ int db_apply_update_cell(context_td *s, int colidx, const char *rowid_text,
     if (colidx == 0) {
         return SQLITE_OK;   /* Do not edit 'rowid' */
     }
+    if (colidx < 0 || colidx >= s->current_ncols) {
+        return SQLITE_MISUSE;   /* JSON path columns are computed */
+    }
     const char *colname = s->current_colnames[colidx];
     if (!colname) {
         return SQLITE_MISUSE;
     }
+    if (s->overlay) {
+        return overlay_set_cell(s->overlay, s->db, s->current_tablename,
+                colname, g_ascii_strtoll(rowid_text, NULL, 10), new_text);
+    }
 
     char sqlbuf[512];
     int needed = snprintf(sqlbuf, sizeof(sqlbuf),
@@ -310,3 +779,148 @@ int db_apply_update_cell(context_td *s, int colidx, const char *rowid_text,
 
     return SQLITE_OK;
 }
+
+
+/* Insert a row with default values into the current table */
+int db_insert_row(context_td *s, GtkTreeIter *iter)
+{
+    if (!s || !s->db || !s->current_tablename || !s->current_colnames
+            || !iter) {
+        return SQLITE_MISUSE;
+    }
+    GtkTreeModel *model =
+        gtk_tree_view_get_model(GTK_TREE_VIEW(s->rows_view));
+    if (!model) {
+        return SQLITE_MISUSE;
+    }
+
+    char *sql = sqlite3_mprintf("INSERT INTO \"%w\" DEFAULT VALUES;",
+            s->current_tablename);
+    int rc = (sql) ? sqlite3_exec(s->db, sql, NULL, NULL, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    /* Read the new row back: defaults may be expressions */
+    sqlite3_int64 rowid = sqlite3_last_insert_rowid(s->db);
+    sql = s_make_select_rowid_all(s->current_tablename,
+            s->current_colnames + 1, s->current_ncols - 1,
+            s->json_columns, "WHERE rowid = ?1");
+    sqlite3_stmt *stmt = NULL;
+    rc = (sql) ? sqlite3_prepare_v2(s->db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_bind_int64(stmt, 1, rowid);
+
+    int ncol = s->current_ncols + s->current_nextra;
+    sqlite3_blob **blobs = calloc((size_t) ncol, sizeof(sqlite3_blob*));
+    if (!blobs) {
+        rc = SQLITE_NOMEM;
+    } else if ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        s_append_row(s, stmt, GTK_LIST_STORE(model), iter, blobs);
+        rc = SQLITE_OK;
+    }
+    if (blobs) {
+        s_close_blobs(blobs, ncol);
+    }
+    sqlite3_finalize(stmt);
+
+    return rc;
+}
+
+
+/* Delete rows of the current table in a single transaction */
+int db_delete_rows(context_td *s, const sqlite3_int64 *rowids, int n)
+{
+    if (!s || !s->db || !s->current_tablename || (!rowids && n > 0)) {
+        return SQLITE_MISUSE;
+    }
+
+    char *sql = sqlite3_mprintf("DELETE FROM \"%w\" WHERE rowid = ?1;",
+            s->current_tablename);
+    sqlite3_stmt *stmt = NULL;
+    int rc = (sql) ? sqlite3_prepare_v2(s->db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    /* One statement, rebound per row, inside one transaction */
+    rc = sqlite3_exec(s->db, "BEGIN;", NULL, NULL, NULL);
+    for (int i = 0; rc == SQLITE_OK && i < n; ++i) {
+        sqlite3_bind_int64(stmt, 1, rowids[i]);
+        rc = sqlite3_step(stmt);
+        rc = (rc == SQLITE_DONE) ? sqlite3_reset(stmt) : rc;
+    }
+    sqlite3_finalize(stmt);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(s->db, "COMMIT;", NULL, NULL, NULL);
+    }
+    if (rc != SQLITE_OK && !sqlite3_get_autocommit(s->db)) {
+        sqlite3_exec(s->db, "ROLLBACK;", NULL, NULL, NULL);
+    }
+
+    return rc;
+}
+
+
+/* Fetch a group of columns of a row of the current table */
+int db_fetch_record(context_td *s, sqlite3_int64 rowid, int first, int n,
+        int maxlen, char **out)
+{
+    if (!s || !s->db || !s->current_tablename || !s->current_colnames
+            || !out || first < 1 || n < 0
+            || first + n > s->current_ncols) {
+        return SQLITE_MISUSE;
+    }
+
+    /* typeof() does not load the value; long ones are read partially */
+    sqlite3_str *str = sqlite3_str_new(s->db);
+    sqlite3_str_appendall(str, "SELECT 0");
+    for (int i = first; i < first + n; ++i) {
+        const char *c = s->current_colnames[i];
+        sqlite3_str_appendf(str, ", typeof(\"%w\"), CASE WHEN "
+                "typeof(\"%w\") IN ('text', 'blob') THEN NULL "
+                "ELSE \"%w\" END", c, c, c);
+    }
+    sqlite3_str_appendf(str, " FROM \"%w\" WHERE rowid = ?1;",
+            s->current_tablename);
+    char *sql = sqlite3_str_finish(str);
+
+    sqlite3_stmt *stmt = NULL;
+    int rc = (sql) ? sqlite3_prepare_v2(s->db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_bind_int64(stmt, 1, rowid);
+
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        for (int i = 0; i < n; ++i) {
+            const char *type =
+                (const char*) sqlite3_column_text(stmt, 1 + 2 * i);
+            const unsigned char *txt = sqlite3_column_text(stmt, 2 + 2 * i);
+            if (type && (strcmp(type, "text") == 0
+                        || strcmp(type, "blob") == 0)) {
+                out[i] = s_describe_long(s, first + i, rowid,
+                        type[0] == 't', maxlen);
+            } else {
+                out[i] = strdup((txt) ? (const char*) txt : "NULL");
+            }
+        }
+        rc = SQLITE_OK;
+    } else if (rc == SQLITE_DONE) {
+        rc = SQLITE_NOTFOUND;
+    }
+    sqlite3_finalize(stmt);
+
+    return rc;
+}
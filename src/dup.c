@@ -0,0 +1,644 @@
+/**
+ * @file dup.c
+ *
+ * @brief Implementation of the partitioned duplicate-row detection
+ */
+
+/* System includes */
+#include <stdlib.h>
+#include <string.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <dup.h>
+
+
+#define DUP_REPORT_EVERY (4096)     /**< Rows between progress reports */
+#define DUP_SCAN_SHARE (0.9)        /**< Progress share of the scan */
+
+
+/**
+ * @struct s_pair_td
+ *
+ * @brief Hash of the chosen columns of one row
+ */
+typedef struct {
+    sqlite3_uint64 hash;    /**< Hash of the column values */
+    sqlite3_int64 rowid;    /**< Row the hash belongs to */
+} s_pair_td;
+
+/**
+ * @struct s_part_td
+ *
+ * @brief One @e rowid range scanned by a worker thread
+ */
+typedef struct {
+    const char *filename;   /**< Database file (shared) */
+    const char *sql;        /**< Range scan statement (shared) */
+    int ncols;              /**< Number of hashed columns */
+    sqlite3_int64 lo;       /**< First rowid of the range */
+    sqlite3_int64 hi;       /**< Last rowid of the range */
+    job_td *job;            /**< Job for progress and cancellation */
+    gint *blocks;           /**< Shared count of scanned row blocks */
+    double span;            /**< Estimated rows over all partitions */
+    s_pair_td *pairs;       /**< Hashes of the rows, sorted on return */
+    size_t npairs;          /**< Number of entries in @e pairs */
+    size_t cap;             /**< Allocated entries in @e pairs */
+    int rc;                 /**< Outcome of the scan */
+} s_part_td;
+
+
+/**
+ * @brief Mix bytes into a 64-bit FNV-1a hash
+ *
+ * @param h Running hash value
+ * @param p Bytes to mix in
+ * @param n Number of bytes
+ *
+ * @return Updated hash value
+ */
+static sqlite3_uint64 s_fnv1a(sqlite3_uint64 h, const void *p, size_t n)
+{
+    const unsigned char *b = p;
+
+    for (size_t i = 0; i < n; ++i) {
+        h ^= b[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+
+/**
+ * @brief Check whether a real value holds an exact 64-bit integer
+ *
+ * @param d   Real value
+ * @param out Where to store the integer value
+ *
+ * @return 1 if @e d is integral and in range, 0 otherwise
+ */
+static int s_real_is_int(double d, sqlite3_int64 *out)
+{
+    if (d < -9.2e18 || d > 9.2e18) {
+        return 0;
+    }
+    sqlite3_int64 i = (sqlite3_int64) d;
+    if ((double) i != d) {
+        return 0;
+    }
+    *out = i;
+
+    return 1;
+}
+
+
+/**
+ * @brief Get the normalized storage class of a value
+ *
+ * Reals holding exact integers are reported as integers so that
+ * @c 1 and @c 1.0 compare equal, as they do in @c GROUP @c BY.
+ *
+ * @param v  Value to inspect
+ * @param iv Where to store the integer value for @e SQLITE_INTEGER
+ *
+ * @return Normalized @e SQLITE_* fundamental type
+ */
+static int s_value_class(sqlite3_value *v, sqlite3_int64 *iv)
+{
+    int type = sqlite3_value_type(v);
+
+    if (type == SQLITE_INTEGER) {
+        *iv = sqlite3_value_int64(v);
+    } else if (type == SQLITE_FLOAT
+            && s_real_is_int(sqlite3_value_double(v), iv)) {
+        type = SQLITE_INTEGER;
+    }
+
+    return type;
+}
+
+
+/**
+ * @brief Hash the values of the current row from a given column on
+ *
+ * @param stmt  Statement positioned on a row
+ * @param first Index of the first hashed column
+ * @param ncols Number of hashed columns
+ *
+ * @return 64-bit hash of the values
+ */
+static sqlite3_uint64 s_hash_row(sqlite3_stmt *stmt, int first, int ncols)
+{
+    sqlite3_uint64 h = 14695981039346656037ULL;
+
+    for (int i = first; i < first + ncols; ++i) {
+        sqlite3_value *v = sqlite3_column_value(stmt, i);
+        sqlite3_int64 iv = 0;
+        int type = s_value_class(v, &iv);
+        unsigned char tag = (unsigned char) type;
+
+        h = s_fnv1a(h, &tag, 1);
+        if (type == SQLITE_INTEGER) {
+            h = s_fnv1a(h, &iv, sizeof(iv));
+        } else if (type == SQLITE_FLOAT) {
+            double dv = sqlite3_value_double(v);
+            h = s_fnv1a(h, &dv, sizeof(dv));
+        } else if (type == SQLITE_TEXT || type == SQLITE_BLOB) {
+            const void *p = (type == SQLITE_TEXT)
+                ? (const void*) sqlite3_value_text(v)
+                : sqlite3_value_blob(v);
+            int n = sqlite3_value_bytes(v);
+            h = s_fnv1a(h, &n, sizeof(n));
+            if (p && n > 0) {
+                h = s_fnv1a(h, p, (size_t) n);
+            }
+        }
+    }
+
+    return h;
+}
+
+
+/**
+ * @brief Compare two values with the rules used for hashing
+ *
+ * @param a First value
+ * @param b Second value
+ *
+ * @return 1 if both values are equal, 0 otherwise
+ */
+static int s_value_equal(sqlite3_value *a, sqlite3_value *b)
+{
+    sqlite3_int64 ia = 0, ib = 0;
+    int ta = s_value_class(a, &ia);
+    int tb = s_value_class(b, &ib);
+
+    if (ta != tb) {
+        return 0;
+    }
+    switch (ta) {
+        case SQLITE_NULL:
+            return 1;
+        case SQLITE_INTEGER:
+            return ia == ib;
+        case SQLITE_FLOAT:
+            return sqlite3_value_double(a) == sqlite3_value_double(b);
+        default: {
+            const void *pa = (ta == SQLITE_TEXT)
+                ? (const void*) sqlite3_value_text(a)
+                : sqlite3_value_blob(a);
+            const void *pb = (tb == SQLITE_TEXT)
+                ? (const void*) sqlite3_value_text(b)
+                : sqlite3_value_blob(b);
+            int na = sqlite3_value_bytes(a);
+            int nb = sqlite3_value_bytes(b);
+            return na == nb
+                && (na == 0 || memcmp(pa, pb, (size_t) na) == 0);
+        }
+    }
+}
+
+
+/**
+ * @brief @a qsort() comparator ordering pairs by hash, then rowid
+ */
+static int s_cmp_pair(const void *a, const void *b)
+{
+    const s_pair_td *pa = a;
+    const s_pair_td *pb = b;
+
+    if (pa->hash != pb->hash) {
+        return (pa->hash < pb->hash) ? -1 : 1;
+    }
+    return (pa->rowid > pb->rowid) - (pa->rowid < pb->rowid);
+}
+
+
+/**
+ * @brief @a qsort() comparator ordering rowids ascending
+ */
+static int s_cmp_rowid(const void *a, const void *b)
+{
+    sqlite3_int64 ra = *(const sqlite3_int64*) a;
+    sqlite3_int64 rb = *(const sqlite3_int64*) b;
+
+    return (ra > rb) - (ra < rb);
+}
+
+
+/**
+ * @brief @a qsort() comparator ordering groups by their first rowid
+ */
+static int s_cmp_group(const void *a, const void *b)
+{
+    const dup_group_td *ga = a;
+    const dup_group_td *gb = b;
+
+    return s_cmp_rowid(&ga->rowids[0], &gb->rowids[0]);
+}
+
+
+/**
+ * @brief Worker thread: hash every row of one @e rowid range and sort
+ *        the hashes
+ *
+ * @param userdata Partition to scan (@e s_part_td *)
+ *
+ * @return Always @c NULL (outcome in @e part->rc)
+ */
+static gpointer s_scan_part(gpointer userdata)
+{
+    s_part_td *part = userdata;
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+
+    part->rc = db_open_reader(part->filename, &db);
+    if (part->rc != SQLITE_OK) {
+        return NULL;
+    }
+    part->rc = sqlite3_prepare_v2(db, part->sql, -1, &stmt, NULL);
+    if (part->rc != SQLITE_OK) {
+        sqlite3_close(db);
+        return NULL;
+    }
+    sqlite3_bind_int64(stmt, 1, part->lo);
+    sqlite3_bind_int64(stmt, 2, part->hi);
+
+    int rc;
+    size_t nrows = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (part->npairs == part->cap) {
+            size_t cap = (part->cap) ? part->cap * 2 : 1024;
+            s_pair_td *p = realloc(part->pairs, cap * sizeof(*p));
+            if (!p) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            part->pairs = p;
+            part->cap = cap;
+        }
+        s_pair_td *pair = &part->pairs[part->npairs++];
+        pair->rowid = sqlite3_column_int64(stmt, 0);
+        pair->hash = s_hash_row(stmt, 1, part->ncols);
+
+        if (++nrows % DUP_REPORT_EVERY == 0) {
+            if (job_is_cancelled(part->job)) {
+                rc = SQLITE_INTERRUPT;
+                break;
+            }
+            g_atomic_int_inc(part->blocks);
+            double done = (double) g_atomic_int_get(part->blocks)
+                * DUP_REPORT_EVERY;
+            job_report(part->job, DUP_SCAN_SHARE * done / part->span,
+                    "Hashing rows... %.0f", done);
+        }
+    }
+    part->rc = (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    if (part->rc == SQLITE_OK && part->npairs > 1) {
+        qsort(part->pairs, part->npairs, sizeof(s_pair_td), s_cmp_pair);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Build a statement selecting the given columns of a table
+ *
+ * @param head  Leading select list item (e.g. @c "rowid")
+ * @param table Table name
+ * @param cols  Column names
+ * @param ncols Number of columns
+ * @param tail  Trailing clause (e.g. the @c WHERE clause)
+ *
+ * @return SQL string (caller must @a sqlite3_free()) or @c NULL
+ */
+static char *s_make_select(const char *head, const char *table,
+        char **cols, int ncols, const char *tail)
+{
+    sqlite3_str *str = sqlite3_str_new(NULL);
+
+    sqlite3_str_appendf(str, "SELECT %s", head);
+    for (int i = 0; i < ncols; ++i) {
+        sqlite3_str_appendf(str, "%s\"%w\"",
+                (i == 0 && !*head) ? "" : ", ", cols[i]);
+    }
+    sqlite3_str_appendf(str, " FROM \"%w\" %s;", table, tail);
+
+    return sqlite3_str_finish(str);
+}
+
+
+/**
+ * @brief Split a run of equal hashes into groups of equal rows
+ *
+ * @param stmt   Statement selecting the columns of one row by rowid
+ * @param ncols  Number of compared columns
+ * @param rowids Candidate rowids (sorted ascending)
+ * @param n      Number of candidates
+ * @param out    Result receiving the groups found
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_verify_run(sqlite3_stmt *stmt, int ncols,
+        const sqlite3_int64 *rowids, int n, dup_result_td *out)
+{
+    sqlite3_value **vals = calloc((size_t) n * (size_t) ncols,
+            sizeof(*vals));
+    int *group = malloc((size_t) n * sizeof(*group));
+    int rc = SQLITE_OK;
+
+    if (!vals || !group) {
+        free(vals);
+        free(group);
+        return SQLITE_NOMEM;
+    }
+
+    /* Load the candidate rows; rows deleted since the scan stay NULL */
+    for (int i = 0; i < n && rc == SQLITE_OK; ++i) {
+        group[i] = -1;
+        sqlite3_bind_int64(stmt, 1, rowids[i]);
+        int step = sqlite3_step(stmt);
+        if (step == SQLITE_ROW) {
+            for (int c = 0; c < ncols; ++c) {
+                vals[i * ncols + c] =
+                    sqlite3_value_dup(sqlite3_column_value(stmt, c));
+                if (!vals[i * ncols + c]) {
+                    rc = SQLITE_NOMEM;
+                }
+            }
+        } else if (step != SQLITE_DONE) {
+            rc = step;
+        }
+        sqlite3_reset(stmt);
+    }
+
+    for (int i = 0; i < n && rc == SQLITE_OK; ++i) {
+        if (group[i] >= 0 || !vals[i * ncols]) {
+            continue;
+        }
+        int count = 1;
+        group[i] = i;
+        for (int j = i + 1; j < n; ++j) {
+            if (group[j] >= 0 || !vals[j * ncols]) {
+                continue;
+            }
+            int equal = 1;
+            for (int c = 0; c < ncols && equal; ++c) {
+                equal = s_value_equal(vals[i * ncols + c],
+                        vals[j * ncols + c]);
+            }
+            if (equal) {
+                group[j] = i;
+                ++count;
+            }
+        }
+        if (count < 2) {
+            continue;
+        }
+
+        dup_group_td *g = realloc(out->groups,
+                (size_t) (out->ngroups + 1) * sizeof(*g));
+        if (!g) {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+        out->groups = g;
+        g = &out->groups[out->ngroups];
+        g->rowids = malloc((size_t) count * sizeof(sqlite3_int64));
+        if (!g->rowids) {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+        g->nrowids = 0;
+        for (int j = i; j < n; ++j) {
+            if (group[j] == i) {
+                g->rowids[g->nrowids++] = rowids[j];
+            }
+        }
+        ++out->ngroups;
+    }
+
+    for (int i = 0; i < n * ncols; ++i) {
+        sqlite3_value_free(vals[i]);
+    }
+    free(vals);
+    free(group);
+
+    return rc;
+}
+
+
+/**
+ * @brief Merge the sorted partitions and verify each hash collision
+ *
+ * @param db     Read connection used for verification
+ * @param sql    Statement selecting the columns of one row by rowid
+ * @param ncols  Number of compared columns
+ * @param parts  Scanned partitions (sorted by hash)
+ * @param nparts Number of partitions
+ * @param job    Job for progress and cancellation (may be @c NULL)
+ * @param out    Result receiving the groups found
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_merge_verify(sqlite3 *db, const char *sql, int ncols,
+        s_part_td *parts, int nparts, job_td *job, dup_result_td *out)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    size_t pos[DUP_MAX_PARTITIONS] = { 0 };
+    sqlite3_int64 *run = NULL;
+    size_t runcap = 0;
+
+    job_report(job, DUP_SCAN_SHARE, "Verifying candidates...");
+    for (;;) {
+        /* Smallest hash among the partition heads */
+        int best = -1;
+        for (int p = 0; p < nparts; ++p) {
+            if (pos[p] < parts[p].npairs && (best < 0
+                        || parts[p].pairs[pos[p]].hash
+                        < parts[best].pairs[pos[best]].hash)) {
+                best = p;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+
+        /* Gather that hash from every partition */
+        sqlite3_uint64 hash = parts[best].pairs[pos[best]].hash;
+        size_t nrun = 0;
+        for (int p = 0; p < nparts && rc == SQLITE_OK; ++p) {
+            while (pos[p] < parts[p].npairs
+                    && parts[p].pairs[pos[p]].hash == hash) {
+                if (nrun == runcap) {
+                    size_t cap = (runcap) ? runcap * 2 : 16;
+                    sqlite3_int64 *r = realloc(run, cap * sizeof(*r));
+                    if (!r) {
+                        rc = SQLITE_NOMEM;
+                        break;
+                    }
+                    run = r;
+                    runcap = cap;
+                }
+                run[nrun++] = parts[p].pairs[pos[p]++].rowid;
+            }
+        }
+        if (rc != SQLITE_OK) {
+            break;
+        }
+        if (nrun < 2) {
+            continue;
+        }
+        if (nrun > (size_t) G_MAXINT) {
+            rc = SQLITE_TOOBIG;
+            break;
+        }
+
+        out->ncandidates += (sqlite3_int64) nrun;
+        qsort(run, nrun, sizeof(*run), s_cmp_rowid);
+        rc = s_verify_run(stmt, ncols, run, (int) nrun, out);
+        if (rc == SQLITE_OK && job_is_cancelled(job)) {
+            rc = SQLITE_INTERRUPT;
+        }
+        if (rc != SQLITE_OK) {
+            break;
+        }
+    }
+    free(run);
+    sqlite3_finalize(stmt);
+
+    return rc;
+}
+
+
+/* Find rows of a table with equal values in the given columns */
+int dup_find(job_td *job, const char *filename, const char *table,
+        char **cols, int ncols, int nparts, dup_result_td *out)
+{
+    if (!filename || !table || !cols || ncols <= 0 || !out) {
+        return SQLITE_MISUSE;
+    }
+    memset(out, 0, sizeof(*out));
+    nparts = CLAMP(nparts, 1, DUP_MAX_PARTITIONS);
+
+    sqlite3 *db = NULL;
+    int rc = db_open_reader(filename, &db);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    /* Rowid bounds of the table */
+    char *sql = sqlite3_mprintf(
+            "SELECT min(rowid), max(rowid) FROM \"%w\";", table);
+    sqlite3_stmt *stmt = NULL;
+    rc = (sql) ? sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        sqlite3_close(db);
+        return rc;
+    }
+    rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW || sqlite3_column_type(stmt, 0) == SQLITE_NULL) {
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        return (rc == SQLITE_ROW || rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    }
+    sqlite3_int64 lo = sqlite3_column_int64(stmt, 0);
+    sqlite3_int64 hi = sqlite3_column_int64(stmt, 1);
+    sqlite3_finalize(stmt);
+
+    /* Split [lo, hi] into equal rowid ranges (unsigned: no overflow) */
+    sqlite3_uint64 span = (sqlite3_uint64) hi - (sqlite3_uint64) lo;
+    if (span < (sqlite3_uint64) nparts) {
+        nparts = 1;
+    }
+    sqlite3_uint64 step = span / (sqlite3_uint64) nparts + 1;
+
+    char *scan_sql = s_make_select("rowid", table, cols, ncols,
+            "WHERE rowid BETWEEN ?1 AND ?2");
+    char *row_sql = s_make_select("", table, cols, ncols,
+            "WHERE rowid = ?1");
+    s_part_td parts[DUP_MAX_PARTITIONS];
+    GThread *threads[DUP_MAX_PARTITIONS];
+    gint blocks = 0;
+
+    if (!scan_sql || !row_sql) {
+        sqlite3_free(scan_sql);
+        sqlite3_free(row_sql);
+        sqlite3_close(db);
+        return SQLITE_NOMEM;
+    }
+
+    memset(parts, 0, sizeof(parts));
+    rc = SQLITE_OK;
+    for (int p = 0; p < nparts; ++p) {
+        sqlite3_uint64 first = (sqlite3_uint64) lo
+            + (sqlite3_uint64) p * step;
+        parts[p].filename = filename;
+        parts[p].sql = scan_sql;
+        parts[p].ncols = ncols;
+        parts[p].lo = (sqlite3_int64) first;
+        parts[p].hi = (p == nparts - 1)
+            ? hi : (sqlite3_int64) (first + step - 1);
+        parts[p].job = job;
+        parts[p].blocks = &blocks;
+        parts[p].span = (double) span + 1.0;
+        threads[p] = g_thread_new("dup-scan", s_scan_part, &parts[p]);
+    }
+    for (int p = 0; p < nparts; ++p) {
+        g_thread_join(threads[p]);
+        if (rc == SQLITE_OK) {
+            rc = parts[p].rc;
+        }
+        out->nscanned += (sqlite3_int64) parts[p].npairs;
+    }
+
+    if (rc == SQLITE_OK) {
+        rc = s_merge_verify(db, row_sql, ncols, parts, nparts, job, out);
+    }
+    if (rc == SQLITE_OK && out->ngroups > 1) {
+        qsort(out->groups, (size_t) out->ngroups, sizeof(dup_group_td),
+                s_cmp_group);
+    }
+
+    for (int p = 0; p < nparts; ++p) {
+        free(parts[p].pairs);
+    }
+    sqlite3_free(scan_sql);
+    sqlite3_free(row_sql);
+    sqlite3_close(db);
+    if (rc != SQLITE_OK) {
+        dup_result_free(out);
+    }
+
+    return rc;
+}
+
+
+/* Free memory held by a duplicate search result */
+void dup_result_free(dup_result_td *r)
+{
+    if (!r) {
+        return;
+    }
+
+    for (int i = 0; i < r->ngroups; ++i) {
+        free(r->groups[i].rowids);
+    }
+    free(r->groups);
+    r->groups = NULL;
+    r->ngroups = 0;
+}
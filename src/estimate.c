@@ -0,0 +1,1223 @@
+/**
+ * @file estimate.c
+ *
+ * @brief Implementation of the estimate of the rows a filter matches
+ */
+
+/* System includes */
+#include <math.h>
+#include <string.h>
+
+/* External includes */
+#include <glib.h>
+
+/* Local includes */
+#include <estimate.h>
+
+
+#define ESTIMATE_UNKNOWN_TERM (0.25)    /**< Rows kept by a term without
+                                             statistics */
+
+
+/**
+ * @enum s_token_type_td
+ *
+ * @brief Kinds of tokens of a condition
+ */
+typedef enum {
+    S_TK_ID,        /**< Identifier or keyword */
+    S_TK_STRING,    /**< String literal (unquoted text) */
+    S_TK_NUMBER,    /**< Numeric literal */
+    S_TK_OP,        /**< Comparison operator */
+    S_TK_LP,        /**< Opening parenthesis */
+    S_TK_RP,        /**< Closing parenthesis */
+    S_TK_COMMA,     /**< Comma */
+    S_TK_DOT,       /**< Dot */
+    S_TK_OTHER      /**< Anything else */
+} s_token_type_td;
+
+/**
+ * @struct s_token_td
+ *
+ * @brief Token of a condition
+ */
+typedef struct {
+    s_token_type_td type;   /**< Kind */
+    char *text;             /**< Text (unquoted for identifiers and
+                                 strings) */
+    int quoted;             /**< Whether an identifier was quoted */
+} s_token_td;
+
+/**
+ * @struct s_value_td
+ *
+ * @brief Value of a literal or of a sample, as SQLite orders them
+ */
+typedef struct {
+    int type;               /**< SQLite type */
+    sqlite3_int64 i;        /**< Integer */
+    double d;               /**< Real */
+    const guint8 *p;        /**< Text or BLOB bytes */
+    int n;                  /**< Bytes of @e p */
+} s_value_td;
+
+/**
+ * @struct s_sample_td
+ *
+ * @brief Sample of @c sqlite_stat4, first column of the index only
+ */
+typedef struct {
+    double neq;             /**< Rows equal to the sample */
+    double nlt;             /**< Rows less than the sample */
+    double ndlt;            /**< Distinct values less than the sample */
+    guint8 *record;         /**< Index record of the sample */
+    s_value_td value;       /**< First column, pointing into @e record */
+} s_sample_td;
+
+/**
+ * @struct s_index_td
+ *
+ * @brief Statistics of an index on the first column
+ */
+typedef struct {
+    char *name;             /**< Index */
+    char *column;           /**< First column */
+    double rows;            /**< Rows (@c sqlite_stat1), or 0 */
+    double per_value;       /**< Rows per first column value, or 0 */
+    GArray *samples;        /**< Samples in index order (@e s_sample_td) */
+} s_index_td;
+
+/**
+ * @struct s_column_td
+ *
+ * @brief Terms of a condition on one column
+ */
+typedef struct {
+    const char *name;       /**< Column, as written */
+    GArray *eq;             /**< Values it may equal (@e s_value_td) */
+    int has_lo;             /**< Whether there is a lower bound */
+    int lo_incl;            /**< Whether it is included */
+    s_value_td lo;          /**< Lower bound */
+    int has_hi;             /**< Whether there is an upper bound */
+    int hi_incl;            /**< Whether it is included */
+    s_value_td hi;          /**< Upper bound */
+    double count;           /**< Rows estimated to match */
+} s_column_td;
+
+/**
+ * @struct s_est_td
+ *
+ * @brief What an estimate is made from
+ */
+typedef struct {
+    sqlite3 *db;            /**< Connection */
+    const char *table;      /**< Table */
+    char *alias;            /**< Column aliasing the rowid, or @c NULL */
+    GPtrArray *indexes;     /**< Indexes (@e s_index_td) */
+    double total;           /**< Rows of the table, or -1 */
+    estimate_basis_td basis;/**< Least reliable source used so far */
+} s_est_td;
+
+
+/**
+ * @brief Release a token
+ *
+ * @param data Token (@e s_token_td *)
+ */
+static void s_token_clear(gpointer data)
+{
+    g_free(((s_token_td*) data)->text);
+}
+
+
+/**
+ * @brief Split a condition into tokens
+ *
+ * Only what terms comparing columns with literals are made of is told
+ * apart; the rest becomes @e S_TK_OTHER.
+ *
+ * @param sql Condition
+ *
+ * @return Tokens (@e s_token_td; free with @a g_array_free())
+ */
+static GArray *s_tokenize(const char *sql)
+{
+    GArray *tokens = g_array_new(FALSE, TRUE, sizeof(s_token_td));
+    const char *p = sql;
+
+    g_array_set_clear_func(tokens, s_token_clear);
+    while (*p) {
+        s_token_td tk = { S_TK_OTHER, NULL, 0 };
+        const char *start = p;
+        char close = 0;
+
+        if (g_ascii_isspace(*p)) {
+            p++;
+            continue;
+        } else if (*p == '\'' || *p == '"' || *p == '`' || *p == '[') {
+            /* Quoted: doubled quotes stand for one */
+            close = (*p == '[') ? ']' : *p;
+            GString *text = g_string_new(NULL);
+            for (p++; *p; p++) {
+                if (*p == close && p[1] == close && close != ']') {
+                    g_string_append_c(text, *p++);
+                } else if (*p == close) {
+                    break;
+                } else {
+                    g_string_append_c(text, *p);
+                }
+            }
+            p += (*p) ? 1 : 0;
+            tk.type = (close == '\'') ? S_TK_STRING : S_TK_ID;
+            tk.quoted = 1;
+            tk.text = g_string_free(text, FALSE);
+        } else if (g_ascii_isdigit(*p) || (*p == '.'
+                    && g_ascii_isdigit(p[1]))) {
+            while (g_ascii_isalnum(*p) || *p == '.' || ((*p == '+'
+                            || *p == '-') && (p[-1] == 'e'
+                                || p[-1] == 'E'))) {
+                p++;
+            }
+            tk.type = S_TK_NUMBER;
+        } else if (g_ascii_isalpha(*p) || *p == '_') {
+            while (g_ascii_isalnum(*p) || *p == '_' || *p == '$') {
+                p++;
+            }
+            tk.type = S_TK_ID;
+        } else if (strchr("<>=!", *p)) {
+            p += (p[1] == '=' || (*p == '<' && p[1] == '>')) ? 2 : 1;
+            tk.type = S_TK_OP;
+        } else {
+            tk.type = (*p == '(') ? S_TK_LP : (*p == ')') ? S_TK_RP
+                : (*p == ',') ? S_TK_COMMA : (*p == '.') ? S_TK_DOT
+                : S_TK_OTHER;
+            p++;
+        }
+        if (!tk.text) {
+            tk.text = g_strndup(start, (gsize) (p - start));
+        }
+        g_array_append_val(tokens, tk);
+    }
+
+    return tokens;
+}
+
+
+/**
+ * @brief Tell whether a token is a given keyword
+ *
+ * @param tk Token (may be @c NULL)
+ * @param kw Keyword, upper case
+ *
+ * @return Non-zero if it is
+ */
+static int s_is_keyword(const s_token_td *tk, const char *kw)
+{
+    return tk && tk->type == S_TK_ID && !tk->quoted
+        && g_ascii_strcasecmp(tk->text, kw) == 0;
+}
+
+
+/**
+ * @brief Get the SQLite affinity of a declared type
+ *
+ * @param decl Declared type (may be @c NULL)
+ *
+ * @return @e SQLITE_INTEGER, @e SQLITE_FLOAT or @e SQLITE_TEXT, or
+ *         @e SQLITE_BLOB for no affinity; numeric affinity is
+ *         @e SQLITE_FLOAT
+ */
+static int s_affinity(const char *decl)
+{
+    char *t = g_ascii_strup((decl) ? decl : "", -1);
+    int aff = SQLITE_FLOAT;
+
+    if (strstr(t, "INT")) {
+        aff = SQLITE_INTEGER;
+    } else if (strstr(t, "CHAR") || strstr(t, "CLOB")
+            || strstr(t, "TEXT")) {
+        aff = SQLITE_TEXT;
+    } else if (strstr(t, "BLOB") || !*t) {
+        aff = SQLITE_BLOB;
+    }
+    g_free(t);
+
+    return aff;
+}
+
+
+/**
+ * @brief Convert a literal to a value, applying the affinity of the
+ *        column it is compared with
+ *
+ * @param tk  Literal token
+ * @param aff Affinity (see @a s_affinity())
+ * @param v   Where to store the value (pointing into the token)
+ *
+ * @return Non-zero if the token is a literal
+ */
+static int s_literal(const s_token_td *tk, int aff, s_value_td *v)
+{
+    memset(v, 0, sizeof(*v));
+    if (s_is_keyword(tk, "NULL")) {
+        v->type = SQLITE_NULL;
+        return 1;
+    } else if (tk->type != S_TK_STRING && tk->type != S_TK_NUMBER) {
+        return 0;
+    }
+
+    /* Numbers are text for text columns, text numbers for numeric ones */
+    int number = (tk->type == S_TK_NUMBER);
+    if (tk->type == S_TK_STRING && (aff == SQLITE_INTEGER
+                || aff == SQLITE_FLOAT)) {
+        char *end = NULL;
+        g_ascii_strtod(tk->text, &end);
+        number = (*tk->text && end && !*end);
+    } else if (aff == SQLITE_TEXT) {
+        number = 0;
+    }
+
+    if (!number) {
+        v->type = SQLITE_TEXT;
+        v->p = (const guint8*) tk->text;
+        v->n = (int) strlen(tk->text);
+    } else if (strpbrk(tk->text, ".eE") && !g_str_has_prefix(tk->text,
+                "0x") && !g_str_has_prefix(tk->text, "0X")) {
+        v->type = SQLITE_FLOAT;
+        v->d = g_ascii_strtod(tk->text, NULL);
+    } else {
+        v->type = SQLITE_INTEGER;
+        v->i = g_ascii_strtoll(tk->text, NULL, 0);
+    }
+
+    return 1;
+}
+
+
+/**
+ * @brief Get the rank of the kind of a value in SQLite order
+ *
+ * @param v Value
+ *
+ * @return 0 for @c NULL, 1 for numbers, 2 for text, 3 for BLOBs
+ */
+static int s_class(const s_value_td *v)
+{
+    return (v->type == SQLITE_INTEGER || v->type == SQLITE_FLOAT) ? 1
+        : (v->type == SQLITE_TEXT) ? 2 : (v->type == SQLITE_BLOB) ? 3 : 0;
+}
+
+
+/**
+ * @brief Compare two values in SQLite order (@c BINARY collation)
+ *
+ * @param a First value
+ * @param b Second value
+ *
+ * @return Negative, zero or positive as @e a is less than, equal to or
+ *         greater than @e b
+ */
+static int s_value_cmp(const s_value_td *a, const s_value_td *b)
+{
+    int ca = s_class(a), cb = s_class(b);
+
+    if (ca != cb) {
+        return (ca < cb) ? -1 : 1;
+    } else if (ca == 1) {
+        if (a->type == SQLITE_INTEGER && b->type == SQLITE_INTEGER) {
+            return (a->i < b->i) ? -1 : (a->i > b->i);
+        }
+        double da = (a->type == SQLITE_INTEGER) ? (double) a->i : a->d;
+        double db = (b->type == SQLITE_INTEGER) ? (double) b->i : b->d;
+        return (da < db) ? -1 : (da > db);
+    } else if (ca >= 2) {
+        int n = MIN(a->n, b->n);
+        int c = (n > 0) ? memcmp(a->p, b->p, (size_t) n) : 0;
+        return (c != 0) ? c : (a->n < b->n) ? -1 : (a->n > b->n);
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Read a varint of an SQLite record
+ *
+ * @param p   Bytes
+ * @param end End of the bytes
+ * @param out Where to store the value
+ *
+ * @return Bytes read, or 0 if truncated
+ */
+static int s_varint(const guint8 *p, const guint8 *end, guint64 *out)
+{
+    *out = 0;
+    for (int i = 0; i < 9 && p + i < end; ++i) {
+        if (i == 8) {
+            *out = (*out << 8) | p[i];
+            return 9;
+        }
+        *out = (*out << 7) | (p[i] & 0x7f);
+        if (!(p[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Decode the first column of an SQLite record
+ *
+ * @param rec Record
+ * @param n   Bytes of @e rec
+ * @param v   Where to store the value (pointing into @e rec)
+ *
+ * @return Non-zero on success
+ */
+static int s_first_column(const guint8 *rec, int n, s_value_td *v)
+{
+    static const int sizes[] = { 0, 1, 2, 3, 4, 6, 8, 8, 0, 0 };
+    const guint8 *end = rec + n;
+    guint64 hdr, type;
+    int k = s_varint(rec, end, &hdr);
+
+    if (k == 0 || hdr > (guint64) n || s_varint(rec + k, end, &type) == 0) {
+        return 0;
+    }
+
+    const guint8 *data = rec + hdr;
+    memset(v, 0, sizeof(*v));
+    if (type >= 12) {
+        v->type = (type % 2) ? SQLITE_TEXT : SQLITE_BLOB;
+        v->n = (int) ((type - 12) / 2);
+        v->p = data;
+        return data + v->n <= end;
+    } else if (type == 10 || type == 11 || data + sizes[type] > end) {
+        return 0;
+    } else if (type == 0) {
+        v->type = SQLITE_NULL;
+        return 1;
+    } else if (type == 8 || type == 9) {
+        v->type = SQLITE_INTEGER;
+        v->i = (type == 9);
+        return 1;
+    }
+
+    /* Big-endian, integers sign-extended */
+    guint64 bits = (data[0] & 0x80 && type != 7) ? ~G_GUINT64_CONSTANT(0)
+        : 0;
+    for (int i = 0; i < sizes[type]; ++i) {
+        bits = (bits << 8) | data[i];
+    }
+    if (type == 7) {
+        v->type = SQLITE_FLOAT;
+        memcpy(&v->d, &bits, sizeof(v->d));
+    } else {
+        v->type = SQLITE_INTEGER;
+        v->i = (sqlite3_int64) bits;
+    }
+
+    return 1;
+}
+
+
+/**
+ * @brief Release the statistics of an index
+ *
+ * @param data Index (@e s_index_td *)
+ */
+static void s_index_free(gpointer data)
+{
+    s_index_td *ix = data;
+
+    for (guint i = 0; ix->samples && i < ix->samples->len; ++i) {
+        g_free(g_array_index(ix->samples, s_sample_td, i).record);
+    }
+    if (ix->samples) {
+        g_array_free(ix->samples, TRUE);
+    }
+    g_free(ix->name);
+    g_free(ix->column);
+    g_free(ix);
+}
+
+
+/**
+ * @brief Find the statistics of an index
+ *
+ * @param e    Estimate
+ * @param name Index
+ *
+ * @return Index, or @c NULL if it is not on a column of the table
+ */
+static s_index_td *s_find_index(const s_est_td *e, const char *name)
+{
+    for (guint i = 0; name && i < e->indexes->len; ++i) {
+        s_index_td *ix = g_ptr_array_index(e->indexes, i);
+        if (g_ascii_strcasecmp(ix->name, name) == 0) {
+            return ix;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Read the indexes of the table, their statistics and the rows
+ *        of the table
+ *
+ * Missing statistics tables are not an error.
+ *
+ * @param e Estimate
+ */
+static void s_load_stats(s_est_td *e)
+{
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2(e->db,
+                "SELECT il.name, ii.name FROM pragma_index_list(?1) AS il"
+                " JOIN pragma_index_info(il.name) AS ii"
+                " WHERE ii.seqno = 0 AND ii.cid >= 0 AND il.partial = 0;",
+                -1, &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, e->table, -1, SQLITE_STATIC);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            s_index_td *ix = g_new0(s_index_td, 1);
+            ix->name = g_strdup((const char*) sqlite3_column_text(stmt, 0));
+            ix->column = g_strdup((const char*) sqlite3_column_text(stmt,
+                        1));
+            ix->samples = g_array_new(FALSE, TRUE, sizeof(s_sample_td));
+            g_ptr_array_add(e->indexes, ix);
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    /* "N per-value..." for an index, "N" for the table alone */
+    stmt = NULL;
+    if (sqlite3_prepare_v2(e->db, "SELECT idx, stat FROM sqlite_stat1"
+                " WHERE tbl = ?1;", -1, &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, e->table, -1, SQLITE_STATIC);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char *stat = (const char*) sqlite3_column_text(stmt, 1);
+            char *end = NULL;
+            double rows = (stat) ? g_ascii_strtod(stat, &end) : 0.0;
+            double per_value = (end) ? g_ascii_strtod(end, NULL) : 0.0;
+            s_index_td *ix = s_find_index(e,
+                    (const char*) sqlite3_column_text(stmt, 0));
+            if (ix) {
+                ix->rows = rows;
+                ix->per_value = per_value;
+            }
+            e->total = MAX(e->total, rows);
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    stmt = NULL;
+    if (sqlite3_prepare_v2(e->db, "SELECT idx, neq, nlt, ndlt, sample"
+                " FROM sqlite_stat4 WHERE tbl = ?1 ORDER BY rowid;", -1,
+                &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, e->table, -1, SQLITE_STATIC);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            s_index_td *ix = s_find_index(e,
+                    (const char*) sqlite3_column_text(stmt, 0));
+            const void *rec = sqlite3_column_blob(stmt, 4);
+            int n = sqlite3_column_bytes(stmt, 4);
+            if (!ix || !rec) {
+                continue;
+            }
+            s_sample_td smp;
+            smp.neq = g_ascii_strtod((const char*)
+                    sqlite3_column_text(stmt, 1), NULL);
+            smp.nlt = g_ascii_strtod((const char*)
+                    sqlite3_column_text(stmt, 2), NULL);
+            smp.ndlt = g_ascii_strtod((const char*)
+                    sqlite3_column_text(stmt, 3), NULL);
+            smp.record = g_malloc((gsize) n);
+            memcpy(smp.record, rec, (size_t) n);
+            if (s_first_column(smp.record, n, &smp.value)) {
+                g_array_append_val(ix->samples, smp);
+            } else {
+                g_free(smp.record);
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+}
+
+
+/**
+ * @brief Find the column aliasing the rowid, if any
+ *
+ * @param e Estimate
+ */
+static void s_find_alias(s_est_td *e)
+{
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2(e->db, "SELECT name, type, pk,"
+                " (SELECT count(*) FROM pragma_table_info(?1) WHERE pk > 0)"
+                " FROM pragma_table_info(?1) WHERE pk = 1;", -1, &stmt,
+                NULL) != SQLITE_OK) {
+        return;
+    }
+    sqlite3_bind_text(stmt, 1, e->table, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW
+            && sqlite3_column_int(stmt, 3) == 1 && sqlite3_column_text(stmt,
+                1) && g_ascii_strcasecmp((const char*)
+                sqlite3_column_text(stmt, 1), "INTEGER") == 0) {
+        e->alias = g_strdup((const char*) sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+}
+
+
+/**
+ * @brief Tell whether a column name is the rowid
+ *
+ * @param e    Estimate
+ * @param name Column name
+ *
+ * @return Non-zero if it is
+ */
+static int s_is_rowid(const s_est_td *e, const char *name)
+{
+    return g_ascii_strcasecmp(name, "rowid") == 0
+        || g_ascii_strcasecmp(name, "oid") == 0
+        || g_ascii_strcasecmp(name, "_rowid_") == 0
+        || (e->alias && g_ascii_strcasecmp(name, e->alias) == 0);
+}
+
+
+/**
+ * @brief Get the declared type of a column of the table
+ *
+ * @param e    Estimate
+ * @param name Column name
+ *
+ * @return Affinity (see @a s_affinity())
+ */
+static int s_column_affinity(const s_est_td *e, const char *name)
+{
+    const char *decl = NULL;
+
+    if (s_is_rowid(e, name)) {
+        return SQLITE_INTEGER;
+    }
+    if (sqlite3_table_column_metadata(e->db, NULL, e->table, name, &decl,
+                NULL, NULL, NULL, NULL) != SQLITE_OK) {
+        return SQLITE_BLOB;
+    }
+
+    return s_affinity(decl);
+}
+
+
+/**
+ * @brief Find the terms on a column, adding an empty entry if none
+ *
+ * @param cols Terms per column (@e s_column_td)
+ * @param name Column name
+ *
+ * @return Entry
+ */
+static s_column_td *s_column(GArray *cols, const char *name)
+{
+    for (guint i = 0; i < cols->len; ++i) {
+        s_column_td *c = &g_array_index(cols, s_column_td, i);
+        if (g_ascii_strcasecmp(c->name, name) == 0) {
+            return c;
+        }
+    }
+
+    s_column_td c;
+    memset(&c, 0, sizeof(c));
+    c.name = name;
+    c.eq = g_array_new(FALSE, TRUE, sizeof(s_value_td));
+    g_array_append_val(cols, c);
+
+    return &g_array_index(cols, s_column_td, cols->len - 1);
+}
+
+
+/**
+ * @brief Add a bound to the terms on a column, keeping the tightest
+ *
+ * @param c  Terms on the column
+ * @param op Operator, with the column on its left
+ * @param v  Literal
+ */
+static void s_add_bound(s_column_td *c, const char *op, const s_value_td *v)
+{
+    int incl = (op[1] == '=');
+
+    if (op[0] == '>') {
+        int cmp = (c->has_lo) ? s_value_cmp(v, &c->lo) : 1;
+        if (cmp > 0 || (cmp == 0 && !incl)) {
+            c->lo = *v;
+            c->lo_incl = incl;
+        }
+        c->has_lo = 1;
+    } else {
+        int cmp = (c->has_hi) ? s_value_cmp(v, &c->hi) : -1;
+        if (cmp < 0 || (cmp == 0 && !incl)) {
+            c->hi = *v;
+            c->hi_incl = incl;
+        }
+        c->has_hi = 1;
+    }
+}
+
+
+/**
+ * @brief Parse a column reference (@c col or @c table.col)
+ *
+ * @param tk  Tokens
+ * @param i   Where the reference starts (advanced past it)
+ * @param end End of the term
+ *
+ * @return Column name, or @c NULL if there is no reference
+ */
+static const char *s_column_ref(const s_token_td *tk, int *i, int end)
+{
+    if (*i >= end || tk[*i].type != S_TK_ID) {
+        return NULL;
+    }
+    if (*i + 2 < end && tk[*i + 1].type == S_TK_DOT
+            && tk[*i + 2].type == S_TK_ID) {
+        *i += 2;
+    }
+
+    return tk[(*i)++].text;
+}
+
+
+/**
+ * @brief Parse a term comparing a column with literals
+ *
+ * @param e    Estimate
+ * @param tk   Tokens
+ * @param i    First token of the term
+ * @param end  End of the term
+ * @param cols Terms per column (@e s_column_td), added to
+ *
+ * @return Non-zero if the term was understood
+ */
+static int s_parse_term(const s_est_td *e, const s_token_td *tk, int i,
+        int end, GArray *cols)
+{
+    static const char *flipped[][2] = {
+        { "<", ">" }, { "<=", ">=" }, { ">", "<" }, { ">=", "<=" },
+        { "=", "=" }, { "==", "=" }
+    };
+    s_value_td v, w;
+    int j = i;
+    const char *name = s_column_ref(tk, &j, end);
+
+    if (name && j + 2 == end && tk[j].type == S_TK_OP) {
+        /* col OP literal */
+        const char *op = tk[j].text;
+        if (!s_literal(&tk[j + 1], s_column_affinity(e, name), &v)
+                || v.type == SQLITE_NULL || strcmp(op, "<>") == 0
+                || strcmp(op, "!=") == 0) {
+            return 0;
+        }
+        s_column_td *c = s_column(cols, name);
+        if (op[0] == '=') {
+            g_array_append_val(c->eq, v);
+        } else {
+            s_add_bound(c, op, &v);
+        }
+        return 1;
+    } else if (name && j + 2 == end && s_is_keyword(&tk[j], "IS")
+            && s_is_keyword(&tk[j + 1], "NULL")) {
+        /* col IS NULL */
+        s_literal(&tk[j + 1], SQLITE_BLOB, &v);
+        g_array_append_val(s_column(cols, name)->eq, v);
+        return 1;
+    } else if (name && j + 4 == end && s_is_keyword(&tk[j], "BETWEEN")
+            && s_is_keyword(&tk[j + 2], "AND")) {
+        /* col BETWEEN literal AND literal */
+        int aff = s_column_affinity(e, name);
+        if (!s_literal(&tk[j + 1], aff, &v) || !s_literal(&tk[j + 3], aff,
+                    &w) || v.type == SQLITE_NULL || w.type == SQLITE_NULL) {
+            return 0;
+        }
+        s_column_td *c = s_column(cols, name);
+        s_add_bound(c, ">=", &v);
+        s_add_bound(c, "<=", &w);
+        return 1;
+    } else if (name && j + 2 < end && s_is_keyword(&tk[j], "IN")
+            && tk[j + 1].type == S_TK_LP && tk[end - 1].type == S_TK_RP) {
+        /* col IN (literal, ...) */
+        int aff = s_column_affinity(e, name);
+        GArray *values = g_array_new(FALSE, FALSE, sizeof(s_value_td));
+        int k = j + 2;
+        for (; k < end - 1; k += 2) {
+            if (!s_literal(&tk[k], aff, &v) || v.type == SQLITE_NULL
+                    || (tk[k + 1].type != S_TK_COMMA && k + 1 != end - 1)) {
+                break;
+            }
+            g_array_append_val(values, v);
+        }
+        int ok = (k >= end - 1 && values->len > 0);
+        if (ok) {
+            g_array_append_vals(s_column(cols, name)->eq, values->data,
+                    values->len);
+        }
+        g_array_free(values, TRUE);
+        return ok;
+    } else if (end - i == 3 && tk[i + 1].type == S_TK_OP) {
+        /* literal OP col */
+        j = i + 2;
+        name = s_column_ref(tk, &j, end);
+        for (size_t f = 0; name && f < G_N_ELEMENTS(flipped); ++f) {
+            if (strcmp(tk[i + 1].text, flipped[f][0]) == 0) {
+                if (!s_literal(&tk[i], s_column_affinity(e, name), &v)
+                        || v.type == SQLITE_NULL) {
+                    return 0;
+                }
+                s_column_td *c = s_column(cols, name);
+                if (flipped[f][1][0] == '=') {
+                    g_array_append_val(c->eq, v);
+                } else {
+                    s_add_bound(c, flipped[f][1], &v);
+                }
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Parse the terms joined by @c AND of a condition
+ *
+ * @param e        Estimate
+ * @param tk       Tokens
+ * @param start    First token
+ * @param end      End of the tokens
+ * @param cols     Terms per column (@e s_column_td), added to
+ * @param nunknown Where to count the terms not understood
+ */
+static void s_parse_terms(const s_est_td *e, const s_token_td *tk,
+        int start, int end, GArray *cols, int *nunknown)
+{
+    int depth = 0, between = 0, first = start;
+
+    /* A disjunction at the top is one term not understood */
+    for (int i = start; i < end; ++i) {
+        depth += (tk[i].type == S_TK_LP) - (tk[i].type == S_TK_RP);
+        if (depth == 0 && s_is_keyword(&tk[i], "OR")) {
+            (*nunknown)++;
+            return;
+        }
+    }
+
+    depth = 0;
+    for (int i = start; i <= end; ++i) {
+        int split = (i == end);
+        if (i < end) {
+            depth += (tk[i].type == S_TK_LP) - (tk[i].type == S_TK_RP);
+            if (depth == 0 && s_is_keyword(&tk[i], "BETWEEN")) {
+                between = 1;
+            } else if (depth == 0 && s_is_keyword(&tk[i], "AND")) {
+                split = !between;
+                between = 0;
+            }
+        }
+        if (!split) {
+            continue;
+        }
+        if (i - first >= 2 && tk[first].type == S_TK_LP
+                && tk[i - 1].type == S_TK_RP) {
+            /* Parenthesized: its own terms, if it is one group */
+            int d = 0, whole = 1;
+            for (int k = first; k < i - 1 && whole; ++k) {
+                d += (tk[k].type == S_TK_LP) - (tk[k].type == S_TK_RP);
+                whole = (d > 0);
+            }
+            if (whole) {
+                s_parse_terms(e, tk, first + 1, i - 1, cols, nunknown);
+                first = i + 1;
+                continue;
+            }
+        }
+        if (i > first && !s_parse_term(e, tk, first, i, cols)) {
+            (*nunknown)++;
+        }
+        first = i + 1;
+    }
+}
+
+
+/**
+ * @brief Estimate the rows of an index equal to a value from its
+ *        samples
+ *
+ * @param e  Estimate
+ * @param ix Index with samples
+ * @param v  Value
+ *
+ * @return Rows
+ */
+static double s_stat4_eq(const s_est_td *e, const s_index_td *ix,
+        const s_value_td *v)
+{
+    const s_sample_td *a = NULL, *b = NULL;
+
+    for (guint i = 0; i < ix->samples->len; ++i) {
+        const s_sample_td *smp = &g_array_index(ix->samples, s_sample_td,
+                i);
+        int cmp = s_value_cmp(&smp->value, v);
+        if (cmp == 0) {
+            return smp->neq;
+        } else if (cmp < 0) {
+            a = smp;
+        } else {
+            b = smp;
+            break;
+        }
+    }
+
+    /* Between samples: rows per distinct value in the gap */
+    double rows = ((b) ? b->nlt : e->total) - ((a) ? a->nlt + a->neq : 0.0);
+    double values = (b) ? b->ndlt - ((a) ? a->ndlt + 1.0 : 0.0)
+        : (ix->per_value > 0.0) ? rows / ix->per_value : 1.0;
+
+    return MAX(rows, 0.0) / MAX(values, 1.0);
+}
+
+
+/**
+ * @brief Place a value on a line, for interpolating between samples
+ *
+ * Numbers are themselves; text and BLOBs are their first bytes read as
+ * a base-256 fraction.
+ *
+ * @param v Value
+ *
+ * @return Position
+ */
+static double s_position(const s_value_td *v)
+{
+    double pos = 0.0, scale = 1.0;
+
+    if (v->type == SQLITE_INTEGER) {
+        return (double) v->i;
+    } else if (v->type == SQLITE_FLOAT) {
+        return v->d;
+    }
+    for (int i = 0; i < MIN(v->n, 6); ++i) {
+        scale /= 256.0;
+        pos += v->p[i] * scale;
+    }
+
+    return pos;
+}
+
+
+/**
+ * @brief Estimate the rows of an index less than (or equal to) a value
+ *        from its samples
+ *
+ * Between two samples of the same kind of value, rows are taken as
+ * evenly spread over the gap; otherwise the value is halfway.
+ *
+ * @param e     Estimate
+ * @param ix    Index with samples
+ * @param v     Value
+ * @param equal Non-zero to count rows equal to @e v too
+ *
+ * @return Rows
+ */
+static double s_stat4_below(const s_est_td *e, const s_index_td *ix,
+        const s_value_td *v, int equal)
+{
+    const s_sample_td *a = NULL, *b = NULL;
+
+    for (guint i = 0; i < ix->samples->len && !b; ++i) {
+        const s_sample_td *smp = &g_array_index(ix->samples, s_sample_td,
+                i);
+        int cmp = s_value_cmp(&smp->value, v);
+        if (cmp == 0) {
+            return smp->nlt + ((equal) ? smp->neq : 0.0);
+        }
+        a = (cmp < 0) ? smp : a;
+        b = (cmp > 0) ? smp : NULL;
+    }
+
+    double lo = (a) ? a->nlt + a->neq : 0.0;
+    double hi = (b) ? b->nlt : e->total;
+    double frac = 0.5;
+    if (a && b && s_class(v) > 0 && s_class(&a->value) == s_class(v)
+            && s_class(&b->value) == s_class(v)) {
+        double pa = s_position(&a->value), pb = s_position(&b->value);
+        frac = (pb > pa) ? (s_position(v) - pa) / (pb - pa) : 0.5;
+        frac = CLAMP(frac, 0.0, 1.0);
+    }
+
+    return lo + frac * MAX(hi - lo, 0.0);
+}
+
+
+/**
+ * @brief Read the smallest or largest rowid
+ *
+ * @param e    Estimate
+ * @param func @c "min" or @c "max"
+ *
+ * @return Rowid, or 0 for an empty table
+ */
+static double s_rowid_end(const s_est_td *e, const char *func)
+{
+    char *sql = sqlite3_mprintf("SELECT %s(rowid) FROM \"%w\";", func,
+            e->table);
+    sqlite3_stmt *stmt = NULL;
+    double v = 0.0;
+
+    if (sql && sqlite3_prepare_v2(e->db, sql, -1, &stmt, NULL) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW) {
+        v = sqlite3_column_double(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_free(sql);
+
+    return v;
+}
+
+
+/**
+ * @brief Get the number of a bound, for a range of rowids
+ *
+ * @param v Bound
+ *
+ * @return Number, or @c NAN for non-numbers
+ */
+static double s_number(const s_value_td *v)
+{
+    return (v->type == SQLITE_INTEGER) ? (double) v->i
+        : (v->type == SQLITE_FLOAT) ? v->d : NAN;
+}
+
+
+/**
+ * @brief Estimate the rows matching the terms on a column
+ *
+ * @param e Estimate (@e basis lowered to the source used)
+ * @param c Terms on the column (@e count set)
+ */
+static void s_estimate_column(s_est_td *e, s_column_td *c)
+{
+    double n = e->total;
+    const s_index_td *ix = NULL;
+
+    for (guint i = 0; i < e->indexes->len; ++i) {
+        const s_index_td *cand = g_ptr_array_index(e->indexes, i);
+        if (g_ascii_strcasecmp(cand->column, c->name) == 0 && (!ix
+                    || cand->samples->len > ix->samples->len
+                    || (cand->rows > 0.0 && ix->rows <= 0.0))) {
+            ix = cand;
+        }
+    }
+
+    if (s_is_rowid(e, c->name)) {
+        /* Rowids are unique and, mostly, evenly spread */
+        double lo = s_rowid_end(e, "min"), hi = s_rowid_end(e, "max");
+        if (c->eq->len > 0) {
+            c->count = MIN(c->eq->len, n);
+        } else {
+            double a = (c->has_lo) ? MAX(s_number(&c->lo), lo) : lo;
+            double b = (c->has_hi) ? MIN(s_number(&c->hi), hi) : hi;
+            c->count = (isnan(a) || isnan(b)) ? n * ESTIMATE_UNKNOWN_TERM
+                : (b < a) ? 0.0 : n * (b - a + 1.0) / (hi - lo + 1.0);
+        }
+        return;
+    }
+
+    if (ix && ix->samples->len > 0) {
+        if (c->eq->len > 0) {
+            c->count = 0.0;
+            for (guint i = 0; i < c->eq->len; ++i) {
+                c->count += s_stat4_eq(e, ix,
+                        &g_array_index(c->eq, s_value_td, i));
+            }
+        } else {
+            /* NULLs are never in a range */
+            s_value_td null = { SQLITE_NULL, 0, 0.0, NULL, 0 };
+            double above = (c->has_hi) ? s_stat4_below(e, ix, &c->hi,
+                    c->hi_incl) : n;
+            double below = (c->has_lo) ? s_stat4_below(e, ix, &c->lo,
+                    !c->lo_incl) : s_stat4_below(e, ix, &null, 1);
+            c->count = MAX(above - below, 0.0);
+        }
+        return;
+    }
+
+    double factor = ESTIMATE_UNKNOWN_TERM;
+    if (ix && ix->per_value > 0.0 && c->eq->len > 0 && n > 0.0) {
+        factor = c->eq->len * ix->per_value / n;
+        e->basis = MIN(e->basis, ESTIMATE_STAT1);
+    } else if (ix && ix->rows > 0.0 && c->eq->len == 0) {
+        /* As SQLite does: a quarter of the rows per bound */
+        factor = (c->has_lo && c->has_hi) ? ESTIMATE_UNKNOWN_TERM
+            * ESTIMATE_UNKNOWN_TERM : ESTIMATE_UNKNOWN_TERM;
+        e->basis = MIN(e->basis, ESTIMATE_STAT1);
+    } else {
+        e->basis = ESTIMATE_GUESS;
+    }
+    c->count = n * MIN(factor, 1.0);
+}
+
+
+/**
+ * @brief Read the query plan of the filter
+ *
+ * @param e         Estimate
+ * @param condition Condition
+ * @param out       Estimate (@e plan, @e index and @e full_scan set)
+ * @param searched  Where to store the first column searched by the
+ *                  index, or @c NULL (free with @a g_free())
+ *
+ * @return @e SQLITE_OK on success or the SQLite error code of preparing
+ *         the query
+ */
+static int s_read_plan(const s_est_td *e, const char *condition,
+        estimate_td *out, char **searched)
+{
+    char *sql = sqlite3_mprintf("EXPLAIN QUERY PLAN SELECT rowid"
+            " FROM \"%w\" WHERE (%s);", e->table, condition);
+    sqlite3_stmt *stmt = NULL;
+    int rc = (sql) ? sqlite3_prepare_v2(e->db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+
+    sqlite3_free(sql);
+    *searched = NULL;
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    GString *plan = g_string_new(NULL);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *detail = (const char*) sqlite3_column_text(stmt, 3);
+        if (!detail) {
+            continue;
+        }
+        g_string_append_printf(plan, "%s%s", (plan->len) ? "\n" : "",
+                detail);
+
+        /* "SCAN t [USING ... INDEX i]", "SEARCH t USING ... (a=? ...)" */
+        const char *using = strstr(detail, " USING ");
+        const char *name = (using) ? strstr(using, "INDEX ") : NULL;
+        if (g_str_has_prefix(detail, "SCAN ")) {
+            out->full_scan = 1;
+        } else if (g_str_has_prefix(detail, "SEARCH ") && using
+                && !out->index) {
+            if (strstr(using, "INTEGER PRIMARY KEY")) {
+                out->index = g_strdup("INTEGER PRIMARY KEY");
+                *searched = g_strdup("rowid");
+            } else if (name) {
+                name += strlen("INDEX ");
+                out->index = g_strndup(name, strcspn(name, " "));
+                const s_index_td *ix = s_find_index(e, out->index);
+                *searched = (ix) ? g_strdup(ix->column) : NULL;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    out->plan = g_string_free(plan, FALSE);
+
+    return SQLITE_OK;
+}
+
+
+/* Estimate the rows of a table matching a condition */
+int estimate_filter(sqlite3 *db, const char *table, const char *condition,
+        int limit, estimate_td *out)
+{
+    if (!out) {
+        return SQLITE_MISUSE;
+    }
+    memset(out, 0, sizeof(*out));
+    out->total = out->rows = out->visited = -1.0;
+    if (!db || !table || !condition) {
+        return SQLITE_MISUSE;
+    }
+
+    s_est_td e = { db, table, NULL, NULL, -1.0, ESTIMATE_STAT4 };
+    e.indexes = g_ptr_array_new_with_free_func(s_index_free);
+    char *searched = NULL;
+    s_find_alias(&e);
+    s_load_stats(&e);
+    int rc = s_read_plan(&e, condition, out, &searched);
+    if (rc != SQLITE_OK) {
+        g_ptr_array_free(e.indexes, TRUE);
+        g_free(e.alias);
+        return rc;
+    }
+
+    if (e.total < 0.0) {
+        /* Without statistics, the largest rowid is the next best thing */
+        e.total = s_rowid_end(&e, "max");
+        e.basis = ESTIMATE_GUESS;
+    }
+
+    GArray *tokens = s_tokenize(condition);
+    GArray *cols = g_array_new(FALSE, TRUE, sizeof(s_column_td));
+    int nunknown = 0;
+    s_parse_terms(&e, (const s_token_td*) tokens->data, 0,
+            (int) tokens->len, cols, &nunknown);
+
+    /* Terms are taken as independent */
+    double rows = e.total, reads = -1.0;
+    for (guint i = 0; i < cols->len; ++i) {
+        s_column_td *c = &g_array_index(cols, s_column_td, i);
+        s_estimate_column(&e, c);
+        rows *= (e.total > 0.0) ? MIN(c->count / e.total, 1.0) : 0.0;
+        if (searched && (g_ascii_strcasecmp(c->name, searched) == 0
+                    || (s_is_rowid(&e, c->name)
+                        && strcmp(searched, "rowid") == 0))) {
+            reads = c->count;
+        }
+        g_array_free(c->eq, TRUE);
+    }
+    for (int i = 0; i < nunknown; ++i) {
+        rows *= ESTIMATE_UNKNOWN_TERM;
+        e.basis = ESTIMATE_GUESS;
+    }
+
+    /* Scans stop once the rows listed are found */
+    if (out->full_scan || reads < 0.0) {
+        reads = e.total;
+    }
+    out->total = e.total;
+    out->rows = rows;
+    out->visited = (rows > limit) ? reads * limit / rows : reads;
+    out->basis = e.basis;
+
+    g_array_free(cols, TRUE);
+    g_array_free(tokens, TRUE);
+    g_ptr_array_free(e.indexes, TRUE);
+    g_free(e.alias);
+    g_free(searched);
+
+    return SQLITE_OK;
+}
+
+
+/* Release the contents of an estimate */
+void estimate_clear(estimate_td *e)
+{
+    if (!e) {
+        return;
+    }
+
+    g_free(e->index);
+    g_free(e->plan);
+    e->index = NULL;
+    e->plan = NULL;
+}
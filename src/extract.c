@@ -0,0 +1,329 @@
+/**
+ * @file extract.c
+ *
+ * @brief Implementation of the parallel BLOB extraction to files
+ */
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+
+/* Project includes */
+#include <db.h>
+#include <thumb.h>
+
+/* Local includes */
+#include <extract.h>
+
+
+#define EXTRACT_REPORT_USEC (200000)    /**< Progress refresh interval */
+#define EXTRACT_EXT_SIZE (8)            /**< Size of a file extension */
+
+
+/**
+ * @struct s_shared_td
+ *
+ * @brief State shared by all the extraction threads
+ */
+typedef struct {
+    const char *filename;   /**< Database file */
+    const char *table;      /**< Table holding the BLOBs */
+    const char *column;     /**< Column holding the BLOBs */
+    const char *dir;        /**< Output directory */
+    char *sql;              /**< Range scan statement */
+    job_td *job;            /**< Job for progress and cancellation */
+    GMutex lock;            /**< Protects the counters below */
+    sqlite3_int64 nfiles;   /**< Files written so far */
+    sqlite3_int64 nbytes;   /**< Bytes written so far */
+    sqlite3_int64 nfailed;  /**< BLOBs that could not be read */
+    gint stop;              /**< Set when a thread hits a fatal error */
+    gint running;           /**< Threads still running */
+} s_shared_td;
+
+/**
+ * @struct s_part_td
+ *
+ * @brief One @e rowid range extracted by a thread
+ */
+typedef struct {
+    s_shared_td *sh;        /**< Shared state */
+    sqlite3_int64 lo;       /**< First rowid of the range */
+    sqlite3_int64 hi;       /**< Last rowid of the range */
+    int rc;                 /**< Outcome of the range */
+} s_part_td;
+
+
+/**
+ * @brief Choose the file extension of a BLOB from its first bytes
+ *
+ * @param prefix First bytes of the BLOB
+ * @param n      Number of bytes in @e prefix
+ * @param ext    Where to write the extension (@e EXTRACT_EXT_SIZE bytes)
+ */
+static void s_extension(const unsigned char *prefix, int n, char *ext)
+{
+    const char *format = thumb_sniff(prefix, n);
+
+    snprintf(ext, EXTRACT_EXT_SIZE, "%s", (format) ? format : "bin");
+    for (char *p = ext; *p; ++p) {
+        *p = g_ascii_tolower(*p);
+    }
+}
+
+
+/**
+ * @brief Stream one open BLOB to a file
+ *
+ * @param blob  BLOB handle positioned on the row
+ * @param rowid Row of the BLOB (names the file)
+ * @param dir   Output directory
+ * @param buf   Buffer of @e EXTRACT_CHUNK bytes
+ * @param size  Size of the BLOB
+ *
+ * @return @e SQLITE_OK on success, an SQLite error code if the BLOB
+ *         cannot be read, or @e SQLITE_CANTOPEN / @e SQLITE_IOERR if the
+ *         file cannot be written
+ */
+static int s_write_blob(sqlite3_blob *blob, sqlite3_int64 rowid,
+        const char *dir, unsigned char *buf, int size)
+{
+    int n = MIN(size, EXTRACT_CHUNK);
+    int rc = sqlite3_blob_read(blob, buf, n, 0);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    char ext[EXTRACT_EXT_SIZE];
+    char name[64];
+    s_extension(buf, n, ext);
+    snprintf(name, sizeof(name), "%lld.%s", (long long) rowid, ext);
+    char *path = g_build_filename(dir, name, NULL);
+    FILE *fp = fopen(path, "wb");
+    g_free(path);
+    if (!fp) {
+        return SQLITE_CANTOPEN;
+    }
+
+    for (int off = 0; rc == SQLITE_OK && off < size; off += n) {
+        n = MIN(EXTRACT_CHUNK, size - off);
+        if (off > 0) {
+            rc = sqlite3_blob_read(blob, buf, n, off);
+        }
+        if (rc == SQLITE_OK
+                && fwrite(buf, 1, (size_t) n, fp) != (size_t) n) {
+            rc = SQLITE_IOERR;
+        }
+    }
+    if (fclose(fp) != 0 && rc == SQLITE_OK) {
+        rc = SQLITE_IOERR;
+    }
+
+    return rc;
+}
+
+
+/**
+ * @brief Thread: extract every BLOB of one @e rowid range
+ *
+ * @param userdata Partition to extract (@e s_part_td *)
+ *
+ * @return Always @c NULL (outcome in @e part->rc)
+ */
+static gpointer s_extract_part(gpointer userdata)
+{
+    s_part_td *part = userdata;
+    s_shared_td *sh = part->sh;
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_blob *blob = NULL;
+    unsigned char *buf = g_malloc(EXTRACT_CHUNK);
+
+    part->rc = db_open_reader(sh->filename, &db);
+    if (part->rc == SQLITE_OK) {
+        part->rc = sqlite3_prepare_v2(db, sh->sql, -1, &stmt, NULL);
+    }
+    if (part->rc == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, part->lo);
+        sqlite3_bind_int64(stmt, 2, part->hi);
+
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            if (g_atomic_int_get(&sh->stop) || job_is_cancelled(sh->job)) {
+                rc = SQLITE_INTERRUPT;
+                break;
+            }
+            sqlite3_int64 rowid = sqlite3_column_int64(stmt, 0);
+            int brc = (blob)
+                ? sqlite3_blob_reopen(blob, rowid)
+                : sqlite3_blob_open(db, "main", sh->table, sh->column,
+                        rowid, 0, &blob);
+            int size = 0;
+            if (brc == SQLITE_OK) {
+                size = sqlite3_blob_bytes(blob);
+                brc = s_write_blob(blob, rowid, sh->dir, buf, size);
+            } else if (blob) {
+                /* A failed reopen leaves the handle aborted */
+                sqlite3_blob_close(blob);
+                blob = NULL;
+            }
+            if (brc == SQLITE_CANTOPEN || brc == SQLITE_IOERR) {
+                rc = brc;
+                break;
+            }
+
+            g_mutex_lock(&sh->lock);
+            if (brc == SQLITE_OK) {
+                sh->nfiles++;
+                sh->nbytes += size;
+            } else {
+                sh->nfailed++;
+            }
+            g_mutex_unlock(&sh->lock);
+        }
+        part->rc = (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    }
+    if (part->rc != SQLITE_OK && part->rc != SQLITE_INTERRUPT) {
+        g_atomic_int_set(&sh->stop, 1);
+    }
+
+    if (blob) {
+        sqlite3_blob_close(blob);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    g_free(buf);
+    g_atomic_int_add(&sh->running, -1);
+
+    return NULL;
+}
+
+
+/**
+ * @brief Publish the progress and throughput of an extraction
+ *
+ * @param sh     Shared state
+ * @param nblobs Number of BLOBs to extract
+ * @param total  Bytes to extract
+ * @param start  Monotonic start time (microseconds)
+ */
+static void s_report(s_shared_td *sh, sqlite3_int64 nblobs, double total,
+        gint64 start)
+{
+    g_mutex_lock(&sh->lock);
+    sqlite3_int64 done = sh->nfiles + sh->nfailed;
+    double bytes = (double) sh->nbytes;
+    g_mutex_unlock(&sh->lock);
+
+    double secs = (double) (g_get_monotonic_time() - start) / 1e6;
+    double fraction = (total > 0.0) ? bytes / total
+        : (double) done / (double) MAX(nblobs, 1);
+    job_report(sh->job, fraction, "%lld of %lld files, %.1f MB/s",
+            (long long) done, (long long) nblobs,
+            (secs > 0.0) ? bytes / secs / 1e6 : 0.0);
+}
+
+
+/* Write every BLOB of a column to a file in a directory */
+int extract_blobs(job_td *job, const char *filename, const char *table,
+        const char *column, const char *dir, int nthreads,
+        extract_result_td *out)
+{
+    if (!filename || !table || !column || !dir || !out) {
+        return SQLITE_MISUSE;
+    }
+    memset(out, 0, sizeof(*out));
+    nthreads = CLAMP(nthreads, 1, EXTRACT_MAX_THREADS);
+    gint64 start = g_get_monotonic_time();
+
+    sqlite3 *db = NULL;
+    int rc = db_open_reader(filename, &db);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    /* Count and bounds; typeof() and length() do not load the BLOBs */
+    job_report(job, 0.0, "Counting BLOBs...");
+    char *sql = sqlite3_mprintf("SELECT count(*), total(length(\"%w\")), "
+            "min(rowid), max(rowid) FROM \"%w\" "
+            "WHERE typeof(\"%w\") = 'blob';", column, table, column);
+    sqlite3_stmt *stmt = NULL;
+    rc = (sql) ? sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_step(stmt);
+    }
+    if (rc != SQLITE_ROW || sqlite3_column_int64(stmt, 0) == 0) {
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        return (rc == SQLITE_ROW) ? SQLITE_OK : rc;
+    }
+    sqlite3_int64 nblobs = sqlite3_column_int64(stmt, 0);
+    double total = sqlite3_column_double(stmt, 1);
+    sqlite3_int64 lo = sqlite3_column_int64(stmt, 2);
+    sqlite3_int64 hi = sqlite3_column_int64(stmt, 3);
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    /* Split [lo, hi] into equal rowid ranges (unsigned: no overflow) */
+    sqlite3_uint64 span = (sqlite3_uint64) hi - (sqlite3_uint64) lo;
+    if (span < (sqlite3_uint64) nthreads) {
+        nthreads = 1;
+    }
+    sqlite3_uint64 step = span / (sqlite3_uint64) nthreads + 1;
+
+    s_shared_td sh;
+    s_part_td parts[EXTRACT_MAX_THREADS];
+    GThread *threads[EXTRACT_MAX_THREADS];
+
+    memset(&sh, 0, sizeof(sh));
+    sh.sql = sqlite3_mprintf("SELECT rowid FROM \"%w\" "
+            "WHERE rowid BETWEEN ?1 AND ?2 AND typeof(\"%w\") = 'blob';",
+            table, column);
+    if (!sh.sql) {
+        return SQLITE_NOMEM;
+    }
+    sh.filename = filename;
+    sh.table = table;
+    sh.column = column;
+    sh.dir = dir;
+    sh.job = job;
+    sh.running = nthreads;
+    g_mutex_init(&sh.lock);
+
+    memset(parts, 0, sizeof(parts));
+    for (int p = 0; p < nthreads; ++p) {
+        sqlite3_uint64 first = (sqlite3_uint64) lo
+            + (sqlite3_uint64) p * step;
+        parts[p].sh = &sh;
+        parts[p].lo = (sqlite3_int64) first;
+        parts[p].hi = (p == nthreads - 1)
+            ? hi : (sqlite3_int64) (first + step - 1);
+        threads[p] = g_thread_new("extract", s_extract_part, &parts[p]);
+    }
+
+    /* Report throughput while the threads write */
+    while (g_atomic_int_get(&sh.running) > 0) {
+        s_report(&sh, nblobs, total, start);
+        g_usleep(EXTRACT_REPORT_USEC);
+    }
+
+    rc = SQLITE_OK;
+    for (int p = 0; p < nthreads; ++p) {
+        g_thread_join(threads[p]);
+        /* A real error explains the interruption of the other threads */
+        if (rc == SQLITE_OK || rc == SQLITE_INTERRUPT) {
+            rc = (parts[p].rc != SQLITE_OK) ? parts[p].rc : rc;
+        }
+    }
+    s_report(&sh, nblobs, total, start);
+
+    out->nfiles = sh.nfiles;
+    out->nbytes = sh.nbytes;
+    out->nfailed = sh.nfailed;
+    out->seconds = (double) (g_get_monotonic_time() - start) / 1e6;
+    g_mutex_clear(&sh.lock);
+    sqlite3_free(sh.sql);
+
+    return rc;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file history.c
+ *
+ * @brief Implementation of the persistent query history
+ */
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <history.h>
+
+
+/**
+ * @struct history_td
+ *
+ * @brief Query history
+ */
+struct history_td {
+    sqlite3 *db;    /**< History database */
+};
+
+
+/* Open (creating it if needed) a query history */
+history_td *history_open(const char *path)
+{
+    char *dflt = NULL;
+    if (!path) {
+        char *dir = g_build_filename(g_get_user_data_dir(), "sqliteview",
+                NULL);
+        g_mkdir_with_parents(dir, 0700);
+        dflt = g_build_filename(dir, "history.db", NULL);
+        g_free(dir);
+        path = dflt;
+    }
+
+    sqlite3 *db = NULL;
+    int rc = sqlite3_open_v2(path, &db,
+            SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    g_free(dflt);
+    if (rc == SQLITE_OK) {
+        /* Other instances of the application may share the file */
+        sqlite3_busy_timeout(db, DB_JOB_BUSY_TIMEOUT);
+        rc = sqlite3_exec(db,
+                "CREATE TABLE IF NOT EXISTS runs("
+                "id INTEGER PRIMARY KEY, "
+                "at TEXT NOT NULL DEFAULT (datetime('now', 'localtime')), "
+                "db TEXT NOT NULL, sql TEXT NOT NULL, usec INTEGER, "
+                "nrows INTEGER, steps INTEGER, plan TEXT, error TEXT);"
+                "CREATE INDEX IF NOT EXISTS runs_by_sql "
+                "ON runs(db, sql, id);", NULL, NULL, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        sqlite3_close(db);
+        return NULL;
+    }
+
+    history_td *h = g_new0(history_td, 1);
+    h->db = db;
+
+    return h;
+}
+
+
+/* Close a query history */
+void history_close(history_td *h)
+{
+    if (!h) {
+        return;
+    }
+
+    sqlite3_close(h->db);
+    g_free(h);
+}
+
+
+/* Store a run of a query */
+int history_add(history_td *h, const char *filename, const char *sql,
+        const query_stats_td *stats, const char *error)
+{
+    if (!h) {
+        return SQLITE_OK;
+    }
+    if (!filename || !sql || !stats) {
+        return SQLITE_MISUSE;
+    }
+
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(h->db,
+            "INSERT INTO runs(db, sql, usec, nrows, steps, plan, error) "
+            "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7);", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_bind_text(stmt, 1, filename, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, sql, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, stats->usec);
+    sqlite3_bind_int64(stmt, 4, stats->nrows);
+    sqlite3_bind_int64(stmt, 5, stats->vm_steps);
+    sqlite3_bind_text(stmt, 6, stats->plan, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 7, error, -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        return rc;
+    }
+
+    char *prune = sqlite3_mprintf("DELETE FROM runs WHERE id <= "
+            "(SELECT max(id) FROM runs) - %d;", HISTORY_MAX_RUNS);
+    rc = (prune) ? sqlite3_exec(h->db, prune, NULL, NULL, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(prune);
+
+    return rc;
+}
+
+
+/* Create a store for `history_search()` */
+GtkListStore *history_store_new(void)
+{
+    GType types[HISTORY_NCOLS];
+
+    for (int i = 0; i < HISTORY_NCOLS; ++i) {
+        types[i] = G_TYPE_STRING;
+    }
+
+    return gtk_list_store_newv(HISTORY_NCOLS, types);
+}
+
+
+/**
+ * @brief Describe how a run compares with the previous run of its SQL
+ *
+ * @param stmt Search statement positioned on a run
+ * @param buf  Where to write the description
+ * @param len  Size of @e buf
+ */
+static void s_describe_change(sqlite3_stmt *stmt, char *buf, size_t len)
+{
+    sqlite3_int64 usec = sqlite3_column_int64(stmt, 4);
+    sqlite3_int64 prev = sqlite3_column_int64(stmt, 8);
+    const char *plan_changed = (sqlite3_column_int(stmt, 9))
+        ? " plan changed" : "";
+
+    if (sqlite3_column_type(stmt, 7) != SQLITE_NULL) {
+        snprintf(buf, len, "failed");
+    } else if (sqlite3_column_type(stmt, 8) == SQLITE_NULL) {
+        snprintf(buf, len, "first run");
+    } else if (prev > 0) {
+        snprintf(buf, len, "%+.0f%%%s",
+                (double) (usec - prev) * 100.0 / (double) prev,
+                plan_changed);
+    } else {
+        snprintf(buf, len, "%s", (*plan_changed) ? plan_changed + 1 : "");
+    }
+}
+
+
+/* Find the runs whose SQL contains a text, newest first */
+int history_search(history_td *h, const char *text, int limit,
+        GtkListStore *store)
+{
+    if (!h || !store) {
+        return SQLITE_MISUSE;
+    }
+
+    /* Previous run of the same SQL on the same file, failed or not */
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(h->db,
+            "SELECT * FROM (SELECT at, db, sql, nrows, usec, steps, plan, "
+            "error, lag(usec) OVER w, "
+            "lag(id) OVER w IS NOT NULL AND plan IS NOT lag(plan) OVER w, "
+            "id FROM runs WINDOW w AS (PARTITION BY db, sql ORDER BY id)) "
+            "WHERE ?1 IS NULL OR instr(lower(sql), lower(?1)) > 0 "
+            "ORDER BY id DESC LIMIT ?2;", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    if (text && *text) {
+        sqlite3_bind_text(stmt, 1, text, -1, SQLITE_STATIC);
+    }
+    sqlite3_bind_int(stmt, 2, limit);
+
+    gtk_list_store_clear(store);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        char ms[32], change[64];
+        const char *error = (const char*) sqlite3_column_text(stmt, 7);
+        char *plan = (error) ? g_strconcat("Error: ", error, NULL)
+            : g_strdup((const char*) sqlite3_column_text(stmt, 6));
+        snprintf(ms, sizeof(ms), "%.3f",
+                (double) sqlite3_column_int64(stmt, 4) / 1000.0);
+        s_describe_change(stmt, change, sizeof(change));
+        gtk_list_store_insert_with_values(store, NULL, -1,
+                HISTORY_COL_WHEN, sqlite3_column_text(stmt, 0),
+                HISTORY_COL_DB, sqlite3_column_text(stmt, 1),
+                HISTORY_COL_MS, ms,
+                HISTORY_COL_CHANGE, change,
+                HISTORY_COL_ROWS, sqlite3_column_text(stmt, 3),
+                HISTORY_COL_STEPS, sqlite3_column_text(stmt, 5),
+                HISTORY_COL_SQL, sqlite3_column_text(stmt, 2),
+                HISTORY_COL_PLAN, plan, -1);
+        g_free(plan);
+    }
+    sqlite3_finalize(stmt);
+
+    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file import.c
+ *
+ * @brief Implementation of the import of files into BLOB cells
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* System includes */
+#include <stdio.h>
+#include <sys/types.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <import.h>
+
+
+/**
+ * @brief Get the size of an open file and rewind it
+ *
+ * @param fp   Open file
+ * @param size Where to store the size in bytes
+ *
+ * @return @e SQLITE_OK on success or @e SQLITE_IOERR on failure
+ */
+static int s_file_size(FILE *fp, sqlite3_int64 *size)
+{
+    if (fseeko(fp, 0, SEEK_END) != 0) {
+        return SQLITE_IOERR;
+    }
+    off_t end = ftello(fp);
+    if (end < 0 || fseeko(fp, 0, SEEK_SET) != 0) {
+        return SQLITE_IOERR;
+    }
+    *size = (sqlite3_int64) end;
+
+    return SQLITE_OK;
+}
+
+
+/**
+ * @brief Resize a cell to @e size zero bytes
+ *
+ * @param db     Connection inside a write transaction
+ * @param table  Table of the cell
+ * @param column Column of the cell
+ * @param rowid  Row of the cell
+ * @param size   New size of the value
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_NOTFOUND if the row does
+ *         not exist, or an SQLite error code otherwise
+ */
+static int s_make_room(sqlite3 *db, const char *table, const char *column,
+        sqlite3_int64 rowid, sqlite3_int64 size)
+{
+    char *sql = sqlite3_mprintf("UPDATE \"%w\" SET \"%w\" = zeroblob(?1) "
+            "WHERE rowid = ?2;", table, column);
+    sqlite3_stmt *stmt = NULL;
+    int rc = (sql) ? sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_bind_int64(stmt, 1, size);
+    sqlite3_bind_int64(stmt, 2, rowid);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        return rc;
+    }
+
+    return (sqlite3_changes(db) == 1) ? SQLITE_OK : SQLITE_NOTFOUND;
+}
+
+
+/**
+ * @brief Copy a file into an open BLOB of the same size
+ *
+ * @param job  Job for progress and cancellation (may be @c NULL)
+ * @param fp   File positioned at its start
+ * @param blob Writable BLOB handle
+ * @param size Bytes to copy
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_INTERRUPT if cancelled,
+ *         @e SQLITE_IOERR on a short read, or an SQLite error code
+ */
+static int s_stream(job_td *job, FILE *fp, sqlite3_blob *blob, int size)
+{
+    unsigned char *buf = g_malloc(IMPORT_CHUNK);
+    int rc = SQLITE_OK;
+
+    for (int off = 0; rc == SQLITE_OK && off < size; ) {
+        int n = MIN(IMPORT_CHUNK, size - off);
+        if (job_is_cancelled(job)) {
+            rc = SQLITE_INTERRUPT;
+        } else if (fread(buf, 1, (size_t) n, fp) != (size_t) n) {
+            rc = SQLITE_IOERR;
+        } else {
+            rc = sqlite3_blob_write(blob, buf, n, off);
+            off += n;
+            job_report(job, (double) off / size, "%d of %d KB",
+                    off / 1024, size / 1024);
+        }
+    }
+    g_free(buf);
+
+    return rc;
+}
+
+
+/* Replace the value of a cell with the content of a file */
+int import_blob_file(job_td *job, const char *filename, const char *table,
+        const char *column, sqlite3_int64 rowid, const char *path)
+{
+    if (!filename || !table || !column || !path) {
+        return SQLITE_MISUSE;
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return SQLITE_CANTOPEN;
+    }
+    sqlite3_int64 size = 0;
+    sqlite3 *db = NULL;
+    int rc = s_file_size(fp, &size);
+    if (rc == SQLITE_OK) {
+        rc = db_open_writer(filename, &db);
+    }
+    if (rc == SQLITE_OK
+            && size > sqlite3_limit(db, SQLITE_LIMIT_LENGTH, -1)) {
+        rc = SQLITE_TOOBIG;
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        sqlite3_blob *blob = NULL;
+        rc = s_make_room(db, table, column, rowid, size);
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_blob_open(db, "main", table, column, rowid, 1,
+                    &blob);
+        }
+        if (rc == SQLITE_OK) {
+            rc = s_stream(job, fp, blob, (int) size);
+        }
+        if (blob) {
+            sqlite3_blob_close(blob);
+        }
+        int rc2 = sqlite3_exec(db, (rc == SQLITE_OK)
+                ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL);
+        if (rc == SQLITE_OK) {
+            rc = rc2;
+        }
+    }
+    sqlite3_close(db);
+    fclose(fp);
+
+    return rc;
+}
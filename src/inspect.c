@@ -0,0 +1,652 @@
+/**
+ * @file inspect.c
+ *
+ * @brief Implementation of the raw B-tree page inspector
+ *
+ * Follows the layout described in the SQLite database file format
+ * documentation: 100-byte header on page 1, 8 or 12-byte B-tree page
+ * headers, big-endian integers and variable-length integers.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* System includes */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <inspect.h>
+
+
+#define INSPECT_HEADER_SIZE (100)   /**< Size of the database header */
+#define INSPECT_FREELIST (1)        /**< Owner index of free pages */
+
+/* B-tree page types (first byte of the page header) */
+#define PAGE_INTERIOR_INDEX (0x02)  /**< Interior index B-tree page */
+#define PAGE_INTERIOR_TABLE (0x05)  /**< Interior table B-tree page */
+#define PAGE_LEAF_INDEX (0x0a)      /**< Leaf index B-tree page */
+#define PAGE_LEAF_TABLE (0x0d)      /**< Leaf table B-tree page */
+
+
+/**
+ * @struct inspect_td
+ *
+ * @brief Mapped database file and lazily built page ownership
+ */
+struct inspect_td {
+    unsigned char *map;     /**< Read-only mapping of the whole file */
+    size_t size;            /**< Size of the mapping in bytes */
+    unsigned page_size;     /**< Page size in bytes */
+    unsigned usable;        /**< Usable bytes per page (minus reserve) */
+    unsigned npages;        /**< Number of complete pages in the file */
+    int nroots;             /**< Number of schema root pages */
+    unsigned *roots;        /**< Root page numbers */
+    char **names;           /**< Owner descriptions (index 0 unused) */
+    int next_root;          /**< Next root whose tree is not walked */
+    int freelist_done;      /**< Non-zero once the freelist is walked */
+    int *owner;             /**< Owner index per page (0: unknown) */
+};
+
+/**
+ * @struct s_cell_td
+ *
+ * @brief Decoded B-tree cell
+ */
+typedef struct {
+    unsigned left;          /**< Left child page (interior pages) */
+    int has_key;            /**< Non-zero if @e key holds a rowid */
+    sqlite3_int64 key;      /**< Integer key (table B-trees) */
+    sqlite3_int64 payload;  /**< Total payload size (0 if none) */
+    unsigned local;         /**< Payload bytes stored on the page */
+    unsigned overflow;      /**< First overflow page (0 if none) */
+} s_cell_td;
+
+
+/**
+ * @brief Read a 2-byte big-endian integer
+ */
+static unsigned s_get2(const unsigned char *p)
+{
+    return ((unsigned) p[0] << 8) | p[1];
+}
+
+
+/**
+ * @brief Read a 4-byte big-endian integer
+ */
+static unsigned s_get4(const unsigned char *p)
+{
+    return ((unsigned) p[0] << 24) | ((unsigned) p[1] << 16)
+        | ((unsigned) p[2] << 8) | p[3];
+}
+
+
+/**
+ * @brief Read an SQLite variable-length integer
+ *
+ * @param p   First byte of the varint
+ * @param end End of the readable bytes
+ * @param v   Where to store the value
+ *
+ * @return Number of bytes used (1 to 9), or 0 if it runs past @e end
+ */
+static unsigned s_varint(const unsigned char *p, const unsigned char *end,
+        sqlite3_int64 *v)
+{
+    sqlite3_uint64 x = 0;
+
+    for (unsigned i = 0; i < 9; ++i) {
+        if (p + i >= end) {
+            return 0;
+        }
+        if (i == 8) {
+            x = (x << 8) | p[i];
+            *v = (sqlite3_int64) x;
+            return 9;
+        }
+        x = (x << 7) | (p[i] & 0x7f);
+        if (!(p[i] & 0x80)) {
+            *v = (sqlite3_int64) x;
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Get the first byte of a page
+ *
+ * @param in   Inspector handle
+ * @param pgno Page number (must be valid)
+ */
+static const unsigned char *s_page(const inspect_td *in, unsigned pgno)
+{
+    return in->map + (size_t) (pgno - 1) * in->page_size;
+}
+
+
+/**
+ * @brief Check whether a page is a B-tree page and get its header
+ *
+ * @param in   Inspector handle
+ * @param pgno Page number (must be valid)
+ * @param hdr  Where to store the offset of the B-tree page header
+ *
+ * @return Page type byte, or 0 if it is not a B-tree page
+ */
+static unsigned s_btree_type(const inspect_td *in, unsigned pgno,
+        unsigned *hdr)
+{
+    *hdr = (pgno == 1) ? INSPECT_HEADER_SIZE : 0;
+    unsigned type = s_page(in, pgno)[*hdr];
+
+    switch (type) {
+        case PAGE_INTERIOR_INDEX:
+        case PAGE_INTERIOR_TABLE:
+        case PAGE_LEAF_INDEX:
+        case PAGE_LEAF_TABLE:
+            return type;
+        default:
+            return 0;
+    }
+}
+
+
+/**
+ * @brief Compute how much of a payload is stored on the B-tree page
+ *
+ * @param in      Inspector handle
+ * @param type    B-tree page type
+ * @param payload Total payload size
+ *
+ * @return Number of payload bytes stored locally
+ */
+static unsigned s_local_size(const inspect_td *in, unsigned type,
+        sqlite3_int64 payload)
+{
+    sqlite3_int64 u = in->usable;
+    sqlite3_int64 x = (type == PAGE_LEAF_TABLE)
+        ? u - 35 : ((u - 12) * 64 / 255) - 23;
+
+    if (payload <= x) {
+        return (unsigned) payload;
+    }
+    sqlite3_int64 m = ((u - 12) * 32 / 255) - 23;
+    sqlite3_int64 k = m + ((payload - m) % (u - 4));
+
+    return (unsigned) ((k <= x) ? k : m);
+}
+
+
+/**
+ * @brief Decode the cell at a given offset of a B-tree page
+ *
+ * @param in   Inspector handle
+ * @param pgno Page number
+ * @param type B-tree page type
+ * @param off  Offset of the cell in the page
+ * @param c    Where to store the decoded cell
+ *
+ * @return 1 on success, 0 if the cell runs past the page
+ */
+static int s_parse_cell(const inspect_td *in, unsigned pgno,
+        unsigned type, unsigned off, s_cell_td *c)
+{
+    const unsigned char *page = s_page(in, pgno);
+    const unsigned char *end = page + in->page_size;
+    const unsigned char *p = page + off;
+    unsigned n;
+
+    memset(c, 0, sizeof(*c));
+    if (off >= in->page_size) {
+        return 0;
+    }
+    if (type == PAGE_INTERIOR_TABLE || type == PAGE_INTERIOR_INDEX) {
+        if (p + 4 > end) {
+            return 0;
+        }
+        c->left = s_get4(p);
+        p += 4;
+    }
+    if (type == PAGE_INTERIOR_TABLE) {
+        c->has_key = 1;
+        return s_varint(p, end, &c->key) != 0;
+    }
+
+    if (!(n = s_varint(p, end, &c->payload))) {
+        return 0;
+    }
+    p += n;
+    if (type == PAGE_LEAF_TABLE) {
+        c->has_key = 1;
+        if (!(n = s_varint(p, end, &c->key))) {
+            return 0;
+        }
+        p += n;
+    }
+    if (c->payload < 0) {
+        return 0;
+    }
+    c->local = s_local_size(in, type, c->payload);
+    if ((sqlite3_int64) c->local < c->payload) {
+        if (p + c->local + 4 > end) {
+            return 0;
+        }
+        c->overflow = s_get4(p + c->local);
+    }
+
+    return 1;
+}
+
+
+/**
+ * @brief Mark the pages of an overflow chain as owned
+ *
+ * @param in    Inspector handle
+ * @param pgno  First overflow page
+ * @param owner Owner index
+ */
+static void s_mark_chain(inspect_td *in, unsigned pgno, int owner)
+{
+    while (pgno >= 1 && pgno <= in->npages && !in->owner[pgno]) {
+        in->owner[pgno] = owner;
+        pgno = s_get4(s_page(in, pgno));
+    }
+}
+
+
+/**
+ * @brief Mark every page of a B-tree (children and overflow chains)
+ *        as owned
+ *
+ * @param in    Inspector handle
+ * @param pgno  Root of the (sub)tree
+ * @param owner Owner index
+ *
+ * @note Pages already owned are not visited again, which also stops
+ *       cycles in corrupt files
+ */
+static void s_walk_tree(inspect_td *in, unsigned pgno, int owner)
+{
+    if (pgno < 1 || pgno > in->npages || in->owner[pgno]) {
+        return;
+    }
+    in->owner[pgno] = owner;
+
+    unsigned hdr;
+    unsigned type = s_btree_type(in, pgno, &hdr);
+    if (!type) {
+        return;
+    }
+    const unsigned char *page = s_page(in, pgno);
+    int interior = (type == PAGE_INTERIOR_TABLE
+            || type == PAGE_INTERIOR_INDEX);
+    unsigned cells = hdr + (interior ? 12u : 8u);
+    unsigned ncells = s_get2(page + hdr + 3);
+
+    for (unsigned i = 0; i < ncells; ++i) {
+        s_cell_td c;
+        if (cells + 2 * i + 2 > in->page_size || !s_parse_cell(in, pgno,
+                    type, s_get2(page + cells + 2 * i), &c)) {
+            break;
+        }
+        if (c.left) {
+            s_walk_tree(in, c.left, owner);
+        }
+        if (c.overflow) {
+            s_mark_chain(in, c.overflow, owner);
+        }
+    }
+    if (interior) {
+        s_walk_tree(in, s_get4(page + hdr + 8), owner);
+    }
+}
+
+
+/**
+ * @brief Mark the freelist trunk and leaf pages
+ *
+ * @param in Inspector handle
+ */
+static void s_walk_freelist(inspect_td *in)
+{
+    unsigned trunk = s_get4(in->map + 32);
+
+    while (trunk >= 1 && trunk <= in->npages && !in->owner[trunk]) {
+        const unsigned char *page = s_page(in, trunk);
+        unsigned nleaves = s_get4(page + 4);
+
+        in->owner[trunk] = INSPECT_FREELIST;
+        for (unsigned i = 0; i < nleaves && 8 + 4 * i + 4 <= in->usable;
+                ++i) {
+            unsigned leaf = s_get4(page + 8 + 4 * i);
+            if (leaf >= 1 && leaf <= in->npages && !in->owner[leaf]) {
+                in->owner[leaf] = INSPECT_FREELIST;
+            }
+        }
+        trunk = s_get4(page);
+    }
+}
+
+
+/**
+ * @brief Load the schema root pages through a read-only connection
+ *
+ * @param in       Inspector handle
+ * @param filename Path to the database file
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_load_roots(inspect_td *in, const char *filename)
+{
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int rc = db_open_reader(filename, &db);
+
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    rc = sqlite3_prepare_v2(db,
+            "SELECT type, name, rootpage FROM sqlite_master "
+            "WHERE rootpage > 0 ORDER BY rootpage;", -1, &stmt, NULL);
+    while (rc == SQLITE_OK && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int n = in->nroots;
+        unsigned *roots = realloc(in->roots,
+                (size_t) (n + 1) * sizeof(*roots));
+        char **names = realloc(in->names,
+                (size_t) (n + 3) * sizeof(*names));
+        if (roots) in->roots = roots;
+        if (names) in->names = names;
+        if (!roots || !names) {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+        /* names[0] unused, names[1] is the freelist, then each root */
+        in->roots[n] = (unsigned) sqlite3_column_int64(stmt, 2);
+        in->names[n + 2] = sqlite3_mprintf("%s '%s'",
+                sqlite3_column_text(stmt, 0),
+                sqlite3_column_text(stmt, 1));
+        in->nroots++;
+        rc = SQLITE_OK;
+    }
+    if (rc == SQLITE_DONE) {
+        rc = SQLITE_OK;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    return rc;
+}
+
+
+/* Map a database file read-only and load its schema root pages */
+int inspect_open(const char *filename, inspect_td **out)
+{
+    if (!filename || !out) {
+        return SQLITE_MISUSE;
+    }
+    *out = NULL;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return SQLITE_CANTOPEN;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < INSPECT_HEADER_SIZE) {
+        close(fd);
+        return SQLITE_NOTADB;
+    }
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED,
+            fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return SQLITE_IOERR;
+    }
+
+    inspect_td *in = calloc(1, sizeof(*in));
+    if (!in) {
+        munmap(map, (size_t) st.st_size);
+        return SQLITE_NOMEM;
+    }
+    in->map = map;
+    in->size = (size_t) st.st_size;
+
+    /* Header: magic string, page size (1 means 65536), reserve */
+    unsigned page_size = s_get2(in->map + 16);
+    if (page_size == 1) {
+        page_size = 65536;
+    }
+    if (memcmp(in->map, "SQLite format 3", 16) != 0 || page_size < 512
+            || (page_size & (page_size - 1)) || in->map[20] >= page_size) {
+        inspect_close(in);
+        return SQLITE_NOTADB;
+    }
+    in->page_size = page_size;
+    in->usable = page_size - in->map[20];
+    in->npages = (unsigned) (in->size / page_size);
+    in->owner = calloc((size_t) in->npages + 1, sizeof(int));
+    in->names = calloc(2, sizeof(char*));
+    if (!in->owner || !in->names) {
+        inspect_close(in);
+        return SQLITE_NOMEM;
+    }
+    in->names[INSPECT_FREELIST] = sqlite3_mprintf("freelist");
+
+    /* The schema table itself is rooted at page 1 */
+    in->roots = malloc(sizeof(unsigned));
+    char **names = realloc(in->names, 3 * sizeof(char*));
+    if (!in->roots || !names) {
+        if (names) in->names = names;
+        inspect_close(in);
+        return SQLITE_NOMEM;
+    }
+    in->names = names;
+    in->roots[0] = 1;
+    in->names[2] = sqlite3_mprintf("table 'sqlite_master'");
+    in->nroots = 1;
+
+    /* Without a readable schema pages still decode, owners stay unknown */
+    (void) s_load_roots(in, filename);
+
+    *out = in;
+
+    return SQLITE_OK;
+}
+
+
+/* Unmap the file and free the inspector */
+void inspect_close(inspect_td *in)
+{
+    if (!in) {
+        return;
+    }
+
+    if (in->names) {
+        for (int i = 1; i < in->nroots + 2; ++i) {
+            sqlite3_free(in->names[i]);
+        }
+    }
+    free(in->names);
+    free(in->roots);
+    free(in->owner);
+    if (in->map) {
+        munmap(in->map, in->size);
+    }
+    free(in);
+}
+
+
+/* Get the number of pages in the mapped file */
+unsigned inspect_page_count(const inspect_td *in)
+{
+    return (in) ? in->npages : 0;
+}
+
+
+/* Get the name of the table or index owning a page */
+const char *inspect_page_owner(inspect_td *in, unsigned pgno)
+{
+    if (!in || pgno < 1 || pgno > in->npages) {
+        return NULL;
+    }
+
+    if (!in->owner[pgno] && !in->freelist_done) {
+        s_walk_freelist(in);
+        in->freelist_done = 1;
+    }
+    while (!in->owner[pgno] && in->next_root < in->nroots) {
+        int r = in->next_root++;
+        s_walk_tree(in, in->roots[r], r + 2);
+    }
+
+    return (in->owner[pgno]) ? in->names[in->owner[pgno]] : NULL;
+}
+
+
+/**
+ * @brief Append the database header fields to a description
+ *
+ * @param in  Inspector handle
+ * @param str String being built
+ */
+static void s_describe_header(const inspect_td *in, sqlite3_str *str)
+{
+    static const char *encodings[] = { "?", "UTF-8", "UTF-16le",
+        "UTF-16be" };
+    const unsigned char *h = in->map;
+    unsigned enc = s_get4(h + 56);
+
+    sqlite3_str_appendf(str,
+            "Database header\n"
+            "  Page size: %u, reserved bytes: %u\n"
+            "  File change counter: %u, pages in header: %u\n"
+            "  Freelist trunk: %u, free pages: %u\n"
+            "  Schema cookie: %u, schema format: %u\n"
+            "  Text encoding: %s, user version: %u, application id: %u\n"
+            "  Largest root (auto-vacuum): %u\n\n",
+            in->page_size, h[20], s_get4(h + 24), s_get4(h + 28),
+            s_get4(h + 32), s_get4(h + 36), s_get4(h + 40),
+            s_get4(h + 44), encodings[(enc <= 3) ? enc : 0],
+            s_get4(h + 60), s_get4(h + 68), s_get4(h + 52));
+}
+
+
+/**
+ * @brief Append an overflow chain to a description
+ *
+ * @param in   Inspector handle
+ * @param str  String being built
+ * @param pgno First overflow page
+ */
+static void s_describe_chain(const inspect_td *in, sqlite3_str *str,
+        unsigned pgno)
+{
+    unsigned count = 0;
+
+    /* A chain cannot be longer than the file: stop on cycles */
+    while (pgno >= 1 && pgno <= in->npages && count < in->npages) {
+        if (count < INSPECT_MAX_CHAIN_SHOWN) {
+            sqlite3_str_appendf(str, "%s%u", (count) ? " -> " : "", pgno);
+        }
+        ++count;
+        pgno = s_get4(s_page(in, pgno));
+    }
+    if (count > INSPECT_MAX_CHAIN_SHOWN) {
+        sqlite3_str_appendf(str, " -> ...");
+    }
+    sqlite3_str_appendf(str, " (%u pages)", count);
+}
+
+
+/* Decode a page into a human-readable description */
+int inspect_describe_page(inspect_td *in, unsigned pgno, char **text)
+{
+    if (!in || !text) {
+        return SQLITE_MISUSE;
+    }
+    *text = NULL;
+    if (pgno < 1 || pgno > in->npages) {
+        return SQLITE_RANGE;
+    }
+
+    const char *owner = inspect_page_owner(in, pgno);
+    sqlite3_str *str = sqlite3_str_new(NULL);
+    sqlite3_str_appendf(str, "Page %u of %u (%u bytes), owner: %s\n\n",
+            pgno, in->npages, in->page_size, (owner) ? owner : "unknown");
+    if (pgno == 1) {
+        s_describe_header(in, str);
+    }
+
+    unsigned hdr;
+    unsigned type = s_btree_type(in, pgno, &hdr);
+    const unsigned char *page = s_page(in, pgno);
+    if (!type) {
+        sqlite3_str_appendf(str,
+                "Not a B-tree page (overflow, freelist, pointer-map or "
+                "unused)\nFirst 4 bytes (next page): %u\n",
+                s_get4(page));
+        *text = sqlite3_str_finish(str);
+        return (*text) ? SQLITE_OK : SQLITE_NOMEM;
+    }
+
+    int interior = (type == PAGE_INTERIOR_TABLE
+            || type == PAGE_INTERIOR_INDEX);
+    unsigned ncells = s_get2(page + hdr + 3);
+    unsigned content = s_get2(page + hdr + 5);
+    sqlite3_str_appendf(str,
+            "Type: %s %s B-tree page (0x%02x)\n"
+            "First freeblock: %u, cells: %u, content start: %u, "
+            "fragmented bytes: %u\n",
+            (interior) ? "interior" : "leaf",
+            (type == PAGE_INTERIOR_TABLE || type == PAGE_LEAF_TABLE)
+            ? "table" : "index", type, s_get2(page + hdr + 1), ncells,
+            (content) ? content : 65536, page[hdr + 7]);
+    if (interior) {
+        sqlite3_str_appendf(str, "Right-most pointer: %u\n",
+                s_get4(page + hdr + 8));
+    }
+
+    sqlite3_str_appendf(str, "\n%5s %6s %8s %20s %10s %6s  %s\n",
+            "Cell", "Offset", "Child", "Key", "Payload", "Local",
+            "Overflow");
+    unsigned cells = hdr + (interior ? 12u : 8u);
+    for (unsigned i = 0; i < ncells; ++i) {
+        if (cells + 2 * i + 2 > in->page_size) {
+            sqlite3_str_appendf(str, "(cell pointer array truncated)\n");
+            break;
+        }
+        unsigned off = s_get2(page + cells + 2 * i);
+        s_cell_td c;
+        if (!s_parse_cell(in, pgno, type, off, &c)) {
+            sqlite3_str_appendf(str, "%5u %6u  (corrupt cell)\n", i, off);
+            continue;
+        }
+        char child[16] = "", key[32] = "";
+        if (c.left) {
+            snprintf(child, sizeof(child), "%u", c.left);
+        }
+        if (c.has_key) {
+            snprintf(key, sizeof(key), "%lld", (long long) c.key);
+        }
+        sqlite3_str_appendf(str, "%5u %6u %8s %20s %10lld %6u  ", i, off,
+                child, key, (long long) c.payload, c.local);
+        if (c.overflow) {
+            s_describe_chain(in, str, c.overflow);
+        }
+        sqlite3_str_appendf(str, "\n");
+    }
+
+    *text = sqlite3_str_finish(str);
+
+    return (*text) ? SQLITE_OK : SQLITE_NOMEM;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file job.c
+ *
+ * @brief Implementation of background jobs on worker threads
+ */
+
+/* System includes */
+#include <stdarg.h>
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Local includes */
+#include <job.h>
+
+
+/**
+ * @struct job_td
+ *
+ * @brief State shared between the worker thread and the main loop
+ */
+struct job_td {
+    GThread *thread;    /**< Worker thread running @e run */
+    GMutex lock;        /**< Protects @e fraction and @e text */
+    double fraction;    /**< Last published completed fraction */
+    char *text;         /**< Last published status text */
+    gint cancelled;     /**< Non-zero once cancellation is requested */
+    int rc;             /**< Value returned by @e run */
+    job_run_fn run;     /**< Job body */
+    job_done_fn done;   /**< Completion callback */
+    void *data;         /**< User data for both callbacks */
+};
+
+
+/**
+ * @brief Finish a job on the main loop: join the worker thread, call
+ *        the completion callback and free the job
+ *
+ * @param userdata Job handle (@e job_td *)
+ *
+ * @return @e G_SOURCE_REMOVE (one-shot idle source)
+ */
+static gboolean s_job_finish(gpointer userdata)
+{
+    job_td *job = userdata;
+
+    g_thread_join(job->thread);
+    if (job->done) {
+        job->done(job, job->rc, job->data);
+    }
+    g_mutex_clear(&job->lock);
+    g_free(job->text);
+    g_free(job);
+
+    return G_SOURCE_REMOVE;
+}
+
+
+/**
+ * @brief Worker thread entry: run the job body and schedule completion
+ *
+ * @param userdata Job handle (@e job_td *)
+ *
+ * @return Always @c NULL
+ */
+static gpointer s_job_thread(gpointer userdata)
+{
+    job_td *job = userdata;
+
+    job->rc = job->run(job, job->data);
+    job_report(job, 1.0, NULL);
+    g_idle_add(s_job_finish, job);
+
+    return NULL;
+}
+
+
+/* Start a background job on a new worker thread */
+job_td *job_start(const char *name, job_run_fn run, job_done_fn done,
+        void *data)
+{
+    if (!run) {
+        return NULL;
+    }
+
+    job_td *job = g_new0(job_td, 1);
+    g_mutex_init(&job->lock);
+    job->rc = SQLITE_OK;
+    job->run = run;
+    job->done = done;
+    job->data = data;
+    job->thread = g_thread_new((name) ? name : "job", s_job_thread, job);
+
+    return job;
+}
+
+
+/* Publish the progress of a job (thread-safe) */
+void job_report(job_td *job, double fraction, const char *fmt, ...)
+{
+    if (!job) {
+        return;
+    }
+
+    char *text = NULL;
+    if (fmt) {
+        va_list ap;
+        va_start(ap, fmt);
+        text = g_strdup_vprintf(fmt, ap);
+        va_end(ap);
+    }
+
+    g_mutex_lock(&job->lock);
+    job->fraction = CLAMP(fraction, 0.0, 1.0);
+    if (text) {
+        g_free(job->text);
+        job->text = text;
+    }
+    g_mutex_unlock(&job->lock);
+}
+
+
+/* Read the last published progress of a job (thread-safe) */
+double job_progress(job_td *job, char **text)
+{
+    if (!job) {
+        return 0.0;
+    }
+
+    g_mutex_lock(&job->lock);
+    double fraction = job->fraction;
+    if (text) {
+        *text = g_strdup(job->text);
+    }
+    g_mutex_unlock(&job->lock);
+
+    return fraction;
+}
+
+
+/* Request cancellation of a job (thread-safe) */
+void job_cancel(job_td *job)
+{
+    if (job) {
+        g_atomic_int_set(&job->cancelled, 1);
+    }
+}
+
+
+/* Check whether cancellation has been requested (thread-safe) */
+int job_is_cancelled(job_td *job)
+{
+    return (job) ? (g_atomic_int_get(&job->cancelled) != 0) : 0;
+}
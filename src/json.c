@@ -0,0 +1,256 @@
+/**
+ * @file json.c
+ *
+ * @brief Implementation of the exploration of JSON cells
+ */
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+
+/* Local includes */
+#include <json.h>
+
+
+/* Create a JSON path column */
+json_column_td *json_column_new(const char *column, const char *path)
+{
+    json_column_td *c = g_new0(json_column_td, 1);
+
+    c->column = g_strdup(column);
+    c->path = g_strdup(path);
+
+    return c;
+}
+
+
+/* Release a JSON path column */
+void json_column_free(void *data)
+{
+    json_column_td *c = data;
+
+    if (!c) {
+        return;
+    }
+    g_free(c->column);
+    g_free(c->path);
+    g_free(c);
+}
+
+
+/* Build the `SELECT` item of a JSON path column */
+char *json_column_sql(const json_column_td *c)
+{
+    /* Named as "column.a.b": the path without its leading '$' */
+    const char *suffix = (c->path[0] == '$') ? c->path + 1 : c->path;
+
+    return sqlite3_mprintf("json_extract(\"%w\", %Q) AS \"%w%w\"",
+            c->column, c->path, c->column, suffix);
+}
+
+
+/* Build a condition matching the rows whose JSON path holds a value */
+char *json_filter_sql(const char *column, const char *path,
+        const char *type, const char *value)
+{
+    if (!column || !path || !type) {
+        return NULL;
+    }
+
+    /* json_extract() gives SQL values: true is 1, false is 0 */
+    char *expr = sqlite3_mprintf("json_extract(\"%w\", %Q)", column, path);
+    char *sql = NULL;
+    if (!expr) {
+        return NULL;
+    } else if (strcmp(type, "null") == 0) {
+        sql = sqlite3_mprintf("%s IS NULL", expr);
+    } else if (strcmp(type, "true") == 0 || strcmp(type, "false") == 0) {
+        sql = sqlite3_mprintf("%s = %d", expr, type[0] == 't');
+    } else if (strcmp(type, "integer") == 0 && value) {
+        sql = sqlite3_mprintf("%s = %lld", expr,
+                (long long) g_ascii_strtoll(value, NULL, 10));
+    } else if (strcmp(type, "real") == 0 && value) {
+        sql = sqlite3_mprintf("%s = %.17g", expr,
+                g_ascii_strtod(value, NULL));
+    } else if (strcmp(type, "text") == 0 && value) {
+        sql = sqlite3_mprintf("%s = %Q", expr, value);
+    }
+    sqlite3_free(expr);
+
+    return sql;
+}
+
+
+/* Create a store for `json_expand()` */
+GtkTreeStore *json_store_new(void)
+{
+    GType types[JSON_NCOLS];
+
+    for (int i = 0; i < JSON_NCOLS; ++i) {
+        types[i] = G_TYPE_STRING;
+    }
+
+    return gtk_tree_store_newv(JSON_NCOLS, types);
+}
+
+
+/**
+ * @brief Add a child listed by @c json_each() to a node
+ *
+ * @param stmt   Children query, on a row
+ * @param store  Tree store
+ * @param parent Node (or @c NULL for the top level)
+ */
+static void s_append_child(sqlite3_stmt *stmt, GtkTreeStore *store,
+        GtkTreeIter *parent)
+{
+    char key[64], size[64];
+    const char *type = (const char*) sqlite3_column_text(stmt, 1);
+    const char *value = (const char*) sqlite3_column_text(stmt, 2);
+    const char *keytext = key;
+    GtkTreeIter iter;
+
+    if (sqlite3_column_type(stmt, 0) == SQLITE_INTEGER) {
+        snprintf(key, sizeof(key), "[%lld]",
+                (long long) sqlite3_column_int64(stmt, 0));
+    } else if (sqlite3_column_type(stmt, 0) == SQLITE_NULL) {
+        snprintf(key, sizeof(key), "$");     /* Top-level scalar */
+    } else {
+        keytext = (const char*) sqlite3_column_text(stmt, 0);
+    }
+
+    int container = sqlite3_column_type(stmt, 4) != SQLITE_NULL;
+    if (container) {
+        sqlite3_int64 n = sqlite3_column_int64(stmt, 4);
+        snprintf(size, sizeof(size), "%lld %s%s", (long long) n,
+                (type && type[0] == 'a') ? "item" : "key",
+                (n == 1) ? "" : "s");
+        value = size;
+    } else if (!value || (type && (strcmp(type, "true") == 0
+                    || strcmp(type, "false") == 0))) {
+        value = (type) ? type : "null";     /* Atoms are NULL, 1 or 0 */
+    }
+
+    gtk_tree_store_insert_with_values(store, &iter, parent, -1,
+            JSON_COL_KEY, keytext, JSON_COL_TYPE, type,
+            JSON_COL_VALUE, value,
+            JSON_COL_PATH, sqlite3_column_text(stmt, 3), -1);
+    if (container && sqlite3_column_int64(stmt, 4) > 0) {
+        /* Lets the node be expanded before its children are read */
+        gtk_tree_store_insert_with_values(store, NULL, &iter, -1,
+                JSON_COL_KEY, "...", -1);
+    }
+}
+
+
+/* List the children of a node of a JSON cell */
+int json_expand(sqlite3 *db, const char *table, const char *column,
+        sqlite3_int64 rowid, GtkTreeStore *store, GtkTreeIter *parent)
+{
+    if (!db || !table || !column || !store) {
+        return SQLITE_MISUSE;
+    }
+
+    GtkTreeModel *model = GTK_TREE_MODEL(store);
+    char *path = NULL;
+    if (parent) {
+        GtkTreeIter child;
+        gtk_tree_model_get(model, parent, JSON_COL_PATH, &path, -1);
+        if (!path) {
+            return SQLITE_MISUSE;   /* A placeholder */
+        }
+        if (gtk_tree_model_iter_children(model, &child, parent)) {
+            char *first = NULL;
+            gtk_tree_model_get(model, &child, JSON_COL_PATH, &first, -1);
+            if (first) {
+                g_free(first);
+                g_free(path);
+                return SQLITE_OK;   /* Already expanded */
+            }
+            gtk_tree_store_remove(store, &child);
+        }
+    } else {
+        gtk_tree_store_clear(store);
+        path = g_strdup("$");
+    }
+
+    char *sql = sqlite3_mprintf("SELECT j.key, j.type, j.atom, "
+            "j.fullkey, CASE j.type "
+            "WHEN 'array' THEN json_array_length(j.value) "
+            "WHEN 'object' THEN (SELECT count(*) FROM json_each(j.value)) "
+            "END FROM \"%w\" AS r, json_each(r.\"%w\", ?2) AS j "
+            "WHERE r.rowid = ?1 LIMIT ?3;", table, column);
+    sqlite3_stmt *stmt = NULL;
+    int rc = (sql) ? sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        g_free(path);
+        return rc;
+    }
+    sqlite3_bind_int64(stmt, 1, rowid);
+    sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, JSON_MAX_CHILDREN + 1);
+
+    int n = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (n++ == JSON_MAX_CHILDREN) {
+            gtk_tree_store_insert_with_values(store, NULL, parent, -1,
+                    JSON_COL_KEY, "...", JSON_COL_VALUE,
+                    "(more not listed)", -1);
+            rc = SQLITE_DONE;
+            break;
+        }
+        s_append_child(stmt, store, parent);
+    }
+    sqlite3_finalize(stmt);
+    g_free(path);
+
+    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+
+
+/* Propose an index for filtering a table by a JSON path */
+int json_suggest_index(sqlite3 *db, const char *table, const char *column,
+        const char *path, char **sql)
+{
+    if (!db || !table || !column || !path || !sql) {
+        return SQLITE_MISUSE;
+    }
+
+    *sql = NULL;
+    char *query = sqlite3_mprintf("EXPLAIN QUERY PLAN SELECT 1 "
+            "FROM \"%w\" WHERE json_extract(\"%w\", %Q) = ?1;", table,
+            column, path);
+    sqlite3_stmt *stmt = NULL;
+    int rc = (query) ? sqlite3_prepare_v2(db, query, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(query);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    /* "SCAN t" (or "SCAN TABLE t" before SQLite 3.36): no usable index */
+    int scan = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *detail = (const char*) sqlite3_column_text(stmt, 3);
+        scan |= detail && strncmp(detail, "SCAN ", 5) == 0;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        return rc;
+    }
+
+    if (scan) {
+        char *name = g_strdup_printf("%s_%s_%s", table, column, path);
+        g_strcanon(name, G_CSET_a_2_z G_CSET_A_2_Z G_CSET_DIGITS "_", '_');
+        *sql = sqlite3_mprintf("CREATE INDEX \"%w\" ON \"%w\"("
+                "json_extract(\"%w\", %Q));", name, table, column, path);
+        g_free(name);
+        if (!*sql) {
+            return SQLITE_NOMEM;
+        }
+    }
+
+    return SQLITE_OK;
+}
@@ -10,27 +10,61 @@
  */
 
 /* System includes */
+#include <stdio.h>
 #include <string.h>
 
 /* Project includes */
+#include <complete.h>
 #include <context.h>
 #include <db.h>
+#include <history.h>
+#include <rowcache.h>
+#include <serve.h>
+#include <session.h>
+#include <thumb.h>
 #include <ui.h>
 
 
 /* Main entry */
 int main(int argc, char **argv)
 {
+    /* `--serve FILE [PORT]` answers HTTP requests, without a window */
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--serve") == 0) {
+        guint64 port = SERVE_DEFAULT_PORT;
+        if (argc == 4 && !g_ascii_string_to_unsigned(argv[3], 10, 0,
+                    G_MAXUINT16, &port, NULL)) {
+            fprintf(stderr, "Invalid port '%s'\n", argv[3]);
+            return 1;
+        }
+        return (serve_run(argv[2], (guint16) port) == SQLITE_OK) ? 0 : 1;
+    }
+
     gtk_init(&argc, &argv);
     context_td state;
 
     memset(&state, 0, sizeof(state));
 
+    /* `--record FILE` saves the session for `bin/session_replay` */
+    if (argc == 3 && strcmp(argv[1], "--record") == 0) {
+        state.session = session_record(argv[2]);
+        if (!state.session) {
+            fprintf(stderr, "Cannot record session to '%s'\n", argv[2]);
+            return 1;
+        }
+    }
+
+    state.history = history_open(NULL);   /* May be NULL: no history */
     ui_build(&state);       /* Build the UI, open DB, and connect handlers */
     gtk_main();             /* GTK main event loop */
 
+    ui_shutdown(&state);        /* Stop counting the timeline */
     db_free_columns(&state);    /* Free memory */
     db_close(&state);           /* Close the SQLite database */
+    thumb_cache_free(state.thumbs); /* Stop decoding thumbnails */
+    session_close(state.session);   /* Stop recording */
+    history_close(state.history);   /* Close the query history */
+    complete_free(state.names);     /* Free the autocompletion index */
+    rowcache_clear();               /* Free the cached rows */
 
     return 0;
 }
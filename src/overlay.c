@@ -0,0 +1,306 @@
+/**
+ * @file overlay.c
+ *
+ * @brief Implementation of the copy-on-write edits of a read-only
+ *        database
+ */
+
+/* System includes */
+#include <string.h>
+
+/* External includes */
+#include <glib.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <overlay.h>
+
+
+/**
+ * @struct overlay_td
+ *
+ * @brief Overlay of a database
+ */
+struct overlay_td {
+    sqlite3 *db;            /**< Side database */
+    sqlite3_stmt *get;      /**< Reads an edited cell */
+    sqlite3_stmt *has;      /**< Tells whether a table has edits */
+};
+
+
+/* Open (or create) the overlay of a database file */
+int overlay_open(const char *filename, overlay_td **out)
+{
+    if (!filename || !out) {
+        return SQLITE_MISUSE;
+    }
+
+    overlay_td *o = g_new0(overlay_td, 1);
+    char *side = g_strconcat(filename, OVERLAY_SUFFIX, NULL);
+    int rc = sqlite3_open_v2(side, &o->db, SQLITE_OPEN_READWRITE
+            | SQLITE_OPEN_CREATE, NULL);
+    g_free(side);
+
+    /* The base value is the one the apply expects to replace */
+    if (rc == SQLITE_OK) {
+        sqlite3_busy_timeout(o->db, DB_JOB_BUSY_TIMEOUT);
+        rc = sqlite3_exec(o->db, "CREATE TABLE IF NOT EXISTS overlay_cell("
+                "tbl TEXT NOT NULL, col TEXT NOT NULL, rid INTEGER NOT NULL,"
+                " value, base, PRIMARY KEY (tbl, col, rid)) WITHOUT ROWID;",
+                NULL, NULL, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(o->db, "SELECT value FROM overlay_cell"
+                " WHERE tbl = ?1 AND col = ?2 AND rid = ?3;", -1, &o->get,
+                NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(o->db, "SELECT 1 FROM overlay_cell"
+                " WHERE tbl = ?1 LIMIT 1;", -1, &o->has, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        overlay_close(o);
+        return rc;
+    }
+    *out = o;
+
+    return SQLITE_OK;
+}
+
+
+/* Close an overlay, keeping its edits in the side file */
+void overlay_close(overlay_td *o)
+{
+    if (!o) {
+        return;
+    }
+
+    sqlite3_finalize(o->get);
+    sqlite3_finalize(o->has);
+    sqlite3_close(o->db);
+    g_free(o);
+}
+
+
+/* Get the message of the last error of the side database */
+const char *overlay_errmsg(const overlay_td *o)
+{
+    return sqlite3_errmsg(o->db);
+}
+
+
+/* Edit a cell */
+int overlay_set_cell(overlay_td *o, sqlite3 *base, const char *table,
+        const char *column, sqlite3_int64 rowid, const char *text)
+{
+    if (!o || !base || !table || !column || !text) {
+        return SQLITE_MISUSE;
+    }
+
+    char *sql = sqlite3_mprintf("SELECT \"%w\" FROM \"%w\" WHERE rowid = ?1;",
+            column, table);
+    sqlite3_stmt *read = NULL, *write = NULL;
+    int rc = (sql) ? sqlite3_prepare_v2(base, sql, -1, &read, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_int64(read, 1, rowid);
+        rc = sqlite3_step(read);
+        rc = (rc == SQLITE_ROW) ? SQLITE_OK : (rc == SQLITE_DONE)
+            ? SQLITE_NOTFOUND : rc;
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(o->db, "INSERT INTO overlay_cell"
+                " VALUES (?1, ?2, ?3, ?4, ?5) ON CONFLICT (tbl, col, rid)"
+                " DO UPDATE SET value = excluded.value;", -1, &write, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(write, 1, table, -1, SQLITE_STATIC);
+        sqlite3_bind_text(write, 2, column, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(write, 3, rowid);
+        sqlite3_bind_text(write, 4, text, -1, SQLITE_STATIC);
+        sqlite3_bind_value(write, 5, sqlite3_column_value(read, 0));
+        rc = sqlite3_step(write);
+        rc = (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    }
+    sqlite3_finalize(write);
+    sqlite3_finalize(read);
+
+    return rc;
+}
+
+
+/* Tell whether a table has edited cells */
+int overlay_has_table(overlay_td *o, const char *table)
+{
+    if (!o || !table) {
+        return 0;
+    }
+
+    sqlite3_bind_text(o->has, 1, table, -1, SQLITE_STATIC);
+    int has = (sqlite3_step(o->has) == SQLITE_ROW);
+    sqlite3_reset(o->has);
+
+    return has;
+}
+
+
+/* Get the edited value of a cell */
+int overlay_get_cell(overlay_td *o, const char *table, const char *column,
+        sqlite3_int64 rowid, char **text)
+{
+    if (!o || !table || !column || !text) {
+        return SQLITE_MISUSE;
+    }
+
+    sqlite3_bind_text(o->get, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(o->get, 2, column, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(o->get, 3, rowid);
+    int rc = sqlite3_step(o->get);
+    *text = (rc == SQLITE_ROW) ? g_strdup((const char*)
+            sqlite3_column_text(o->get, 0)) : NULL;
+    sqlite3_reset(o->get);
+
+    return rc;
+}
+
+
+/* Count the edited cells */
+sqlite3_int64 overlay_count(overlay_td *o)
+{
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_int64 n = -1;
+
+    if (o && sqlite3_prepare_v2(o->db, "SELECT count(*) FROM overlay_cell;",
+                -1, &stmt, NULL) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW) {
+        n = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    return n;
+}
+
+
+/**
+ * @brief Write the edited cells in the open transaction of the base
+ *
+ * @param o         Overlay
+ * @param w         Read-write connection to the base, in a transaction
+ * @param applied   Where to count the cells written
+ * @param conflicts Where to count the cells changed in the base
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ *         (message on @e w, or on the side database if @e w has none)
+ */
+static int s_write_cells(overlay_td *o, sqlite3 *w, int *applied,
+        int *conflicts)
+{
+    sqlite3_stmt *list = NULL, *update = NULL;
+    char *tbl = NULL, *col = NULL;
+    int rc = sqlite3_prepare_v2(o->db, "SELECT tbl, col, rid, value, base"
+            " FROM overlay_cell ORDER BY tbl, col, rid;", -1, &list, NULL);
+
+    while (rc == SQLITE_OK && (rc = sqlite3_step(list)) == SQLITE_ROW) {
+        const char *t = (const char*) sqlite3_column_text(list, 0);
+        const char *c = (const char*) sqlite3_column_text(list, 1);
+
+        /* One statement per column, cells in rowid order */
+        rc = SQLITE_OK;
+        if (!update || g_strcmp0(t, tbl) != 0 || g_strcmp0(c, col) != 0) {
+            g_free(tbl);
+            g_free(col);
+            tbl = g_strdup(t);
+            col = g_strdup(c);
+            sqlite3_finalize(update);
+            update = NULL;
+            char *sql = sqlite3_mprintf("UPDATE \"%w\" SET \"%w\" = ?1"
+                    " WHERE rowid = ?2 AND \"%w\" IS ?3;", tbl, col, col);
+            rc = (sql) ? sqlite3_prepare_v2(w, sql, -1, &update, NULL)
+                : SQLITE_NOMEM;
+            sqlite3_free(sql);
+        }
+        if (rc == SQLITE_OK) {
+            sqlite3_bind_value(update, 1, sqlite3_column_value(list, 3));
+            sqlite3_bind_int64(update, 2, sqlite3_column_int64(list, 2));
+            sqlite3_bind_value(update, 3, sqlite3_column_value(list, 4));
+            rc = sqlite3_step(update);
+            sqlite3_reset(update);
+            rc = (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+        }
+        if (rc == SQLITE_OK && sqlite3_changes(w) == 0) {
+            (*conflicts)++;
+        } else if (rc == SQLITE_OK) {
+            (*applied)++;
+        }
+    }
+    sqlite3_finalize(update);
+    sqlite3_finalize(list);
+    g_free(tbl);
+    g_free(col);
+
+    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+
+
+/* Write every edited cell to the base database in one transaction */
+int overlay_apply(overlay_td *o, const char *filename, int *applied,
+        int *conflicts, char **errmsg)
+{
+    if (!o || !filename || !applied || !conflicts) {
+        return SQLITE_MISUSE;
+    }
+
+    sqlite3 *w = NULL;
+    *applied = *conflicts = 0;
+    if (errmsg) {
+        *errmsg = NULL;
+    }
+
+    /* Take the write lock at once, and hold it only while writing */
+    int rc = db_open_writer(filename, &w);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(w, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = s_write_cells(o, w, applied, conflicts);
+        if (rc == SQLITE_OK && *conflicts > 0) {
+            rc = SQLITE_ABORT;
+        }
+        if (rc != SQLITE_OK && errmsg) {
+            *errmsg = g_strdup((rc == SQLITE_ABORT)
+                    ? "Cells were changed since they were edited"
+                    : (sqlite3_errcode(w) != SQLITE_OK) ? sqlite3_errmsg(w)
+                    : sqlite3_errmsg(o->db));
+        }
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_exec(w, "COMMIT;", NULL, NULL, NULL);
+        }
+        if (rc != SQLITE_OK) {
+            if (errmsg && !*errmsg) {
+                *errmsg = g_strdup(sqlite3_errmsg(w));
+            }
+            sqlite3_exec(w, "ROLLBACK;", NULL, NULL, NULL);
+            *applied = 0;
+        }
+    } else if (errmsg) {
+        *errmsg = g_strdup((w) ? sqlite3_errmsg(w) : sqlite3_errstr(rc));
+    }
+    sqlite3_close(w);
+
+    return (rc == SQLITE_OK) ? overlay_discard(o) : rc;
+}
+
+
+/* Forget every edited cell */
+int overlay_discard(overlay_td *o)
+{
+    if (!o) {
+        return SQLITE_MISUSE;
+    }
+
+    return sqlite3_exec(o->db, "DELETE FROM overlay_cell;", NULL, NULL,
+            NULL);
+}
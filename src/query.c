@@ -0,0 +1,252 @@
+/**
+ * @file query.c
+ *
+ * @brief Implementation of the ad-hoc SQL execution
+ */
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+
+/* Local includes */
+#include <query.h>
+
+
+/**
+ * @brief Append the query plan of a prepared statement to a text
+ *
+ * Statements without a plan (e.g. @c CREATE) and @c EXPLAIN statements
+ * add nothing.
+ *
+ * @param db   Connection the statement was prepared on
+ * @param stmt Prepared statement
+ * @param out  Text to append to
+ */
+static void s_append_plan(sqlite3 *db, sqlite3_stmt *stmt, GString *out)
+{
+    if (sqlite3_stmt_isexplain(stmt)) {
+        return;
+    }
+
+    char *sql = sqlite3_mprintf("EXPLAIN QUERY PLAN %s", sqlite3_sql(stmt));
+    sqlite3_stmt *eqp = NULL;
+    if (!sql || sqlite3_prepare_v2(db, sql, -1, &eqp, NULL) != SQLITE_OK) {
+        sqlite3_free(sql);
+        return;
+    }
+    sqlite3_free(sql);
+
+    /* Columns: id, parent, notused, detail; parents come first */
+    GHashTable *depth = g_hash_table_new(g_direct_hash, g_direct_equal);
+    if (out->len > 0) {
+        g_string_append_c(out, '\n');
+    }
+    while (sqlite3_step(eqp) == SQLITE_ROW) {
+        int id = sqlite3_column_int(eqp, 0);
+        int parent = sqlite3_column_int(eqp, 1);
+        int d = GPOINTER_TO_INT(g_hash_table_lookup(depth,
+                    GINT_TO_POINTER(parent)));
+        const unsigned char *detail = sqlite3_column_text(eqp, 3);
+        g_hash_table_insert(depth, GINT_TO_POINTER(id),
+                GINT_TO_POINTER(d + 1));
+        g_string_append_printf(out, "%*s%s\n", 2 * d, "",
+                (detail) ? (const char*) detail : "");
+    }
+    g_hash_table_destroy(depth);
+    sqlite3_finalize(eqp);
+}
+
+
+/**
+ * @brief Append the current row of a statement to a list store
+ *
+ * @param stmt  Statement positioned on a row
+ * @param store Store with one string column per result column
+ */
+static void s_append_row(sqlite3_stmt *stmt, GtkListStore *store)
+{
+    int ncol = sqlite3_column_count(stmt);
+    GtkTreeIter iter;
+
+    gtk_list_store_append(store, &iter);
+    for (int i = 0; i < ncol; ++i) {
+        char desc[64];
+        const char *sval = desc;
+        if (sqlite3_column_type(stmt, i) == SQLITE_BLOB) {
+            snprintf(desc, sizeof(desc), "[BLOB, %d bytes]",
+                    sqlite3_column_bytes(stmt, i));
+        } else {
+            const unsigned char *txt = sqlite3_column_text(stmt, i);
+            sval = (txt) ? (const char*) txt : "";
+        }
+        gtk_list_store_set(store, &iter, i, sval, -1);
+    }
+}
+
+
+/* Add the counters of a statement to the measurements */
+void query_collect(sqlite3_stmt *stmt, query_stats_td *stats)
+{
+    if (!stmt || !stats) {
+        return;
+    }
+
+    stats->vm_steps += sqlite3_stmt_status(stmt,
+            SQLITE_STMTSTATUS_VM_STEP, 0);
+    stats->fullscan_steps += sqlite3_stmt_status(stmt,
+            SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+    stats->sorts += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 0);
+    stats->autoindexes += sqlite3_stmt_status(stmt,
+            SQLITE_STMTSTATUS_AUTOINDEX, 0);
+    stats->memused = MAX(stats->memused, sqlite3_stmt_status(stmt,
+                SQLITE_STMTSTATUS_MEMUSED, 0));
+
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+    /* One line per loop: "detail: loops, rows visited" */
+    GString *loops = g_string_new(stats->loops);
+    for (int i = 0; ; ++i) {
+        sqlite3_int64 nloop = 0, nvisit = 0;
+        const char *detail = NULL;
+        if (sqlite3_stmt_scanstatus(stmt, i, SQLITE_SCANSTAT_NLOOP,
+                    &nloop) != 0) {
+            break;
+        }
+        sqlite3_stmt_scanstatus(stmt, i, SQLITE_SCANSTAT_NVISIT, &nvisit);
+        sqlite3_stmt_scanstatus(stmt, i, SQLITE_SCANSTAT_EXPLAIN, &detail);
+        g_string_append_printf(loops, "%s%s: %lld loop%s, %lld rows "
+                "visited", (loops->len) ? "\n" : "",
+                (detail) ? detail : "?", (long long) nloop,
+                (nloop == 1) ? "" : "s", (long long) nvisit);
+    }
+    g_free(stats->loops);
+    stats->loops = g_string_free(loops, FALSE);
+#endif  /* SQLITE_ENABLE_STMT_SCANSTATUS */
+}
+
+
+/* Describe the counters of the measurements in one line */
+void query_describe_stats(const query_stats_td *stats, char *buf,
+        size_t len)
+{
+    snprintf(buf, len, "%lld VM steps, %lld full scan steps, %lld sorts, "
+            "%lld autoindex rows, %.1f KiB", (long long) stats->vm_steps,
+            (long long) stats->fullscan_steps, (long long) stats->sorts,
+            (long long) stats->autoindexes,
+            (double) stats->memused / 1024.0);
+}
+
+
+/* Release the texts of the measurements */
+void query_stats_clear(query_stats_td *stats)
+{
+    if (!stats) {
+        return;
+    }
+
+    g_free(stats->plan);
+    g_free(stats->loops);
+    memset(stats, 0, sizeof(*stats));
+}
+
+
+/* Describe the query plan of every statement of an SQL text */
+int query_plan(sqlite3 *db, const char *sql, char **out)
+{
+    if (!db || !sql || !out) {
+        return SQLITE_MISUSE;
+    }
+
+    GString *plan = g_string_new(NULL);
+    const char *tail = sql;
+    int rc = SQLITE_OK;
+    while (rc == SQLITE_OK && tail && *tail) {
+        sqlite3_stmt *stmt = NULL;
+        rc = sqlite3_prepare_v2(db, tail, -1, &stmt, &tail);
+        if (rc == SQLITE_OK && stmt) {
+            s_append_plan(db, stmt, plan);
+        }
+        sqlite3_finalize(stmt);
+    }
+    *out = g_string_free(plan, FALSE);
+
+    return rc;
+}
+
+
+/* Run the statements of an SQL text */
+int query_run(sqlite3 *db, const char *sql, GtkListStore **store,
+        result_td **result, char ***names, query_stats_td *stats)
+{
+    if (!db || !sql || !store || !result || !names || !stats) {
+        return SQLITE_MISUSE;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    *store = NULL;
+    *result = NULL;
+    *names = NULL;
+    GString *plan = g_string_new(NULL);
+    const char *tail = sql;
+    int rc = SQLITE_OK;
+    while (rc == SQLITE_OK && tail && *tail) {
+        sqlite3_stmt *stmt = NULL;
+        gint64 t0 = g_get_monotonic_time();
+        rc = sqlite3_prepare_v2(db, tail, -1, &stmt, &tail);
+        stats->usec += g_get_monotonic_time() - t0;
+        if (rc != SQLITE_OK || !stmt) {
+            continue;   /* Error, or only blanks and comments */
+        }
+        s_append_plan(db, stmt, plan);
+
+        int ncol = sqlite3_column_count(stmt);
+        GtkListStore *rows = NULL;
+        result_td *cache = NULL;
+        if (ncol > 0) {
+            GType *types = g_new(GType, ncol);
+            for (int i = 0; i < ncol; ++i) {
+                types[i] = G_TYPE_STRING;
+            }
+            rows = gtk_list_store_newv(ncol, types);
+            g_free(types);
+            cache = result_new(ncol);
+        }
+
+        /* Rows past the limit are counted but not kept */
+        sqlite3_int64 n = 0;
+        t0 = g_get_monotonic_time();
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            if (rows && n < QUERY_MAX_ROWS) {
+                /* Typed values first: the text of a number converts it */
+                result_append(cache, stmt);
+                s_append_row(stmt, rows);
+            }
+            n++;
+        }
+        stats->usec += g_get_monotonic_time() - t0;
+        query_collect(stmt, stats);
+        rc = (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+
+        if (rows && rc == SQLITE_OK) {
+            if (*store) {
+                g_object_unref(*store);
+            }
+            result_free(*result);
+            g_strfreev(*names);
+            *store = rows;
+            *result = cache;
+            *names = g_new0(char*, ncol + 1);
+            for (int i = 0; i < ncol; ++i) {
+                const char *name = sqlite3_column_name(stmt, i);
+                (*names)[i] = g_strdup((name) ? name : "?");
+            }
+            stats->nrows = n;
+        } else if (rows) {
+            g_object_unref(rows);
+            result_free(cache);
+        }
+        sqlite3_finalize(stmt);
+    }
+    stats->plan = g_string_free(plan, FALSE);
+
+    return rc;
+}
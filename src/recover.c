@@ -0,0 +1,501 @@
+/**
+ * @file recover.c
+ *
+ * @brief Implementation of the recovery of damaged databases
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* System includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <recover.h>
+
+#ifdef HAVE_SQLITE3RECOVER
+#include <sqlite3recover.h>
+#endif
+
+
+#define RECOVER_MAX_ROWID ((sqlite3_int64) 0x7fffffffffffffffLL)
+#define RECOVER_MIN_ROWID (-RECOVER_MAX_ROWID - 1)
+
+
+/**
+ * @struct s_object_td
+ *
+ * @brief Schema object read from the damaged database
+ */
+typedef struct {
+    char *type;     /**< Object type ("table", "index", ...) */
+    char *name;     /**< Object name */
+    char *sql;      /**< Statement creating the object */
+} s_object_td;
+
+
+/**
+ * @brief Count the rows of every table of the recovered database and
+ *        add them to the report
+ *
+ * @param dst Path of the recovered database
+ * @param rep Report being built
+ * @param out Result receiving the totals
+ */
+static void s_report_tables(const char *dst, sqlite3_str *rep,
+        recover_result_td *out)
+{
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+
+    if (db_open_reader(dst, &db) != SQLITE_OK) {
+        return;
+    }
+    if (sqlite3_prepare_v2(db, "SELECT name FROM sqlite_master "
+                "WHERE type='table' AND name NOT LIKE 'sqlite_%' "
+                "ORDER BY name;", -1, &stmt, NULL) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char *name = (const char*) sqlite3_column_text(stmt, 0);
+            char *sql = sqlite3_mprintf("SELECT count(*) FROM \"%w\";",
+                    name);
+            sqlite3_stmt *count = NULL;
+            if (sql && sqlite3_prepare_v2(db, sql, -1, &count, NULL)
+                    == SQLITE_OK && sqlite3_step(count) == SQLITE_ROW) {
+                sqlite3_int64 n = sqlite3_column_int64(count, 0);
+                sqlite3_str_appendf(rep, "  %s: %lld rows\n", name,
+                        (long long) n);
+                out->nrows += n;
+                out->ntables++;
+            }
+            sqlite3_finalize(count);
+            sqlite3_free(sql);
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+
+#ifdef HAVE_SQLITE3RECOVER
+/**
+ * @brief Recover with the SQLite recovery extension
+ *
+ * @param job Job for progress and cancellation
+ * @param src Damaged database
+ * @param dst Database to create
+ * @param rep Report being built
+ * @param out Result receiving the totals
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_recover_extension(job_td *job, const char *src,
+        const char *dst, sqlite3_str *rep, recover_result_td *out)
+{
+    sqlite3 *db = NULL;
+    int rc = db_open_reader(src, &db);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    sqlite3_recover *p = sqlite3_recover_init(db, "main", dst);
+    sqlite3_recover_config(p, SQLITE_RECOVER_LOST_AND_FOUND,
+            (void*) "lost_and_found");
+    long steps = 0;
+    while (sqlite3_recover_step(p) == SQLITE_OK) {
+        if (job_is_cancelled(job)) {
+            break;
+        }
+        if (++steps % 1000 == 0) {
+            job_report(job, 1.0 - 1.0 / (1.0 + (double) steps / 1e5),
+                    "Recovering... %ld steps", steps);
+        }
+    }
+    rc = sqlite3_recover_errcode(p);
+    if (rc != SQLITE_OK) {
+        sqlite3_str_appendf(rep, "Recovery error: %s\n",
+                sqlite3_recover_errmsg(p));
+        out->nlost++;
+    }
+    sqlite3_recover_finish(p);
+    sqlite3_close(db);
+    if (job_is_cancelled(job)) {
+        return SQLITE_INTERRUPT;
+    }
+
+    sqlite3_str_appendf(rep, "Recovered with the SQLite recovery "
+            "extension; orphaned rows go to 'lost_and_found'.\n\n");
+    s_report_tables(dst, rep, out);
+
+    return rc;
+}
+#endif  /* HAVE_SQLITE3RECOVER */
+
+
+/**
+ * @brief Find the first rowid that can be seeked at or after a given
+ *        one, stepping over unreadable ranges with growing gaps
+ *
+ * @param probe Statement selecting the first rowid >= ?1
+ * @param from  First rowid that could not be read
+ * @param next  Where to store the next rowid found
+ *
+ * @return 1 if a row was found, 0 if none is reachable
+ */
+static int s_skip_damage(sqlite3_stmt *probe, sqlite3_int64 from,
+        sqlite3_int64 *next)
+{
+    sqlite3_uint64 gap = 0;
+
+    for (;;) {
+        if (gap > (sqlite3_uint64) RECOVER_MAX_ROWID
+                || from > RECOVER_MAX_ROWID - (sqlite3_int64) gap) {
+            return 0;
+        }
+        sqlite3_bind_int64(probe, 1, from + (sqlite3_int64) gap);
+        int rc = sqlite3_step(probe);
+        if (rc == SQLITE_ROW) {
+            *next = sqlite3_column_int64(probe, 0);
+        }
+        sqlite3_reset(probe);
+        if (rc == SQLITE_ROW) {
+            return 1;
+        }
+        if (rc == SQLITE_DONE) {
+            return 0;
+        }
+        gap = (gap) ? gap * 2 : 1;
+    }
+}
+
+
+/**
+ * @brief Prepare the statement inserting rows shaped like a select
+ *
+ * @param ddb       Connection to the new database
+ * @param table     Table name
+ * @param sel       Statement reading the rows
+ * @param has_rowid Non-zero if the first selected column is @e rowid
+ * @param ins       Where to store the prepared statement
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_prepare_insert(sqlite3 *ddb, const char *table,
+        sqlite3_stmt *sel, int has_rowid, sqlite3_stmt **ins)
+{
+    int ncol = sqlite3_column_count(sel);
+    sqlite3_str *str = sqlite3_str_new(NULL);
+
+    /* INSERT INTO t(rowid, c1, ...) VALUES (?, ?, ...) */
+    sqlite3_str_appendf(str, "INSERT INTO \"%w\"(", table);
+    for (int i = 0; i < ncol; ++i) {
+        if (i == 0 && has_rowid) {
+            sqlite3_str_appendall(str, "rowid");
+        } else {
+            sqlite3_str_appendf(str, "%s\"%w\"", (i) ? ", " : "",
+                    sqlite3_column_name(sel, i));
+        }
+    }
+    sqlite3_str_appendall(str, ") VALUES (");
+    for (int i = 0; i < ncol; ++i) {
+        sqlite3_str_appendall(str, (i) ? ", ?" : "?");
+    }
+    sqlite3_str_appendall(str, ");");
+    char *sql = sqlite3_str_finish(str);
+    int rc = (sql) ? sqlite3_prepare_v2(ddb, sql, -1, ins, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+
+    return rc;
+}
+
+
+/**
+ * @brief Copy the readable rows of a table in rowid batches
+ *
+ * Each batch is one transaction on the new database.  When reading
+ * fails, the damaged range is skipped with @a s_skip_damage() and the
+ * copy resumes past it.  Tables without @e rowid are copied in a
+ * single scan up to the first error.
+ *
+ * @param job   Job for progress and cancellation
+ * @param sdb   Connection to the damaged database
+ * @param ddb   Connection to the new database
+ * @param table Table name
+ * @param frac  Progress fraction reported while copying
+ * @param rep   Report being built
+ * @param out   Result receiving the totals
+ *
+ * @return @e SQLITE_OK (damage is reported, not returned),
+ *         @e SQLITE_INTERRUPT or an error writing the new database
+ */
+static int s_copy_table(job_td *job, sqlite3 *sdb, sqlite3 *ddb,
+        const char *table, double frac, sqlite3_str *rep,
+        recover_result_td *out)
+{
+    char *sql = sqlite3_mprintf("SELECT rowid, * FROM \"%w\" "
+            "WHERE rowid >= ?1 ORDER BY rowid LIMIT %d;", table,
+            RECOVER_BATCH_ROWS);
+    char *probe_sql = sqlite3_mprintf("SELECT rowid FROM \"%w\" "
+            "WHERE rowid >= ?1 ORDER BY rowid LIMIT 1;", table);
+    char *scan_sql = sqlite3_mprintf("SELECT * FROM \"%w\";", table);
+    sqlite3_stmt *sel = NULL, *probe = NULL, *ins = NULL;
+    int has_rowid = 1;
+    int rc = (sql && probe_sql && scan_sql) ? SQLITE_OK : SQLITE_NOMEM;
+
+    if (rc == SQLITE_OK
+            && sqlite3_prepare_v2(sdb, sql, -1, &sel, NULL) == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(sdb, probe_sql, -1, &probe, NULL);
+    } else if (rc == SQLITE_OK) {
+        /* WITHOUT ROWID table: no keys to skip damage with */
+        has_rowid = 0;
+        rc = sqlite3_prepare_v2(sdb, scan_sql, -1, &sel, NULL);
+    }
+    sqlite3_free(sql);
+    sqlite3_free(probe_sql);
+    sqlite3_free(scan_sql);
+    if (rc != SQLITE_OK) {
+        sqlite3_str_appendf(rep, "  %s: not readable (%s)\n", table,
+                sqlite3_errmsg(sdb));
+        out->nlost++;
+        sqlite3_finalize(sel);
+        sqlite3_finalize(probe);
+        return (rc == SQLITE_NOMEM) ? rc : SQLITE_OK;
+    }
+    rc = s_prepare_insert(ddb, table, sel, has_rowid, &ins);
+
+    int ncol = sqlite3_column_count(sel);
+    sqlite3_int64 from = RECOVER_MIN_ROWID;
+    sqlite3_int64 copied = 0, rejected = 0;
+    int done = 0;
+    while (rc == SQLITE_OK && !done) {
+        if (job_is_cancelled(job)) {
+            rc = SQLITE_INTERRUPT;
+            break;
+        }
+        sqlite3_exec(ddb, "BEGIN;", NULL, NULL, NULL);
+        if (has_rowid) {
+            sqlite3_bind_int64(sel, 1, from);
+        }
+        int n = 0, step;
+        while ((step = sqlite3_step(sel)) == SQLITE_ROW) {
+            for (int i = 0; i < ncol; ++i) {
+                sqlite3_bind_value(ins, i + 1,
+                        sqlite3_column_value(sel, i));
+            }
+            if (sqlite3_step(ins) == SQLITE_DONE) {
+                ++copied;
+            } else {
+                ++rejected;
+            }
+            sqlite3_reset(ins);
+            if (has_rowid) {
+                /* Next batch (or the skip after damage) starts past it */
+                sqlite3_int64 rowid = sqlite3_column_int64(sel, 0);
+                done = (rowid == RECOVER_MAX_ROWID);
+                from = rowid + !done;
+            }
+            if (++n == RECOVER_BATCH_ROWS && !has_rowid) {
+                sqlite3_exec(ddb, "COMMIT; BEGIN;", NULL, NULL, NULL);
+                n = 0;
+            }
+        }
+        if (has_rowid) {
+            sqlite3_reset(sel);
+        }
+        rc = sqlite3_exec(ddb, "COMMIT;", NULL, NULL, NULL);
+
+        if (step == SQLITE_DONE) {
+            done = done || !has_rowid || (n < RECOVER_BATCH_ROWS);
+        } else if (!has_rowid) {
+            sqlite3_str_appendf(rep, "  %s: rows after the %lldth "
+                    "unreadable (%s)\n", table,
+                    (long long) (copied + rejected), sqlite3_errstr(step));
+            out->nlost++;
+            done = 1;
+        } else if (!done) {
+            /* Rows from 'from' on are unreadable: find the next good one */
+            sqlite3_int64 next = from - 1;
+            out->nlost++;
+            if (s_skip_damage(probe, from, &next) && next == from) {
+                /* Its key can be seeked but its content is damaged */
+                sqlite3_str_appendf(rep, "  %s: rowid %lld unreadable "
+                        "(%s)\n", table, (long long) from,
+                        sqlite3_errstr(step));
+                done = (from == RECOVER_MAX_ROWID);
+                from += !done;
+            } else if (next > from) {
+                sqlite3_str_appendf(rep, "  %s: rowids %lld to %lld "
+                        "unreadable (%s)\n", table, (long long) from,
+                        (long long) next - 1, sqlite3_errstr(step));
+                from = next;
+            } else {
+                sqlite3_str_appendf(rep, "  %s: rowids from %lld on "
+                        "unreadable (%s)\n", table, (long long) from,
+                        sqlite3_errstr(step));
+                done = 1;
+            }
+        }
+        job_report(job, frac, "Recovering '%s'... %lld rows", table,
+                (long long) copied);
+    }
+
+    sqlite3_str_appendf(rep, "  %s: %lld rows recovered", table,
+            (long long) copied);
+    if (rejected) {
+        sqlite3_str_appendf(rep, ", %lld rejected by constraints",
+                (long long) rejected);
+    }
+    sqlite3_str_appendf(rep, "\n");
+    out->nrows += copied;
+    out->ntables++;
+
+    sqlite3_finalize(ins);
+    sqlite3_finalize(probe);
+    sqlite3_finalize(sel);
+
+    return rc;
+}
+
+
+/**
+ * @brief Recover by recreating the schema and copying readable rows
+ *
+ * @param job Job for progress and cancellation
+ * @param src Damaged database
+ * @param dst Database to create
+ * @param rep Report being built
+ * @param out Result receiving the totals
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_recover_salvage(job_td *job, const char *src,
+        const char *dst, sqlite3_str *rep, recover_result_td *out)
+{
+    sqlite3 *sdb = NULL, *ddb = NULL;
+    sqlite3_stmt *stmt = NULL;
+    s_object_td *objs = NULL;
+    int nobjs = 0;
+
+    int rc = db_open_reader(src, &sdb);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(sdb, "SELECT type, name, sql "
+                "FROM sqlite_master WHERE sql IS NOT NULL "
+                "AND name NOT LIKE 'sqlite_%' "
+                "ORDER BY type <> 'table', rowid;", -1, &stmt, NULL);
+    }
+    while (rc == SQLITE_OK && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        s_object_td *o = realloc(objs, (size_t) (nobjs + 1) * sizeof(*o));
+        if (!o) {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+        objs = o;
+        objs[nobjs].type = strdup((const char*) sqlite3_column_text(stmt, 0));
+        objs[nobjs].name = strdup((const char*) sqlite3_column_text(stmt, 1));
+        objs[nobjs].sql = strdup((const char*) sqlite3_column_text(stmt, 2));
+        ++nobjs;
+        rc = SQLITE_OK;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        sqlite3_str_appendf(rep, "Schema not readable: %s\n",
+                (sdb) ? sqlite3_errmsg(sdb) : sqlite3_errstr(rc));
+        if (rc == SQLITE_OK) {
+            rc = SQLITE_CORRUPT;
+        }
+    } else {
+        remove(dst);
+        rc = sqlite3_open_v2(dst, &ddb,
+                SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+        if (rc != SQLITE_OK) {
+            sqlite3_str_appendf(rep, "Cannot create '%s': %s\n", dst,
+                    (ddb) ? sqlite3_errmsg(ddb) : sqlite3_errstr(rc));
+        } else {
+            sqlite3_exec(ddb, "PRAGMA journal_mode=OFF; "
+                    "PRAGMA synchronous=OFF;", NULL, NULL, NULL);
+        }
+    }
+
+    /* Tables first, then their rows, then indexes, triggers, views */
+    for (int i = 0; i < nobjs && rc == SQLITE_OK; ++i) {
+        if (strcmp(objs[i].type, "table") != 0) {
+            continue;
+        }
+        if (sqlite3_strnicmp(objs[i].sql, "CREATE VIRTUAL", 14) == 0) {
+            sqlite3_str_appendf(rep, "  %s: virtual table skipped\n",
+                    objs[i].name);
+            continue;
+        }
+        if (sqlite3_exec(ddb, objs[i].sql, NULL, NULL, NULL)
+                != SQLITE_OK) {
+            sqlite3_str_appendf(rep, "  %s: cannot recreate (%s)\n",
+                    objs[i].name, sqlite3_errmsg(ddb));
+            out->nlost++;
+            continue;
+        }
+        rc = s_copy_table(job, sdb, ddb, objs[i].name,
+                (double) i / (double) nobjs, rep, out);
+    }
+    for (int i = 0; i < nobjs && rc == SQLITE_OK; ++i) {
+        if (strcmp(objs[i].type, "table") == 0) {
+            continue;
+        }
+        if (sqlite3_exec(ddb, objs[i].sql, NULL, NULL, NULL)
+                != SQLITE_OK) {
+            sqlite3_str_appendf(rep, "  %s '%s': cannot recreate (%s)\n",
+                    objs[i].type, objs[i].name, sqlite3_errmsg(ddb));
+            out->nlost++;
+        }
+    }
+
+    for (int i = 0; i < nobjs; ++i) {
+        free(objs[i].type);
+        free(objs[i].name);
+        free(objs[i].sql);
+    }
+    free(objs);
+    sqlite3_close(ddb);
+    sqlite3_close(sdb);
+
+    return rc;
+}
+
+
+/* Recover the readable content of a database into a new file */
+int recover_database(job_td *job, const char *src, const char *dst,
+        recover_result_td *out)
+{
+    if (!src || !dst || !out) {
+        return SQLITE_MISUSE;
+    }
+    memset(out, 0, sizeof(*out));
+
+    sqlite3_str *rep = sqlite3_str_new(NULL);
+    sqlite3_str_appendf(rep, "Recovery of '%s' into '%s'\n\n", src, dst);
+#ifdef HAVE_SQLITE3RECOVER
+    int rc = s_recover_extension(job, src, dst, rep, out);
+#else
+    int rc = s_recover_salvage(job, src, dst, rep, out);
+#endif
+    sqlite3_str_appendf(rep, "\n%lld rows in %d tables, %d losses\n",
+            (long long) out->nrows, out->ntables, out->nlost);
+    out->report = sqlite3_str_finish(rep);
+
+    return rc;
+}
+
+
+/* Free memory held by a recovery result */
+void recover_result_free(recover_result_td *r)
+{
+    if (!r) {
+        return;
+    }
+
+    sqlite3_free(r->report);
+    r->report = NULL;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file regexp.c
+ *
+ * @brief Implementation of the @c REGEXP operator for SQLite connections
+ */
+
+/* External includes */
+#include <glib.h>
+
+/* Local includes */
+#include <regexp.h>
+
+
+/**
+ * @brief Release a compiled pattern kept as auxiliary data
+ *
+ * @param re Compiled pattern (@e GRegex *)
+ */
+static void s_regex_unref(void *re)
+{
+    g_regex_unref(re);
+}
+
+
+/**
+ * @brief Implementation of @c regexp(pattern, text)
+ *
+ * @param ctx  Function context
+ * @param argc Number of arguments (2)
+ * @param argv Pattern and text
+ */
+static void s_regexp(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    (void) argc;
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL
+            || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        return;     /* NULL, as for the other operators */
+    }
+
+    /* Compiled on the first row only while the pattern is constant */
+    GRegex *re = sqlite3_get_auxdata(ctx, 0);
+    int compiled = 0;
+    if (!re) {
+        GError *err = NULL;
+        const char *pattern = (const char*) sqlite3_value_text(argv[0]);
+        re = g_regex_new((pattern) ? pattern : "", G_REGEX_OPTIMIZE, 0,
+                &err);
+        if (!re) {
+            sqlite3_result_error(ctx, (err) ? err->message
+                    : "Invalid regular expression", -1);
+            g_clear_error(&err);
+            return;
+        }
+        compiled = 1;
+    }
+
+    const char *text = (const char*) sqlite3_value_text(argv[1]);
+    int len = sqlite3_value_bytes(argv[1]);
+    sqlite3_result_int(ctx, text && g_regex_match_full(re, text, len, 0, 0,
+                NULL, NULL));
+
+    /* May release it at once if the pattern is not constant */
+    if (compiled) {
+        sqlite3_set_auxdata(ctx, 0, re, s_regex_unref);
+    }
+}
+
+
+/* Register the `regexp()` function on a connection */
+int regexp_register(sqlite3 *db)
+{
+    if (!db) {
+        return SQLITE_MISUSE;
+    }
+
+    return sqlite3_create_function_v2(db, "regexp", 2,
+            SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS, NULL,
+            s_regexp, NULL, NULL, NULL);
+}
@@ -0,0 +1,737 @@
+/**
+ * @file result.c
+ *
+ * @brief Implementation of the typed cache of query results
+ */
+
+/* System includes */
+#include <string.h>
+
+/* Local includes */
+#include <result.h>
+
+
+#define RESULT_INSERTION_SORT (16)  /**< Runs sorted by insertion */
+#define RESULT_FIRST_ROWS (64)      /**< Rows first allocated of a block */
+#define RESULT_MAX_KEY_DEPTH (64)   /**< Bytes of text and BLOBs keyed
+                                         before ties are compared */
+
+
+/**
+ * @brief Value of a cell
+ */
+typedef union {
+    gint64 i;           /**< Integer */
+    double d;           /**< Real */
+    struct {
+        guint32 off;    /**< Offset in the arena of the block */
+        guint32 len;    /**< Bytes */
+    } s;                /**< Text or BLOB */
+} s_value_td;
+
+/**
+ * @struct s_block_td
+ *
+ * @brief Block of rows, cells stored row by row
+ */
+typedef struct {
+    guint8 *types;      /**< SQLite type of each cell */
+    s_value_td *values; /**< Value of each cell */
+    GByteArray *bytes;  /**< Arena of the text and BLOB values */
+    guint32 nrows;      /**< Rows used */
+    guint32 capacity;   /**< Rows allocated, up to
+                             @e RESULT_BLOCK_ROWS */
+} s_block_td;
+
+/**
+ * @struct result_td
+ *
+ * @brief Typed result cache
+ */
+struct result_td {
+    int ncols;          /**< Number of columns */
+    GPtrArray *blocks;  /**< Blocks of rows (@e s_block_td) */
+    guint32 nrows;      /**< Number of rows */
+};
+
+/**
+ * @struct s_key_td
+ *
+ * @brief Sort key of a row
+ *
+ * The key orders rows as their values do, the sort direction included,
+ * except that values with the same key may still differ unless both
+ * are @e exact.
+ */
+typedef struct {
+    guint64 key;        /**< Storage class, then a prefix of the value */
+    guint32 row;        /**< Row */
+    guint8 cls;         /**< 0 NULL, 1 number, 2 text, 3 BLOB */
+    guint8 exact;       /**< Whether the key tells the whole value */
+} s_key_td;
+
+/**
+ * @struct s_sort_td
+ *
+ * @brief What a sort compares
+ */
+typedef struct {
+    const result_td *r; /**< Cache */
+    int col;            /**< Column */
+    int descending;     /**< Non-zero for descending order */
+} s_sort_td;
+
+/**
+ * @struct s_part_td
+ *
+ * @brief Range of keys built and sorted, or merged, by a thread
+ */
+typedef struct {
+    const s_sort_td *sort;  /**< What is compared */
+    s_key_td *keys;         /**< Keys */
+    s_key_td *tmp;          /**< Scratch space, as large as @e keys */
+    guint32 lo;             /**< First key of the range */
+    guint32 mid;            /**< First key of the second run (merges) */
+    guint32 hi;             /**< End of the range */
+} s_part_td;
+
+
+/**
+ * @brief Release a block
+ *
+ * @param data Block (@e s_block_td *)
+ */
+static void s_block_free(gpointer data)
+{
+    s_block_td *b = data;
+
+    g_free(b->types);
+    g_free(b->values);
+    g_byte_array_unref(b->bytes);
+    g_free(b);
+}
+
+
+/* Create an empty result cache */
+result_td *result_new(int ncols)
+{
+    result_td *r = g_new0(result_td, 1);
+
+    r->ncols = MAX(ncols, 0);
+    r->blocks = g_ptr_array_new_with_free_func(s_block_free);
+
+    return r;
+}
+
+
+/* Release a result cache */
+void result_free(result_td *r)
+{
+    if (!r) {
+        return;
+    }
+
+    g_ptr_array_free(r->blocks, TRUE);
+    g_free(r);
+}
+
+
+/* Copy the current row of a statement to the end of the cache */
+void result_append(result_td *r, sqlite3_stmt *stmt)
+{
+    size_t ncols = (size_t) r->ncols;
+    guint32 row = r->nrows % RESULT_BLOCK_ROWS;
+
+    if (row == 0) {
+        s_block_td *b = g_new0(s_block_td, 1);
+        b->bytes = g_byte_array_new();
+        g_ptr_array_add(r->blocks, b);
+    }
+    s_block_td *b = g_ptr_array_index(r->blocks, r->blocks->len - 1);
+
+    /* Small results stay small: blocks grow up to their full size */
+    if (row == b->capacity) {
+        b->capacity = (b->capacity) ? MIN(b->capacity * 2,
+                RESULT_BLOCK_ROWS) : RESULT_FIRST_ROWS;
+        b->types = g_renew(guint8, b->types, b->capacity * ncols);
+        b->values = g_renew(s_value_td, b->values, b->capacity * ncols);
+    }
+
+    for (size_t c = 0; c < ncols; ++c) {
+        size_t cell = row * ncols + c;
+        int type = sqlite3_column_type(stmt, (int) c);
+        const void *data = NULL;
+        b->types[cell] = (guint8) type;
+        switch (type) {
+            case SQLITE_INTEGER:
+                b->values[cell].i = sqlite3_column_int64(stmt, (int) c);
+                break;
+            case SQLITE_FLOAT:
+                b->values[cell].d = sqlite3_column_double(stmt, (int) c);
+                break;
+            case SQLITE_TEXT:
+            case SQLITE_BLOB:
+                data = (type == SQLITE_TEXT)
+                    ? (const void*) sqlite3_column_text(stmt, (int) c)
+                    : sqlite3_column_blob(stmt, (int) c);
+                b->values[cell].s.off = b->bytes->len;
+                b->values[cell].s.len =
+                    (guint32) sqlite3_column_bytes(stmt, (int) c);
+                if (data) {
+                    g_byte_array_append(b->bytes, data,
+                            b->values[cell].s.len);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    b->nrows++;
+    r->nrows++;
+}
+
+
+/* Get the number of rows of the cache */
+guint32 result_count(const result_td *r)
+{
+    return r->nrows;
+}
+
+
+/* Get the memory held by the cache */
+size_t result_size(const result_td *r)
+{
+    size_t size = sizeof(*r);
+
+    for (guint i = 0; i < r->blocks->len; ++i) {
+        const s_block_td *b = g_ptr_array_index(r->blocks, i);
+        size += sizeof(*b) + b->capacity * (size_t) r->ncols
+            * (sizeof(guint8) + sizeof(s_value_td)) + b->bytes->len;
+    }
+
+    return size;
+}
+
+
+/**
+ * @brief Find a cell
+ *
+ * @param r     Cache
+ * @param row   Row
+ * @param col   Column
+ * @param type  Where to store the SQLite type of the cell
+ * @param bytes Where to store the text or BLOB bytes (@c NULL for
+ *              other types)
+ *
+ * @return Value of the cell
+ */
+static const s_value_td *s_cell(const result_td *r, guint32 row, int col,
+        int *type, const guint8 **bytes)
+{
+    const s_block_td *b = g_ptr_array_index(r->blocks,
+            row / RESULT_BLOCK_ROWS);
+    size_t cell = (row % RESULT_BLOCK_ROWS) * (size_t) r->ncols
+        + (size_t) col;
+
+    *type = b->types[cell];
+    *bytes = (*type == SQLITE_TEXT || *type == SQLITE_BLOB)
+        ? b->bytes->data + b->values[cell].s.off : NULL;
+
+    return &b->values[cell];
+}
+
+
+/* Get the SQLite type of a cell */
+int result_type(const result_td *r, guint32 row, int col)
+{
+    const guint8 *bytes;
+    int type;
+
+    s_cell(r, row, col, &type, &bytes);
+
+    return type;
+}
+
+
+/* Get a cell as text, as sqlite3_column_text() gives it */
+char *result_text(const result_td *r, guint32 row, int col)
+{
+    const guint8 *bytes;
+    int type;
+    const s_value_td *v = s_cell(r, row, col, &type, &bytes);
+    char num[32];
+
+    switch (type) {
+        case SQLITE_INTEGER:
+            return g_strdup_printf("%" G_GINT64_FORMAT, v->i);
+        case SQLITE_FLOAT:
+            sqlite3_snprintf(sizeof(num), num, "%!.15g", v->d);
+            return g_strdup(num);
+        case SQLITE_TEXT:
+        case SQLITE_BLOB:
+            return g_strndup((const char*) bytes, v->s.len);
+        default:
+            return NULL;
+    }
+}
+
+
+/**
+ * @brief Compare an integer with a real, as SQLite does
+ *
+ * @param i Integer
+ * @param d Real
+ *
+ * @return Negative, zero or positive as @e i is less than, equal to or
+ *         greater than @e d
+ */
+static int s_compare_int_real(gint64 i, double d)
+{
+    /* Doubles beyond the range of integers are outside of it */
+    if (d < -9223372036854775808.0) {
+        return 1;
+    } else if (d >= 9223372036854775808.0) {
+        return -1;
+    }
+
+    gint64 whole = (gint64) d;
+    if (i != whole) {
+        return (i < whole) ? -1 : 1;
+    }
+    double frac = d - (double) whole;
+
+    return (frac > 0.0) ? -1 : (frac < 0.0) ? 1 : 0;
+}
+
+
+/**
+ * @brief Compare the values of two rows of the same storage class
+ *
+ * @param r   Cache
+ * @param col Column
+ * @param a   First row
+ * @param b   Second row
+ *
+ * @return Negative, zero or positive as @e a sorts before, with or
+ *         after @e b
+ */
+static int s_compare_values(const result_td *r, int col, guint32 a,
+        guint32 b)
+{
+    int ta, tb;
+    const guint8 *ba, *bb;
+    const s_value_td *va = s_cell(r, a, col, &ta, &ba);
+    const s_value_td *vb = s_cell(r, b, col, &tb, &bb);
+
+    if (ta == SQLITE_INTEGER && tb == SQLITE_INTEGER) {
+        return (va->i < vb->i) ? -1 : (va->i > vb->i);
+    } else if (ta == SQLITE_FLOAT && tb == SQLITE_FLOAT) {
+        return (va->d < vb->d) ? -1 : (va->d > vb->d);
+    } else if (ta == SQLITE_INTEGER && tb == SQLITE_FLOAT) {
+        return s_compare_int_real(va->i, vb->d);
+    } else if (ta == SQLITE_FLOAT && tb == SQLITE_INTEGER) {
+        return -s_compare_int_real(vb->i, va->d);
+    } else if (ba && bb) {
+        /* BINARY collation: bytes, then length */
+        guint32 n = MIN(va->s.len, vb->s.len);
+        int c = (n > 0) ? memcmp(ba, bb, n) : 0;
+        return (c != 0) ? c : (va->s.len < vb->s.len) ? -1
+            : (va->s.len > vb->s.len);
+    }
+
+    return 0;   /* Both NULL */
+}
+
+
+/**
+ * @brief Compare two sort keys
+ *
+ * @param a    First key
+ * @param b    Second key
+ * @param sort What is compared (@c NULL to compare the keys and rows
+ *             only)
+ *
+ * @return Negative, zero or positive as @e a sorts before, with or
+ *         after @e b (zero only for the same row)
+ */
+static int s_compare(const s_key_td *a, const s_key_td *b,
+        const s_sort_td *sort)
+{
+    int c = 0;
+
+    if (a->key != b->key) {
+        return (a->key < b->key) ? -1 : 1;
+    } else if (sort && (!a->exact || !b->exact)) {
+        c = s_compare_values(sort->r, sort->col, a->row, b->row);
+        if (sort->descending) {
+            c = -c;
+        }
+    }
+
+    /* Ties keep the result order */
+    return (c != 0) ? c : (a->row < b->row) ? -1 : (a->row > b->row);
+}
+
+
+/**
+ * @brief Build the sort key of a row
+ *
+ * The two high bits hold the storage class (NULL, number, text, BLOB,
+ * as SQLite orders them).  Numbers follow with their IEEE 754 bits,
+ * flipped so that they sort as unsigned, less the last two; text and
+ * BLOBs with 7 of their bytes from @e depth on and how many bytes are
+ * left there, up to 8, which orders them as the @c BINARY collation
+ * does.
+ *
+ * @param sort  What is compared
+ * @param row   Row
+ * @param depth Bytes of text and BLOBs already known to be equal
+ * @param key   Where to store the key
+ */
+static void s_make_key(const s_sort_td *sort, guint32 row, guint32 depth,
+        s_key_td *key)
+{
+    int type;
+    const guint8 *bytes;
+    const s_value_td *v = s_cell(sort->r, row, sort->col, &type, &bytes);
+    guint64 k = 0;
+    int exact = 1;
+
+    key->cls = 0;
+    if (type == SQLITE_INTEGER || type == SQLITE_FLOAT) {
+        double d = (type == SQLITE_INTEGER) ? (double) v->i : v->d;
+        guint64 bits;
+        memcpy(&bits, &d, sizeof(bits));
+        bits = (bits >> 63) ? ~bits : bits | (G_GUINT64_CONSTANT(1) << 63);
+        k = (G_GUINT64_CONSTANT(1) << 62) | (bits >> 2);
+        key->cls = 1;
+        exact = ((bits & 3) == 0);
+        if (type == SQLITE_INTEGER) {
+            /* Integers beyond 2^53 may not survive the conversion */
+            exact = exact && d < 9223372036854775808.0
+                && (gint64) d == v->i;
+        }
+    } else if (bytes) {
+        guint32 len = (v->s.len > depth) ? v->s.len - depth : 0;
+        for (guint32 i = 0; i < 7; ++i) {
+            k = (k << 8) | ((i < len) ? bytes[depth + i] : 0);
+        }
+        key->cls = (type == SQLITE_TEXT) ? 2 : 3;
+        k = (k << 4) | MIN(len, 8);
+        k = ((guint64) key->cls << 62) | (k << 2);
+        exact = (len < 8);
+    }
+
+    key->key = sort->descending ? ~k : k;
+    key->row = row;
+    key->exact = (guint8) exact;
+}
+
+
+/**
+ * @brief Merge two sorted runs
+ *
+ * @param a    First run
+ * @param na   Keys of @e a
+ * @param b    Second run
+ * @param nb   Keys of @e b
+ * @param out  Where to store the @e na + @e nb merged keys
+ * @param sort What is compared (see @a s_compare())
+ */
+static void s_merge(const s_key_td *a, size_t na, const s_key_td *b,
+        size_t nb, s_key_td *out, const s_sort_td *sort)
+{
+    size_t i = 0, j = 0, k = 0;
+
+    while (i < na && j < nb) {
+        out[k++] = (s_compare(&b[j], &a[i], sort) < 0) ? b[j++] : a[i++];
+    }
+    memcpy(out + k, a + i, (na - i) * sizeof(*a));
+    memcpy(out + k + (na - i), b + j, (nb - j) * sizeof(*b));
+}
+
+
+/**
+ * @brief Sort keys with a merge sort
+ *
+ * @param keys Keys (sorted in place)
+ * @param tmp  Scratch space of @e n keys
+ * @param n    Number of keys
+ * @param sort What is compared
+ */
+static void s_sort_keys(s_key_td *keys, s_key_td *tmp, size_t n,
+        const s_sort_td *sort)
+{
+    if (n <= RESULT_INSERTION_SORT) {
+        for (size_t i = 1; i < n; ++i) {
+            s_key_td k = keys[i];
+            size_t j = i;
+            for (; j > 0 && s_compare(&k, &keys[j - 1], sort) < 0; --j) {
+                keys[j] = keys[j - 1];
+            }
+            keys[j] = k;
+        }
+        return;
+    }
+
+    size_t half = n / 2;
+    s_sort_keys(keys, tmp, half, sort);
+    s_sort_keys(keys + half, tmp + half, n - half, sort);
+    if (s_compare(&keys[half - 1], &keys[half], sort) < 0) {
+        return;     /* Already in order, as for presorted results */
+    }
+    s_merge(keys, half, keys + half, n - half, tmp, sort);
+    memcpy(keys, tmp, n * sizeof(*keys));
+}
+
+
+/**
+ * @brief Sort keys by their @e key field with a stable radix sort
+ *
+ * Bytes are taken from the least significant one, skipping those that
+ * all keys share.
+ *
+ * @param keys Keys (sorted in place)
+ * @param tmp  Scratch space of @e n keys
+ * @param n    Number of keys
+ */
+static void s_radix_sort(s_key_td *keys, s_key_td *tmp, size_t n)
+{
+    if (n < 2) {
+        return;
+    }
+
+    size_t *counts = g_new0(size_t, 8 * 256);
+    s_key_td *src = keys, *dst = tmp;
+
+    for (size_t i = 0; i < n; ++i) {
+        for (unsigned int byte = 0; byte < 8; ++byte) {
+            counts[256 * byte + ((keys[i].key >> (8 * byte)) & 0xff)]++;
+        }
+    }
+
+    for (unsigned int byte = 0; byte < 8; ++byte) {
+        size_t *count = counts + 256 * byte;
+        if (count[(src[0].key >> (8 * byte)) & 0xff] == n) {
+            continue;
+        }
+        size_t pos = 0;
+        for (int d = 0; d < 256; ++d) {
+            size_t c = count[d];
+            count[d] = pos;
+            pos += c;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            dst[count[(src[i].key >> (8 * byte)) & 0xff]++] = src[i];
+        }
+        s_key_td *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != keys) {
+        memcpy(keys, src, n * sizeof(*keys));
+    }
+    g_free(counts);
+}
+
+
+/**
+ * @brief Sort the runs of equal keys that do not tell their values
+ *        apart
+ *
+ * Runs of text or BLOBs get new keys from their next bytes, are radix
+ * sorted again and so on, up to @e RESULT_MAX_KEY_DEPTH bytes, so long
+ * equal values do not nest a call per 7 bytes; others, and runs still
+ * tied there, are compared by value.
+ *
+ * @param keys  Keys, sorted by @e key and row
+ * @param tmp   Scratch space of @e n keys
+ * @param n     Number of keys
+ * @param depth Bytes of text and BLOBs the keys were made from
+ * @param sort  What is compared
+ */
+static void s_sort_ties(s_key_td *keys, s_key_td *tmp, size_t n,
+        guint32 depth, const s_sort_td *sort)
+{
+    for (size_t i = 0; i < n;) {
+        size_t j = i + 1;
+        int exact = keys[i].exact;
+        for (; j < n && keys[j].key == keys[i].key; ++j) {
+            exact = exact && keys[j].exact;
+        }
+        if (exact || j - i < 2) {
+            /* Nothing to do */
+        } else if (keys[i].cls >= 2 && depth + 7 < RESULT_MAX_KEY_DEPTH) {
+            for (size_t k = i; k < j; ++k) {
+                s_make_key(sort, keys[k].row, depth + 7, &keys[k]);
+            }
+            s_radix_sort(keys + i, tmp + i, j - i);
+            s_sort_ties(keys + i, tmp + i, j - i, depth + 7, sort);
+        } else {
+            s_sort_keys(keys + i, tmp + i, j - i, sort);
+        }
+        i = j;
+    }
+}
+
+
+/**
+ * @brief Build and radix sort the keys of a range of rows (thread body)
+ *
+ * @param data Range (@e s_part_td *)
+ *
+ * @return @c NULL
+ */
+static gpointer s_sort_part(gpointer data)
+{
+    s_part_td *p = data;
+
+    for (guint32 row = p->lo; row < p->hi; ++row) {
+        s_make_key(p->sort, row, 0, &p->keys[row]);
+    }
+    s_radix_sort(p->keys + p->lo, p->tmp + p->lo, p->hi - p->lo);
+
+    return NULL;
+}
+
+
+/**
+ * @brief Merge two adjacent sorted runs into the scratch space (thread
+ *        body)
+ *
+ * Only keys and rows are compared, so that merges never look values up.
+ *
+ * @param data Runs [@e lo, @e mid) and [@e mid, @e hi) (@e s_part_td *)
+ *
+ * @return @c NULL
+ */
+static gpointer s_merge_part(gpointer data)
+{
+    s_part_td *p = data;
+
+    s_merge(p->keys + p->lo, p->mid - p->lo, p->keys + p->mid,
+            p->hi - p->mid, p->tmp + p->lo, NULL);
+
+    return NULL;
+}
+
+
+/**
+ * @brief Sort the ties of a range of keys (thread body)
+ *
+ * @param data Range, not splitting runs of equal keys (@e s_part_td *)
+ *
+ * @return @c NULL
+ */
+static gpointer s_ties_part(gpointer data)
+{
+    s_part_td *p = data;
+
+    s_sort_ties(p->keys + p->lo, p->tmp + p->lo, p->hi - p->lo, 0,
+            p->sort);
+
+    return NULL;
+}
+
+
+/**
+ * @brief Run a thread body on parts, each on its own thread if several
+ *
+ * @param name   Name of the threads
+ * @param func   Thread body
+ * @param parts  Parts
+ * @param nparts Number of parts
+ */
+static void s_run_parts(const char *name, GThreadFunc func,
+        s_part_td *parts, int nparts)
+{
+    GThread *threads[RESULT_MAX_PARTITIONS];
+
+    for (int p = 0; p < nparts; ++p) {
+        threads[p] = (nparts > 1) ? g_thread_new(name, func, &parts[p])
+            : NULL;
+    }
+    for (int p = 0; p < nparts; ++p) {
+        if (threads[p]) {
+            g_thread_join(threads[p]);
+        } else {
+            func(&parts[p]);
+        }
+    }
+}
+
+
+/* Sort the rows of the cache by a column */
+int result_sort(const result_td *r, int col, int descending, int nparts,
+        guint32 *order)
+{
+    if (!r || col < 0 || col >= r->ncols || !order) {
+        return SQLITE_MISUSE;
+    }
+
+    guint32 n = r->nrows;
+    s_sort_td sort = { r, col, descending };
+    s_key_td *keys = g_new(s_key_td, MAX(n, 1));
+    s_key_td *tmp = g_new(s_key_td, MAX(n, 1));
+    s_part_td parts[RESULT_MAX_PARTITIONS];
+    guint32 bounds[RESULT_MAX_PARTITIONS + 1];
+
+    nparts = CLAMP(nparts, 1, RESULT_MAX_PARTITIONS);
+    nparts = (int) MIN((guint32) nparts, MAX(n / RESULT_MIN_PARTITION, 1));
+    for (int p = 0; p <= nparts; ++p) {
+        bounds[p] = (guint32) ((guint64) n * (guint64) p
+                / (guint64) nparts);
+    }
+
+    /* Sort the parts by key, then merge pairs of runs until one is left */
+    for (int p = 0; p < nparts; ++p) {
+        parts[p] = (s_part_td) { &sort, keys, tmp, bounds[p], 0,
+            bounds[p + 1] };
+    }
+    s_run_parts("result-sort", s_sort_part, parts, nparts);
+
+    int nruns = nparts;
+    while (nruns > 1) {
+        int nmerges = nruns / 2;
+        for (int m = 0; m < nmerges; ++m) {
+            parts[m] = (s_part_td) { &sort, keys, tmp, bounds[2 * m],
+                bounds[2 * m + 1], bounds[2 * m + 2] };
+        }
+        s_run_parts("result-merge", s_merge_part, parts, nmerges);
+        if (nruns % 2) {
+            guint32 lo = bounds[nruns - 1];
+            memcpy(tmp + lo, keys + lo, (n - lo) * sizeof(*keys));
+        }
+
+        /* The merged runs are now in the scratch space */
+        s_key_td *swap = keys;
+        keys = tmp;
+        tmp = swap;
+        for (int m = 0; m <= nmerges; ++m) {
+            bounds[m] = bounds[MIN(2 * m, nruns)];
+        }
+        nruns = nmerges + nruns % 2;
+        bounds[nruns] = n;
+    }
+
+    /* Then the ties, in parts that end where a key changes */
+    for (int p = 0; p < nparts; ++p) {
+        guint32 lo = (p > 0) ? parts[p - 1].hi : 0;
+        guint32 hi = MAX(lo, (guint32) ((guint64) n * (guint64) (p + 1)
+                    / (guint64) nparts));
+        while (hi > 0 && hi < n && keys[hi].key == keys[hi - 1].key) {
+            hi++;
+        }
+        parts[p] = (s_part_td) { &sort, keys, tmp, lo, 0, hi };
+    }
+    s_run_parts("result-ties", s_ties_part, parts, nparts);
+
+    for (guint32 i = 0; i < n; ++i) {
+        order[i] = keys[i].row;
+    }
+    g_free(keys);
+    g_free(tmp);
+
+    return SQLITE_OK;
+}
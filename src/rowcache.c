@@ -0,0 +1,304 @@
+/**
+ * @file rowcache.c
+ *
+ * @brief Implementation of the blocks of rows shared by the views of a
+ *        database file
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* System includes */
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* External includes */
+#include <sqlite3.h>
+
+/* Local includes */
+#include <rowcache.h>
+
+
+#define ROWCACHE_COUNTER_OFFSET (24)    /**< File change counter in the
+                                             database header */
+
+
+/**
+ * @struct rowcache_block_td
+ *
+ * @brief Cached block
+ */
+struct rowcache_block_td {
+    char *key;              /**< File and query ("dev:ino\nquery") */
+    result_td *rows;        /**< Rows */
+    size_t size;            /**< Memory held by @e rows */
+    int refs;               /**< References: views, and the cache while
+                                 it holds the block */
+    GList *link;            /**< Link in @e s_lru, or @c NULL once
+                                 dropped */
+};
+
+
+static GMutex s_lock;               /**< Guards what follows */
+static GHashTable *s_blocks;        /**< Blocks by key */
+static GHashTable *s_versions;      /**< Version seen by "dev:ino" */
+static GQueue s_lru = G_QUEUE_INIT; /**< Blocks, most recently used
+                                         first */
+static size_t s_bytes;              /**< Memory held by the blocks */
+
+
+/**
+ * @brief Release a reference to a block, with the lock held
+ *
+ * @param b Block
+ */
+static void s_unref_locked(rowcache_block_td *b)
+{
+    if (--b->refs == 0) {
+        result_free(b->rows);
+        g_free(b->key);
+        g_free(b);
+    }
+}
+
+
+/**
+ * @brief Drop a block from the cache, with the lock held
+ *
+ * @param b Block
+ */
+static void s_drop(rowcache_block_td *b)
+{
+    g_hash_table_remove(s_blocks, b->key);
+    g_queue_delete_link(&s_lru, b->link);
+    b->link = NULL;
+    s_bytes -= b->size;
+    s_unref_locked(b);
+}
+
+
+/**
+ * @brief Build the "dev:ino" prefix of the keys of a file
+ *
+ * @param id Identity of the file
+ *
+ * @return Prefix (free with @a g_free())
+ */
+static char *s_file_key(const rowcache_id_td *id)
+{
+    return g_strdup_printf("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT,
+            id->dev, id->ino);
+}
+
+
+/**
+ * @brief Check whether two versions of a file are the same
+ *
+ * @param a Version
+ * @param b Version
+ *
+ * @return 1 if they are the same, 0 otherwise
+ */
+static int s_same_version(const rowcache_id_td *a, const rowcache_id_td *b)
+{
+    return a->counter == b->counter && a->size == b->size
+        && a->mtime == b->mtime && a->wal_size == b->wal_size
+        && a->wal_mtime == b->wal_mtime;
+}
+
+
+/**
+ * @brief Drop the blocks of another version of a file, with the lock
+ *        held
+ *
+ * Creates the tables on first use.
+ *
+ * @param id   Identity and version of the file
+ * @param file Where to store the "dev:ino" prefix of the keys of the
+ *             file (free with @a g_free())
+ */
+static void s_check_version(const rowcache_id_td *id, char **file)
+{
+    if (!s_blocks) {
+        s_blocks = g_hash_table_new(g_str_hash, g_str_equal);
+        s_versions = g_hash_table_new_full(g_str_hash, g_str_equal,
+                g_free, g_free);
+    }
+
+    *file = s_file_key(id);
+    rowcache_id_td *seen = g_hash_table_lookup(s_versions, *file);
+    if (seen && s_same_version(seen, id)) {
+        return;
+    }
+
+    /* Whichever view sees the change first drops the blocks of all */
+    if (seen) {
+        size_t len = strlen(*file);
+        for (GList *l = s_lru.head; l; ) {
+            rowcache_block_td *b = l->data;
+            l = l->next;
+            if (strncmp(b->key, *file, len) == 0 && b->key[len] == '\n') {
+                s_drop(b);
+            }
+        }
+    }
+    rowcache_id_td *version = g_new(rowcache_id_td, 1);
+    *version = *id;
+    g_hash_table_replace(s_versions, g_strdup(*file), version);
+}
+
+
+/* Read the identity and version of a database file */
+int rowcache_identify(const char *filename, rowcache_id_td *id)
+{
+    struct stat st;
+    unsigned char counter[4];
+    int fd = (filename) ? open(filename, O_RDONLY) : -1;
+
+    if (fd < 0) {
+        return SQLITE_CANTOPEN;
+    }
+    int ok = (fstat(fd, &st) == 0);
+    ssize_t n = (ok) ? pread(fd, counter, sizeof(counter),
+            ROWCACHE_COUNTER_OFFSET) : -1;
+    close(fd);
+    if (!ok) {
+        return SQLITE_CANTOPEN;
+    }
+
+    memset(id, 0, sizeof(*id));
+    id->dev = (guint64) st.st_dev;
+    id->ino = (guint64) st.st_ino;
+    id->size = (gint64) st.st_size;
+    id->mtime = (gint64) st.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000)
+        + st.st_mtim.tv_nsec;
+    if (n == (ssize_t) sizeof(counter)) {
+        id->counter = (guint32) counter[0] << 24
+            | (guint32) counter[1] << 16 | (guint32) counter[2] << 8
+            | counter[3];
+    }
+
+    /* Commits in WAL mode append to the -wal file only */
+    char *wal = g_strconcat(filename, "-wal", NULL);
+    id->wal_size = -1;
+    if (stat(wal, &st) == 0) {
+        id->wal_size = (gint64) st.st_size;
+        id->wal_mtime = (gint64) st.st_mtim.tv_sec
+            * G_GINT64_CONSTANT(1000000000) + st.st_mtim.tv_nsec;
+    }
+    g_free(wal);
+
+    return SQLITE_OK;
+}
+
+
+/* Find the block of a query on a file */
+rowcache_block_td *rowcache_get(const rowcache_id_td *id, const char *key)
+{
+    rowcache_block_td *b = NULL;
+    char *file = NULL;
+
+    if (!id || !key) {
+        return NULL;
+    }
+
+    g_mutex_lock(&s_lock);
+    s_check_version(id, &file);
+    char *full = g_strconcat(file, "\n", key, NULL);
+    b = g_hash_table_lookup(s_blocks, full);
+    if (b) {
+        g_queue_unlink(&s_lru, b->link);
+        g_queue_push_head_link(&s_lru, b->link);
+        b->refs++;
+    }
+    g_mutex_unlock(&s_lock);
+    g_free(full);
+    g_free(file);
+
+    return b;
+}
+
+
+/* Cache the block of a query on a file */
+rowcache_block_td *rowcache_put(const rowcache_id_td *id, const char *key,
+        result_td *rows)
+{
+    rowcache_block_td *b = NULL;
+    char *file = NULL;
+    int stale = 0;
+
+    g_mutex_lock(&s_lock);
+
+    /* Rows read while the file changed are older than the version
+     * another view may have seen since: keep its blocks */
+    if (s_versions) {
+        file = s_file_key(id);
+        const rowcache_id_td *seen = g_hash_table_lookup(s_versions, file);
+        stale = (seen && !s_same_version(seen, id));
+        g_free(file);
+    }
+    if (stale) {
+        g_mutex_unlock(&s_lock);
+        result_free(rows);
+        return NULL;
+    }
+
+    b = g_new0(rowcache_block_td, 1);
+    b->rows = rows;
+    b->size = result_size(rows) + strlen(key);
+    b->refs = 2;
+    s_check_version(id, &file);
+    b->key = g_strconcat(file, "\n", key, NULL);
+    rowcache_block_td *old = g_hash_table_lookup(s_blocks, b->key);
+    if (old) {
+        s_drop(old);
+    }
+    g_hash_table_insert(s_blocks, b->key, b);
+    g_queue_push_head(&s_lru, b);
+    b->link = s_lru.head;
+    s_bytes += b->size;
+
+    /* Views keep the blocks they use alive, dropped or not */
+    while (s_bytes > ROWCACHE_MAX_BYTES && s_lru.tail != b->link) {
+        s_drop(s_lru.tail->data);
+    }
+    g_mutex_unlock(&s_lock);
+    g_free(file);
+
+    return b;
+}
+
+
+/* Get the rows of a block */
+const result_td *rowcache_rows(const rowcache_block_td *b)
+{
+    return b->rows;
+}
+
+
+/* Release a reference to a block */
+void rowcache_unref(rowcache_block_td *b)
+{
+    if (!b) {
+        return;
+    }
+
+    g_mutex_lock(&s_lock);
+    s_unref_locked(b);
+    g_mutex_unlock(&s_lock);
+}
+
+
+/* Drop every block not in use */
+void rowcache_clear(void)
+{
+    g_mutex_lock(&s_lock);
+    while (s_lru.head) {
+        s_drop(s_lru.head->data);
+    }
+    if (s_versions) {
+        g_hash_table_remove_all(s_versions);
+    }
+    g_mutex_unlock(&s_lock);
+}
@@ -0,0 +1,377 @@
+/**
+ * @file script.c
+ *
+ * @brief Implementation of the streaming execution of SQL scripts
+ */
+
+#define _DEFAULT_SOURCE     /* madvise() */
+
+/* System includes */
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <script.h>
+
+
+#define SCRIPT_REPORT_USEC (200000)     /**< Progress refresh interval */
+#define SCRIPT_RELEASE (1 << 24)    /**< Bytes run between page releases */
+
+
+/**
+ * @brief Statements that cannot run in (or that end) a batch
+ *        transaction
+ */
+static const char *s_outside_batch[] = {
+    "BEGIN", "COMMIT", "END", "ROLLBACK", "SAVEPOINT", "RELEASE",
+    "VACUUM", "ATTACH", "DETACH", "PRAGMA", NULL
+};
+
+
+/**
+ * @brief Check whether a statement must run outside batch transactions
+ *
+ * @param sql Text of the statement
+ *
+ * @return 1 if it manages transactions or cannot run inside one,
+ *         0 otherwise
+ */
+static int s_runs_outside_batch(const char *sql)
+{
+    const char *p = sql;
+
+    /* Skip blanks and comments before the first keyword */
+    for (;;) {
+        while (g_ascii_isspace(*p)) {
+            p++;
+        }
+        if (p[0] == '-' && p[1] == '-') {
+            p = strchr(p, '\n');
+        } else if (p[0] == '/' && p[1] == '*') {
+            p = strstr(p + 2, "*/");
+            p = (p) ? p + 2 : NULL;
+        } else {
+            break;
+        }
+        if (!p) {
+            return 0;
+        }
+    }
+
+    for (int i = 0; s_outside_batch[i]; ++i) {
+        size_t n = strlen(s_outside_batch[i]);
+        if (g_ascii_strncasecmp(p, s_outside_batch[i], n) == 0
+                && !g_ascii_isalnum(p[n]) && p[n] != '_') {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Get the line of a script a statement starts on
+ *
+ * @param base Start of the script
+ * @param size Size of the script
+ * @param off  Offset where the statement (or its leading blanks) starts
+ *
+ * @return Line number, starting at 1
+ */
+static sqlite3_int64 s_line_of(const char *base, sqlite3_int64 size,
+        sqlite3_int64 off)
+{
+    sqlite3_int64 line = 1;
+
+    while (off < size && g_ascii_isspace(base[off])) {
+        off++;
+    }
+    for (const char *p = base; (p = memchr(p, '\n',
+                    (size_t) (base + off - p))) != NULL; ++p) {
+        line++;
+    }
+
+    return line;
+}
+
+
+/**
+ * @brief Check whether the first statement of a window of a script ends
+ *        inside it
+ *
+ * A failed prepare is retried with a larger window only if the window
+ * may have cut the statement; otherwise the error is the statement's.
+ *
+ * @param db   Connection the statement failed to prepare on
+ * @param sql  Start of the window
+ * @param n    Size of the window
+ *
+ * @return 1 if a complete statement ends inside the window, 0 if not
+ */
+static int s_ends_in_window(sqlite3 *db, const char *sql, int n)
+{
+    int from = sqlite3_error_offset(db);
+    int complete = 0;
+
+    /* Parsing stopped at the end of the window: the statement is cut */
+    if (from >= n) {
+        return 0;
+    }
+
+    /* Its end is the first ';' closing it, at or after the error */
+    char *copy = g_strndup(sql, (gsize) n);
+    for (char *p = copy + MAX(from, 0); !complete
+            && (p = strchr(p, ';')) != NULL; ++p) {
+        char c = p[1];
+        p[1] = '\0';
+        complete = sqlite3_complete(copy);
+        p[1] = c;
+    }
+    g_free(copy);
+
+    return complete;
+}
+
+
+/**
+ * @brief Prepare the next statement of a script
+ *
+ * The parser gets a window of the script starting at @e SCRIPT_WINDOW
+ * bytes: SQLite copies the input given by length, so passing the rest
+ * of a huge script would copy it for every statement.  The window
+ * grows while the statement may be cut by its end; a statement that
+ * ends inside it and fails to prepare is reported at once.
+ *
+ * @param db    Connection to prepare on
+ * @param base  Start of the script
+ * @param size  Size of the script
+ * @param off   Offset of the statement
+ * @param stmt  Where to store the statement (@c NULL if only blanks or
+ *              comments were found)
+ * @param next  Where to store the offset following the statement
+ * @param error Where to copy the message of a failure
+ * @param len   Size of @e error
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_TOOBIG if the statement
+ *         exceeds the SQL length limit, or an SQLite error code
+ */
+static int s_prepare_next(sqlite3 *db, const char *base,
+        sqlite3_int64 size, sqlite3_int64 off, sqlite3_stmt **stmt,
+        sqlite3_int64 *next, char *error, size_t len)
+{
+    sqlite3_int64 maxlen = sqlite3_limit(db, SQLITE_LIMIT_SQL_LENGTH, -1);
+    sqlite3_int64 left = size - off;
+    sqlite3_int64 win = MIN(SCRIPT_WINDOW, maxlen);
+
+    for (;;) {
+        int n = (int) MIN(win, left);
+        const char *tail = NULL;
+        int rc = sqlite3_prepare_v2(db, base + off, n, stmt, &tail);
+
+        /* Parsing up to the end of the window may have cut it short */
+        if (n == left || (rc == SQLITE_OK && tail < base + off + n)
+                || (rc != SQLITE_OK && s_ends_in_window(db, base + off,
+                        n))) {
+            if (rc != SQLITE_OK) {
+                snprintf(error, len, "%s", sqlite3_errmsg(db));
+            }
+            *next = (rc == SQLITE_OK) ? tail - base : off;
+            return rc;
+        }
+        sqlite3_finalize(*stmt);
+        *stmt = NULL;
+        if (n >= maxlen) {
+            snprintf(error, len, "Statement longer than %lld bytes",
+                    (long long) maxlen);
+            return SQLITE_TOOBIG;
+        }
+        win = MIN(win * 4, maxlen);
+    }
+}
+
+
+/**
+ * @brief Run a prepared statement of a script inside or outside the
+ *        batch transactions
+ *
+ * @param db       Connection of the statement
+ * @param stmt     Statement to run (finalized on return)
+ * @param in_batch Non-zero while a batch transaction is open (updated)
+ * @param error    Where to copy the message of a failure
+ * @param len      Size of @e error
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_run_statement(sqlite3 *db, sqlite3_stmt *stmt,
+        int *in_batch, char *error, size_t len)
+{
+    int rc = SQLITE_OK;
+
+    if (s_runs_outside_batch(sqlite3_sql(stmt))) {
+        if (*in_batch) {
+            rc = sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+            *in_batch = 0;
+        }
+    } else if (!*in_batch && sqlite3_get_autocommit(db)) {
+        /* Only when the script has no transaction of its own open */
+        rc = sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+        *in_batch = (rc == SQLITE_OK);
+    }
+
+    if (rc == SQLITE_OK) {
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            /* Rows of queries in the script are dropped */
+        }
+        rc = (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(error, len, "%s", sqlite3_errmsg(db));
+    }
+    sqlite3_finalize(stmt);
+
+    return rc;
+}
+
+
+/**
+ * @brief Execute the statements of a mapped script
+ *
+ * @param job  Job for progress and cancellation (may be @c NULL)
+ * @param db   Read-write connection
+ * @param base Start of the mapped script
+ * @param out  Outcome (@e out->size set by the caller)
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_INTERRUPT if cancelled, or
+ *         the error code of the failing statement
+ */
+static int s_walk(job_td *job, sqlite3 *db, const char *base,
+        script_result_td *out)
+{
+    sqlite3_int64 size = out->size;
+    sqlite3_int64 off = 0;
+    sqlite3_int64 released = 0;
+    sqlite3_int64 page = (sqlite3_int64) sysconf(_SC_PAGESIZE);
+    gint64 reported = 0;
+    int in_batch = 0;
+    int nbatch = 0;
+    int rc = SQLITE_OK;
+
+    while (rc == SQLITE_OK && off < size) {
+        sqlite3_stmt *stmt = NULL;
+        sqlite3_int64 next = off;
+        if (job_is_cancelled(job)) {
+            rc = SQLITE_INTERRUPT;
+            break;
+        }
+        rc = s_prepare_next(db, base, size, off, &stmt, &next, out->error,
+                sizeof(out->error));
+        if (rc == SQLITE_OK && stmt) {
+            int was_in_batch = in_batch;
+            rc = s_run_statement(db, stmt, &in_batch, out->error,
+                    sizeof(out->error));
+            out->nstatements += (rc == SQLITE_OK);
+            nbatch = (was_in_batch) ? nbatch + 1 : 1;
+            if (rc == SQLITE_OK && in_batch && nbatch >= SCRIPT_BATCH) {
+                rc = sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+                in_batch = 0;
+                if (rc != SQLITE_OK) {
+                    snprintf(out->error, sizeof(out->error), "%s",
+                            sqlite3_errmsg(db));
+                }
+            }
+        }
+        if (rc != SQLITE_OK) {
+            break;  /* `off` stays on the failing statement */
+        }
+        off = next;
+
+        /* Executed pages are not needed again */
+        if (off - released >= SCRIPT_RELEASE) {
+            sqlite3_int64 end = off / page * page;
+            madvise((void*) (base + released), (size_t) (end - released),
+                    MADV_DONTNEED);
+            released = end;
+        }
+        gint64 now = g_get_monotonic_time();
+        if (now - reported >= SCRIPT_REPORT_USEC) {
+            char *done = g_format_size((guint64) off);
+            char *total = g_format_size((guint64) size);
+            job_report(job, (double) off / (double) size,
+                    "%s of %s, %lld statements", done, total,
+                    (long long) out->nstatements);
+            g_free(done);
+            g_free(total);
+            reported = now;
+        }
+    }
+
+    if (in_batch) {
+        int rc2 = sqlite3_exec(db, (rc == SQLITE_OK) ? "COMMIT;"
+                : "ROLLBACK;", NULL, NULL, NULL);
+        if (rc == SQLITE_OK && rc2 != SQLITE_OK) {
+            rc = rc2;
+            snprintf(out->error, sizeof(out->error), "%s",
+                    sqlite3_errmsg(db));
+        }
+    }
+    if (rc != SQLITE_OK && rc != SQLITE_INTERRUPT) {
+        out->line = s_line_of(base, size, off);
+    }
+    out->offset = off;
+
+    return rc;
+}
+
+
+/* Execute every statement of an SQL script file */
+int script_run_file(job_td *job, const char *filename, const char *path,
+        script_result_td *out)
+{
+    if (!filename || !path || !out) {
+        return SQLITE_MISUSE;
+    }
+
+    memset(out, 0, sizeof(*out));
+    gint64 start = g_get_monotonic_time();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return SQLITE_CANTOPEN;
+    }
+    struct stat st;
+    void *map = NULL;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return SQLITE_IOERR;
+    }
+    out->size = (sqlite3_int64) st.st_size;
+    if (out->size > 0) {
+        map = mmap(NULL, (size_t) out->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return SQLITE_IOERR;
+        }
+        madvise(map, (size_t) out->size, MADV_SEQUENTIAL);
+    }
+    close(fd);  /* The mapping keeps the file */
+
+    sqlite3 *db = NULL;
+    int rc = db_open_writer(filename, &db);
+    if (rc == SQLITE_OK && map) {
+        rc = s_walk(job, db, map, out);
+    }
+    sqlite3_close(db);
+    if (map) {
+        munmap(map, (size_t) out->size);
+    }
+    out->seconds = (double) (g_get_monotonic_time() - start) / 1e6;
+
+    return rc;
+}
@@ -0,0 +1,947 @@
+/**
+ * @file serve.c
+ *
+ * @brief Implementation of the read-only HTTP/JSON access to a database
+ */
+
+/* System includes */
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+/* External includes */
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <sqlite3.h>
+
+/* Project includes */
+#include <db.h>
+#include <rowcache.h>
+
+/* Local includes */
+#include <serve.h>
+
+
+#define SERVE_CHUNK (16384)     /**< Bytes of body buffered per chunk */
+#define SERVE_TIMEOUT (30)      /**< Seconds a client may stay idle */
+#define SERVE_MAX_HEADERS (100) /**< Header lines read of a request */
+#define SERVE_MAX_LINE (8192)   /**< Bytes of the request line or of a
+                                     header line */
+
+
+/**
+ * @struct s_conn_td
+ *
+ * @brief Read-only connection of the pool
+ */
+typedef struct {
+    sqlite3 *db;                /**< Connection */
+} s_conn_td;
+
+/**
+ * @struct s_server_td
+ *
+ * @brief State shared by the request threads
+ */
+typedef struct {
+    GAsyncQueue *pool;      /**< Idle connections (@e s_conn_td) */
+    const char *filename;   /**< Database file */
+} s_server_td;
+
+/**
+ * @struct s_response_td
+ *
+ * @brief Body being streamed with chunked transfer encoding
+ */
+typedef struct {
+    GOutputStream *out;     /**< Client connection */
+    GString *buf;           /**< Body not sent yet */
+    int failed;             /**< Whether the client went away */
+} s_response_td;
+
+
+/**
+ * @brief Get the reason phrase of an HTTP status
+ *
+ * @param status Status code
+ *
+ * @return Reason phrase
+ */
+static const char *s_reason(int status)
+{
+    switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 414: return "URI Too Long";
+        case 431: return "Request Header Fields Too Large";
+        default: return "Internal Server Error";
+    }
+}
+
+
+/**
+ * @brief Append the escaped characters of a JSON string
+ *
+ * @param g Where to append them
+ * @param s Valid UTF-8 text
+ * @param n Bytes of @e s
+ */
+static void s_json_chars(GString *g, const char *s, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = (unsigned char) s[i];
+        if (c == '"' || c == '\\') {
+            g_string_append_c(g, '\\');
+            g_string_append_c(g, (char) c);
+        } else if (c == '\n') {
+            g_string_append(g, "\\n");
+        } else if (c == '\t') {
+            g_string_append(g, "\\t");
+        } else if (c < 0x20) {
+            g_string_append_printf(g, "\\u%04x", c);
+        } else {
+            g_string_append_c(g, (char) c);
+        }
+    }
+}
+
+
+/**
+ * @brief Append a JSON string
+ *
+ * Invalid UTF-8 sequences are replaced, since JSON must be valid UTF-8.
+ * Embedded NUL characters are kept as @c \\u0000.
+ *
+ * @param g   Where to append it
+ * @param s   Text (may be @c NULL for @c null)
+ * @param len Bytes of @e s, or -1 if null-terminated
+ */
+static void s_json_string(GString *g, const char *s, gssize len)
+{
+    if (!s) {
+        g_string_append(g, "null");
+        return;
+    }
+
+    size_t n = (len < 0) ? strlen(s) : (size_t) len;
+    const char *end = s + n;
+
+    /* UTF-8 is validated between NULs, which glib takes as invalid */
+    g_string_append_c(g, '"');
+    for (;;) {
+        const char *nul = memchr(s, '\0', (size_t) (end - s));
+        gssize part = (nul) ? nul - s : end - s;
+        if (g_utf8_validate(s, part, NULL)) {
+            s_json_chars(g, s, (size_t) part);
+        } else {
+            char *valid = g_utf8_make_valid(s, part);
+            s_json_chars(g, valid, strlen(valid));
+            g_free(valid);
+        }
+        if (!nul) {
+            break;
+        }
+        g_string_append(g, "\\u0000");
+        s = nul + 1;
+    }
+    g_string_append_c(g, '"');
+}
+
+
+/**
+ * @brief Append a text column of a row as a JSON string
+ *
+ * @param g    Where to append it
+ * @param stmt Statement, on a row
+ * @param i    Column
+ */
+static void s_json_column(GString *g, sqlite3_stmt *stmt, int i)
+{
+    const char *text = (const char*) sqlite3_column_text(stmt, i);
+
+    s_json_string(g, text, sqlite3_column_bytes(stmt, i));
+}
+
+
+/**
+ * @brief Append a column of a row as a JSON value
+ *
+ * BLOBs are given as @c {"base64": "..."}, and non-finite reals as
+ * @c null.
+ *
+ * @param g    Where to append it
+ * @param stmt Statement, on a row
+ * @param i    Column
+ */
+static void s_json_value(GString *g, sqlite3_stmt *stmt, int i)
+{
+    char num[G_ASCII_DTOSTR_BUF_SIZE];
+
+    switch (sqlite3_column_type(stmt, i)) {
+        case SQLITE_INTEGER:
+            g_string_append_printf(g, "%lld",
+                    (long long) sqlite3_column_int64(stmt, i));
+            break;
+        case SQLITE_FLOAT: {
+            double d = sqlite3_column_double(stmt, i);
+            g_string_append(g, (isfinite(d))
+                    ? g_ascii_dtostr(num, sizeof(num), d) : "null");
+            break;
+        }
+        case SQLITE_TEXT:
+            s_json_column(g, stmt, i);
+            break;
+        case SQLITE_BLOB: {
+            const void *blob = sqlite3_column_blob(stmt, i);
+            int n = sqlite3_column_bytes(stmt, i);
+            char *b64 = g_base64_encode(blob, (gsize) n);
+            g_string_append_printf(g, "{\"base64\": \"%s\"}", b64);
+            g_free(b64);
+            break;
+        }
+        default:
+            g_string_append(g, "null");
+            break;
+    }
+}
+
+
+/**
+ * @brief Send a whole response
+ *
+ * @param out    Client connection
+ * @param status HTTP status
+ * @param etag   Entity tag (may be @c NULL)
+ * @param body   JSON body (may be @c NULL for none)
+ */
+static void s_send(GOutputStream *out, int status, const char *etag,
+        const char *body)
+{
+    GString *g = g_string_new(NULL);
+
+    g_string_append_printf(g, "HTTP/1.1 %d %s\r\nConnection: close\r\n",
+            status, s_reason(status));
+    if (etag) {
+        g_string_append_printf(g, "ETag: %s\r\n", etag);
+    }
+    if (body) {
+        g_string_append_printf(g, "Content-Type: application/json\r\n"
+                "Content-Length: %zu\r\n\r\n%s", strlen(body), body);
+    } else {
+        g_string_append(g, "\r\n");
+    }
+    g_output_stream_write_all(out, g->str, g->len, NULL, NULL, NULL);
+    g_string_free(g, TRUE);
+}
+
+
+/**
+ * @brief Send an error response
+ *
+ * @param out    Client connection
+ * @param status HTTP status
+ * @param msg    Error message
+ */
+static void s_send_error(GOutputStream *out, int status, const char *msg)
+{
+    GString *body = g_string_new("{\"error\": ");
+
+    s_json_string(body, msg, -1);
+    g_string_append(body, "}\n");
+    s_send(out, status, NULL, body->str);
+    g_string_free(body, TRUE);
+}
+
+
+/**
+ * @brief Answer @c 304 if the client holds the current version
+ *
+ * @param out  Client connection
+ * @param etag Entity tag of the current version
+ * @param inm  @c If-None-Match header (may be @c NULL)
+ *
+ * @return Non-zero if answered
+ */
+static int s_not_modified(GOutputStream *out, const char *etag,
+        const char *inm)
+{
+    if (!inm || (strcmp(inm, "*") != 0 && !strstr(inm, etag))) {
+        return 0;
+    }
+    s_send(out, 304, etag, NULL);
+
+    return 1;
+}
+
+
+/**
+ * @brief Start a streamed response
+ *
+ * @param r    Response
+ * @param out  Client connection
+ * @param etag Entity tag
+ */
+static void s_begin(s_response_td *r, GOutputStream *out, const char *etag)
+{
+    char head[256];
+
+    r->out = out;
+    r->buf = g_string_sized_new(SERVE_CHUNK + 1024);
+    r->failed = 0;
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\n"
+            "Connection: close\r\nContent-Type: application/json\r\n"
+            "Transfer-Encoding: chunked\r\nETag: %s\r\n\r\n", etag);
+    if (!g_output_stream_write_all(out, head, (gsize) n, NULL, NULL,
+                NULL)) {
+        r->failed = 1;
+    }
+}
+
+
+/**
+ * @brief Send the buffered body as a chunk
+ *
+ * @param r    Response
+ * @param last Non-zero to end the body (the buffer is then released)
+ *
+ * @return Non-zero if the client went away
+ */
+static int s_flush(s_response_td *r, int last)
+{
+    char size[32];
+
+    if (!r->failed && r->buf->len > 0) {
+        int n = snprintf(size, sizeof(size), "%zx\r\n", r->buf->len);
+        g_string_append(r->buf, "\r\n");
+        r->failed = !g_output_stream_write_all(r->out, size, (gsize) n,
+                NULL, NULL, NULL)
+            || !g_output_stream_write_all(r->out, r->buf->str, r->buf->len,
+                    NULL, NULL, NULL);
+    }
+    g_string_truncate(r->buf, 0);
+    if (last) {
+        if (!r->failed) {
+            g_output_stream_write_all(r->out, "0\r\n\r\n", 5, NULL, NULL,
+                    NULL);
+        }
+        g_string_free(r->buf, TRUE);
+        r->buf = NULL;
+    }
+
+    return r->failed;
+}
+
+
+/**
+ * @brief Start a read transaction and tag the version it reads
+ *
+ * The tag is the version of the file (see @a rowcache_identify()), the
+ * same for every connection of the pool, so one commit changes it
+ * once.  It is read before the snapshot starts: a commit in between
+ * gets newer rows under the older tag, which only costs a later
+ * request a full answer, never older rows under the newer tag.
+ *
+ * @param srv  Server
+ * @param c    Connection
+ * @param etag Where to store the entity tag
+ * @param len  Size of @e etag
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_snapshot(s_server_td *srv, s_conn_td *c, char *etag,
+        size_t len)
+{
+    rowcache_id_td id;
+    int rc = rowcache_identify(srv->filename, &id);
+
+    /* Reading starts the snapshot */
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(c->db, "BEGIN; SELECT 1 FROM sqlite_master "
+                "LIMIT 1;", NULL, NULL, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        snprintf(etag, len, "\"%x-%llx-%llx-%llx-%llx\"", id.counter,
+                (unsigned long long) id.size, (unsigned long long) id.mtime,
+                (unsigned long long) id.wal_size,
+                (unsigned long long) id.wal_mtime);
+    }
+
+    return rc;
+}
+
+
+/**
+ * @brief Answer @c /tables
+ *
+ * @param db   Connection, in the read transaction
+ * @param out  Client connection
+ * @param etag Entity tag
+ * @param inm  @c If-None-Match header (may be @c NULL)
+ */
+static void s_list_tables(sqlite3 *db, GOutputStream *out, const char *etag,
+        const char *inm)
+{
+    sqlite3_stmt *stmt = NULL;
+    s_response_td r;
+
+    if (sqlite3_prepare_v2(db, "SELECT name, type FROM sqlite_master "
+                "WHERE type IN ('table', 'view') "
+                "AND name NOT LIKE 'sqlite_%' ORDER BY name;", -1, &stmt,
+                NULL) != SQLITE_OK) {
+        s_send_error(out, 500, sqlite3_errmsg(db));
+        return;
+    }
+    if (s_not_modified(out, etag, inm)) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    s_begin(&r, out, etag);
+    g_string_append(r.buf, "{\"tables\": [");
+    int n = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        g_string_append(r.buf, (n++ > 0) ? ",\n  {\"name\": "
+                : "\n  {\"name\": ");
+        s_json_column(r.buf, stmt, 0);
+        g_string_append(r.buf, ", \"type\": ");
+        s_json_column(r.buf, stmt, 1);
+        g_string_append_c(r.buf, '}');
+        if (r.buf->len >= SERVE_CHUNK && s_flush(&r, 0)) {
+            break;
+        }
+    }
+    g_string_append(r.buf, "\n]}\n");
+    s_flush(&r, 1);
+    sqlite3_finalize(stmt);
+}
+
+
+/**
+ * @brief Check that a table or view exists
+ *
+ * @param db    Connection
+ * @param table Table or view
+ * @param sql   Where to store its @c CREATE statement (free with
+ *              @a g_free()), or @c NULL
+ * @param view  Where to store whether it is a view
+ *
+ * @return @e SQLITE_OK if it exists, @e SQLITE_NOTFOUND if not, or an
+ *         SQLite error code
+ */
+static int s_find_table(sqlite3 *db, const char *table, char **sql,
+        int *view)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, "SELECT sql, type = 'view' "
+            "FROM sqlite_master WHERE type IN ('table', 'view') "
+            "AND name = ?1;", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW && sql) {
+        *sql = g_strdup((const char*) sqlite3_column_text(stmt, 0));
+    }
+    *view = (rc == SQLITE_ROW) && sqlite3_column_int(stmt, 1);
+    sqlite3_finalize(stmt);
+
+    return (rc == SQLITE_ROW) ? SQLITE_OK
+        : (rc == SQLITE_DONE) ? SQLITE_NOTFOUND : rc;
+}
+
+
+/**
+ * @brief Answer @c /tables/NAME/schema
+ *
+ * @param db    Connection, in the read transaction
+ * @param table Table or view
+ * @param out   Client connection
+ * @param etag  Entity tag
+ * @param inm   @c If-None-Match header (may be @c NULL)
+ */
+static void s_schema(sqlite3 *db, const char *table, GOutputStream *out,
+        const char *etag, const char *inm)
+{
+    sqlite3_stmt *stmt = NULL;
+    char *sql = NULL;
+    int view = 0;
+    s_response_td r;
+
+    int rc = s_find_table(db, table, &sql, &view);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db, "SELECT name, type, \"notnull\", "
+                "dflt_value, pk FROM pragma_table_info(?1);", -1, &stmt,
+                NULL);
+    }
+    if (rc != SQLITE_OK) {
+        s_send_error(out, (rc == SQLITE_NOTFOUND) ? 404 : 500,
+                (rc == SQLITE_NOTFOUND) ? "No such table"
+                : sqlite3_errmsg(db));
+        g_free(sql);
+        return;
+    }
+    if (s_not_modified(out, etag, inm)) {
+        sqlite3_finalize(stmt);
+        g_free(sql);
+        return;
+    }
+
+    s_begin(&r, out, etag);
+    g_string_append(r.buf, "{\"name\": ");
+    s_json_string(r.buf, table, -1);
+    g_string_append(r.buf, ",\n \"sql\": ");
+    s_json_string(r.buf, sql, -1);
+    g_string_append(r.buf, ",\n \"columns\": [");
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    for (int n = 0; sqlite3_step(stmt) == SQLITE_ROW; ++n) {
+        g_string_append(r.buf, (n > 0) ? ",\n  {\"name\": "
+                : "\n  {\"name\": ");
+        s_json_column(r.buf, stmt, 0);
+        g_string_append(r.buf, ", \"type\": ");
+        s_json_column(r.buf, stmt, 1);
+        g_string_append_printf(r.buf, ", \"notnull\": %s, \"default\": ",
+                (sqlite3_column_int(stmt, 2)) ? "true" : "false");
+        s_json_column(r.buf, stmt, 3);
+        g_string_append_printf(r.buf, ", \"pk\": %d}",
+                sqlite3_column_int(stmt, 4));
+    }
+    g_string_append(r.buf, "\n]}\n");
+    s_flush(&r, 1);
+    sqlite3_finalize(stmt);
+    g_free(sql);
+}
+
+
+/**
+ * @brief Read the paging parameters of a query string
+ *
+ * @param query     Query string (may be @c NULL)
+ * @param after     Where to store @c after (untouched if absent)
+ * @param has_after Where to store whether @c after is given
+ * @param limit     Where to store @c limit (untouched if absent)
+ *
+ * @return Non-zero if every parameter is valid
+ */
+static int s_parse_paging(const char *query, gint64 *after, int *has_after,
+        gint64 *limit)
+{
+    gchar **params = g_strsplit((query) ? query : "", "&", 0);
+    int ok = 1;
+
+    for (int i = 0; ok && params[i]; ++i) {
+        char *value = strchr(params[i], '=');
+        if (!value) {
+            continue;
+        }
+        *value++ = '\0';
+        if (strcmp(params[i], "after") == 0) {
+            ok = g_ascii_string_to_signed(value, 10, G_MININT64,
+                    G_MAXINT64, after, NULL);
+            *has_after = 1;
+        } else if (strcmp(params[i], "limit") == 0) {
+            ok = g_ascii_string_to_signed(value, 10, 1, SERVE_PAGE_MAX,
+                    limit, NULL);
+        }
+    }
+    g_strfreev(params);
+
+    return ok;
+}
+
+
+/**
+ * @brief Answer @c /tables/NAME/rows
+ *
+ * @param db    Connection, in the read transaction
+ * @param table Table
+ * @param query Query string (may be @c NULL)
+ * @param out   Client connection
+ * @param etag  Entity tag
+ * @param inm   @c If-None-Match header (may be @c NULL)
+ */
+static void s_rows(sqlite3 *db, const char *table, const char *query,
+        GOutputStream *out, const char *etag, const char *inm)
+{
+    gint64 after = 0, limit = SERVE_PAGE_DEFAULT;
+    int has_after = 0, view = 0;
+    sqlite3_stmt *stmt = NULL;
+    s_response_td r;
+    char msg[128];
+
+    if (!s_parse_paging(query, &after, &has_after, &limit)) {
+        snprintf(msg, sizeof(msg), "Expected after=ROWID and limit=1..%d",
+                SERVE_PAGE_MAX);
+        s_send_error(out, 400, msg);
+        return;
+    }
+    int rc = s_find_table(db, table, NULL, &view);
+    if (rc == SQLITE_NOTFOUND) {
+        s_send_error(out, 404, "No such table");
+        return;
+    } else if (view) {
+        s_send_error(out, 400, "Views have no rowid to page by");
+        return;
+    }
+
+    /* Keyset paging: the rowid index goes straight to the page */
+    char *sql = sqlite3_mprintf("SELECT rowid AS rowid, * FROM \"%w\" %s "
+            "ORDER BY rowid LIMIT ?2;", table,
+            (has_after) ? "WHERE rowid > ?1" : "");
+    rc = (rc != SQLITE_OK) ? rc : (sql)
+        ? sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        s_send_error(out, 400, sqlite3_errmsg(db));  /* e.g. no rowid */
+        return;
+    }
+    if (s_not_modified(out, etag, inm)) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+    sqlite3_bind_int64(stmt, 1, after);
+    sqlite3_bind_int64(stmt, 2, limit);
+
+    s_begin(&r, out, etag);
+    int ncols = sqlite3_column_count(stmt);
+    g_string_append(r.buf, "{\"columns\": [");
+    for (int i = 0; i < ncols; ++i) {
+        if (i > 0) {
+            g_string_append(r.buf, ", ");
+        }
+        s_json_string(r.buf, sqlite3_column_name(stmt, i), -1);
+    }
+    g_string_append(r.buf, "],\n \"rows\": [");
+
+    gint64 n = 0, last = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        g_string_append(r.buf, (n++ > 0) ? ",\n  [" : "\n  [");
+        for (int i = 0; i < ncols; ++i) {
+            if (i > 0) {
+                g_string_append(r.buf, ", ");
+            }
+            s_json_value(r.buf, stmt, i);
+        }
+        g_string_append_c(r.buf, ']');
+        last = sqlite3_column_int64(stmt, 0);
+        if (r.buf->len >= SERVE_CHUNK && s_flush(&r, 0)) {
+            break;
+        }
+    }
+
+    /* The status is sent already: errors end the body instead */
+    g_string_append(r.buf, "\n],\n ");
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        g_string_append(r.buf, "\"error\": ");
+        s_json_string(r.buf, sqlite3_errmsg(db), -1);
+    } else if (n == limit) {
+        g_string_append_printf(r.buf, "\"next\": %lld", (long long) last);
+    } else {
+        g_string_append(r.buf, "\"next\": null");
+    }
+    g_string_append(r.buf, "}\n");
+    s_flush(&r, 1);
+    sqlite3_finalize(stmt);
+}
+
+
+/**
+ * @brief Answer a @c GET request on a connection of the pool
+ *
+ * @param srv    Server
+ * @param target Request target (path and query string)
+ * @param inm    @c If-None-Match header (may be @c NULL)
+ * @param out    Client connection
+ */
+static void s_handle_get(s_server_td *srv, const char *target,
+        const char *inm, GOutputStream *out)
+{
+    char *path = g_strdup(target);
+    char *query = strchr(path, '?');
+    if (query) {
+        *query++ = '\0';
+    }
+
+    /* Split before unescaping: names may hold "%2F" */
+    gchar **parts = g_strsplit((path[0] == '/') ? path + 1 : "", "/", 0);
+    guint n = g_strv_length(parts);
+    int valid = (path[0] == '/');
+    for (guint i = 0; i < n && valid; ++i) {
+        char *part = g_uri_unescape_string(parts[i], NULL);
+        valid = (part != NULL);
+        if (part) {
+            g_free(parts[i]);
+            parts[i] = part;
+        }
+    }
+    int route = (!valid || n < 1 || strcmp(parts[0], "tables") != 0) ? 0
+        : (n == 1) ? 1
+        : (n == 3 && strcmp(parts[2], "schema") == 0) ? 2
+        : (n == 3 && strcmp(parts[2], "rows") == 0) ? 3 : 0;
+
+    if (route == 0) {
+        s_send_error(out, (valid) ? 404 : 400, (valid) ? "Not found"
+                : "Malformed path");
+    } else {
+        s_conn_td *c = g_async_queue_pop(srv->pool);
+        char etag[96];
+        if (s_snapshot(srv, c, etag, sizeof(etag)) != SQLITE_OK) {
+            s_send_error(out, 500, sqlite3_errmsg(c->db));
+        } else if (route == 1) {
+            s_list_tables(c->db, out, etag, inm);
+        } else if (route == 2) {
+            s_schema(c->db, parts[1], out, etag, inm);
+        } else {
+            s_rows(c->db, parts[1], query, out, etag, inm);
+        }
+        sqlite3_exec(c->db, "COMMIT;", NULL, NULL, NULL);
+        g_async_queue_push(srv->pool, c);
+    }
+    g_strfreev(parts);
+    g_free(path);
+}
+
+
+/**
+ * @brief Read a line of a request, of at most @e SERVE_MAX_LINE bytes
+ *
+ * @param in       Client connection
+ * @param too_long Where to flag a line longer than @e SERVE_MAX_LINE
+ *
+ * @return Line without its end (free with @a g_free()), or @c NULL at
+ *         the end of the stream, on error or if it is too long
+ */
+static char *s_read_line(GDataInputStream *in, int *too_long)
+{
+    GString *g = g_string_new(NULL);
+    GError *error = NULL;
+
+    *too_long = 0;
+    for (;;) {
+        guchar c = g_data_input_stream_read_byte(in, NULL, &error);
+        if (error) {
+            g_error_free(error);
+            g_string_free(g, TRUE);
+            return NULL;
+        }
+        if (c == '\n') {
+            break;
+        }
+        /* Stop reading a client that never ends the line */
+        if (g->len == SERVE_MAX_LINE) {
+            *too_long = 1;
+            g_string_free(g, TRUE);
+            return NULL;
+        }
+        g_string_append_c(g, (char) c);
+    }
+    if (g->len > 0 && g->str[g->len - 1] == '\r') {
+        g_string_truncate(g, g->len - 1);
+    }
+
+    return g_string_free(g, FALSE);
+}
+
+
+/**
+ * @brief Read one request of a client and answer it (request thread)
+ *
+ * @param data     Client connection (@e GSocketConnection *, released)
+ * @param userdata Server (@e s_server_td *)
+ */
+static void s_serve_client(gpointer data, gpointer userdata)
+{
+    GSocketConnection *conn = data;
+    s_server_td *srv = userdata;
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(conn));
+    GDataInputStream *in = g_data_input_stream_new(
+            g_io_stream_get_input_stream(G_IO_STREAM(conn)));
+    char *inm = NULL;
+    int uri_too_long = 0;
+    int header_too_long = 0;
+
+    g_socket_set_timeout(g_socket_connection_get_socket(conn),
+            SERVE_TIMEOUT);
+    char *line = s_read_line(in, &uri_too_long);
+    for (int i = 0; line && i < SERVE_MAX_HEADERS; ++i) {
+        char *header = s_read_line(in, &header_too_long);
+        if (!header || header[0] == '\0') {
+            g_free(header);
+            break;
+        }
+        if (g_ascii_strncasecmp(header, "If-None-Match:", 14) == 0) {
+            g_free(inm);
+            inm = g_strstrip(g_strdup(header + 14));
+        }
+        g_free(header);
+    }
+
+    gchar **request = g_strsplit((line) ? line : "", " ", 3);
+    if (uri_too_long) {
+        s_send_error(out, 414, "Request line too long");
+    } else if (header_too_long) {
+        s_send_error(out, 431, "Header line too long");
+    } else if (g_strv_length(request) != 3) {
+        s_send_error(out, 400, "Malformed request");
+    } else if (strcmp(request[0], "GET") != 0) {
+        s_send_error(out, 405, "Only GET is allowed");
+    } else {
+        s_handle_get(srv, request[1], inm, out);
+    }
+    g_strfreev(request);
+    g_free(line);
+    g_free(inm);
+    g_io_stream_close(G_IO_STREAM(conn), NULL, NULL);
+    g_object_unref(in);
+    g_object_unref(conn);
+}
+
+
+/**
+ * @brief Handler for the "incoming" signal of the service (main loop):
+ *        queue the client for a request thread
+ *
+ * Clients beyond @e SERVE_MAX_THREADS wait in the queue of the thread
+ * pool, so the listener never stops accepting.
+ *
+ * @param svc      Service (unused)
+ * @param conn     Client connection
+ * @param source   Listener source object (unused)
+ * @param userdata Request threads (@e GThreadPool *)
+ *
+ * @return @c TRUE (the client is handled)
+ */
+static gboolean s_on_incoming(GSocketService *svc, GSocketConnection *conn,
+        GObject *source, gpointer userdata)
+{
+    (void) svc;
+    (void) source;
+
+    g_thread_pool_push(userdata, g_object_ref(conn), NULL);
+
+    return TRUE;
+}
+
+
+/**
+ * @brief Handler for @c SIGINT and @c SIGTERM: stop serving
+ *
+ * @param userdata Main loop (@e GMainLoop *)
+ *
+ * @return @e G_SOURCE_CONTINUE (removed when serving stops)
+ */
+static gboolean s_on_signal(gpointer userdata)
+{
+    g_main_loop_quit(userdata);
+
+    return G_SOURCE_CONTINUE;
+}
+
+
+/**
+ * @brief Fill the pool of read-only connections
+ *
+ * @param srv      Server
+ * @param filename Database file
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_open_pool(s_server_td *srv, const char *filename)
+{
+    int rc = SQLITE_OK;
+
+    for (int i = 0; i < SERVE_POOL_SIZE && rc == SQLITE_OK; ++i) {
+        s_conn_td *c = g_new0(s_conn_td, 1);
+        rc = db_open_reader(filename, &c->db);
+        if (rc == SQLITE_OK) {
+            /* Fails here, not on the first request, if not a database */
+            rc = sqlite3_exec(c->db, "SELECT 1 FROM sqlite_master LIMIT 1;",
+                    NULL, NULL, NULL);
+        }
+        if (rc == SQLITE_OK) {
+            g_async_queue_push(srv->pool, c);
+        } else {
+            sqlite3_close(c->db);
+            g_free(c);
+        }
+    }
+
+    return rc;
+}
+
+
+/* Answer HTTP requests on a database until interrupted */
+int serve_run(const char *filename, guint16 port)
+{
+    if (!filename) {
+        return SQLITE_MISUSE;
+    }
+
+    s_server_td srv;
+    memset(&srv, 0, sizeof(srv));
+    srv.pool = g_async_queue_new();
+    srv.filename = filename;
+
+    int rc = s_open_pool(&srv, filename);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Cannot open '%s': %s\n", filename,
+                sqlite3_errstr(rc));
+    }
+
+    GSocketService *svc = g_socket_service_new();
+    GInetAddress *lo = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    GSocketAddress *addr = g_inet_socket_address_new(lo, port);
+    GSocketAddress *bound = NULL;
+    GError *err = NULL;
+    if (rc == SQLITE_OK && !g_socket_listener_add_address(
+                G_SOCKET_LISTENER(svc), addr, G_SOCKET_TYPE_STREAM,
+                G_SOCKET_PROTOCOL_TCP, NULL, &bound, &err)) {
+        fprintf(stderr, "Cannot listen on port %u: %s\n", port,
+                err->message);
+        g_error_free(err);
+        rc = SQLITE_CANTOPEN;
+    }
+
+    if (rc == SQLITE_OK) {
+        GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+        guint sigint = g_unix_signal_add(SIGINT, s_on_signal, loop);
+        guint sigterm = g_unix_signal_add(SIGTERM, s_on_signal, loop);
+        GThreadPool *threads = g_thread_pool_new(s_serve_client, &srv,
+                SERVE_MAX_THREADS, FALSE, NULL);
+        g_signal_connect(svc, "incoming", G_CALLBACK(s_on_incoming),
+                threads);
+        g_socket_service_start(svc);
+        printf("Serving '%s' on http://127.0.0.1:%u/\n", filename,
+                g_inet_socket_address_get_port(
+                    G_INET_SOCKET_ADDRESS(bound)));
+        fflush(stdout);
+
+        g_main_loop_run(loop);
+        g_socket_service_stop(svc);
+        g_socket_listener_close(G_SOCKET_LISTENER(svc));
+        g_source_remove(sigint);
+        g_source_remove(sigterm);
+        g_main_loop_unref(loop);
+        g_thread_pool_free(threads, FALSE, TRUE);   /* Let them finish */
+    }
+
+    s_conn_td *c;
+    while ((c = g_async_queue_try_pop(srv.pool)) != NULL) {
+        sqlite3_close(c->db);
+        g_free(c);
+    }
+    g_async_queue_unref(srv.pool);
+    if (bound) {
+        g_object_unref(bound);
+    }
+    g_object_unref(addr);
+    g_object_unref(lo);
+    g_object_unref(svc);
+
+    return rc;
+}
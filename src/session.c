@@ -0,0 +1,359 @@
+/**
+ * @file session.c
+ *
+ * @brief Implementation of session recording and replay
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* System includes */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project includes */
+#include <context.h>
+#include <db.h>
+
+/* Local includes */
+#include <session.h>
+
+
+/**
+ * @struct session_td
+ *
+ * @brief Session recorder
+ */
+struct session_td {
+    FILE *fp;       /**< Session file */
+    gint64 start;   /**< Monotonic time the recording started */
+};
+
+/**
+ * @struct s_stat_td
+ *
+ * @brief Replay timings of one operation
+ */
+typedef struct {
+    const char *op;     /**< Operation name */
+    int count;          /**< Events replayed */
+    int failed;         /**< Events that returned an error */
+    gint64 total;       /**< Total time (us) */
+    gint64 max;         /**< Slowest event (us) */
+} s_stat_td;
+
+/**
+ * @struct s_replay_td
+ *
+ * @brief State of a replay
+ */
+typedef struct {
+    context_td s;       /**< Context driven like the application's */
+    char *copy;         /**< Temporary copy of the open database */
+} s_replay_td;
+
+
+/* Start recording a session to a file */
+session_td *session_record(const char *path)
+{
+    FILE *fp = (path) ? fopen(path, "w") : NULL;
+    if (!fp) {
+        return NULL;
+    }
+
+    /* Line buffered: a crash loses at most the event being written */
+    setvbuf(fp, NULL, _IOLBF, 0);
+    session_td *ss = g_new0(session_td, 1);
+    ss->fp = fp;
+    ss->start = g_get_monotonic_time();
+
+    return ss;
+}
+
+
+/* Stop recording and close the session file */
+void session_close(session_td *ss)
+{
+    if (!ss) {
+        return;
+    }
+
+    fclose(ss->fp);
+    g_free(ss);
+}
+
+
+/* Append an event to the session file */
+void session_log(session_td *ss, const char *op, ...)
+{
+    if (!ss || !op) {
+        return;
+    }
+
+    va_list ap;
+    fprintf(ss->fp, "%lld\t%s",
+            (long long) ((g_get_monotonic_time() - ss->start) / 1000), op);
+    va_start(ap, op);
+    for (const char *arg = va_arg(ap, const char*); arg;
+            arg = va_arg(ap, const char*)) {
+        char *escaped = g_strescape(arg, NULL);
+        fprintf(ss->fp, "\t%s", escaped);
+        g_free(escaped);
+    }
+    va_end(ap);
+    fputc('\n', ss->fp);
+}
+
+
+/**
+ * @brief Drop the temporary copy of the database being replayed
+ *
+ * @param r Replay state
+ */
+static void s_drop_copy(s_replay_td *r)
+{
+    db_free_columns(&r->s);
+    db_close(&r->s);
+    if (r->copy) {
+        remove(r->copy);
+        g_free(r->copy);
+        r->copy = NULL;
+    }
+}
+
+
+/**
+ * @brief Replay an @c open event: copy the database and open the copy
+ *
+ * The copy is made before the clock starts, so only opening and
+ * listing the tables is timed.
+ *
+ * @param r    Replay state
+ * @param path Database recorded in the session
+ * @param t0   Where to store the start time of the timed part
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_replay_open(s_replay_td *r, const char *path, gint64 *t0)
+{
+    s_drop_copy(r);
+
+    int rc = db_copy_to_temp(path, &r->copy);
+
+    *t0 = g_get_monotonic_time();
+    if (rc == SQLITE_OK) {
+        rc = db_open(&r->s, r->copy);
+    }
+    if (rc == SQLITE_OK) {
+        rc = db_fill_table_list(&r->s);
+    }
+
+    return rc;
+}
+
+
+/**
+ * @brief Replay a @c delete event
+ *
+ * @param r      Replay state
+ * @param rowids Space separated rowids
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_replay_delete(s_replay_td *r, const char *rowids)
+{
+    char **parts = g_strsplit(rowids, " ", -1);
+    int n = (int) g_strv_length(parts);
+    sqlite3_int64 *ids = g_new(sqlite3_int64, MAX(n, 1));
+
+    for (int i = 0; i < n; ++i) {
+        ids[i] = g_ascii_strtoll(parts[i], NULL, 10);
+    }
+    int rc = db_delete_rows(&r->s, ids, n);
+    g_free(ids);
+    g_strfreev(parts);
+
+    return rc;
+}
+
+
+/**
+ * @brief Replay a @c fetch event
+ *
+ * @param r     Replay state
+ * @param rowid Row of the record
+ * @param first First column fetched
+ * @param n     Number of columns fetched
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_replay_fetch(s_replay_td *r, const char *rowid,
+        const char *first, const char *n)
+{
+    int count = atoi(n);
+    char **values = g_new0(char*, MAX(count, 1));
+    int rc = db_fetch_record(&r->s, g_ascii_strtoll(rowid, NULL, 10),
+            atoi(first), count, DB_RECORD_MAX_VALUE, values);
+
+    for (int i = 0; i < count; ++i) {
+        free(values[i]);
+    }
+    g_free(values);
+
+    return rc;
+}
+
+
+/**
+ * @brief Replay a @c filter or @c seek event: set the condition or the
+ *        seek of the rows shown next
+ *
+ * @param r    Replay state
+ * @param op   @c filter or @c seek
+ * @param args Condition, or column and first value (empty for none)
+ *
+ * @return @e SQLITE_OK
+ */
+static int s_replay_view(s_replay_td *r, const char *op, char **args)
+{
+    if (strcmp(op, "filter") == 0) {
+        sqlite3_free(r->s.row_filter);
+        r->s.row_filter = (*args[0]) ? sqlite3_mprintf("%s", args[0])
+            : NULL;
+    } else {
+        sqlite3_free(r->s.seek_column);
+        sqlite3_free(r->s.seek_from);
+        r->s.seek_column = (*args[0]) ? sqlite3_mprintf("%s", args[0])
+            : NULL;
+        r->s.seek_from = (*args[0]) ? sqlite3_mprintf("%s", args[1])
+            : NULL;
+    }
+
+    return SQLITE_OK;
+}
+
+
+/**
+ * @brief Replay one event
+ *
+ * @param r     Replay state
+ * @param op    Operation name
+ * @param args  Unescaped arguments
+ * @param nargs Number of entries in @e args
+ * @param t0    Where to store the start time of the timed part
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_MISUSE for malformed or
+ *         unknown events, or an SQLite error code on failure
+ */
+static int s_replay_event(s_replay_td *r, const char *op, char **args,
+        int nargs, gint64 *t0)
+{
+    *t0 = g_get_monotonic_time();
+
+    if (strcmp(op, "open") == 0 && nargs == 1) {
+        return s_replay_open(r, args[0], t0);
+    } else if (strcmp(op, "table") == 0 && nargs == 1) {
+        return db_populate_rows(&r->s, args[0]);
+    } else if (strcmp(op, "scroll") == 0) {
+        return SQLITE_OK;   /* The rows are already in the model */
+    } else if (strcmp(op, "edit") == 0 && nargs == 3) {
+        return db_apply_update_cell(&r->s, atoi(args[0]), args[1],
+                args[2]);
+    } else if (strcmp(op, "insert") == 0) {
+        GtkTreeIter iter;
+        return db_insert_row(&r->s, &iter);
+    } else if (strcmp(op, "delete") == 0 && nargs == 1) {
+        return s_replay_delete(r, args[0]);
+    } else if (strcmp(op, "fetch") == 0 && nargs == 3) {
+        return s_replay_fetch(r, args[0], args[1], args[2]);
+    } else if ((strcmp(op, "filter") == 0 && nargs == 1)
+            || (strcmp(op, "seek") == 0 && nargs == 2)) {
+        return s_replay_view(r, op, args);
+    }
+
+    return SQLITE_MISUSE;
+}
+
+
+/* Replay the database operations of a session file with timing */
+int session_replay(const char *path, FILE *out)
+{
+    FILE *fp = (path) ? fopen(path, "r") : NULL;
+    if (!fp || !out) {
+        if (fp) fclose(fp);
+        return SQLITE_CANTOPEN;
+    }
+
+    s_stat_td stats[] = {
+        { "open", 0, 0, 0, 0 }, { "table", 0, 0, 0, 0 },
+        { "scroll", 0, 0, 0, 0 }, { "edit", 0, 0, 0, 0 },
+        { "insert", 0, 0, 0, 0 }, { "delete", 0, 0, 0, 0 },
+        { "fetch", 0, 0, 0, 0 }, { "filter", 0, 0, 0, 0 },
+        { "seek", 0, 0, 0, 0 },
+    };
+    size_t nstats = sizeof(stats) / sizeof(stats[0]);
+    s_replay_td r;
+    memset(&r, 0, sizeof(r));
+    r.s.tables_store = gtk_list_store_new(1, G_TYPE_STRING);
+    r.s.rows_view = g_object_ref_sink(gtk_tree_view_new());
+
+    int first_rc = SQLITE_OK;
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, fp) > 0) {
+        line[strcspn(line, "\r\n")] = '\0';  /* Keep empty arguments */
+        char **fields = g_strsplit(line, "\t", -1);
+        int nfields = (int) g_strv_length(fields);
+        if (nfields < 2) {
+            g_strfreev(fields);
+            continue;
+        }
+        for (int i = 2; i < nfields; ++i) {
+            char *arg = g_strcompress(fields[i]);
+            g_free(fields[i]);
+            fields[i] = arg;
+        }
+
+        gint64 t0 = 0;
+        int rc = s_replay_event(&r, fields[1], fields + 2, nfields - 2,
+                &t0);
+        gint64 dt = g_get_monotonic_time() - t0;
+        for (size_t i = 0; i < nstats; ++i) {
+            if (strcmp(stats[i].op, fields[1]) == 0) {
+                stats[i].count++;
+                stats[i].failed += (rc != SQLITE_OK);
+                stats[i].total += dt;
+                stats[i].max = MAX(stats[i].max, dt);
+            }
+        }
+        fprintf(out, "%10s ms  %-7s %10.3f ms%s%s\n", fields[0],
+                fields[1], (double) dt / 1000.0,
+                (rc == SQLITE_OK) ? "" : "  ",
+                (rc == SQLITE_OK) ? "" : sqlite3_errstr(rc));
+        if (first_rc == SQLITE_OK) {
+            first_rc = rc;
+        }
+        g_strfreev(fields);
+    }
+    free(line);
+    fclose(fp);
+
+    fprintf(out, "\n%-7s %6s %6s %12s %12s %12s\n", "op", "count",
+            "failed", "total ms", "mean ms", "max ms");
+    for (size_t i = 0; i < nstats; ++i) {
+        if (stats[i].count > 0) {
+            fprintf(out, "%-7s %6d %6d %12.3f %12.3f %12.3f\n",
+                    stats[i].op, stats[i].count, stats[i].failed,
+                    (double) stats[i].total / 1000.0,
+                    (double) stats[i].total / 1000.0 / stats[i].count,
+                    (double) stats[i].max / 1000.0);
+        }
+    }
+
+    s_drop_copy(&r);
+    g_object_unref(r.s.rows_view);
+    g_object_unref(r.s.tables_store);
+
+    return first_rc;
+}
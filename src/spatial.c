@@ -0,0 +1,726 @@
+/**
+ * @file spatial.c
+ *
+ * @brief Implementation of the browsing of spatial tables by window
+ */
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+
+/* External includes */
+#include <glib.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <spatial.h>
+
+
+#define SPATIAL_REPORT_ROWS (65536)     /**< Rows indexed between reports */
+
+
+/**
+ * @brief Names of coordinate columns, X first
+ */
+static const char *s_coordinates[][2] = {
+    { "x", "y" }, { "lon", "lat" }, { "lng", "lat" },
+    { "longitude", "latitude" }
+};
+
+
+/**
+ * @struct spatial_td
+ *
+ * @brief Window over a spatial source
+ */
+struct spatial_td {
+    sqlite3 *db;            /**< Connection */
+    spatial_source_td src;  /**< Source (copy) */
+    sqlite3_stmt *query;    /**< Window query on the R*Tree */
+    sqlite3_stmt *version;  /**< @c PRAGMA @c data_version */
+    sqlite3_int64 changes[2];   /**< Data version and total changes when
+                                     the items were read */
+    GArray *items;          /**< Items of the window (@e spatial_item_td) */
+    spatial_box_td win;     /**< Current window */
+    int has_win;            /**< Whether @e items matches @e win */
+    int complete;           /**< Whether @e items holds every item */
+    int nqueries;           /**< Queries of the last move */
+    sqlite3_int64 nread;    /**< Items read by the last move */
+};
+
+
+/**
+ * @brief Count the dimensions declared by an R*Tree
+ *
+ * @param sql @c CREATE @c VIRTUAL @c TABLE statement (lowercase)
+ *
+ * @return Number of dimensions (0 if not an R*Tree)
+ */
+static int s_rtree_dims(const char *sql)
+{
+    const char *p = strstr(sql, "using rtree");
+    int ncols = 0;
+
+    p = (p) ? strchr(p, '(') : NULL;
+    while (p && *p && *p != ')') {
+        p++;
+        while (g_ascii_isspace(*p)) {
+            p++;
+        }
+        if (*p && *p != '+' && *p != ')') {
+            ncols++;    /* Auxiliary columns start with '+' */
+        }
+        while (*p && *p != ',' && *p != ')') {
+            p++;
+        }
+    }
+
+    return (ncols - 1) / 2;
+}
+
+
+/**
+ * @brief Describe an R*Tree of at least two dimensions as a source
+ *
+ * @param db   Connection
+ * @param name R*Tree table
+ * @param src  Where to store the R*Tree, its columns and dimensions
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_NOTFOUND if @e name is not
+ *         such an R*Tree, or an SQLite error code
+ */
+static int s_describe_rtree(sqlite3 *db, const char *name,
+        spatial_source_td *src)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, "SELECT lower(sql) FROM sqlite_master "
+            "WHERE type = 'table' AND name = ?1;", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    const char *sql = (rc == SQLITE_ROW)
+        ? (const char*) sqlite3_column_text(stmt, 0) : NULL;
+    int ndims = (sql) ? s_rtree_dims(sql) : 0;
+    int integer = sql && strstr(sql, "using rtree_i32") != NULL;
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        return rc;
+    }
+    if (ndims < 2) {
+        return SQLITE_NOTFOUND;
+    }
+
+    /* Column 0 is the id, then minimum and maximum of each dimension */
+    rc = sqlite3_prepare_v2(db, "SELECT name FROM pragma_table_info(?1) "
+            "WHERE cid BETWEEN 1 AND 4 ORDER BY cid;", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    int n = 0;
+    while (n < 4 && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        src->cols[n++] = g_strdup((const char*) sqlite3_column_text(stmt,
+                    0));
+    }
+    sqlite3_finalize(stmt);
+    if (n < 4) {
+        return SQLITE_NOTFOUND;
+    }
+    src->rtree = g_strdup(name);
+    src->ndims = ndims;
+    src->integer = integer;
+
+    return SQLITE_OK;
+}
+
+
+/**
+ * @brief Find the coordinate columns of a table
+ *
+ * @param db    Connection
+ * @param table Table
+ * @param src   Where to store the X and Y columns
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_NOTFOUND if there are
+ *         none, or an SQLite error code
+ */
+static int s_find_coordinates(sqlite3 *db, const char *table,
+        spatial_source_td *src)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, "SELECT name FROM pragma_table_info(?1);",
+            -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        g_ptr_array_add(names,
+                g_strdup((const char*) sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_finalize(stmt);
+
+    for (size_t p = 0; p < G_N_ELEMENTS(s_coordinates) && !src->ycol;
+            ++p) {
+        const char *x = NULL, *y = NULL;
+        for (guint i = 0; i < names->len; ++i) {
+            const char *name = g_ptr_array_index(names, i);
+            if (name && g_ascii_strcasecmp(name, s_coordinates[p][0]) == 0) {
+                x = name;
+            } else if (name
+                    && g_ascii_strcasecmp(name, s_coordinates[p][1]) == 0) {
+                y = name;
+            }
+        }
+        if (x && y) {
+            src->xcol = g_strdup(x);
+            src->ycol = g_strdup(y);
+        }
+    }
+    g_ptr_array_free(names, TRUE);
+
+    if (rc != SQLITE_DONE) {
+        return rc;
+    }
+
+    return (src->xcol) ? SQLITE_OK : SQLITE_NOTFOUND;
+}
+
+
+/* Find how a table can be browsed spatially */
+int spatial_find_source(sqlite3 *db, const char *table,
+        spatial_source_td *src)
+{
+    if (!db || !table || !src) {
+        return SQLITE_MISUSE;
+    }
+
+    memset(src, 0, sizeof(*src));
+    src->table = g_strdup(table);
+    int rc = s_describe_rtree(db, table, src);
+    if (rc == SQLITE_NOTFOUND) {
+        rc = s_find_coordinates(db, table, src);
+        if (rc == SQLITE_OK) {
+            /* Built by `spatial_build_index()`; may not exist yet */
+            char *rtree = g_strdup_printf("%s_rtree", table);
+            int rc2 = s_describe_rtree(db, rtree, src);
+            rc = (rc2 == SQLITE_NOTFOUND) ? SQLITE_OK : rc2;
+            g_free(rtree);
+        }
+    }
+    if (rc != SQLITE_OK) {
+        spatial_source_clear(src);
+    }
+
+    return rc;
+}
+
+
+/* Release the strings of a spatial source */
+void spatial_source_clear(spatial_source_td *src)
+{
+    if (!src) {
+        return;
+    }
+
+    g_free(src->table);
+    g_free(src->rtree);
+    for (int i = 0; i < 4; ++i) {
+        g_free(src->cols[i]);
+    }
+    g_free(src->xcol);
+    g_free(src->ycol);
+    memset(src, 0, sizeof(*src));
+}
+
+
+/**
+ * @brief Create the triggers keeping the R*Tree of a table up to date
+ *
+ * @param db    Read-write connection
+ * @param src   Source with coordinate columns
+ * @param rtree R*Tree of the table
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_create_triggers(sqlite3 *db, const spatial_source_td *src,
+        const char *rtree)
+{
+    const char *t = src->table;
+    const char *x = src->xcol;
+    const char *y = src->ycol;
+    sqlite3_str *str = sqlite3_str_new(db);
+
+    /* Rows without numeric coordinates are not indexed */
+    sqlite3_str_appendf(str, "CREATE TRIGGER \"%w_ins\" AFTER INSERT "
+            "ON \"%w\" WHEN typeof(new.\"%w\") IN ('integer', 'real') "
+            "AND typeof(new.\"%w\") IN ('integer', 'real') BEGIN "
+            "INSERT INTO \"%w\" VALUES (new.rowid, new.\"%w\", "
+            "new.\"%w\", new.\"%w\", new.\"%w\"); END;",
+            rtree, t, x, y, rtree, x, x, y, y);
+    sqlite3_str_appendf(str, "CREATE TRIGGER \"%w_upd\" AFTER UPDATE "
+            "OF \"%w\", \"%w\" ON \"%w\" BEGIN "
+            "DELETE FROM \"%w\" WHERE id = old.rowid; "
+            "INSERT INTO \"%w\" SELECT new.rowid, new.\"%w\", new.\"%w\", "
+            "new.\"%w\", new.\"%w\" "
+            "WHERE typeof(new.\"%w\") IN ('integer', 'real') "
+            "AND typeof(new.\"%w\") IN ('integer', 'real'); END;",
+            rtree, x, y, t, rtree, rtree, x, x, y, y, x, y);
+    sqlite3_str_appendf(str, "CREATE TRIGGER \"%w_del\" AFTER DELETE "
+            "ON \"%w\" BEGIN DELETE FROM \"%w\" WHERE id = old.rowid; "
+            "END;", rtree, t, rtree);
+    char *sql = sqlite3_str_finish(str);
+    int rc = (sql) ? sqlite3_exec(db, sql, NULL, NULL, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+
+    return rc;
+}
+
+
+/**
+ * @brief Fill the R*Tree of a table from its rows
+ *
+ * @param job   Job for progress and cancellation (may be @c NULL)
+ * @param db    Read-write connection, in a transaction
+ * @param src   Source with coordinate columns
+ * @param rtree R*Tree of the table
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_INTERRUPT if cancelled, or
+ *         an SQLite error code
+ */
+static int s_fill_rtree(job_td *job, sqlite3 *db,
+        const spatial_source_td *src, const char *rtree)
+{
+    sqlite3_stmt *rows = NULL;
+    sqlite3_stmt *insert = NULL;
+    sqlite3_int64 maxrowid = 0;
+
+    char *sql = sqlite3_mprintf("SELECT max(rowid) FROM \"%w\";",
+            src->table);
+    int rc = (sql) ? sqlite3_prepare_v2(db, sql, -1, &rows, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc == SQLITE_OK && sqlite3_step(rows) == SQLITE_ROW) {
+        maxrowid = sqlite3_column_int64(rows, 0);
+    }
+    sqlite3_finalize(rows);
+    rows = NULL;
+
+    if (rc == SQLITE_OK) {
+        sql = sqlite3_mprintf("SELECT rowid, \"%w\", \"%w\" FROM \"%w\" "
+                "WHERE typeof(\"%w\") IN ('integer', 'real') "
+                "AND typeof(\"%w\") IN ('integer', 'real');", src->xcol,
+                src->ycol, src->table, src->xcol, src->ycol);
+        rc = (sql) ? sqlite3_prepare_v2(db, sql, -1, &rows, NULL)
+            : SQLITE_NOMEM;
+        sqlite3_free(sql);
+    }
+    if (rc == SQLITE_OK) {
+        sql = sqlite3_mprintf("INSERT INTO \"%w\" VALUES (?1, ?2, ?2, ?3, "
+                "?3);", rtree);
+        rc = (sql) ? sqlite3_prepare_v2(db, sql, -1, &insert, NULL)
+            : SQLITE_NOMEM;
+        sqlite3_free(sql);
+    }
+
+    sqlite3_int64 n = 0;
+    while (rc == SQLITE_OK && (rc = sqlite3_step(rows)) == SQLITE_ROW) {
+        sqlite3_bind_int64(insert, 1, sqlite3_column_int64(rows, 0));
+        sqlite3_bind_double(insert, 2, sqlite3_column_double(rows, 1));
+        sqlite3_bind_double(insert, 3, sqlite3_column_double(rows, 2));
+        rc = sqlite3_step(insert);
+        rc = (rc == SQLITE_DONE) ? sqlite3_reset(insert) : rc;
+        if (rc == SQLITE_OK && ++n % SPATIAL_REPORT_ROWS == 0) {
+            if (job_is_cancelled(job)) {
+                rc = SQLITE_INTERRUPT;
+            }
+            job_report(job, (maxrowid > 0) ? (double)
+                    sqlite3_column_int64(rows, 0) / (double) maxrowid : 0.0,
+                    "%lld rows indexed", (long long) n);
+        }
+    }
+    sqlite3_finalize(insert);
+    sqlite3_finalize(rows);
+
+    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+
+
+/* Create the R*Tree index of a table with coordinate columns */
+int spatial_build_index(job_td *job, const char *filename,
+        const spatial_source_td *src)
+{
+    if (!filename || !src || !src->table || !src->xcol || !src->ycol) {
+        return SQLITE_MISUSE;
+    }
+
+    sqlite3 *db = NULL;
+    int rc = db_open_writer(filename, &db);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    char *rtree = g_strdup_printf("%s_rtree", src->table);
+    char *sql = sqlite3_mprintf("BEGIN IMMEDIATE; CREATE VIRTUAL TABLE "
+            "\"%w\" USING rtree(id, minx, maxx, miny, maxy);", rtree);
+    rc = (sql) ? sqlite3_exec(db, sql, NULL, NULL, NULL) : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc == SQLITE_OK) {
+        rc = s_fill_rtree(job, db, src, rtree);
+    }
+    if (rc == SQLITE_OK) {
+        rc = s_create_triggers(db, src, rtree);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+    }
+    if (rc != SQLITE_OK && !sqlite3_get_autocommit(db)) {
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+    }
+    g_free(rtree);
+    sqlite3_close(db);
+
+    return rc;
+}
+
+
+/* Create an (empty) window over a spatial source */
+int spatial_new(sqlite3 *db, const spatial_source_td *src,
+        spatial_td **out)
+{
+    if (!db || !src || !src->rtree || !out) {
+        return SQLITE_MISUSE;
+    }
+
+    *out = NULL;
+    spatial_td *sp = g_new0(spatial_td, 1);
+    sp->db = db;
+    sp->src.table = g_strdup(src->table);
+    sp->src.rtree = g_strdup(src->rtree);
+    for (int i = 0; i < 4; ++i) {
+        sp->src.cols[i] = g_strdup(src->cols[i]);
+    }
+    sp->src.ndims = src->ndims;
+    sp->src.integer = src->integer;
+    sp->src.xcol = g_strdup(src->xcol);
+    sp->src.ycol = g_strdup(src->ycol);
+    sp->items = g_array_new(FALSE, FALSE, sizeof(spatial_item_td));
+
+    /* Run on every move: prepared once, kept by SQLite */
+    char **c = sp->src.cols;
+    char *sql = sqlite3_mprintf("SELECT rowid, \"%w\", \"%w\", \"%w\", "
+            "\"%w\" FROM \"%w\" WHERE \"%w\" >= ?1 AND \"%w\" <= ?2 "
+            "AND \"%w\" >= ?3 AND \"%w\" <= ?4 LIMIT ?5;", c[0], c[1],
+            c[2], c[3], sp->src.rtree, c[1], c[0], c[3], c[2]);
+    int rc = (sql) ? sqlite3_prepare_v3(db, sql, -1,
+            SQLITE_PREPARE_PERSISTENT, &sp->query, NULL) : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v3(db, "PRAGMA data_version;", -1,
+                SQLITE_PREPARE_PERSISTENT, &sp->version, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        spatial_free(sp);
+        return rc;
+    }
+    *out = sp;
+
+    return SQLITE_OK;
+}
+
+
+/* Release a window */
+void spatial_free(spatial_td *sp)
+{
+    if (!sp) {
+        return;
+    }
+
+    sqlite3_finalize(sp->query);
+    sqlite3_finalize(sp->version);
+    g_array_free(sp->items, TRUE);
+    spatial_source_clear(&sp->src);
+    g_free(sp);
+}
+
+
+/**
+ * @brief Read a big-endian coordinate of an R*Tree node
+ *
+ * @param p       Coordinate
+ * @param integer Non-zero for an @c rtree_i32
+ *
+ * @return Coordinate
+ */
+static double s_node_coord(const unsigned char *p, int integer)
+{
+    guint32 bits = ((guint32) p[0] << 24) | ((guint32) p[1] << 16)
+        | ((guint32) p[2] << 8) | (guint32) p[3];
+
+    if (integer) {
+        return (double) (gint32) bits;
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+
+    return (double) f;
+}
+
+
+/* Get the bounding box of every item of the source */
+int spatial_extent(spatial_td *sp, spatial_box_td *out)
+{
+    if (!sp || !out) {
+        return SQLITE_MISUSE;
+    }
+
+    /* Root node: 2-byte depth, 2-byte cell count, then the cells */
+    sqlite3_stmt *stmt = NULL;
+    char *sql = sqlite3_mprintf("SELECT data FROM \"%w_node\" "
+            "WHERE nodeno = 1;", sp->src.rtree);
+    int rc = (sql) ? sqlite3_prepare_v2(sp->db, sql, -1, &stmt, NULL)
+        : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    rc = SQLITE_NOTFOUND;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char *data = sqlite3_column_blob(stmt, 0);
+        int size = sqlite3_column_bytes(stmt, 0);
+        int cell = 8 + 8 * sp->src.ndims;
+        int ncells = (size >= 4) ? (data[2] << 8) | data[3] : 0;
+        for (int i = 0; i < ncells && 4 + (i + 1) * cell <= size; ++i) {
+            const unsigned char *p = data + 4 + i * cell + 8;
+            spatial_box_td b = {
+                s_node_coord(p, sp->src.integer),
+                s_node_coord(p + 4, sp->src.integer),
+                s_node_coord(p + 8, sp->src.integer),
+                s_node_coord(p + 12, sp->src.integer)
+            };
+            if (rc != SQLITE_OK) {
+                *out = b;
+                rc = SQLITE_OK;
+            } else {
+                out->x0 = MIN(out->x0, b.x0);
+                out->x1 = MAX(out->x1, b.x1);
+                out->y0 = MIN(out->y0, b.y0);
+                out->y1 = MAX(out->y1, b.y1);
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    return rc;
+}
+
+
+/**
+ * @brief Check whether two boxes intersect (borders included)
+ *
+ * @param a First box
+ * @param b Second box
+ *
+ * @return Non-zero if they intersect
+ */
+static int s_intersects(const spatial_box_td *a, const spatial_box_td *b)
+{
+    return a->x1 >= b->x0 && a->x0 <= b->x1 && a->y1 >= b->y0
+        && a->y0 <= b->y1;
+}
+
+
+/**
+ * @brief Split the part of a window outside another into strips
+ *
+ * @param win New window
+ * @param old Previous window (intersecting @e win)
+ * @param out Where to store the strips (up to four)
+ *
+ * @return Number of strips
+ */
+static int s_uncovered(const spatial_box_td *win, const spatial_box_td *old,
+        spatial_box_td *out)
+{
+    int n = 0;
+
+    /* Full-height strips left and right, then top and bottom between */
+    if (win->x0 < old->x0) {
+        out[n++] = (spatial_box_td) { win->x0, old->x0, win->y0, win->y1 };
+    }
+    if (win->x1 > old->x1) {
+        out[n++] = (spatial_box_td) { old->x1, win->x1, win->y0, win->y1 };
+    }
+    double x0 = MAX(win->x0, old->x0);
+    double x1 = MIN(win->x1, old->x1);
+    if (win->y0 < old->y0) {
+        out[n++] = (spatial_box_td) { x0, x1, win->y0, old->y0 };
+    }
+    if (win->y1 > old->y1) {
+        out[n++] = (spatial_box_td) { x0, x1, old->y1, win->y1 };
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Add the items of a box to the window
+ *
+ * Items intersecting any of the excluded boxes (already read) are
+ * skipped, so no item is added twice.
+ *
+ * @param sp    Window
+ * @param box   Box to read
+ * @param excl  Boxes already read
+ * @param nexcl Number of boxes in @e excl
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_read_box(spatial_td *sp, const spatial_box_td *box,
+        const spatial_box_td *excl, int nexcl)
+{
+    int room = SPATIAL_MAX_ITEMS - (int) sp->items->len;
+    int nrows = 0;
+    int rc;
+
+    sqlite3_bind_double(sp->query, 1, box->x0);
+    sqlite3_bind_double(sp->query, 2, box->x1);
+    sqlite3_bind_double(sp->query, 3, box->y0);
+    sqlite3_bind_double(sp->query, 4, box->y1);
+    sqlite3_bind_int(sp->query, 5, room + 1);
+    sp->nqueries++;
+
+    while ((rc = sqlite3_step(sp->query)) == SQLITE_ROW) {
+        spatial_item_td item = {
+            sqlite3_column_int64(sp->query, 0), {
+                sqlite3_column_double(sp->query, 1),
+                sqlite3_column_double(sp->query, 2),
+                sqlite3_column_double(sp->query, 3),
+                sqlite3_column_double(sp->query, 4)
+            }
+        };
+        int seen = 0;
+        nrows++;
+        for (int i = 0; i < nexcl && !seen; ++i) {
+            seen = s_intersects(&item.box, &excl[i]);
+        }
+        if (seen) {
+            continue;
+        }
+        if ((int) sp->items->len >= SPATIAL_MAX_ITEMS) {
+            sp->complete = 0;
+            break;
+        }
+        g_array_append_val(sp->items, item);
+    }
+    sp->nread += nrows;
+    if (nrows > room) {
+        sp->complete = 0;   /* The limit may have hidden some */
+    }
+    sqlite3_reset(sp->query);
+
+    return (rc == SQLITE_ROW || rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+
+
+/**
+ * @brief Check whether the database changed since the items were read
+ *
+ * Covers both the changes made by other connections and by this one.
+ *
+ * @param sp Window
+ *
+ * @return Non-zero if it changed (or on error)
+ */
+static int s_changed(spatial_td *sp)
+{
+    sqlite3_int64 changes[2] = { -1, sqlite3_total_changes(sp->db) };
+
+    if (sqlite3_step(sp->version) == SQLITE_ROW) {
+        changes[0] = sqlite3_column_int64(sp->version, 0);
+    }
+    sqlite3_reset(sp->version);
+    int changed = changes[0] < 0 || changes[0] != sp->changes[0]
+        || changes[1] != sp->changes[1];
+    memcpy(sp->changes, changes, sizeof(changes));
+
+    return changed;
+}
+
+
+/* Move the window, reading only what it uncovers */
+int spatial_window(spatial_td *sp, const spatial_box_td *win)
+{
+    if (!sp || !win) {
+        return SQLITE_MISUSE;
+    }
+
+    int rc = SQLITE_OK;
+    sp->nqueries = 0;
+    sp->nread = 0;
+    int changed = s_changed(sp);
+    if (sp->has_win && sp->complete && !changed
+            && s_intersects(win, &sp->win)) {
+        /* Keep the items still in the window */
+        spatial_item_td *items = (spatial_item_td*) sp->items->data;
+        guint kept = 0;
+        for (guint i = 0; i < sp->items->len; ++i) {
+            if (s_intersects(&items[i].box, win)) {
+                items[kept++] = items[i];
+            }
+        }
+        g_array_set_size(sp->items, kept);
+
+        spatial_box_td read[5];
+        spatial_box_td strips[4];
+        int n = s_uncovered(win, &sp->win, strips);
+        read[0] = sp->win;
+        for (int i = 0; i < n && rc == SQLITE_OK; ++i) {
+            rc = s_read_box(sp, &strips[i], read, i + 1);
+            read[i + 1] = strips[i];
+        }
+    } else {
+        g_array_set_size(sp->items, 0);
+        sp->complete = 1;
+        rc = s_read_box(sp, win, NULL, 0);
+    }
+
+    sp->win = *win;
+    sp->has_win = (rc == SQLITE_OK);
+    if (rc != SQLITE_OK) {
+        g_array_set_size(sp->items, 0);
+    }
+
+    return rc;
+}
+
+
+/* Get the items of the window */
+const spatial_item_td *spatial_items(const spatial_td *sp, int *n,
+        int *complete)
+{
+    if (complete) {
+        *complete = sp->complete;
+    }
+    *n = (int) sp->items->len;
+
+    return (const spatial_item_td*) sp->items->data;
+}
+
+
+/* Get the cost of the last move of the window */
+void spatial_last_cost(const spatial_td *sp, int *nqueries,
+        sqlite3_int64 *nread)
+{
+    *nqueries = sp->nqueries;
+    *nread = sp->nread;
+}
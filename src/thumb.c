@@ -0,0 +1,462 @@
+/**
+ * @file thumb.c
+ *
+ * @brief Implementation of the image thumbnail cache and decoding pool
+ */
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <thumb.h>
+
+
+#define THUMB_CHUNK (65536)     /**< Bytes per @a sqlite3_blob_read() */
+#define THUMB_KEY_SIZE (48)     /**< Size of a "column:rowid" key */
+
+
+/**
+ * @struct thumb_cache_td
+ *
+ * @brief Thumbnails of the current table, LRU ordered, plus the state
+ *        of the decoding pool
+ */
+struct thumb_cache_td {
+    GThreadPool *pool;      /**< Decoding worker pool */
+    thumb_ready_fn ready;   /**< Callback run when thumbnails arrive */
+    void *data;             /**< User data for @e ready */
+    gint generation;        /**< Bumped on reset to drop stale decodes */
+    char *filename;         /**< Database file of the current table */
+    char *table;            /**< Current table */
+    char **colnames;        /**< Column names of the rows view */
+    int ncols;              /**< Number of entries in @e colnames */
+    GHashTable *marks;      /**< Keys of cells holding images */
+    GHashTable *entries;    /**< Key to @e s_entry_td */
+    GQueue lru;             /**< Entries, most recently used first */
+    GHashTable *pending;    /**< Keys queued or being decoded */
+    GMutex readers_lock;    /**< Guards the idle readers */
+    char *readers_file;     /**< Database file of the idle readers */
+    GQueue readers;         /**< Idle reader connections (@e sqlite3 *),
+                                 reused by the workers */
+};
+
+/**
+ * @struct s_entry_td
+ *
+ * @brief Cached thumbnail
+ */
+typedef struct {
+    char *key;          /**< "column:rowid" key */
+    GdkPixbuf *pix;     /**< Thumbnail, @c NULL if decoding failed */
+    GList *link;        /**< Node in the LRU queue */
+} s_entry_td;
+
+/**
+ * @struct s_task_td
+ *
+ * @brief Decode request handed to a worker and back
+ */
+typedef struct {
+    thumb_cache_td *c;      /**< Owning cache */
+    gint generation;        /**< Cache generation at request time */
+    char *key;              /**< "column:rowid" key */
+    char *filename;         /**< Database file */
+    char *table;            /**< Table of the cell */
+    char *colname;          /**< Column of the cell */
+    sqlite3_int64 rowid;    /**< Row of the cell */
+    GdkPixbuf *pix;         /**< Decoded thumbnail (or @c NULL) */
+} s_task_td;
+
+
+/**
+ * @brief Build the key of a cell
+ *
+ * @param buf    Buffer of @e THUMB_KEY_SIZE bytes
+ * @param colidx Column index
+ * @param rowid  Row identifier
+ */
+static void s_make_key(char *buf, int colidx, sqlite3_int64 rowid)
+{
+    snprintf(buf, THUMB_KEY_SIZE, "%d:%lld", colidx, (long long) rowid);
+}
+
+
+/**
+ * @brief Free a cache entry
+ *
+ * @param p Entry (@e s_entry_td *)
+ */
+static void s_entry_free(gpointer p)
+{
+    s_entry_td *e = p;
+
+    if (e->pix) {
+        g_object_unref(e->pix);
+    }
+    g_free(e->key);
+    g_free(e);
+}
+
+
+/**
+ * @brief Free a decode request
+ *
+ * @param t Request
+ */
+static void s_task_free(s_task_td *t)
+{
+    if (t->pix) {
+        g_object_unref(t->pix);
+    }
+    g_free(t->key);
+    g_free(t->filename);
+    g_free(t->table);
+    g_free(t->colname);
+    g_free(t);
+}
+
+
+/**
+ * @brief Handler for the "size-prepared" signal of the pixbuf loader:
+ *        decode straight to thumbnail size
+ *
+ * @param loader   The loader that emitted the signal
+ * @param width    Width of the full image
+ * @param height   Height of the full image
+ * @param userdata Unused
+ */
+static void s_on_size_prepared(GdkPixbufLoader *loader, gint width,
+        gint height, gpointer userdata)
+{
+    (void) userdata;
+
+    if (width <= THUMB_SIZE && height <= THUMB_SIZE) {
+        return;
+    }
+    double scale = MIN((double) THUMB_SIZE / width,
+            (double) THUMB_SIZE / height);
+    gdk_pixbuf_loader_set_size(loader, MAX(1, (int) (width * scale)),
+            MAX(1, (int) (height * scale)));
+}
+
+
+/**
+ * @brief Deliver a decoded thumbnail to the cache (main loop)
+ *
+ * @param userdata Finished request (@e s_task_td *)
+ *
+ * @return @e G_SOURCE_REMOVE (one-shot idle source)
+ */
+static gboolean s_deliver(gpointer userdata)
+{
+    s_task_td *t = userdata;
+    thumb_cache_td *c = t->c;
+
+    if (t->generation == g_atomic_int_get(&c->generation)) {
+        g_hash_table_remove(c->pending, t->key);
+
+        /* Failures are cached too, so they are not retried */
+        s_entry_td *e = g_new0(s_entry_td, 1);
+        e->key = t->key;
+        e->pix = t->pix;
+        t->key = NULL;
+        t->pix = NULL;
+        g_queue_push_head(&c->lru, e);
+        e->link = c->lru.head;
+        g_hash_table_replace(c->entries, e->key, e);
+
+        while (g_queue_get_length(&c->lru) > THUMB_CACHE_CAPACITY) {
+            s_entry_td *old = g_queue_pop_tail(&c->lru);
+            g_hash_table_remove(c->entries, old->key);
+            s_entry_free(old);
+        }
+        if (c->ready) {
+            c->ready(c->data);
+        }
+    }
+    s_task_free(t);
+
+    return G_SOURCE_REMOVE;
+}
+
+
+/**
+ * @brief Take a reader connection to a file, idle or new
+ *
+ * Reusing connections spares each decode opening the file and parsing
+ * its schema.
+ *
+ * @param c        Cache
+ * @param filename Database file
+ *
+ * @return Connection (give it back with @a s_give_reader()), or
+ *         @c NULL if the file cannot be opened
+ */
+static sqlite3 *s_take_reader(thumb_cache_td *c, const char *filename)
+{
+    sqlite3 *db = NULL;
+
+    g_mutex_lock(&c->readers_lock);
+    if (g_strcmp0(c->readers_file, filename) == 0) {
+        db = g_queue_pop_head(&c->readers);
+    }
+    g_mutex_unlock(&c->readers_lock);
+
+    if (!db && db_open_reader(filename, &db) != SQLITE_OK) {
+        sqlite3_close(db);
+        db = NULL;
+    }
+
+    return db;
+}
+
+
+/**
+ * @brief Give a reader connection back, kept idle while its file is
+ *        the current one
+ *
+ * @param c        Cache
+ * @param filename Database file of the connection
+ * @param db       Connection
+ */
+static void s_give_reader(thumb_cache_td *c, const char *filename,
+        sqlite3 *db)
+{
+    g_mutex_lock(&c->readers_lock);
+    if (g_strcmp0(c->readers_file, filename) == 0
+            && g_queue_get_length(&c->readers) < THUMB_MAX_WORKERS) {
+        g_queue_push_head(&c->readers, db);
+        db = NULL;
+    }
+    g_mutex_unlock(&c->readers_lock);
+    sqlite3_close(db);
+}
+
+
+/**
+ * @brief Decode one thumbnail (worker thread)
+ *
+ * Streams the BLOB in @e THUMB_CHUNK pieces into a pixbuf loader, so
+ * memory stays bounded whatever the size of the image.
+ *
+ * @param data     Request (@e s_task_td *)
+ * @param userdata Owning cache (unused)
+ */
+static void s_decode(gpointer data, gpointer userdata)
+{
+    (void) userdata;
+    s_task_td *t = data;
+    sqlite3 *db = NULL;
+    sqlite3_blob *blob = NULL;
+
+    /* Skip requests made stale by a table switch */
+    if (t->generation == g_atomic_int_get(&t->c->generation)
+            && (db = s_take_reader(t->c, t->filename)) != NULL
+            && sqlite3_blob_open(db, "main", t->table, t->colname,
+                t->rowid, 0, &blob) == SQLITE_OK) {
+        GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
+        g_signal_connect(loader, "size-prepared",
+                G_CALLBACK(s_on_size_prepared), NULL);
+
+        unsigned char *chunk = g_malloc(THUMB_CHUNK);
+        int size = sqlite3_blob_bytes(blob);
+        int ok = 1;
+        for (int off = 0; ok && off < size; off += THUMB_CHUNK) {
+            int n = MIN(THUMB_CHUNK, size - off);
+            ok = sqlite3_blob_read(blob, chunk, n, off) == SQLITE_OK
+                && gdk_pixbuf_loader_write(loader, chunk, (gsize) n, NULL);
+        }
+        g_free(chunk);
+        if (gdk_pixbuf_loader_close(loader, NULL) && ok) {
+            GdkPixbuf *pix = gdk_pixbuf_loader_get_pixbuf(loader);
+            t->pix = (pix) ? g_object_ref(pix) : NULL;
+        }
+        g_object_unref(loader);
+    }
+    if (blob) {
+        sqlite3_blob_close(blob);
+    }
+    if (db) {
+        s_give_reader(t->c, t->filename, db);
+    }
+
+    g_idle_add(s_deliver, t);
+}
+
+
+/* Create a thumbnail cache with its decoding pool */
+thumb_cache_td *thumb_cache_new(thumb_ready_fn ready, void *data)
+{
+    thumb_cache_td *c = g_new0(thumb_cache_td, 1);
+
+    c->ready = ready;
+    c->data = data;
+    c->marks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            NULL);
+    c->entries = g_hash_table_new(g_str_hash, g_str_equal);
+    c->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            NULL);
+    g_queue_init(&c->lru);
+    g_mutex_init(&c->readers_lock);
+    g_queue_init(&c->readers);
+    c->pool = g_thread_pool_new(s_decode, c,
+            (gint) CLAMP(g_get_num_processors(), 1, THUMB_MAX_WORKERS),
+            FALSE, NULL);
+
+    return c;
+}
+
+
+/* Free the cache, waiting for running decodes to finish */
+void thumb_cache_free(thumb_cache_td *c)
+{
+    if (!c) {
+        return;
+    }
+
+    g_thread_pool_free(c->pool, TRUE, TRUE);
+    thumb_cache_reset(c, NULL, NULL, NULL, 0);
+    g_free(c->colnames);
+    g_hash_table_destroy(c->marks);
+    g_hash_table_destroy(c->entries);
+    g_hash_table_destroy(c->pending);
+    g_mutex_clear(&c->readers_lock);
+    g_free(c);
+}
+
+
+/* Forget all thumbnails and marks and start a new table */
+void thumb_cache_reset(thumb_cache_td *c, const char *filename,
+        const char *table, char **colnames, int ncols)
+{
+    if (!c) {
+        return;
+    }
+
+    g_atomic_int_inc(&c->generation);
+    g_hash_table_remove_all(c->marks);
+    g_hash_table_remove_all(c->pending);
+    g_hash_table_remove_all(c->entries);
+    g_queue_clear_full(&c->lru, s_entry_free);
+
+    for (int i = 0; i < c->ncols; ++i) {
+        g_free(c->colnames[i]);
+    }
+    g_free(c->colnames);
+    /* Idle readers of another file are closed; busy ones on return */
+    g_mutex_lock(&c->readers_lock);
+    if (g_strcmp0(c->readers_file, filename) != 0) {
+        sqlite3 *db;
+        while ((db = g_queue_pop_head(&c->readers)) != NULL) {
+            sqlite3_close(db);
+        }
+        g_free(c->readers_file);
+        c->readers_file = g_strdup(filename);
+    }
+    g_mutex_unlock(&c->readers_lock);
+
+    g_free(c->filename);
+    g_free(c->table);
+    c->filename = g_strdup(filename);
+    c->table = g_strdup(table);
+    c->ncols = (colnames) ? ncols : 0;
+    c->colnames = g_new0(char*, c->ncols + 1);
+    for (int i = 0; i < c->ncols; ++i) {
+        c->colnames[i] = g_strdup(colnames[i]);
+    }
+}
+
+
+/* Detect an image format from the first bytes of a BLOB */
+const char *thumb_sniff(const unsigned char *prefix, int n)
+{
+    static const struct {
+        const char *name;
+        int offset;
+        int len;
+        const char *magic;
+    } formats[] = {
+        { "PNG", 0, 8, "\x89PNG\r\n\x1a\n" },
+        { "JPEG", 0, 3, "\xff\xd8\xff" },
+        { "GIF", 0, 6, "GIF87a" },
+        { "GIF", 0, 6, "GIF89a" },
+        { "WebP", 8, 4, "WEBP" },
+        { "TIFF", 0, 4, "II*\0" },
+        { "TIFF", 0, 4, "MM\0*" },
+        { "ICO", 0, 4, "\0\0\1\0" },
+        { "BMP", 0, 2, "BM" },
+    };
+
+    if (!prefix) {
+        return NULL;
+    }
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+        if (n >= formats[i].offset + formats[i].len
+                && memcmp(prefix + formats[i].offset, formats[i].magic,
+                    (size_t) formats[i].len) == 0) {
+            /* WebP also needs its RIFF container */
+            if (formats[i].offset == 8 && memcmp(prefix, "RIFF", 4) != 0) {
+                continue;
+            }
+            return formats[i].name;
+        }
+    }
+
+    return NULL;
+}
+
+
+/* Mark a cell as holding an image */
+void thumb_cache_mark(thumb_cache_td *c, int colidx, sqlite3_int64 rowid)
+{
+    if (!c || colidx <= 0 || colidx >= c->ncols) {
+        return;
+    }
+
+    char key[THUMB_KEY_SIZE];
+    s_make_key(key, colidx, rowid);
+    g_hash_table_replace(c->marks, g_strdup(key), GINT_TO_POINTER(1));
+}
+
+
+/* Get the thumbnail of a cell, scheduling its decode if needed */
+GdkPixbuf *thumb_cache_get(thumb_cache_td *c, int colidx,
+        sqlite3_int64 rowid)
+{
+    if (!c) {
+        return NULL;
+    }
+
+    char key[THUMB_KEY_SIZE];
+    s_make_key(key, colidx, rowid);
+    if (!g_hash_table_contains(c->marks, key)) {
+        return NULL;
+    }
+
+    s_entry_td *e = g_hash_table_lookup(c->entries, key);
+    if (e) {
+        g_queue_unlink(&c->lru, e->link);
+        g_queue_push_head_link(&c->lru, e->link);
+        return e->pix;
+    }
+    if (g_hash_table_contains(c->pending, key)) {
+        return NULL;
+    }
+
+    s_task_td *t = g_new0(s_task_td, 1);
+    t->c = c;
+    t->generation = g_atomic_int_get(&c->generation);
+    t->key = g_strdup(key);
+    t->filename = g_strdup(c->filename);
+    t->table = g_strdup(c->table);
+    t->colname = g_strdup(c->colnames[colidx]);
+    t->rowid = rowid;
+    g_hash_table_add(c->pending, g_strdup(key));
+    g_thread_pool_push(c->pool, t, NULL);
+
+    return NULL;
+}
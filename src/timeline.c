@@ -0,0 +1,497 @@
+/**
+ * @file timeline.c
+ *
+ * @brief Implementation of the row density over time of a table
+ */
+
+/* System includes */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* External includes */
+#include <glib.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <timeline.h>
+
+
+#define TIMELINE_FIRST_STEP (32)        /**< Buckets apart, first round */
+#define TIMELINE_PROGRESS_OPS (100000)  /**< VM steps between checks for
+                                             cancellation */
+#define TIMELINE_UNIX_JD (2440587.5)    /**< Julian day of the epoch */
+
+
+/**
+ * @struct timeline_td
+ *
+ * @brief Timeline of a table
+ *
+ * Buckets are evenly spaced on an axis that is the values themselves
+ * for numbers, and seconds since the epoch for text.
+ */
+struct timeline_td {
+    char *table;            /**< Table */
+    char *column;           /**< Timestamp column */
+    int text;               /**< Non-zero for ISO-8601 text */
+    char sep;               /**< Separator of date and time in text */
+    int integer;            /**< Non-zero for integers */
+    int julian;             /**< Non-zero for Julian day numbers */
+    double scale;           /**< Units of a number per second */
+    char *first;            /**< First value, as text (text only) */
+    char *last;             /**< Last value, as text (text only) */
+    double lo;              /**< First value on the axis */
+    double hi;              /**< Last value on the axis */
+    GMutex lock;            /**< Lock of @e counts */
+    sqlite3_int64 counts[TIMELINE_BUCKETS]; /**< Rows of each bucket, or
+                                                 -1 until counted */
+};
+
+
+/**
+ * @brief Tell whether a column looks like a timestamp
+ *
+ * @param name Column name
+ * @param type Declared type (may be @c NULL)
+ *
+ * @return 2 for a date or time declared type, 1 for a timestamp-like
+ *         name, 0 otherwise
+ */
+static int s_time_rank(const char *name, const char *type)
+{
+    char *t = g_ascii_strdown((type) ? type : "", -1);
+    char *n = g_ascii_strdown(name, -1);
+    int rank = 0;
+
+    if (strstr(t, "date") || strstr(t, "time")) {
+        rank = 2;
+    } else if (strstr(n, "time") || strstr(n, "date") || strstr(n, "stamp")
+            || strcmp(n, "ts") == 0 || g_str_has_suffix(n, "_at")
+            || g_str_has_suffix(n, "_ts")) {
+        rank = 1;
+    }
+    g_free(t);
+    g_free(n);
+
+    return rank;
+}
+
+
+/* Find the timestamp column of a table */
+int timeline_find_column(sqlite3 *db, const char *table, char **column)
+{
+    if (!db || !table || !column) {
+        return SQLITE_MISUSE;
+    }
+
+    *column = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db,
+            "SELECT ii.name, ti.type FROM pragma_index_list(?1) AS il"
+            " JOIN pragma_index_info(il.name) AS ii"
+            " JOIN pragma_table_info(?1) AS ti ON ti.name = ii.name"
+            " WHERE ii.seqno = 0 AND il.partial = 0;", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+
+    int best = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *name = (const char*) sqlite3_column_text(stmt, 0);
+        int rank = (name) ? s_time_rank(name,
+                (const char*) sqlite3_column_text(stmt, 1)) : 0;
+        if (rank > best) {
+            g_free(*column);
+            *column = g_strdup(name);
+            best = rank;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+
+
+/**
+ * @brief Read the first or last value of the timestamp column
+ *
+ * @param db    Connection
+ * @param t     Timeline (table and column set)
+ * @param last  Non-zero for the last value
+ * @param value Where to store a copy of the value (free with
+ *              @a sqlite3_value_free(); @c NULL if the column has no
+ *              values)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_end_value(sqlite3 *db, const timeline_td *t, int last,
+        sqlite3_value **value)
+{
+    /* One index seek; `min()` and `max()` together would scan */
+    char *sql = sqlite3_mprintf("SELECT \"%w\" FROM \"%w\""
+            " WHERE \"%w\" IS NOT NULL ORDER BY \"%w\" %s LIMIT 1;",
+            t->column, t->table, t->column, t->column,
+            (last) ? "DESC" : "ASC");
+    if (!sql) {
+        return SQLITE_NOMEM;
+    }
+
+    *value = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        *value = sqlite3_value_dup(sqlite3_column_value(stmt, 0));
+        rc = (*value) ? SQLITE_DONE : SQLITE_NOMEM;
+    }
+    sqlite3_finalize(stmt);
+
+    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+
+
+/**
+ * @brief Convert the ISO-8601 text ends of a timeline to seconds
+ *
+ * @param db Connection
+ * @param t  Timeline (@e first and @e last set)
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_MISMATCH if they are not
+ *         dates, or an SQLite error code on failure
+ */
+static int s_text_range(sqlite3 *db, timeline_td *t)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db,
+            "SELECT (julianday(?1) - 2440587.5) * 86400.0,"
+            " (julianday(?2) - 2440587.5) * 86400.0;", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_bind_text(stmt, 1, t->first, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, t->last, -1, SQLITE_STATIC);
+
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        rc = (sqlite3_column_type(stmt, 0) == SQLITE_NULL
+                || sqlite3_column_type(stmt, 1) == SQLITE_NULL)
+            ? SQLITE_MISMATCH : SQLITE_OK;
+        t->lo = sqlite3_column_double(stmt, 0);
+        t->hi = sqlite3_column_double(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+
+    return rc;
+}
+
+
+/**
+ * @brief Guess the unit of numeric timestamps from their magnitude
+ *
+ * @param t Timeline (@e lo and @e hi set)
+ */
+static void s_guess_unit(timeline_td *t)
+{
+    double m = MAX(fabs(t->lo), fabs(t->hi));
+
+    t->scale = 1.0;
+    if (!t->integer && m >= 1e6 && m < 1e7) {
+        t->julian = 1;  /* As `julianday()` gives */
+    } else if (m >= 1e17) {
+        t->scale = 1e9;
+    } else if (m >= 1e14) {
+        t->scale = 1e6;
+    } else if (m >= 1e11) {
+        t->scale = 1e3;
+    }
+}
+
+
+/* Create the timeline of a timestamp column */
+int timeline_new(sqlite3 *db, const char *table, const char *column,
+        timeline_td **out)
+{
+    if (!db || !table || !column || !out) {
+        return SQLITE_MISUSE;
+    }
+
+    timeline_td *t = g_new0(timeline_td, 1);
+    t->table = g_strdup(table);
+    t->column = g_strdup(column);
+    g_mutex_init(&t->lock);
+    for (int b = 0; b < TIMELINE_BUCKETS; ++b) {
+        t->counts[b] = -1;
+    }
+
+    sqlite3_value *first = NULL, *last = NULL;
+    int rc = s_end_value(db, t, 0, &first);
+    if (rc == SQLITE_OK) {
+        rc = s_end_value(db, t, 1, &last);
+    }
+    if (rc == SQLITE_OK && (!first || !last)) {
+        rc = SQLITE_EMPTY;
+    }
+
+    if (rc == SQLITE_OK) {
+        int ta = sqlite3_value_type(first);
+        int tb = sqlite3_value_type(last);
+        if (ta == SQLITE_TEXT && tb == SQLITE_TEXT) {
+            t->text = 1;
+            t->first = g_strdup((const char*) sqlite3_value_text(first));
+            t->last = g_strdup((const char*) sqlite3_value_text(last));
+            t->sep = (strlen(t->first) > 10 && t->first[10] == 'T')
+                ? 'T' : ' ';
+            rc = s_text_range(db, t);
+        } else if ((ta == SQLITE_INTEGER || ta == SQLITE_FLOAT)
+                && (tb == SQLITE_INTEGER || tb == SQLITE_FLOAT)) {
+            t->integer = (ta == SQLITE_INTEGER && tb == SQLITE_INTEGER);
+            t->lo = sqlite3_value_double(first);
+            t->hi = sqlite3_value_double(last);
+            s_guess_unit(t);
+        } else {
+            rc = SQLITE_MISMATCH;
+        }
+    }
+    sqlite3_value_free(first);
+    sqlite3_value_free(last);
+
+    if (rc != SQLITE_OK) {
+        timeline_free(t);
+        t = NULL;
+    }
+    *out = t;
+
+    return rc;
+}
+
+
+/* Release a timeline */
+void timeline_free(timeline_td *t)
+{
+    if (!t) {
+        return;
+    }
+
+    g_mutex_clear(&t->lock);
+    g_free(t->table);
+    g_free(t->column);
+    g_free(t->first);
+    g_free(t->last);
+    g_free(t);
+}
+
+
+/**
+ * @brief Convert a point of the axis of a timeline to Unix time
+ *
+ * @param t Timeline
+ * @param v Point of the axis
+ *
+ * @return Seconds since the epoch
+ */
+static double s_seconds(const timeline_td *t, double v)
+{
+    if (t->text) {
+        return v;
+    } else if (t->julian) {
+        return (v - TIMELINE_UNIX_JD) * 86400.0;
+    }
+
+    return v / t->scale;
+}
+
+
+/**
+ * @brief Format Unix time in UTC
+ *
+ * @param seconds Seconds since the epoch
+ * @param format  @a g_date_time_format() format
+ * @param buf     Where to store the text (a number if out of range)
+ * @param len     Size of @e buf
+ */
+static void s_format_time(double seconds, const char *format, char *buf,
+        size_t len)
+{
+    GDateTime *dt = (seconds > -62135596800.0 && seconds < 253402300800.0)
+        ? g_date_time_new_from_unix_utc((gint64) floor(seconds)) : NULL;
+    char *text = (dt) ? g_date_time_format(dt, format) : NULL;
+
+    if (text) {
+        g_strlcpy(buf, text, len);
+    } else {
+        snprintf(buf, len, "%.0f", seconds);
+    }
+    g_free(text);
+    if (dt) {
+        g_date_time_unref(dt);
+    }
+}
+
+
+/**
+ * @brief Bind a bucket bound of a timeline to a statement parameter
+ *
+ * Bound 0 is the first value and bound @e TIMELINE_BUCKETS the last,
+ * as stored, so that no value falls outside of the buckets.
+ *
+ * @param stmt  Statement
+ * @param param Parameter
+ * @param t     Timeline
+ * @param bound Bound, from 0 to @e TIMELINE_BUCKETS
+ */
+static void s_bind_bound(sqlite3_stmt *stmt, int param,
+        const timeline_td *t, int bound)
+{
+    double v = t->lo + (t->hi - t->lo) * bound / TIMELINE_BUCKETS;
+
+    if (t->text) {
+        char text[64];
+        const char *value = (bound == 0) ? t->first
+            : (bound == TIMELINE_BUCKETS) ? t->last : text;
+        s_format_time(v, (t->sep == 'T') ? "%Y-%m-%dT%H:%M:%S"
+                : "%Y-%m-%d %H:%M:%S", text, sizeof(text));
+        sqlite3_bind_text(stmt, param, value, -1, SQLITE_TRANSIENT);
+    } else if (bound == 0 || bound == TIMELINE_BUCKETS) {
+        sqlite3_bind_double(stmt, param, (bound == 0) ? t->lo : t->hi);
+    } else {
+        sqlite3_bind_double(stmt, param, v);
+    }
+}
+
+
+/**
+ * @brief SQLite progress handler of the counts: stop if cancelled
+ *
+ * @param data Job handle (@e job_td *)
+ *
+ * @return Non-zero to interrupt the statement
+ */
+static int s_on_progress(void *data)
+{
+    return job_is_cancelled(data);
+}
+
+
+/* Count the rows of every bucket (job body) */
+int timeline_count(job_td *job, const char *filename, timeline_td *t)
+{
+    if (!filename || !t) {
+        return SQLITE_MISUSE;
+    }
+
+    sqlite3 *db = NULL;
+    int rc = db_open_reader(filename, &db);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    sqlite3_progress_handler(db, TIMELINE_PROGRESS_OPS, s_on_progress,
+            job);
+
+    /* Buckets end before the next one starts, the last at the last value */
+    sqlite3_stmt *stmts[2] = { NULL, NULL };
+    for (int i = 0; i < 2 && rc == SQLITE_OK; ++i) {
+        char *sql = sqlite3_mprintf("SELECT count(*) FROM \"%w\""
+                " WHERE \"%w\" >= ?1 AND \"%w\" %s ?2;", t->table,
+                t->column, t->column, (i == 0) ? "<" : "<=");
+        rc = (sql) ? sqlite3_prepare_v2(db, sql, -1, &stmts[i], NULL)
+            : SQLITE_NOMEM;
+        sqlite3_free(sql);
+    }
+
+    /* Coarsely spread buckets first, then those in between */
+    guint8 counted[TIMELINE_BUCKETS] = { 0 };
+    int done = 0;
+    for (int step = TIMELINE_FIRST_STEP; step > 0 && rc == SQLITE_OK;
+            step /= 2) {
+        for (int b = 0; b < TIMELINE_BUCKETS && rc == SQLITE_OK;
+                b += step) {
+            if (counted[b]) {
+                continue;
+            }
+            sqlite3_stmt *stmt = stmts[b == TIMELINE_BUCKETS - 1];
+            s_bind_bound(stmt, 1, t, b);
+            s_bind_bound(stmt, 2, t, b + 1);
+            rc = sqlite3_step(stmt);
+            if (rc == SQLITE_ROW) {
+                g_mutex_lock(&t->lock);
+                t->counts[b] = sqlite3_column_int64(stmt, 0);
+                g_mutex_unlock(&t->lock);
+                rc = SQLITE_OK;
+            }
+            sqlite3_reset(stmt);
+            counted[b] = 1;
+            done++;
+            job_report(job, (double) done / TIMELINE_BUCKETS,
+                    "Counted %d of %d buckets", done, TIMELINE_BUCKETS);
+        }
+    }
+    if (job_is_cancelled(job)) {
+        rc = SQLITE_INTERRUPT;
+    }
+
+    sqlite3_finalize(stmts[0]);
+    sqlite3_finalize(stmts[1]);
+    sqlite3_close(db);
+
+    return rc;
+}
+
+
+/* Get the counts of the buckets known so far (thread-safe) */
+sqlite3_int64 timeline_counts(timeline_td *t, sqlite3_int64 *counts)
+{
+    sqlite3_int64 max = 0;
+
+    g_mutex_lock(&t->lock);
+    memcpy(counts, t->counts, sizeof(t->counts));
+    g_mutex_unlock(&t->lock);
+    for (int b = 0; b < TIMELINE_BUCKETS; ++b) {
+        max = MAX(max, counts[b]);
+    }
+
+    return max;
+}
+
+
+/* Get the timestamp column of a timeline */
+const char *timeline_column(const timeline_td *t)
+{
+    return t->column;
+}
+
+
+/* Describe the time at a point of a timeline */
+void timeline_describe(const timeline_td *t, double frac, char *buf,
+        size_t len)
+{
+    double v = t->lo + (t->hi - t->lo) * CLAMP(frac, 0.0, 1.0);
+
+    s_format_time(s_seconds(t, v), "%Y-%m-%d %H:%M", buf, len);
+}
+
+
+/* Get the value at a point of a timeline as an SQL literal */
+char *timeline_seek(const timeline_td *t, double frac)
+{
+    frac = CLAMP(frac, 0.0, 1.0);
+    double v = t->lo + (t->hi - t->lo) * frac;
+
+    if (t->text) {
+        char text[64];
+        s_format_time(v, (t->sep == 'T') ? "%Y-%m-%dT%H:%M:%S"
+                : "%Y-%m-%d %H:%M:%S", text, sizeof(text));
+        return sqlite3_mprintf("%Q", (frac > 0.0) ? text : t->first);
+    } else if (t->integer) {
+        return sqlite3_mprintf("%lld", (long long) floor(v));
+    }
+
+    return sqlite3_mprintf("%!.17g", v);
+}
@@ -7,227 +7,3402 @@
 
 /* System includes */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* Project includes */
+#include <complete.h>
 #include <db.h>
+#include <dup.h>
+#include <estimate.h>
+#include <extract.h>
+#include <history.h>
+#include <import.h>
+#include <inspect.h>
+#include <job.h>
+#include <json.h>
+#include <overlay.h>
+#include <query.h>
+#include <recover.h>
+#include <script.h>
+#include <spatial.h>
+#include <thumb.h>
 
 /* Local includes */
 #include <ui.h>
 
+
+#define UI_FORM_GROUP (64)  /**< Columns fetched at once by the form */
+#define UI_HISTORY_LIMIT (500)  /**< Runs listed by the query history */
+#define UI_COMPLETE_MAX (40)    /**< Names offered by autocompletion */
+#define UI_JSON_SLOW_MS (100)   /**< Filter time worth an index (ms) */
+#define UI_ESTIMATE_DELAY_MS (300)  /**< Typing pause before estimating */
+#define UI_FILTER_SCAN_ASK (1000000)    /**< Rows scanned worth asking */
+
+/**
+ * @brief Responses of the JSON explorer
+ */
+enum {
+    UI_JSON_COLUMN = 1,     /**< Show the selected path as a column */
+    UI_JSON_FILTER,         /**< Show rows holding the selected value */
+    UI_JSON_RESET           /**< Drop JSON columns and filter */
+};
+
+/**
+ * @brief Show a modal error dialog with a message
+ *
+ * @param parent Parent window for the dialog (may be @c NULL)
+ * @param msg    Null-terminated message text to display
+ */
+static void s_show_error_dialog(GtkWindow *parent, const char *msg)
+{
+    GtkWidget *d = gtk_message_dialog_new(parent, GTK_DIALOG_MODAL,
+            GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE, "%s", msg);
+    gtk_dialog_run(GTK_DIALOG(d));
+    gtk_widget_destroy(d);
+}
+
+
+/**
+ * @brief Show a modal informational dialog with a message
+ *
+ * @param parent Parent window for the dialog (may be @c NULL)
+ * @param msg    Null-terminated message text to display
+ */
+static void s_show_info_dialog(GtkWindow *parent, const char *msg)
+{
+    GtkWidget *d = gtk_message_dialog_new(parent, GTK_DIALOG_MODAL,
+            GTK_MESSAGE_INFO, GTK_BUTTONS_CLOSE, "%s", msg);
+    gtk_dialog_run(GTK_DIALOG(d));
+    gtk_widget_destroy(d);
+}
+
+
+/**
+ * @brief Show a modal yes/no question dialog
+ *
+ * @param parent Parent window for the dialog (may be @c NULL)
+ * @param msg    Null-terminated question text to display
+ *
+ * @return @c TRUE if the user answered yes, @c FALSE otherwise
+ */
+static gboolean s_ask_question(GtkWindow *parent, const char *msg)
+{
+    GtkWidget *d = gtk_message_dialog_new(parent, GTK_DIALOG_MODAL,
+            GTK_MESSAGE_QUESTION, GTK_BUTTONS_YES_NO, "%s", msg);
+    gint response = gtk_dialog_run(GTK_DIALOG(d));
+    gtk_widget_destroy(d);
+
+    return response == GTK_RESPONSE_YES;
+}
+
+
+/**
+ * @brief Refuse writing to the open file in overlay mode
+ *
+ * @param s Pointer to the application context
+ *
+ * @return @c TRUE if the file may be written to, else @c FALSE (after
+ *         telling so)
+ */
+static gboolean s_check_writable(context_td *s)
+{
+    if (s->overlay_mode) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "The file is read-only "
+                "in overlay mode: only cell edits are possible, kept "
+                "aside until applied.");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/**
+ * @brief Show a modal dialog with a long, read-only, monospace text
+ *
+ * @param parent Parent window for the dialog (may be @c NULL)
+ * @param title  Title of the dialog
+ * @param text   Null-terminated text to display
+ */
+static void s_show_text_dialog(GtkWindow *parent, const char *title,
+        const char *text)
+{
+    GtkWidget *d = gtk_dialog_new_with_buttons(title, parent,
+            GTK_DIALOG_MODAL, "_Close", GTK_RESPONSE_CLOSE, NULL);
+    gtk_window_set_default_size(GTK_WINDOW(d), 640, 420);
+    GtkWidget *tv = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(tv), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(tv), TRUE);
+    gtk_text_buffer_set_text(gtk_text_view_get_buffer(GTK_TEXT_VIEW(tv)),
+            (text) ? text : "", -1);
+    GtkWidget *sc = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(sc), tv);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(
+                    GTK_DIALOG(d))), sc, TRUE, TRUE, 0);
+    gtk_widget_show_all(d);
+    gtk_dialog_run(GTK_DIALOG(d));
+    gtk_widget_destroy(d);
+}
+
+
+/**
+ * @struct s_progress_td
+ *
+ * @brief Non-modal progress dialog following a background job
+ */
+typedef struct {
+    GtkWidget *dlg;     /**< Dialog window with a Cancel button */
+    GtkWidget *bar;     /**< Progress bar showing the job status */
+    guint timer;        /**< Source id of the polling timer */
+    job_td *job;        /**< Followed job */
+} s_progress_td;
+
+
+/**
+ * @brief Timer callback refreshing a progress dialog from its job
+ *
+ * @param userdata Progress dialog (@e s_progress_td *)
+ *
+ * @return @e G_SOURCE_CONTINUE (removed by @a s_progress_free())
+ */
+static gboolean s_progress_tick(gpointer userdata)
+{
+    s_progress_td *p = userdata;
+    char *text = NULL;
+    double fraction = job_progress(p->job, &text);
+
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(p->bar), fraction);
+    if (text) {
+        gtk_progress_bar_set_text(GTK_PROGRESS_BAR(p->bar), text);
+        g_free(text);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+
+/**
+ * @brief Handler for the "response" signal of a progress dialog:
+ *        request cancellation of the job
+ *
+ * @param dlg      The dialog that emitted the signal (unused)
+ * @param response Response identifier (unused)
+ * @param userdata Progress dialog (@e s_progress_td *)
+ */
+static void s_on_progress_response(GtkDialog *dlg, gint response,
+        gpointer userdata)
+{
+    (void) dlg;
+    (void) response;
+    s_progress_td *p = userdata;
+
+    job_cancel(p->job);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(p->bar), "Cancelling...");
+}
+
+
+/**
+ * @brief Show a progress dialog following a background job
+ *
+ * @param s     Pointer to the application context
+ * @param title Title of the dialog
+ * @param job   Job to follow (must outlive the dialog)
+ *
+ * @return Progress dialog (release with @a s_progress_free() from the
+ *         job completion callback)
+ */
+static s_progress_td *s_progress_new(context_td *s, const char *title,
+        job_td *job)
+{
+    s_progress_td *p = g_new0(s_progress_td, 1);
+
+    p->job = job;
+    p->dlg = gtk_dialog_new_with_buttons(title, GTK_WINDOW(s->win),
+            GTK_DIALOG_DESTROY_WITH_PARENT,
+            "_Cancel", GTK_RESPONSE_CANCEL, NULL);
+    p->bar = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(p->bar), TRUE);
+    gtk_widget_set_size_request(p->bar, 360, -1);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(
+                    GTK_DIALOG(p->dlg))), p->bar, TRUE, TRUE, 6);
+    g_signal_connect(p->dlg, "response",
+            G_CALLBACK(s_on_progress_response), p);
+    g_signal_connect(p->dlg, "delete-event",
+            G_CALLBACK(gtk_true), NULL);
+    p->timer = g_timeout_add(100, s_progress_tick, p);
+    gtk_widget_show_all(p->dlg);
+
+    return p;
+}
+
+
+/**
+ * @brief Close a progress dialog and release it
+ *
+ * @param p Progress dialog (may be @c NULL)
+ */
+static void s_progress_free(s_progress_td *p)
+{
+    if (!p) {
+        return;
+    }
+
+    g_source_remove(p->timer);
+    gtk_widget_destroy(p->dlg);
+    g_free(p);
+}
+
+
+/**
+ * @struct s_dup_job_td
+ *
+ * @brief Parameters and result of a duplicate search job
+ */
+typedef struct {
+    context_td *s;          /**< Application context */
+    char *filename;         /**< Database file to scan */
+    char *table;            /**< Table to scan */
+    char **cols;            /**< Compared columns (@c NULL terminated) */
+    int ncols;              /**< Number of compared columns */
+    dup_result_td result;   /**< Groups found */
+    s_progress_td *progress;    /**< Progress dialog */
+} s_dup_job_td;
+
+
+/**
+ * @brief Duplicate search job body (worker thread)
+ *
+ * @param job  Running job
+ * @param data Job parameters (@e s_dup_job_td *)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_dup_job_run(job_td *job, void *data)
+{
+    s_dup_job_td *d = data;
+
+    return dup_find(job, d->filename, d->table, d->cols, d->ncols,
+            (int) g_get_num_processors(), &d->result);
+}
+
+
+/**
+ * @brief Duplicate search completion (main loop): show the groups
+ *
+ * @param job  Finished job (unused)
+ * @param rc   Outcome of the search
+ * @param data Job parameters and result (@e s_dup_job_td *)
+ */
+static void s_dup_job_done(job_td *job, int rc, void *data)
+{
+    (void) job;
+    s_dup_job_td *d = data;
+    context_td *s = d->s;
+
+    s_progress_free(d->progress);
+    if (rc == SQLITE_INTERRUPT) {
+        /* Cancelled by the user: nothing to report */
+    } else if (rc != SQLITE_OK) {
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Duplicate search failed: %s",
+                sqlite3_errstr(rc));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+    } else if (d->result.ngroups == 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "No duplicates among %lld rows.",
+                (long long) d->result.nscanned);
+        s_show_info_dialog(GTK_WINDOW(s->win), msg);
+    } else {
+        GtkListStore *store = gtk_list_store_new(3, G_TYPE_INT,
+                G_TYPE_INT, G_TYPE_STRING);
+        for (int i = 0; i < d->result.ngroups; ++i) {
+            const dup_group_td *g = &d->result.groups[i];
+            GString *ids = g_string_new(NULL);
+            for (int j = 0; j < g->nrowids && j < 20; ++j) {
+                g_string_append_printf(ids, "%s%lld", (j) ? ", " : "",
+                        (long long) g->rowids[j]);
+            }
+            if (g->nrowids > 20) {
+                g_string_append(ids, ", ...");
+            }
+            GtkTreeIter iter;
+            gtk_list_store_append(store, &iter);
+            gtk_list_store_set(store, &iter, 0, i + 1, 1, g->nrowids,
+                    2, ids->str, -1);
+            g_string_free(ids, TRUE);
+        }
+
+        char title[256];
+        snprintf(title, sizeof(title),
+                "Duplicates in '%s': %d groups (%lld rows scanned)",
+                d->table, d->result.ngroups,
+                (long long) d->result.nscanned);
+        GtkWidget *dlg = gtk_dialog_new_with_buttons(title,
+                GTK_WINDOW(s->win), GTK_DIALOG_MODAL,
+                "_Close", GTK_RESPONSE_CLOSE, NULL);
+        GtkWidget *tv =
+            gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+        const char *titles[] = { "Group", "Rows", "Rowids" };
+        for (int i = 0; i < 3; ++i) {
+            gtk_tree_view_append_column(GTK_TREE_VIEW(tv),
+                    gtk_tree_view_column_new_with_attributes(titles[i],
+                        gtk_cell_renderer_text_new(), "text", i, NULL));
+        }
+        g_object_unref(store);
+        GtkWidget *sc = gtk_scrolled_window_new(NULL, NULL);
+        gtk_widget_set_size_request(sc, 500, 300);
+        gtk_container_add(GTK_CONTAINER(sc), tv);
+        gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(
+                        GTK_DIALOG(dlg))), sc, TRUE, TRUE, 0);
+        gtk_widget_show_all(dlg);
+        gtk_dialog_run(GTK_DIALOG(dlg));
+        gtk_widget_destroy(dlg);
+    }
+
+    dup_result_free(&d->result);
+    g_strfreev(d->cols);
+    g_free(d->table);
+    g_free(d->filename);
+    g_free(d);
+}
+
+
+/**
+ * @struct s_recover_job_td
+ *
+ * @brief Parameters and result of a recovery job
+ */
+typedef struct {
+    context_td *s;              /**< Application context */
+    char *src;                  /**< Damaged database file */
+    char *dst;                  /**< Database file to create */
+    recover_result_td result;   /**< Outcome and report */
+    s_progress_td *progress;    /**< Progress dialog */
+} s_recover_job_td;
+
+
+/**
+ * @brief Recovery job body (worker thread)
+ *
+ * @param job  Running job
+ * @param data Job parameters (@e s_recover_job_td *)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_recover_job_run(job_td *job, void *data)
+{
+    s_recover_job_td *d = data;
+
+    return recover_database(job, d->src, d->dst, &d->result);
+}
+
+
+/**
+ * @brief Recovery completion (main loop): show the report
+ *
+ * @param job  Finished job (unused)
+ * @param rc   Outcome of the recovery
+ * @param data Job parameters and result (@e s_recover_job_td *)
+ */
+static void s_recover_job_done(job_td *job, int rc, void *data)
+{
+    (void) job;
+    s_recover_job_td *d = data;
+
+    s_progress_free(d->progress);
+    if (rc != SQLITE_INTERRUPT) {
+        char title[256];
+        snprintf(title, sizeof(title), "Recovery %s",
+                (rc == SQLITE_OK) ? "finished" : "failed");
+        s_show_text_dialog(GTK_WINDOW(d->s->win), title,
+                (d->result.report) ? d->result.report : sqlite3_errstr(rc));
+    }
+
+    recover_result_free(&d->result);
+    g_free(d->src);
+    g_free(d->dst);
+    g_free(d);
+}
+
+
+/**
+ * @brief Offer to recover a damaged database into a new file and
+ *        start the recovery job
+ *
+ * @param s        Pointer to the application context
+ * @param filename Path of the damaged database
+ * @param reason   Why recovery is offered (first line of the question)
+ */
+static void s_offer_recovery(context_td *s, const char *filename,
+        const char *reason)
+{
+    char msg[1024];
+    snprintf(msg, sizeof(msg), "%s\n\nRecover its readable content "
+            "into a new database file?", reason);
+    if (!s_ask_question(GTK_WINDOW(s->win), msg)) {
+        return;
+    }
+
+    GtkWidget *dlg = gtk_file_chooser_dialog_new("Save recovered DB",
+            GTK_WINDOW(s->win), GTK_FILE_CHOOSER_ACTION_SAVE,
+            "_Cancel", GTK_RESPONSE_CANCEL,
+            "_Save", GTK_RESPONSE_ACCEPT, NULL);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dlg),
+            TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dlg),
+            "recovered.db");
+
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT) {
+        char *dst = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dlg));
+        if (dst && strcmp(dst, filename) == 0) {
+            s_show_error_dialog(GTK_WINDOW(s->win),
+                    "Choose a file other than the damaged database.");
+            g_free(dst);
+        } else if (dst) {
+            s_recover_job_td *d = g_new0(s_recover_job_td, 1);
+            d->s = s;
+            d->src = g_strdup(filename);
+            d->dst = dst;
+            job_td *job = job_start("recover", s_recover_job_run,
+                    s_recover_job_done, d);
+            d->progress = s_progress_new(s, "Recovering database", job);
+        }
+    }
+    gtk_widget_destroy(dlg);
+}
+
+
+/**
+ * @struct s_extract_job_td
+ *
+ * @brief Parameters and result of a BLOB extraction job
+ */
+typedef struct {
+    context_td *s;              /**< Application context */
+    char *filename;             /**< Database file */
+    char *table;                /**< Table holding the BLOBs */
+    char *column;               /**< Column holding the BLOBs */
+    char *dir;                  /**< Output directory */
+    extract_result_td result;   /**< Counters of the extraction */
+    s_progress_td *progress;    /**< Progress dialog */
+} s_extract_job_td;
+
+
+/**
+ * @brief BLOB extraction job body (worker thread)
+ *
+ * @param job  Running job
+ * @param data Job parameters (@e s_extract_job_td *)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_extract_job_run(job_td *job, void *data)
+{
+    s_extract_job_td *d = data;
+
+    return extract_blobs(job, d->filename, d->table, d->column, d->dir,
+            (int) g_get_num_processors(), &d->result);
+}
+
+
+/**
+ * @brief BLOB extraction completion (main loop): show the counters
+ *
+ * @param job  Finished job (unused)
+ * @param rc   Outcome of the extraction
+ * @param data Job parameters and result (@e s_extract_job_td *)
+ */
+static void s_extract_job_done(job_td *job, int rc, void *data)
+{
+    (void) job;
+    s_extract_job_td *d = data;
+    char *size = g_format_size((guint64) d->result.nbytes);
+    char msg[1024];
+
+    s_progress_free(d->progress);
+    if (rc == SQLITE_OK || rc == SQLITE_INTERRUPT) {
+        snprintf(msg, sizeof(msg), "%s %lld files (%s) in %.1f s, "
+                "%.1f MB/s.",
+                (rc == SQLITE_OK) ? "Extracted" : "Cancelled after",
+                (long long) d->result.nfiles, size,
+                d->result.seconds, (d->result.seconds > 0.0)
+                ? (double) d->result.nbytes / d->result.seconds / 1e6
+                : 0.0);
+        s_show_info_dialog(GTK_WINDOW(d->s->win), msg);
+    } else {
+        snprintf(msg, sizeof(msg), "Extraction failed after %lld files: "
+                "%s", (long long) d->result.nfiles, sqlite3_errstr(rc));
+        s_show_error_dialog(GTK_WINDOW(d->s->win), msg);
+    }
+
+    g_free(size);
+    g_free(d->filename);
+    g_free(d->table);
+    g_free(d->column);
+    g_free(d->dir);
+    g_free(d);
+}
+
+
+/**
+ * @struct s_import_job_td
+ *
+ * @brief Parameters of a file import job
+ */
+typedef struct {
+    context_td *s;              /**< Application context */
+    char *filename;             /**< Database file */
+    char *table;                /**< Table of the cell */
+    char *column;               /**< Column of the cell */
+    sqlite3_int64 rowid;        /**< Row of the cell */
+    char *path;                 /**< File to import */
+    s_progress_td *progress;    /**< Progress dialog */
+} s_import_job_td;
+
+
+/**
+ * @brief File import job body (worker thread)
+ *
+ * @param job  Running job
+ * @param data Job parameters (@e s_import_job_td *)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_import_job_run(job_td *job, void *data)
+{
+    s_import_job_td *d = data;
+
+    return import_blob_file(job, d->filename, d->table, d->column,
+            d->rowid, d->path);
+}
+
+
+/* Defined below, with the handlers that load the rows view */
+static void s_show_table(context_td *s, const char *tname);
+
+
+/**
+ * @brief File import completion (main loop): reload the rows view
+ *
+ * @param job  Finished job (unused)
+ * @param rc   Outcome of the import
+ * @param data Job parameters (@e s_import_job_td *)
+ */
+static void s_import_job_done(job_td *job, int rc, void *data)
+{
+    (void) job;
+    s_import_job_td *d = data;
+    context_td *s = d->s;
+
+    s_progress_free(d->progress);
+    if (rc == SQLITE_OK) {
+        /* Only if the user is still looking at the same table */
+        if (s->current_tablename
+                && strcmp(s->current_tablename, d->table) == 0) {
+            s_show_table(s, d->table);
+        }
+    } else if (rc != SQLITE_INTERRUPT) {
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Failed to import '%s': %s", d->path,
+                sqlite3_errstr(rc));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+    }
+
+    g_free(d->filename);
+    g_free(d->table);
+    g_free(d->column);
+    g_free(d->path);
+    g_free(d);
+}
+
+
+/**
+ * @struct s_script_job_td
+ *
+ * @brief Parameters of an SQL script job
+ */
+typedef struct {
+    context_td *s;              /**< Application context */
+    char *filename;             /**< Database file */
+    char *path;                 /**< SQL script file */
+    script_result_td result;    /**< Outcome of the run */
+    s_progress_td *progress;    /**< Progress dialog */
+} s_script_job_td;
+
+
+/**
+ * @brief SQL script job body (worker thread)
+ *
+ * @param job  Running job
+ * @param data Job parameters (@e s_script_job_td *)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_script_job_run(job_td *job, void *data)
+{
+    s_script_job_td *d = data;
+
+    return script_run_file(job, d->filename, d->path, &d->result);
+}
+
+
+/**
+ * @brief SQL script completion (main loop): report the outcome and
+ *        reload the tables list and the rows view
+ *
+ * @param job  Finished job (unused)
+ * @param rc   Outcome of the script
+ * @param data Job parameters (@e s_script_job_td *)
+ */
+static void s_script_job_done(job_td *job, int rc, void *data)
+{
+    (void) job;
+    s_script_job_td *d = data;
+    context_td *s = d->s;
+    char msg[1024];
+
+    s_progress_free(d->progress);
+    if (rc == SQLITE_OK || rc == SQLITE_INTERRUPT) {
+        snprintf(msg, sizeof(msg), "%s %lld statements in %.1f s.",
+                (rc == SQLITE_OK) ? "Executed" : "Cancelled after",
+                (long long) d->result.nstatements, d->result.seconds);
+        s_show_info_dialog(GTK_WINDOW(s->win), msg);
+    } else if (d->result.line > 0) {
+        snprintf(msg, sizeof(msg), "Script stopped at line %lld (byte "
+                "%lld) after %lld statements: %s", (long long)
+                d->result.line, (long long) d->result.offset,
+                (long long) d->result.nstatements, d->result.error);
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+    } else {
+        snprintf(msg, sizeof(msg), "Failed to run '%s': %s", d->path,
+                sqlite3_errstr(rc));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+    }
+
+    /* Only if the same database is still open */
+    if (s->db && s->filename && strcmp(s->filename, d->filename) == 0) {
+        char *tname = g_strdup(s->current_tablename);
+        db_fill_table_list(s);
+        if (tname) {
+            s_show_table(s, tname);
+        }
+        g_free(tname);
+    }
+
+    g_free(d->filename);
+    g_free(d->path);
+    g_free(d);
+}
+
+
+/**
+ * @brief Handler for the "edited" signal of a @e GtkCellRendererText
+ * 
+ * Reads the @e rowid from the model using the provided path, updates
+ * the corresponding cell in the database via @a db_apply_update_cell(),
+ * and on success updates the list store cell value.
+ *
+ * @param cell      The @e GtkCellRendererText that emitted the signal
+ * @param path      String path identifying the row in the @e GtkTreeModel
+ * @param new_text  New text value entered by the user
+ * @param user_data Pointer to the application context (@e context_td *)
+ *
+ * @note Shows an error dialog if the update fails
+ */
+static void s_on_cell_edited(GtkCellRendererText *cell,
+        const gchar *path, const gchar *new_text, gpointer user_data)
+{
+    context_td *s = user_data;
+    if (!s) {
+        return;
+    }
+    gpointer p = g_object_get_data(G_OBJECT(cell), "col-index");
+    int colidx = GPOINTER_TO_INT(p);
+
+    GtkTreeModel *model =
+        gtk_tree_view_get_model(GTK_TREE_VIEW(s->rows_view));
+    GtkTreeIter iter;
+    if (!gtk_tree_model_get_iter_from_string(model, &iter, path)) {
+        return;
+    }
+    gchar *rowid_text = NULL;
+    gtk_tree_model_get(model, &iter, 0, &rowid_text, -1);
+    if (!rowid_text) {
+        return;
+    }
+
+    int rc = db_apply_update_cell(s, colidx, rowid_text, new_text);
+    if (rc != SQLITE_OK) {
+        const char *errmsg = (s->overlay && rc != SQLITE_NOTFOUND)
+            ? overlay_errmsg(s->overlay) : s->db
+            ? sqlite3_errmsg(s->db)
+            : "Unknown DB error";
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Failed to update cell: %s", errmsg);
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        g_free(rowid_text);
+        return;
+    }
+
+    char col[16];
+    snprintf(col, sizeof(col), "%d", colidx);
+    session_log(s->session, "edit", col, rowid_text, new_text, NULL);
+    gtk_list_store_set(GTK_LIST_STORE(model), &iter, colidx,
+            new_text, -1);
+    g_free(rowid_text);
+}
+
+
+/**
+ * @brief Redraw the rows view when new thumbnails are ready
+ *
+ * @param data Pointer to the application context (@e context_td *)
+ */
+static void s_on_thumbs_ready(void *data)
+{
+    context_td *s = data;
+
+    gtk_widget_queue_draw(s->rows_view);
+}
+
+
+/**
+ * @brief Cell data function of the thumbnail renderers
+ *
+ * Looks up the thumbnail of the cell, which schedules its decode the
+ * first time an image cell becomes visible.
+ *
+ * @param col      Column of the cell (unused)
+ * @param cell     The @e GtkCellRendererPixbuf to set up
+ * @param model    Rows model
+ * @param iter     Row of the cell
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_thumb_cell_data(GtkTreeViewColumn *col,
+        GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter,
+        gpointer userdata)
+{
+    (void) col;
+    context_td *s = userdata;
+    int colidx = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(cell),
+                "col-index"));
+    gchar *rowid_text = NULL;
+    GdkPixbuf *pix = NULL;
+
+    gtk_tree_model_get(model, iter, 0, &rowid_text, -1);
+    if (rowid_text) {
+        pix = thumb_cache_get(s->thumbs, colidx,
+                g_ascii_strtoll(rowid_text, NULL, 10));
+        g_free(rowid_text);
+    }
+    g_object_set(cell, "pixbuf", pix, "visible", pix != NULL, NULL);
+}
+
+
+/**
+ * @brief Match the columns of the rows view to the current table
+ *
+ * Columns are pooled: column @e i always shows model column @e i, so
+ * its renderers, properties and signal handlers are set up only once,
+ * when the pool first grows to it.  On a table switch only titles,
+ * visibility, editability (JSON path columns are computed) and the
+ * "text" attribute (cleared on hidden columns, which the smaller model
+ * does not have) are updated.
+ *
+ * @param s Pointer to the application context
+ */
+static void s_sync_columns(context_td *s)
+{
+    GtkTreeView *tv = GTK_TREE_VIEW(s->rows_view);
+    int ncols = (s->current_colnames)
+        ? s->current_ncols + s->current_nextra : 0;
+    int npool = (int) gtk_tree_view_get_n_columns(tv);
+
+    for (int pos = npool; pos < ncols; ++pos) {
+        GtkTreeViewColumn *col = gtk_tree_view_column_new();
+        GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+        gtk_tree_view_column_pack_start(col, renderer, TRUE);
+        g_object_set(renderer, "editable", (pos == 0) ? FALSE : TRUE,
+                NULL);
+        g_object_set_data(G_OBJECT(renderer), "col-index",
+                GINT_TO_POINTER(pos));
+        g_signal_connect(renderer, "edited",
+                G_CALLBACK(s_on_cell_edited), s);
+        if (pos > 0) {
+            GtkCellRenderer *pr = gtk_cell_renderer_pixbuf_new();
+            g_object_set_data(G_OBJECT(pr), "col-index",
+                    GINT_TO_POINTER(pos));
+            gtk_tree_view_column_pack_start(col, pr, FALSE);
+            gtk_tree_view_column_set_cell_data_func(col, pr,
+                    s_thumb_cell_data, s, NULL);
+        }
+        g_object_set_data(G_OBJECT(col), "text-renderer", renderer);
+        gtk_tree_view_append_column(tv, col);
+    }
+
+    npool = (int) gtk_tree_view_get_n_columns(tv);
+    for (int pos = 0; pos < npool; ++pos) {
+        GtkTreeViewColumn *col = gtk_tree_view_get_column(tv, pos);
+        GtkCellRenderer *renderer =
+            g_object_get_data(G_OBJECT(col), "text-renderer");
+        int shown = pos < ncols;
+        g_object_set(renderer, "editable",
+                pos > 0 && pos < s->current_ncols, NULL);
+        gtk_tree_view_column_clear_attributes(col, renderer);
+        if (shown) {
+            gtk_tree_view_column_add_attribute(col, renderer, "text", pos);
+            gtk_tree_view_column_set_title(col,
+                    s->current_colnames[pos]);
+        }
+        gtk_tree_view_column_set_visible(col, shown);
+    }
+    gtk_tree_view_columns_autosize(tv);
+}
+
+
+/**
+ * @struct s_timeline_job_td
+ *
+ * @brief Counting of the histogram of a timeline
+ */
+typedef struct {
+    context_td *s;      /**< Application context */
+    timeline_td *t;     /**< Timeline counted */
+    char *filename;     /**< Database file */
+    guint timer;        /**< Source id of the redraw timer */
+} s_timeline_job_td;
+
+
+/**
+ * @brief Timer callback redrawing the timeline strip while it is
+ *        counted
+ *
+ * @param userdata Pointer to the application context (@e context_td *)
+ *
+ * @return @e G_SOURCE_CONTINUE (removed when the job is done)
+ */
+static gboolean s_timeline_tick(gpointer userdata)
+{
+    context_td *s = userdata;
+
+    gtk_widget_queue_draw(s->timeline_area);
+
+    return G_SOURCE_CONTINUE;
+}
+
+
+/**
+ * @brief Body of the job counting a timeline
+ *
+ * @param job  Job handle
+ * @param data Counting (@e s_timeline_job_td *)
+ *
+ * @return Result of @a timeline_count()
+ */
+static int s_timeline_job_run(job_td *job, void *data)
+{
+    s_timeline_job_td *d = data;
+
+    return timeline_count(job, d->filename, d->t);
+}
+
+
+/**
+ * @brief Completion callback of the job counting a timeline
+ *
+ * Releases the timeline if the table changed meanwhile.
+ *
+ * @param job  Job handle (unused)
+ * @param rc   Result of the job (unused: uncounted buckets show it)
+ * @param data Counting (@e s_timeline_job_td *)
+ */
+static void s_timeline_job_done(job_td *job, int rc, void *data)
+{
+    (void) job;
+    (void) rc;
+    s_timeline_job_td *d = data;
+    context_td *s = d->s;
+
+    g_source_remove(d->timer);
+    if (d->t == s->timeline) {
+        s->timeline_job = NULL;
+    } else {
+        timeline_free(d->t);
+    }
+    gtk_widget_queue_draw(s->timeline_area);
+    g_free(d->filename);
+    g_free(d);
+}
+
+
+/**
+ * @brief Drop the timeline of the current table and hide its strip
+ *
+ * A timeline still being counted is released when its job is done.
+ *
+ * @param s Pointer to the application context
+ */
+static void s_timeline_release(context_td *s)
+{
+    if (s->timeline_job) {
+        job_cancel(s->timeline_job);
+        s->timeline_job = NULL;
+    } else {
+        timeline_free(s->timeline);
+    }
+    s->timeline = NULL;
+    if (s->timeline_area) {
+        gtk_widget_hide(s->timeline_area);
+    }
+}
+
+
+/**
+ * @brief Show the timeline strip of a table with an indexed timestamp
+ *        column and count its histogram in the background
+ *
+ * @param s     Pointer to the application context
+ * @param tname Table shown
+ */
+static void s_show_timeline(context_td *s, const char *tname)
+{
+    s_timeline_release(s);
+
+    char *column = NULL;
+    if (!s->filename || timeline_find_column(s->db, tname, &column)
+            != SQLITE_OK || !column
+            || timeline_new(s->db, tname, column, &s->timeline)
+            != SQLITE_OK) {
+        g_free(column);
+        return;     /* No timeline: the strip stays hidden */
+    }
+    g_free(column);
+
+    s_timeline_job_td *d = g_new0(s_timeline_job_td, 1);
+    d->s = s;
+    d->t = s->timeline;
+    d->filename = g_strdup(s->filename);
+    d->timer = g_timeout_add(250, s_timeline_tick, s);
+    s->timeline_job = job_start("timeline", s_timeline_job_run,
+            s_timeline_job_done, d);
+    gtk_widget_show(s->timeline_area);
+}
+
+
+/**
+ * @brief Handler for the "draw" signal of the timeline strip: draw the
+ *        row density histogram, uncounted buckets greyed
+ *
+ * @param w        Drawing area
+ * @param cr       Cairo context
+ * @param userdata Pointer to the application context (@e context_td *)
+ *
+ * @return @c FALSE, to let the default handler run
+ */
+static gboolean s_on_timeline_draw(GtkWidget *w, cairo_t *cr,
+        gpointer userdata)
+{
+    context_td *s = userdata;
+    double width = gtk_widget_get_allocated_width(w);
+    double height = gtk_widget_get_allocated_height(w);
+
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    cairo_paint(cr);
+    if (!s->timeline) {
+        return FALSE;
+    }
+
+    sqlite3_int64 counts[TIMELINE_BUCKETS];
+    sqlite3_int64 max = timeline_counts(s->timeline, counts);
+    double bw = width / TIMELINE_BUCKETS;
+    for (int b = 0; b < TIMELINE_BUCKETS; ++b) {
+        double h = (counts[b] < 0) ? height
+            : (max > 0) ? (height - 14.0) * (double) counts[b]
+            / (double) max : 0.0;
+        if (counts[b] < 0) {
+            cairo_set_source_rgb(cr, 0.92, 0.92, 0.92);
+        } else {
+            cairo_set_source_rgb(cr, 0.1, 0.3, 0.7);
+        }
+        cairo_rectangle(cr, b * bw, height - h, MAX(bw - 1.0, 1.0), h);
+        cairo_fill(cr);
+    }
+
+    /* Range of the timeline, in the top corners */
+    char first[64], last[64];
+    cairo_text_extents_t ext;
+    timeline_describe(s->timeline, 0.0, first, sizeof(first));
+    timeline_describe(s->timeline, 1.0, last, sizeof(last));
+    cairo_set_source_rgb(cr, 0.2, 0.2, 0.2);
+    cairo_set_font_size(cr, 10.0);
+    cairo_move_to(cr, 2.0, 10.0);
+    cairo_show_text(cr, first);
+    cairo_text_extents(cr, last, &ext);
+    cairo_move_to(cr, width - ext.x_advance - 2.0, 10.0);
+    cairo_show_text(cr, last);
+
+    return FALSE;
+}
+
+
+/**
+ * @brief Handler for the "query-tooltip" signal of the timeline strip:
+ *        describe the time and the rows under the pointer
+ *
+ * @param w        Drawing area
+ * @param x        Pointer X
+ * @param y        Pointer Y (unused)
+ * @param keyboard Whether the tooltip was asked from the keyboard
+ *                 (unused)
+ * @param tooltip  Tooltip to fill
+ * @param userdata Pointer to the application context (@e context_td *)
+ *
+ * @return @c TRUE if there is a tooltip to show
+ */
+static gboolean s_on_timeline_tooltip(GtkWidget *w, gint x, gint y,
+        gboolean keyboard, GtkTooltip *tooltip, gpointer userdata)
+{
+    (void) y;
+    (void) keyboard;
+    context_td *s = userdata;
+    int width = gtk_widget_get_allocated_width(w);
+
+    if (!s->timeline || width <= 0) {
+        return FALSE;
+    }
+
+    double frac = (double) x / width;
+    int b = CLAMP((int) (frac * TIMELINE_BUCKETS), 0, TIMELINE_BUCKETS - 1);
+    sqlite3_int64 counts[TIMELINE_BUCKETS];
+    timeline_counts(s->timeline, counts);
+    char when[64], text[160];
+    timeline_describe(s->timeline, frac, when, sizeof(when));
+    if (counts[b] < 0) {
+        snprintf(text, sizeof(text), "%s (counting...)", when);
+    } else {
+        snprintf(text, sizeof(text), "%s (%lld rows around)", when,
+                (long long) counts[b]);
+    }
+    gtk_tooltip_set_text(tooltip, text);
+
+    return TRUE;
+}
+
+
+/**
+ * @brief Handler for the "button-press-event" signal of the timeline
+ *        strip: show the rows from the time clicked on (first button),
+ *        or from the start of the table again (third button)
+ *
+ * @param w        Drawing area
+ * @param ev       Button event
+ * @param userdata Pointer to the application context (@e context_td *)
+ *
+ * @return @c TRUE if the rows view moved, @c FALSE otherwise
+ */
+static gboolean s_on_timeline_button(GtkWidget *w, GdkEventButton *ev,
+        gpointer userdata)
+{
+    context_td *s = userdata;
+    int width = gtk_widget_get_allocated_width(w);
+
+    if (!s->timeline || !s->current_tablename || width <= 0
+            || (ev->button != 1 && ev->button != 3)) {
+        return FALSE;
+    }
+
+    sqlite3_free(s->seek_column);
+    sqlite3_free(s->seek_from);
+    s->seek_column = NULL;
+    s->seek_from = NULL;
+    if (ev->button == 1) {
+        s->seek_from = timeline_seek(s->timeline, ev->x / width);
+        s->seek_column = (s->seek_from) ? sqlite3_mprintf("%s",
+                timeline_column(s->timeline)) : NULL;
+    }
+    session_log(s->session, "seek", (s->seek_column) ? s->seek_column
+            : "", (s->seek_from) ? s->seek_from : "", NULL);
+
+    char *tname = g_strdup(s->current_tablename);
+    s_show_table(s, tname);
+    g_free(tname);
+
+    return TRUE;
+}
+
+
+/**
+ * @brief Describe the counters of the last fill of the rows view
+ *
+ * The rows visited by each loop are the tooltip where the library
+ * gives them, otherwise the query plan.
+ *
+ * @param s Pointer to the application context
+ */
+static void s_show_rows_stats(context_td *s)
+{
+    if (!s->rows_stats_label) {
+        return;
+    }
+
+    const query_stats_td *st = &s->rows_stats;
+    char msg[512], counters[256];
+    if (s->rows_cached) {
+        snprintf(msg, sizeof(msg), "%lld row%s in %.3f ms, from cached rows",
+                (long long) st->nrows, (st->nrows == 1) ? "" : "s",
+                (double) st->usec / 1000.0);
+    } else {
+        query_describe_stats(st, counters, sizeof(counters));
+        snprintf(msg, sizeof(msg), "%lld row%s in %.3f ms, %s",
+                (long long) st->nrows, (st->nrows == 1) ? "" : "s",
+                (double) st->usec / 1000.0, counters);
+    }
+    gtk_label_set_text(GTK_LABEL(s->rows_stats_label), msg);
+    gtk_widget_set_tooltip_text(s->rows_stats_label,
+            (st->loops) ? st->loops : st->plan);
+}
+
+
+/**
+ * @brief Show a table in the rows view
+ *
+ * Populate the rows view from the database via @a db_populate_rows()
+ * and match the pooled columns to it (see @a s_sync_columns()); the
+ * filter entry shows the condition on the rows, and the label below
+ * the counters of the fill (see @a s_show_rows_stats()).  Offer
+ * recovery if the table cannot be read because the file is damaged.
+ *
+ * @param s     Pointer to the application context
+ * @param tname Table to show
+ */
+static void s_show_table(context_td *s, const char *tname)
+{
+    session_log(s->session, "table", tname, NULL);
+    int rc = db_populate_rows(s, tname);
+    if (s->filter_entry) {
+        gtk_entry_set_text(GTK_ENTRY(s->filter_entry),
+                (s->row_filter) ? s->row_filter : "");
+    }
+    if (rc != SQLITE_OK) {
+        const char *errmsg = s->db
+            ? sqlite3_errmsg(s->db)
+            : "Unknown DB error";
+        char msg[1024];
+        snprintf(msg, sizeof(msg),
+                "Failed to populate rows: %s", errmsg);
+        if (((rc & 0xff) == SQLITE_CORRUPT
+                    || (rc & 0xff) == SQLITE_NOTADB)
+                && s->filename) {
+            s_offer_recovery(s, s->filename, msg);
+        } else {
+            s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        }
+    }
+    s_sync_columns(s);
+    s_show_rows_stats(s);
+}
+
+
+/**
+ * @brief Handler for table selection changes in the tables list
+ *
+ * When a table is selected, show it in the rows view (see
+ * @a s_show_table()).
+ *
+ * @param sel      The @e GtkTreeSelection that changed
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_table_selected(GtkTreeSelection *sel,
+        gpointer userdata)
+{
+    context_td *s = userdata;
+    GtkTreeIter iter;
+    GtkTreeModel *model;
+    if (gtk_tree_selection_get_selected(sel, &model, &iter)) {
+        gchar *tname = NULL;
+        gtk_tree_model_get(model, &iter, 0, &tname, -1);
+        if (tname) {
+            s_show_table(s, tname);
+            s_show_timeline(s, tname);
+            g_free(tname);
+        } /* ! if (tname) */
+    } /* ! if (gtk_tree_selection_get_selected) */
+}
+
+
+/**
+ * @brief Describe the estimate of the filter being typed
+ *
+ * Runs once typing pauses for @e UI_ESTIMATE_DELAY_MS.  Nothing is
+ * read but the schema and the statistics (see @a estimate_filter()),
+ * so it takes no longer on a huge table than on a small one; the query
+ * plan is the tooltip.
+ *
+ * @param userdata Pointer to the application context (@e context_td *)
+ *
+ * @return @c G_SOURCE_REMOVE
+ */
+static gboolean s_estimate_tick(gpointer userdata)
+{
+    context_td *s = userdata;
+    const char *text = gtk_entry_get_text(GTK_ENTRY(s->filter_entry));
+    GtkLabel *label = GTK_LABEL(s->estimate_label);
+    estimate_td e;
+
+    s->estimate_timer = 0;
+    if (!s->db || !s->current_tablename || !*text) {
+        gtk_label_set_text(label, "");
+        gtk_widget_set_tooltip_text(s->estimate_label, NULL);
+        return G_SOURCE_REMOVE;
+    }
+
+    char msg[512];
+    if (estimate_filter(s->db, s->current_tablename, text,
+                SQL_QUERY_MAX_LIMIT, &e) != SQLITE_OK) {
+        snprintf(msg, sizeof(msg), "Invalid filter: %s",
+                sqlite3_errmsg(s->db));
+    } else {
+        snprintf(msg, sizeof(msg), "~%.0f of %.0f rows match; %s%s%s,"
+                " reads ~%.0f rows; %s", e.rows, e.total,
+                (e.index) ? "searches " : "",
+                (e.index) ? e.index : "", (e.full_scan) ? ((e.index)
+                    ? " and scans the table" : "scans the table") : "",
+                e.visited, (e.basis == ESTIMATE_STAT4) ? "from samples"
+                : (e.basis == ESTIMATE_STAT1) ? "from averages"
+                : "partly guessed (ANALYZE would help)");
+    }
+    gtk_label_set_text(label, msg);
+    gtk_widget_set_tooltip_text(s->estimate_label, e.plan);
+    estimate_clear(&e);
+
+    return G_SOURCE_REMOVE;
+}
+
+
+/**
+ * @brief Handler for edits of the filter entry: estimate the filter
+ *        once typing pauses
+ *
+ * @param entry    Filter entry (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_filter_changed(GtkEditable *entry, gpointer userdata)
+{
+    (void) entry;
+    context_td *s = userdata;
+
+    if (s->estimate_timer) {
+        g_source_remove(s->estimate_timer);
+    }
+    s->estimate_timer = g_timeout_add(UI_ESTIMATE_DELAY_MS,
+            s_estimate_tick, s);
+}
+
+
+/**
+ * @brief Handler for Enter in the filter entry: show the rows of the
+ *        current table matching it
+ *
+ * A filter estimated to scan more than @e UI_FILTER_SCAN_ASK rows is
+ * only run once confirmed.  An empty entry drops the filter.
+ *
+ * @param entry    Filter entry
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_filter_activate(GtkEntry *entry, gpointer userdata)
+{
+    context_td *s = userdata;
+    const char *text = gtk_entry_get_text(entry);
+    estimate_td e;
+
+    if (!s->db || !s->current_tablename) {
+        return;
+    }
+    if (*text && estimate_filter(s->db, s->current_tablename, text,
+                SQL_QUERY_MAX_LIMIT, &e) != SQLITE_OK) {
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Invalid filter: %s",
+                sqlite3_errmsg(s->db));
+        estimate_clear(&e);
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        return;
+    } else if (*text) {
+        int ask = (e.full_scan && e.visited > UI_FILTER_SCAN_ASK);
+        char msg[512];
+        snprintf(msg, sizeof(msg), "This filter scans the table and "
+                "reads about %.0f rows (an estimate).  Run it anyway?",
+                e.visited);
+        estimate_clear(&e);
+        if (ask && !s_ask_question(GTK_WINDOW(s->win), msg)) {
+            return;
+        }
+    }
+
+    char *filter = (*text) ? sqlite3_mprintf("%s", text) : NULL;
+    sqlite3_free(s->row_filter);
+    s->row_filter = filter;
+    session_log(s->session, "filter", text, NULL);
+    char *tname = g_strdup(s->current_tablename);
+    s_show_table(s, tname);
+    g_free(tname);
+}
+
+
+/**
+ * @brief Show an "Open DB" file chooser, open the selected SQLite DB
+ *        and list tables
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ *
+ * @note Displays error or info dialogs on failure
+ * @note Uses @a db_is_sqlite(), @a db_open() and @a db_fill_table_list()
+ */
+static void s_on_open(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    GtkWidget *dlg = gtk_file_chooser_dialog_new("Open SQLite DB",
+            GTK_WINDOW(s->win), GTK_FILE_CHOOSER_ACTION_OPEN,
+            "_Cancel", GTK_RESPONSE_CANCEL,
+            "_Open", GTK_RESPONSE_ACCEPT, NULL);
+
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT) {
+        char *filename =
+            gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dlg));
+        if (filename) {
+            if (!db_is_sqlite(filename)) {
+                char msg[1024];
+                snprintf(msg, sizeof(msg),
+                        "Cannot open file '%s': not an SQLite database", 
+                        filename);
+                s_offer_recovery(s, filename, msg);
+                g_free(filename);
+                gtk_widget_destroy(dlg);
+                return;
+            }
+            s_timeline_release(s);
+            int rc = db_open(s, filename);
+            if (rc != SQLITE_OK) {
+                const char *errmsg = s->db
+                    ? sqlite3_errmsg(s->db)
+                    : sqlite3_errstr(rc);
+                char msg[1024];
+                snprintf(msg, sizeof(msg),
+                        "Failed to open database: %s", errmsg);
+                s_show_error_dialog(GTK_WINDOW(s->win), msg);
+                db_close(s);
+                g_free(filename);
+                gtk_widget_destroy(dlg);
+                return;
+            }
+            session_log(s->session, "open", filename, NULL);
+            rc = db_fill_table_list(s);
+            if (rc != SQLITE_OK) {
+                const char *errmsg = s->db
+                    ? sqlite3_errmsg(s->db)
+                    : sqlite3_errstr(rc);
+                char msg[1024];
+                snprintf(msg, sizeof(msg),
+                        "Opened database but failed to list tables: %s",
+                        errmsg);
+                s_show_info_dialog(GTK_WINDOW(s->win), msg);
+            }
+            g_free(filename);
+        }
+    }
+    gtk_widget_destroy(dlg);
+}
+
+
+/**
+ * @brief Write the edits of the overlay to the open file, in one short
+ *        transaction, and show the result
+ *
+ * @param s Pointer to the application context, in overlay mode
+ */
+static void s_apply_overlay(context_td *s)
+{
+    int applied = 0, conflicts = 0;
+    char *errmsg = NULL;
+    char msg[1024];
+
+    int rc = overlay_apply(s->overlay, s->filename, &applied, &conflicts,
+            &errmsg);
+    if (rc == SQLITE_ABORT) {
+        snprintf(msg, sizeof(msg), "Nothing was applied: %d edited "
+                "cell(s) were changed in the file since they were edited.",
+                conflicts);
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+    } else if (rc != SQLITE_OK) {
+        snprintf(msg, sizeof(msg), "Failed to apply the edits: %s",
+                (errmsg) ? errmsg : sqlite3_errstr(rc));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+    } else {
+        snprintf(msg, sizeof(msg), "Applied %d edited cell(s).", applied);
+        s_show_info_dialog(GTK_WINDOW(s->win), msg);
+    }
+    g_free(errmsg);
+
+    if (rc == SQLITE_OK && s->current_tablename) {
+        char *tname = g_strdup(s->current_tablename);
+        s_show_table(s, tname);
+        g_free(tname);
+    }
+}
+
+
+/**
+ * @brief Handler for the overlay mode toggle: reopen the file read-only
+ *        with its overlay, or read-write without it
+ *
+ * Leaving overlay mode offers to apply the pending edits; those not
+ * applied stay in the side file for the next time.
+ *
+ * @param btn      Toggle button
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_overlay_toggled(GtkToggleButton *btn, gpointer userdata)
+{
+    context_td *s = userdata;
+    int active = gtk_toggle_button_get_active(btn);
+
+    if (active == s->overlay_mode) {
+        return;
+    }
+    sqlite3_int64 pending = (!active) ? overlay_count(s->overlay) : 0;
+    if (pending > 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "Apply the %lld edited cell(s) to the "
+                "file now?  Otherwise they are kept aside for the next "
+                "time.", (long long) pending);
+        if (s_ask_question(GTK_WINDOW(s->win), msg)) {
+            s_apply_overlay(s);
+        }
+    }
+    s->overlay_mode = active;
+    if (!s->filename) {
+        return;
+    }
+
+    char *filename = g_strdup(s->filename);
+    char *tname = (s->current_tablename)
+        ? g_strdup(s->current_tablename) : NULL;
+    int rc = db_open(s, filename);
+    if (rc != SQLITE_OK) {
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Failed to reopen database: %s",
+                (s->overlay_mode && s->db && !s->overlay)
+                ? "cannot open the overlay" : s->db
+                ? sqlite3_errmsg(s->db) : sqlite3_errstr(rc));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        db_close(s);
+    } else if (tname) {
+        s_show_table(s, tname);
+    }
+    g_free(tname);
+    g_free(filename);
+}
+
+
+/**
+ * @brief Apply the edits of the overlay to the open file
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_apply_overlay(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    sqlite3_int64 pending = (s->overlay) ? overlay_count(s->overlay) : 0;
+    char msg[256];
+
+    if (!s->overlay) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "Edits are kept aside only "
+                "in overlay mode.");
+        return;
+    } else if (pending <= 0) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "There are no edits to "
+                "apply.");
+        return;
+    }
+    snprintf(msg, sizeof(msg), "Write the %lld edited cell(s) to the file "
+            "in one transaction?", (long long) pending);
+    if (s_ask_question(GTK_WINDOW(s->win), msg)) {
+        s_apply_overlay(s);
+    }
+}
+
+
+/**
+ * @brief Ask for the columns to compare and start a duplicate search
+ *        over the current table
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ *
+ * @note The search runs as a background job (see @a dup_find())
+ */
+static void s_on_find_duplicates(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    if (!s->db || !s->filename || !s->current_tablename
+            || s->current_ncols < 2) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "Select a table first.");
+        return;
+    }
+
+    GtkWidget *dlg = gtk_dialog_new_with_buttons("Find duplicate rows",
+            GTK_WINDOW(s->win), GTK_DIALOG_MODAL,
+            "_Cancel", GTK_RESPONSE_CANCEL,
+            "_Find", GTK_RESPONSE_ACCEPT, NULL);
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    GtkWidget *sc = gtk_scrolled_window_new(NULL, NULL);
+    gtk_widget_set_size_request(sc, 300, 300);
+    gtk_container_add(GTK_CONTAINER(sc), box);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(
+                    GTK_DIALOG(dlg))), sc, TRUE, TRUE, 0);
+
+    /* Column 0 is 'rowid', unique by definition */
+    GtkWidget **checks = g_new0(GtkWidget*, s->current_ncols);
+    for (int i = 1; i < s->current_ncols; ++i) {
+        checks[i] = gtk_check_button_new_with_label(
+                s->current_colnames[i]);
+        gtk_box_pack_start(GTK_BOX(box), checks[i], FALSE, FALSE, 0);
+    }
+    gtk_widget_show_all(dlg);
+
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT) {
+        s_dup_job_td *d = g_new0(s_dup_job_td, 1);
+        d->cols = g_new0(char*, s->current_ncols);
+        for (int i = 1; i < s->current_ncols; ++i) {
+            if (gtk_toggle_button_get_active(
+                        GTK_TOGGLE_BUTTON(checks[i]))) {
+                d->cols[d->ncols++] = g_strdup(s->current_colnames[i]);
+            }
+        }
+        if (d->ncols == 0) {
+            g_strfreev(d->cols);
+            g_free(d);
+            s_show_info_dialog(GTK_WINDOW(s->win),
+                    "Select at least one column.");
+        } else {
+            d->s = s;
+            d->filename = g_strdup(s->filename);
+            d->table = g_strdup(s->current_tablename);
+            job_td *job = job_start("dup-find", s_dup_job_run,
+                    s_dup_job_done, d);
+            d->progress = s_progress_new(s, "Finding duplicates", job);
+        }
+    }
+    g_free(checks);
+    gtk_widget_destroy(dlg);
+}
+
+
+/**
+ * @brief Ask for a column and a directory and start extracting the
+ *        BLOBs of the current table to files
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ *
+ * @note The extraction runs as a background job (see
+ *       @a extract_blobs())
+ */
+static void s_on_extract_blobs(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    if (!s->db || !s->filename || !s->current_tablename
+            || s->current_ncols < 2) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "Select a table first.");
+        return;
+    }
+
+    GtkWidget *dlg = gtk_dialog_new_with_buttons("Extract BLOBs",
+            GTK_WINDOW(s->win), GTK_DIALOG_MODAL,
+            "_Cancel", GTK_RESPONSE_CANCEL,
+            "_Extract", GTK_RESPONSE_ACCEPT, NULL);
+    GtkWidget *grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 6);
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 6);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(
+                    GTK_DIALOG(dlg))), grid, TRUE, TRUE, 6);
+
+    /* Column 0 is 'rowid' */
+    GtkWidget *combo = gtk_combo_box_text_new();
+    for (int i = 1; i < s->current_ncols; ++i) {
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo),
+                s->current_colnames[i]);
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(combo), 0);
+    GtkWidget *folder = gtk_file_chooser_button_new("Output directory",
+            GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Column"), 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), combo, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Directory"),
+            0, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), folder, 1, 1, 1, 1);
+    gtk_widget_show_all(dlg);
+
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT) {
+        char *column = gtk_combo_box_text_get_active_text(
+                GTK_COMBO_BOX_TEXT(combo));
+        char *dir = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(folder));
+        if (!column || !dir) {
+            g_free(column);
+            g_free(dir);
+            s_show_info_dialog(GTK_WINDOW(s->win),
+                    "Select a column and a directory.");
+        } else {
+            s_extract_job_td *d = g_new0(s_extract_job_td, 1);
+            d->s = s;
+            d->filename = g_strdup(s->filename);
+            d->table = g_strdup(s->current_tablename);
+            d->column = column;
+            d->dir = dir;
+            job_td *job = job_start("extract", s_extract_job_run,
+                    s_extract_job_done, d);
+            d->progress = s_progress_new(s, "Extracting BLOBs", job);
+        }
+    }
+    gtk_widget_destroy(dlg);
+}
+
+
+/**
+ * @brief Ask for a column and a file and import the file into that
+ *        cell of the selected row
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ *
+ * @note The import runs as a background job (see @a import_blob_file())
+ */
+static void s_on_import_file(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    GtkTreeSelection *sel =
+        gtk_tree_view_get_selection(GTK_TREE_VIEW(s->rows_view));
+    GtkTreeModel *model = NULL;
+    GList *rows = gtk_tree_selection_get_selected_rows(sel, &model);
+    GtkTreeIter iter;
+    if (!s->db || !s->filename || !s->current_tablename
+            || s->current_ncols < 2 || !rows || rows->next
+            || !gtk_tree_model_get_iter(model, &iter, rows->data)) {
+        g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+        s_show_info_dialog(GTK_WINDOW(s->win),
+                "Select a single row first.");
+        return;
+    }
+    g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+    if (!s_check_writable(s)) {
+        return;
+    }
+    gchar *rowid_text = NULL;
+    gtk_tree_model_get(model, &iter, 0, &rowid_text, -1);
+    if (!rowid_text) {
+        return;
+    }
+
+    GtkWidget *dlg = gtk_dialog_new_with_buttons("Import file into cell",
+            GTK_WINDOW(s->win), GTK_DIALOG_MODAL,
+            "_Cancel", GTK_RESPONSE_CANCEL,
+            "_Import", GTK_RESPONSE_ACCEPT, NULL);
+    GtkWidget *grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 6);
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 6);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(
+                    GTK_DIALOG(dlg))), grid, TRUE, TRUE, 6);
+
+    /* Column 0 is 'rowid' */
+    GtkWidget *combo = gtk_combo_box_text_new();
+    for (int i = 1; i < s->current_ncols; ++i) {
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo),
+                s->current_colnames[i]);
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(combo), 0);
+    GtkWidget *file = gtk_file_chooser_button_new("File to import",
+            GTK_FILE_CHOOSER_ACTION_OPEN);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Column"), 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), combo, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("File"), 0, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), file, 1, 1, 1, 1);
+    gtk_widget_show_all(dlg);
+
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT) {
+        char *column = gtk_combo_box_text_get_active_text(
+                GTK_COMBO_BOX_TEXT(combo));
+        char *path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(file));
+        if (!column || !path) {
+            g_free(column);
+            g_free(path);
+            s_show_info_dialog(GTK_WINDOW(s->win),
+                    "Select a column and a file.");
+        } else {
+            s_import_job_td *d = g_new0(s_import_job_td, 1);
+            d->s = s;
+            d->filename = g_strdup(s->filename);
+            d->table = g_strdup(s->current_tablename);
+            d->column = column;
+            d->rowid = g_ascii_strtoll(rowid_text, NULL, 10);
+            d->path = path;
+            job_td *job = job_start("import", s_import_job_run,
+                    s_import_job_done, d);
+            d->progress = s_progress_new(s, "Importing file", job);
+        }
+    }
+    g_free(rowid_text);
+    gtk_widget_destroy(dlg);
+}
+
+
+/**
+ * @brief Execute an SQL script file on the open database
+ *
+ * The script is streamed statement by statement in a background job
+ * (see @a script_run_file()), so files of any size can be run.
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_run_script(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    if (!s->filename) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "Open a database first.");
+        return;
+    } else if (!s_check_writable(s)) {
+        return;
+    }
+
+    GtkWidget *dlg = gtk_file_chooser_dialog_new("Run SQL file",
+            GTK_WINDOW(s->win), GTK_FILE_CHOOSER_ACTION_OPEN,
+            "_Cancel", GTK_RESPONSE_CANCEL,
+            "_Run", GTK_RESPONSE_ACCEPT, NULL);
+
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT) {
+        char *path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dlg));
+        if (path) {
+            s_script_job_td *d = g_new0(s_script_job_td, 1);
+            d->s = s;
+            d->filename = g_strdup(s->filename);
+            d->path = path;
+            job_td *job = job_start("script", s_script_job_run,
+                    s_script_job_done, d);
+            d->progress = s_progress_new(s, "Running SQL file", job);
+        }
+    }
+    gtk_widget_destroy(dlg);
+}
+
+
+/**
+ * @brief Insert a row with default values into the current table and
+ *        select it
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_insert_row(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    if (!s->db || !s->current_tablename) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "Select a table first.");
+        return;
+    }
+    if (!s_check_writable(s)) {
+        return;
+    }
+
+    GtkTreeIter iter;
+    int rc = db_insert_row(s, &iter);
+    if (rc != SQLITE_OK) {
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Failed to insert row: %s",
+                sqlite3_errmsg(s->db));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        return;
+    }
+    session_log(s->session, "insert", NULL);
+
+    GtkTreeView *tv = GTK_TREE_VIEW(s->rows_view);
+    GtkTreePath *path =
+        gtk_tree_model_get_path(gtk_tree_view_get_model(tv), &iter);
+    gtk_tree_selection_unselect_all(gtk_tree_view_get_selection(tv));
+    gtk_tree_selection_select_path(gtk_tree_view_get_selection(tv), path);
+    gtk_tree_view_scroll_to_cell(tv, path, NULL, FALSE, 0.0f, 0.0f);
+    gtk_tree_path_free(path);
+}
+
+
+/**
+ * @brief Delete the selected rows of the current table after
+ *        confirmation
+ *
+ * All rows are deleted in one transaction; on success they are removed
+ * from the model one by one instead of reloading the table.
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_delete_rows(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    GtkTreeSelection *sel =
+        gtk_tree_view_get_selection(GTK_TREE_VIEW(s->rows_view));
+    GtkTreeModel *model = NULL;
+    GList *rows = gtk_tree_selection_get_selected_rows(sel, &model);
+    if (!s->db || !s->current_tablename || !rows) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "Select rows first.");
+        return;
+    }
+    if (!s_check_writable(s)) {
+        g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+        return;
+    }
+
+    /* Row references survive the removal of the rows before them */
+    int n = (int) g_list_length(rows);
+    sqlite3_int64 *rowids = g_new(sqlite3_int64, n);
+    GtkTreeRowReference **refs = g_new(GtkTreeRowReference*, n);
+    int i = 0;
+    for (GList *l = rows; l; l = l->next, ++i) {
+        GtkTreeIter iter;
+        gchar *rowid_text = NULL;
+        gtk_tree_model_get_iter(model, &iter, l->data);
+        gtk_tree_model_get(model, &iter, 0, &rowid_text, -1);
+        rowids[i] = (rowid_text) ? g_ascii_strtoll(rowid_text, NULL, 10)
+            : 0;
+        refs[i] = gtk_tree_row_reference_new(model, l->data);
+        g_free(rowid_text);
+    }
+    g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+
+    char msg[1024];
+    snprintf(msg, sizeof(msg), "Delete %d row%s from '%s'?", n,
+            (n == 1) ? "" : "s", s->current_tablename);
+    if (s_ask_question(GTK_WINDOW(s->win), msg)) {
+        int rc = db_delete_rows(s, rowids, n);
+        if (rc != SQLITE_OK) {
+            snprintf(msg, sizeof(msg), "Failed to delete rows: %s",
+                    sqlite3_errmsg(s->db));
+            s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        } else {
+            GString *ids = g_string_new(NULL);
+            for (i = 0; i < n; ++i) {
+                g_string_append_printf(ids, "%s%lld", (i) ? " " : "",
+                        (long long) rowids[i]);
+            }
+            session_log(s->session, "delete", ids->str, NULL);
+            g_string_free(ids, TRUE);
+            for (i = 0; i < n; ++i) {
+                GtkTreePath *path = gtk_tree_row_reference_get_path(refs[i]);
+                GtkTreeIter iter;
+                if (path && gtk_tree_model_get_iter(model, &iter, path)) {
+                    gtk_list_store_remove(GTK_LIST_STORE(model), &iter);
+                }
+                gtk_tree_path_free(path);
+            }
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        gtk_tree_row_reference_free(refs[i]);
+    }
+    g_free(refs);
+    g_free(rowids);
+}
+
+
+/**
+ * @struct s_form_td
+ *
+ * @brief State of the record form of one row
+ */
+typedef struct {
+    context_td *s;          /**< Application context */
+    sqlite3_int64 rowid;    /**< Row shown in the form */
+    GtkListStore *store;    /**< One model row per column: name, value */
+    GtkTreeView *tv;        /**< Form view */
+    guint8 *loaded;         /**< Non-zero for groups already fetched */
+    int ngroups;            /**< Number of column groups */
+} s_form_td;
+
+
+/**
+ * @brief Fetch the groups of columns visible in the record form
+ *
+ * @param adj      Vertical adjustment of the form (unused)
+ * @param userdata Form state (@e s_form_td *)
+ */
+static void s_form_fetch_visible(GtkAdjustment *adj, gpointer userdata)
+{
+    (void) adj;
+    s_form_td *f = userdata;
+    GtkTreePath *start = NULL;
+    GtkTreePath *end = NULL;
+
+    if (!gtk_tree_view_get_visible_range(f->tv, &start, &end)) {
+        return;
+    }
+    int first = gtk_tree_path_get_indices(start)[0] / UI_FORM_GROUP;
+    int last = gtk_tree_path_get_indices(end)[0] / UI_FORM_GROUP;
+    gtk_tree_path_free(start);
+    gtk_tree_path_free(end);
+
+    char *values[UI_FORM_GROUP];
+    for (int g = first; g <= last && g < f->ngroups; ++g) {
+        if (f->loaded[g]) {
+            continue;
+        }
+        /* Model row i is column i + 1 ('rowid' is not listed) */
+        int col = 1 + g * UI_FORM_GROUP;
+        int n = MIN(UI_FORM_GROUP, f->s->current_ncols - col);
+        memset(values, 0, sizeof(values));
+        if (f->s->session) {
+            char srowid[32], scol[16], scount[16];
+            snprintf(srowid, sizeof(srowid), "%lld", (long long) f->rowid);
+            snprintf(scol, sizeof(scol), "%d", col);
+            snprintf(scount, sizeof(scount), "%d", n);
+            session_log(f->s->session, "fetch", srowid, scol, scount,
+                    NULL);
+        }
+        if (db_fetch_record(f->s, f->rowid, col, n, DB_RECORD_MAX_VALUE,
+                    values) != SQLITE_OK) {
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            GtkTreeIter iter;
+            if (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(f->store),
+                        &iter, NULL, col - 1 + i)) {
+                gtk_list_store_set(f->store, &iter, 1,
+                        (values[i]) ? values[i] : "(unreadable)", -1);
+            }
+            free(values[i]);
+        }
+        f->loaded[g] = 1;
+    }
+}
+
+
+/**
+ * @brief Show the selected row of the rows view as a form
+ *
+ * Column names are listed at once; values are fetched in groups of
+ * @e UI_FORM_GROUP columns when they scroll into view, and long ones
+ * are truncated (see @a db_fetch_record()), so very wide rows open
+ * instantly.
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_record_form(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    GtkTreeSelection *sel =
+        gtk_tree_view_get_selection(GTK_TREE_VIEW(s->rows_view));
+    GtkTreeModel *model = NULL;
+    GList *rows = gtk_tree_selection_get_selected_rows(sel, &model);
+    GtkTreeIter iter;
+    if (!s->db || !s->current_tablename || s->current_ncols < 2 || !rows
+            || rows->next
+            || !gtk_tree_model_get_iter(model, &iter, rows->data)) {
+        g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+        s_show_info_dialog(GTK_WINDOW(s->win),
+                "Select a single row first.");
+        return;
+    }
+    g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+    gchar *rowid_text = NULL;
+    gtk_tree_model_get(model, &iter, 0, &rowid_text, -1);
+    if (!rowid_text) {
+        return;
+    }
+
+    s_form_td f;
+    memset(&f, 0, sizeof(f));
+    f.s = s;
+    f.rowid = g_ascii_strtoll(rowid_text, NULL, 10);
+    f.ngroups = (s->current_ncols - 1 + UI_FORM_GROUP - 1) / UI_FORM_GROUP;
+    f.loaded = g_new0(guint8, f.ngroups);
+    f.store = gtk_list_store_new(2, G_TYPE_STRING, G_TYPE_STRING);
+    for (int i = 1; i < s->current_ncols; ++i) {
+        gtk_list_store_insert_with_values(f.store, NULL, -1,
+                0, s->current_colnames[i], 1, "...", -1);
+    }
+
+    char title[256];
+    snprintf(title, sizeof(title), "Record %s of '%s'", rowid_text,
+            s->current_tablename);
+    GtkWidget *dlg = gtk_dialog_new_with_buttons(title,
+            GTK_WINDOW(s->win), GTK_DIALOG_MODAL,
+            "_Close", GTK_RESPONSE_CLOSE, NULL);
+    f.tv = GTK_TREE_VIEW(gtk_tree_view_new_with_model(
+                GTK_TREE_MODEL(f.store)));
+    g_object_unref(f.store);
+    const char *titles[] = { "Column", "Value" };
+    for (int i = 0; i < 2; ++i) {
+        GtkCellRenderer *r = gtk_cell_renderer_text_new();
+        g_object_set(r, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+        GtkTreeViewColumn *col = gtk_tree_view_column_new_with_attributes(
+                titles[i], r, "text", i, NULL);
+        gtk_tree_view_column_set_resizable(col, TRUE);
+        gtk_tree_view_append_column(f.tv, col);
+    }
+    GtkWidget *sc = gtk_scrolled_window_new(NULL, NULL);
+    gtk_widget_set_size_request(sc, 600, 500);
+    gtk_container_add(GTK_CONTAINER(sc), GTK_WIDGET(f.tv));
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(
+                    GTK_DIALOG(dlg))), sc, TRUE, TRUE, 0);
+
+    /* "changed" covers the first layout, "value-changed" scrolling */
+    GtkAdjustment *adj =
+        gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(sc));
+    g_signal_connect(adj, "changed", G_CALLBACK(s_form_fetch_visible), &f);
+    g_signal_connect(adj, "value-changed",
+            G_CALLBACK(s_form_fetch_visible), &f);
+    gtk_widget_show_all(dlg);
+    gtk_dialog_run(GTK_DIALOG(dlg));
+    g_signal_handlers_disconnect_by_data(adj, &f);
+    gtk_widget_destroy(dlg);
+
+    g_free(f.loaded);
+    g_free(rowid_text);
+}
+
+
+/**
+ * @struct s_json_td
+ *
+ * @brief State of the JSON explorer
+ */
+typedef struct {
+    context_td *s;          /**< Application context */
+    char *table;            /**< Table of the cell */
+    char *column;           /**< Column of the cell */
+    sqlite3_int64 rowid;    /**< Row of the cell */
+    GtkTreeStore *store;    /**< Nodes read so far */
+} s_json_td;
+
+
+/**
+ * @brief Handler for the "test-expand-row" signal of the JSON explorer:
+ *        read the children of the node
+ *
+ * @param tv       Tree view of the cell (unused)
+ * @param iter     Node being expanded
+ * @param path     Path of the node (unused)
+ * @param userdata JSON explorer (@e s_json_td *)
+ *
+ * @return @c FALSE, to let the node expand
+ */
+static gboolean s_on_json_expand(GtkTreeView *tv, GtkTreeIter *iter,
+        GtkTreePath *path, gpointer userdata)
+{
+    (void) tv;
+    (void) path;
+    s_json_td *j = userdata;
+
+    json_expand(j->s->db, j->table, j->column, j->rowid, j->store, iter);
+
+    return FALSE;
+}
+
+
+/**
+ * @brief Offer an index on a JSON path that a filter found slow
+ *
+ * @param s      Pointer to the application context
+ * @param column Column holding the JSON
+ * @param path   Path filtered on
+ * @param ms     Time the filtered rows took to load
+ */
+static void s_offer_json_index(context_td *s, const char *column,
+        const char *path, double ms)
+{
+    char *sql = NULL;
+    if (json_suggest_index(s->db, s->current_tablename, column, path,
+                &sql) != SQLITE_OK || !sql) {
+        return;
+    }
+
+    char *msg = g_strdup_printf("Filtering on %s%s took %.0f ms because "
+            "it scans the whole table.  Create an index on it?\n\n%s",
+            column, (path[0] == '$') ? path + 1 : path, ms, sql);
+    if (s_ask_question(GTK_WINDOW(s->win), msg) && s_check_writable(s)) {
+        if (sqlite3_exec(s->db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+            char err[1024];
+            snprintf(err, sizeof(err), "Failed to create the index: %s",
+                    sqlite3_errmsg(s->db));
+            s_show_error_dialog(GTK_WINDOW(s->win), err);
+        } else {
+            char *tname = g_strdup(s->current_tablename);
+            s_show_table(s, tname);
+            g_free(tname);
+        }
+    }
+    g_free(msg);
+    sqlite3_free(sql);
+}
+
+
+/**
+ * @brief Apply a choice of the JSON explorer to the rows view
+ *
+ * @param j        JSON explorer
+ * @param response @e UI_JSON_COLUMN, @e UI_JSON_FILTER or
+ *                 @e UI_JSON_RESET
+ * @param sel      Selection of the explorer
+ */
+static void s_json_apply(s_json_td *j, int response, GtkTreeSelection *sel)
+{
+    context_td *s = j->s;
+    GtkTreeModel *model = NULL;
+    GtkTreeIter iter;
+    gchar *path = NULL;
+    gchar *type = NULL;
+    gchar *value = NULL;
+
+    if (response != UI_JSON_RESET) {
+        if (gtk_tree_selection_get_selected(sel, &model, &iter)) {
+            gtk_tree_model_get(model, &iter, JSON_COL_PATH, &path,
+                    JSON_COL_TYPE, &type, JSON_COL_VALUE, &value, -1);
+        }
+        if (!path) {
+            s_show_info_dialog(GTK_WINDOW(s->win), "Select a node first.");
+            g_free(type);
+            g_free(value);
+            return;
+        }
+    }
+
+    char *filter = NULL;
+    if (response == UI_JSON_COLUMN) {
+        if (!s->json_columns) {
+            s->json_columns = g_ptr_array_new_with_free_func(
+                    json_column_free);
+        }
+        g_ptr_array_add(s->json_columns, json_column_new(j->column, path));
+    } else if (response == UI_JSON_FILTER) {
+        filter = json_filter_sql(j->column, path, type, value);
+        if (!filter) {
+            s_show_info_dialog(GTK_WINDOW(s->win),
+                    "Only values, not arrays or objects, can be filtered "
+                    "on.");
+        } else {
+            sqlite3_free(s->row_filter);
+            s->row_filter = filter;
+            session_log(s->session, "filter", filter, NULL);
+        }
+    } else {
+        db_reset_view(s);
+        session_log(s->session, "filter", "", NULL);
+        session_log(s->session, "seek", "", "", NULL);
+    }
+
+    if (response != UI_JSON_FILTER || filter) {
+        gint64 start = g_get_monotonic_time();
+        s_show_table(s, j->table);
+        double ms = (double) (g_get_monotonic_time() - start) / 1000.0;
+        if (filter && ms >= UI_JSON_SLOW_MS) {
+            s_offer_json_index(s, j->column, path, ms);
+        }
+    }
+    g_free(path);
+    g_free(type);
+    g_free(value);
+}
+
+
+/**
+ * @brief Explore the JSON of the cell under the cursor of the rows view
+ *
+ * The tree is read one level at a time as nodes are expanded (see
+ * @a json_expand()).  The selected path can be added as a column of the
+ * rows view or the rows filtered by the selected value; an index on the
+ * path is offered when the filter is slow.
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_explore_json(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    GtkTreeView *rows = GTK_TREE_VIEW(s->rows_view);
+    GtkTreePath *cursor = NULL;
+    GtkTreeViewColumn *col = NULL;
+    GtkTreeModel *model = gtk_tree_view_get_model(rows);
+    GtkTreeIter iter;
+    int colidx = -1;
+
+    gtk_tree_view_get_cursor(rows, &cursor, &col);
+    if (col) {
+        GtkCellRenderer *r = g_object_get_data(G_OBJECT(col),
+                "text-renderer");
+        colidx = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(r),
+                    "col-index"));
+    }
+    if (!s->db || !s->current_tablename || !cursor || colidx < 1
+            || colidx >= s->current_ncols
+            || !gtk_tree_model_get_iter(model, &iter, cursor)) {
+        gtk_tree_path_free(cursor);
+        s_show_info_dialog(GTK_WINDOW(s->win),
+                "Select a cell holding JSON first.");
+        return;
+    }
+    gtk_tree_path_free(cursor);
+    gchar *rowid_text = NULL;
+    gtk_tree_model_get(model, &iter, 0, &rowid_text, -1);
+    if (!rowid_text) {
+        return;
+    }
+
+    s_json_td j;
+    memset(&j, 0, sizeof(j));
+    j.s = s;
+    j.table = g_strdup(s->current_tablename);
+    j.column = g_strdup(s->current_colnames[colidx]);
+    j.rowid = g_ascii_strtoll(rowid_text, NULL, 10);
+    j.store = json_store_new();
+    g_free(rowid_text);
+    if (json_expand(s->db, j.table, j.column, j.rowid, j.store, NULL)
+            != SQLITE_OK) {
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Cannot read the cell as JSON: %s",
+                sqlite3_errmsg(s->db));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        g_object_unref(j.store);
+        g_free(j.column);
+        g_free(j.table);
+        return;
+    }
+
+    char title[256];
+    snprintf(title, sizeof(title), "JSON of %s, row %lld", j.column,
+            (long long) j.rowid);
+    GtkWidget *dlg = gtk_dialog_new_with_buttons(title, GTK_WINDOW(s->win),
+            GTK_DIALOG_MODAL, "_Reset view", UI_JSON_RESET,
+            "Add as _column", UI_JSON_COLUMN,
+            "_Filter rows", UI_JSON_FILTER,
+            "_Close", GTK_RESPONSE_CLOSE, NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dlg), 640, 480);
+
+    GtkWidget *tv = gtk_tree_view_new_with_model(GTK_TREE_MODEL(j.store));
+    const char *titles[] = { "Key", "Type", "Value" };
+    const int cols[] = { JSON_COL_KEY, JSON_COL_TYPE, JSON_COL_VALUE };
+    for (size_t i = 0; i < G_N_ELEMENTS(cols); ++i) {
+        GtkCellRenderer *r = gtk_cell_renderer_text_new();
+        g_object_set(r, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+        GtkTreeViewColumn *c = gtk_tree_view_column_new_with_attributes(
+                titles[i], r, "text", cols[i], NULL);
+        gtk_tree_view_column_set_resizable(c, TRUE);
+        gtk_tree_view_column_set_expand(c, cols[i] == JSON_COL_VALUE);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(tv), c);
+    }
+    g_signal_connect(tv, "test-expand-row", G_CALLBACK(s_on_json_expand),
+            &j);
+    GtkWidget *sc = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(sc), tv);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(
+                    GTK_DIALOG(dlg))), sc, TRUE, TRUE, 0);
+
+    gtk_widget_show_all(dlg);
+    int response = gtk_dialog_run(GTK_DIALOG(dlg));
+    if (response == UI_JSON_COLUMN || response == UI_JSON_FILTER
+            || response == UI_JSON_RESET) {
+        s_json_apply(&j, response,
+                gtk_tree_view_get_selection(GTK_TREE_VIEW(tv)));
+    }
+    gtk_widget_destroy(dlg);
+    g_object_unref(j.store);
+    g_free(j.column);
+    g_free(j.table);
+}
+
+
+/**
+ * @struct s_spatial_td
+ *
+ * @brief State of the spatial view
+ */
+typedef struct {
+    spatial_td *sp;         /**< Window over the table */
+    GtkWidget *status;      /**< Label with the cost of the last move */
+    double cx;              /**< X at the center of the view */
+    double cy;              /**< Y at the center of the view */
+    double scale;           /**< Units per pixel (0 until fitted) */
+    spatial_box_td extent;  /**< Bounding box of every item */
+    int dragging;           /**< Whether the view is being panned */
+    double drag_x;          /**< Pointer X when last panned */
+    double drag_y;          /**< Pointer Y when last panned */
+} s_spatial_td;
+
+
+/**
+ * @brief Handler for the "draw" signal of the spatial view: move the
+ *        window to the visible area and draw its items
+ *
+ * Moves are made here, so pans and zooms faster than the redraws cost
+ * one window query per frame.
+ *
+ * @param w        Drawing area
+ * @param cr       Cairo context
+ * @param userdata Spatial view (@e s_spatial_td *)
+ *
+ * @return @c FALSE, to let the default handler run
+ */
+static gboolean s_on_spatial_draw(GtkWidget *w, cairo_t *cr,
+        gpointer userdata)
+{
+    s_spatial_td *v = userdata;
+    double width = gtk_widget_get_allocated_width(w);
+    double height = gtk_widget_get_allocated_height(w);
+
+    if (v->scale <= 0.0) {
+        /* Fit the extent, with a margin */
+        double sx = (v->extent.x1 - v->extent.x0) / width;
+        double sy = (v->extent.y1 - v->extent.y0) / height;
+        v->scale = MAX(MAX(sx, sy) * 1.05, 1e-9);
+    }
+    spatial_box_td win = {
+        v->cx - width / 2.0 * v->scale, v->cx + width / 2.0 * v->scale,
+        v->cy - height / 2.0 * v->scale, v->cy + height / 2.0 * v->scale
+    };
+
+    gint64 t0 = g_get_monotonic_time();
+    int rc = spatial_window(v->sp, &win);
+    double ms = (double) (g_get_monotonic_time() - t0) / 1000.0;
+
+    int n = 0, complete = 0, nqueries = 0;
+    sqlite3_int64 nread = 0;
+    const spatial_item_td *items = spatial_items(v->sp, &n, &complete);
+    spatial_last_cost(v->sp, &nqueries, &nread);
+    char status[256];
+    if (rc == SQLITE_OK) {
+        snprintf(status, sizeof(status), "%d items%s, %d queries read "
+                "%lld in %.1f ms", n, (complete) ? "" : " (zoom in to "
+                "see all)", nqueries, (long long) nread, ms);
+    } else {
+        snprintf(status, sizeof(status), "Cannot read the window: %s",
+                sqlite3_errstr(rc));
+    }
+    gtk_label_set_text(GTK_LABEL(v->status), status);
+
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    cairo_paint(cr);
+    cairo_set_source_rgb(cr, 0.1, 0.3, 0.7);
+    cairo_set_line_width(cr, 1.0);
+    for (int i = 0; i < n; ++i) {
+        /* Y grows upwards */
+        const spatial_box_td *b = &items[i].box;
+        double x = (b->x0 - win.x0) / v->scale;
+        double y = height - (b->y1 - win.y0) / v->scale;
+        double bw = (b->x1 - b->x0) / v->scale;
+        double bh = (b->y1 - b->y0) / v->scale;
+        if (bw < 2.0 && bh < 2.0) {
+            cairo_rectangle(cr, x - 1.0, y - 1.0, 2.0, 2.0);
+            cairo_fill(cr);
+        } else {
+            cairo_rectangle(cr, x, y, bw, bh);
+            cairo_stroke(cr);
+        }
+    }
+
+    return FALSE;
+}
+
+
+/**
+ * @brief Handler for the "button-press-event" and "button-release-event"
+ *        signals of the spatial view: start or stop panning
+ *
+ * @param w        Drawing area (unused)
+ * @param ev       Button event
+ * @param userdata Spatial view (@e s_spatial_td *)
+ *
+ * @return @c TRUE for the first button, @c FALSE otherwise
+ */
+static gboolean s_on_spatial_button(GtkWidget *w, GdkEventButton *ev,
+        gpointer userdata)
+{
+    (void) w;
+    s_spatial_td *v = userdata;
+
+    if (ev->button != 1) {
+        return FALSE;
+    }
+    v->dragging = (ev->type == GDK_BUTTON_PRESS);
+    v->drag_x = ev->x;
+    v->drag_y = ev->y;
+
+    return TRUE;
+}
+
+
+/**
+ * @brief Handler for the "motion-notify-event" signal of the spatial
+ *        view: pan while the first button is held
+ *
+ * @param w        Drawing area
+ * @param ev       Motion event
+ * @param userdata Spatial view (@e s_spatial_td *)
+ *
+ * @return @c TRUE when panning, @c FALSE otherwise
+ */
+static gboolean s_on_spatial_motion(GtkWidget *w, GdkEventMotion *ev,
+        gpointer userdata)
+{
+    s_spatial_td *v = userdata;
+
+    if (!v->dragging) {
+        return FALSE;
+    }
+    v->cx -= (ev->x - v->drag_x) * v->scale;
+    v->cy += (ev->y - v->drag_y) * v->scale;
+    v->drag_x = ev->x;
+    v->drag_y = ev->y;
+    gtk_widget_queue_draw(w);
+
+    return TRUE;
+}
+
+
+/**
+ * @brief Handler for the "scroll-event" signal of the spatial view:
+ *        zoom around the pointer
+ *
+ * @param w        Drawing area
+ * @param ev       Scroll event
+ * @param userdata Spatial view (@e s_spatial_td *)
+ *
+ * @return @c TRUE if zoomed, @c FALSE otherwise
+ */
+static gboolean s_on_spatial_scroll(GtkWidget *w, GdkEventScroll *ev,
+        gpointer userdata)
+{
+    s_spatial_td *v = userdata;
+    double factor;
+
+    if (ev->direction == GDK_SCROLL_UP) {
+        factor = 1.0 / 1.25;
+    } else if (ev->direction == GDK_SCROLL_DOWN) {
+        factor = 1.25;
+    } else {
+        return FALSE;
+    }
+
+    /* Keep the point under the pointer where it is */
+    double dx = ev->x - gtk_widget_get_allocated_width(w) / 2.0;
+    double dy = ev->y - gtk_widget_get_allocated_height(w) / 2.0;
+    double px = v->cx + dx * v->scale;
+    double py = v->cy - dy * v->scale;
+    v->scale *= factor;
+    v->cx = px - dx * v->scale;
+    v->cy = py + dy * v->scale;
+    gtk_widget_queue_draw(w);
+
+    return TRUE;
+}
+
+
+/**
+ * @brief Show the spatial view of a table with an R*Tree
+ *
+ * @param s   Pointer to the application context
+ * @param src Source found by @a spatial_find_source() with an R*Tree
+ */
+static void s_show_spatial(context_td *s, const spatial_source_td *src)
+{
+    s_spatial_td v;
+    char msg[1024];
+
+    memset(&v, 0, sizeof(v));
+    int rc = spatial_new(s->db, src, &v.sp);
+    if (rc == SQLITE_OK) {
+        rc = spatial_extent(v.sp, &v.extent);
+    }
+    if (rc != SQLITE_OK) {
+        if (rc == SQLITE_NOTFOUND) {
+            snprintf(msg, sizeof(msg), "'%s' has no items to show.",
+                    src->table);
+            s_show_info_dialog(GTK_WINDOW(s->win), msg);
+        } else {
+            snprintf(msg, sizeof(msg), "Cannot read '%s': %s",
+                    src->rtree, sqlite3_errmsg(s->db));
+            s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        }
+        spatial_free(v.sp);
+        return;
+    }
+    v.cx = (v.extent.x0 + v.extent.x1) / 2.0;
+    v.cy = (v.extent.y0 + v.extent.y1) / 2.0;
+
+    char title[256];
+    snprintf(title, sizeof(title), "Spatial view of %s", src->table);
+    GtkWidget *dlg = gtk_dialog_new_with_buttons(title, GTK_WINDOW(s->win),
+            GTK_DIALOG_MODAL, "_Close", GTK_RESPONSE_CLOSE, NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dlg), 720, 560);
+    GtkWidget *area = gtk_dialog_get_content_area(GTK_DIALOG(dlg));
+
+    GtkWidget *canvas = gtk_drawing_area_new();
+    gtk_widget_add_events(canvas, GDK_BUTTON_PRESS_MASK
+            | GDK_BUTTON_RELEASE_MASK | GDK_POINTER_MOTION_MASK
+            | GDK_SCROLL_MASK);
+    g_signal_connect(canvas, "draw", G_CALLBACK(s_on_spatial_draw), &v);
+    g_signal_connect(canvas, "button-press-event",
+            G_CALLBACK(s_on_spatial_button), &v);
+    g_signal_connect(canvas, "button-release-event",
+            G_CALLBACK(s_on_spatial_button), &v);
+    g_signal_connect(canvas, "motion-notify-event",
+            G_CALLBACK(s_on_spatial_motion), &v);
+    g_signal_connect(canvas, "scroll-event",
+            G_CALLBACK(s_on_spatial_scroll), &v);
+    gtk_box_pack_start(GTK_BOX(area), canvas, TRUE, TRUE, 0);
+    v.status = gtk_label_new("");
+    gtk_label_set_xalign(GTK_LABEL(v.status), 0.0f);
+    gtk_box_pack_start(GTK_BOX(area), v.status, FALSE, FALSE, 0);
+
+    gtk_widget_show_all(dlg);
+    gtk_dialog_run(GTK_DIALOG(dlg));
+    gtk_widget_destroy(dlg);
+    spatial_free(v.sp);
+}
+
+
+/**
+ * @struct s_spatial_job_td
+ *
+ * @brief Parameters of a spatial indexing job
+ */
+typedef struct {
+    context_td *s;              /**< Application context */
+    char *filename;             /**< Database file */
+    spatial_source_td src;      /**< Table and its coordinate columns */
+    s_progress_td *progress;    /**< Progress dialog */
+} s_spatial_job_td;
+
+
+/**
+ * @brief Spatial indexing job body (worker thread)
+ *
+ * @param job  Running job
+ * @param data Job parameters (@e s_spatial_job_td *)
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_spatial_job_run(job_td *job, void *data)
+{
+    s_spatial_job_td *d = data;
+
+    return spatial_build_index(job, d->filename, &d->src);
+}
+
+
+/**
+ * @brief Spatial indexing completion (main loop): report a failure or
+ *        show the spatial view of the table
+ *
+ * @param job  Finished job (unused)
+ * @param rc   Outcome of the indexing
+ * @param data Job parameters (@e s_spatial_job_td *)
+ */
+static void s_spatial_job_done(job_td *job, int rc, void *data)
+{
+    (void) job;
+    s_spatial_job_td *d = data;
+    context_td *s = d->s;
+    char msg[1024];
+
+    s_progress_free(d->progress);
+    if (rc != SQLITE_OK && rc != SQLITE_INTERRUPT) {
+        snprintf(msg, sizeof(msg), "Failed to index '%s': %s",
+                d->src.table, sqlite3_errstr(rc));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+    }
+
+    /* Only if the same database is still open */
+    if (rc == SQLITE_OK && s->db && s->filename
+            && strcmp(s->filename, d->filename) == 0) {
+        spatial_source_td src;
+        db_fill_table_list(s);
+        if (spatial_find_source(s->db, d->src.table, &src) == SQLITE_OK) {
+            if (src.rtree) {
+                s_show_spatial(s, &src);
+            }
+            spatial_source_clear(&src);
+        }
+    }
+
+    spatial_source_clear(&d->src);
+    g_free(d->filename);
+    g_free(d);
+}
+
+
+/**
+ * @brief Browse the current table by bounding-box window
+ *
+ * Tables with coordinate columns but no R*Tree are offered one, built
+ * by a background job.
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_spatial_view(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    context_td *s = userdata;
+    spatial_source_td src;
+    char msg[1024];
+
+    if (!s->db || !s->current_tablename) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "Select a table first.");
+        return;
+    }
+    int rc = spatial_find_source(s->db, s->current_tablename, &src);
+    if (rc == SQLITE_NOTFOUND) {
+        snprintf(msg, sizeof(msg), "'%s' is not an R*Tree and has no "
+                "coordinate columns (x/y, lon/lat or longitude/latitude).",
+                s->current_tablename);
+        s_show_info_dialog(GTK_WINDOW(s->win), msg);
+        return;
+    } else if (rc != SQLITE_OK) {
+        snprintf(msg, sizeof(msg), "Cannot read '%s': %s",
+                s->current_tablename, sqlite3_errmsg(s->db));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        return;
+    }
+
+    if (src.rtree) {
+        s_show_spatial(s, &src);
+        spatial_source_clear(&src);
+        return;
+    }
+
+    snprintf(msg, sizeof(msg), "Index '%s' by (%s, %s) with the R*Tree "
+            "'%s_rtree'?  Triggers will keep it up to date.", src.table,
+            src.xcol, src.ycol, src.table);
+    if (!s_check_writable(s) || !s_ask_question(GTK_WINDOW(s->win), msg)) {
+        spatial_source_clear(&src);
+        return;
+    }
+    s_spatial_job_td *d = g_new0(s_spatial_job_td, 1);
+    d->s = s;
+    d->filename = g_strdup(s->filename);
+    d->src = src;
+    job_td *job = job_start("spatial", s_spatial_job_run,
+            s_spatial_job_done, d);
+    d->progress = s_progress_new(s, "Building spatial index", job);
+}
+
+
+/**
+ * @struct s_query_td
+ *
+ * @brief State of the query editor
+ */
+typedef struct {
+    context_td *s;          /**< Application context */
+    GtkWidget *dlg;         /**< Editor dialog */
+    GtkTextBuffer *sql;     /**< SQL being edited */
+    GtkTreeView *result;    /**< Rows of the last run */
+    result_td *rows;        /**< Typed rows of the last run (or @c NULL) */
+    guint32 *order;         /**< Row shown at each position (@c NULL if
+                                 in result order) */
+    GtkLabel *status;       /**< Outcome of the last run */
+    GtkTextMark *word;      /**< Start of the word being completed */
+    GtkWidget *menu;        /**< Completion choices (or @c NULL) */
+} s_query_td;
+
+
+/**
+ * @brief Handler for the "clicked" signal of a result column header:
+ *        sort the rows by that column, or reverse the order if it is
+ *        the sort column already
+ *
+ * Rows are sorted from the typed result cache, not from the strings of
+ * the list store, which is then reordered in place.
+ *
+ * @param col      The column header clicked
+ * @param userdata Query editor (@e s_query_td *)
+ */
+static void s_on_query_sort(GtkTreeViewColumn *col, gpointer userdata)
+{
+    s_query_td *q = userdata;
+    GtkListStore *store = GTK_LIST_STORE(gtk_tree_view_get_model(
+                q->result));
+    guint32 n = (q->rows) ? result_count(q->rows) : 0;
+    if (!store || n == 0) {
+        return;
+    }
+
+    int index = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(col),
+                "column"));
+    GtkSortType dir = (gtk_tree_view_column_get_sort_indicator(col)
+            && gtk_tree_view_column_get_sort_order(col)
+            == GTK_SORT_ASCENDING) ? GTK_SORT_DESCENDING
+        : GTK_SORT_ASCENDING;
+    guint32 *order = g_new(guint32, n);
+    gint64 t0 = g_get_monotonic_time();
+    if (result_sort(q->rows, index, dir == GTK_SORT_DESCENDING,
+                (int) g_get_num_processors(), order) != SQLITE_OK) {
+        g_free(order);
+        return;
+    }
+    gint64 usec = g_get_monotonic_time() - t0;
+
+    /* The store wants, for each new position, the current one */
+    guint32 *pos = g_new(guint32, n);
+    for (guint32 i = 0; i < n; ++i) {
+        pos[(q->order) ? q->order[i] : i] = i;
+    }
+    gint *moves = g_new(gint, n);
+    for (guint32 i = 0; i < n; ++i) {
+        moves[i] = (gint) pos[order[i]];
+    }
+    gtk_list_store_reorder(store, moves);
+    g_free(moves);
+    g_free(pos);
+    g_free(q->order);
+    q->order = order;
+
+    GList *cols = gtk_tree_view_get_columns(q->result);
+    for (GList *l = cols; l; l = l->next) {
+        gtk_tree_view_column_set_sort_indicator(l->data, l->data == col);
+    }
+    g_list_free(cols);
+    gtk_tree_view_column_set_sort_order(col, dir);
+
+    char msg[256];
+    snprintf(msg, sizeof(msg), "%u row%s sorted by %s in %.3f ms", n,
+            (n == 1) ? "" : "s", gtk_tree_view_column_get_title(col),
+            (double) usec / 1000.0);
+    gtk_label_set_text(q->status, msg);
+}
+
+
+/**
+ * @brief Show a query result in the result view of the query editor
+ *
+ * @param q     Query editor
+ * @param store Result rows (may be @c NULL to clear the view)
+ * @param names Result column names (@c NULL terminated)
+ */
+static void s_query_show_result(s_query_td *q, GtkListStore *store,
+        char **names)
+{
+    GList *cols = gtk_tree_view_get_columns(q->result);
+    for (GList *l = cols; l; l = l->next) {
+        gtk_tree_view_remove_column(q->result, l->data);
+    }
+    g_list_free(cols);
+
+    for (int i = 0; store && names && names[i]; ++i) {
+        GtkCellRenderer *r = gtk_cell_renderer_text_new();
+        g_object_set(r, "ellipsize", PANGO_ELLIPSIZE_END,
+                "width-chars", 12, NULL);
+        GtkTreeViewColumn *col = gtk_tree_view_column_new_with_attributes(
+                names[i], r, "text", i, NULL);
+        gtk_tree_view_column_set_resizable(col, TRUE);
+        gtk_tree_view_column_set_clickable(col, TRUE);
+        g_object_set_data(G_OBJECT(col), "column", GINT_TO_POINTER(i));
+        g_signal_connect(col, "clicked", G_CALLBACK(s_on_query_sort), q);
+        gtk_tree_view_append_column(q->result, col);
+    }
+    gtk_tree_view_set_model(q->result, GTK_TREE_MODEL(store));
+}
+
+
+/**
+ * @brief Run the SQL of the query editor and store the run in the
+ *        query history
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Query editor (@e s_query_td *)
+ */
+static void s_on_query_run(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    s_query_td *q = userdata;
+    GtkTextIter start, end;
+
+    gtk_text_buffer_get_bounds(q->sql, &start, &end);
+    char *sql = gtk_text_buffer_get_text(q->sql, &start, &end, FALSE);
+    if (!*g_strstrip(sql)) {
+        g_free(sql);
+        return;
+    }
+
+    GtkListStore *store = NULL;
+    result_td *rows = NULL;
+    char **names = NULL;
+    query_stats_td stats;
+    char msg[1024], counters[256];
+    int rc = query_run(q->s->db, sql, &store, &rows, &names, &stats);
+    if (rc == SQLITE_OK) {
+        s_query_show_result(q, store, names);
+        result_free(q->rows);
+        g_free(q->order);
+        q->rows = rows;
+        q->order = NULL;
+        query_describe_stats(&stats, counters, sizeof(counters));
+        snprintf(msg, sizeof(msg), "%lld row%s in %.3f ms, %s%s",
+                (long long) stats.nrows, (stats.nrows == 1) ? "" : "s",
+                (double) stats.usec / 1000.0, counters,
+                (stats.nrows > QUERY_MAX_ROWS) ? " (first rows shown)" : "");
+    } else {
+        snprintf(msg, sizeof(msg), "Error: %s", sqlite3_errmsg(q->s->db));
+        result_free(rows);
+    }
+    gtk_label_set_text(q->status, msg);
+    gtk_widget_set_tooltip_text(GTK_WIDGET(q->status),
+            (rc == SQLITE_OK) ? stats.loops : NULL);
+    history_add(q->s->history, q->s->filename, sql, &stats,
+            (rc == SQLITE_OK) ? NULL : sqlite3_errmsg(q->s->db));
+
+    if (store) {
+        g_object_unref(store);
+    }
+    g_strfreev(names);
+    query_stats_clear(&stats);
+    g_free(sql);
+}
+
+
+/**
+ * @brief Move an iterator back to the start of the SQL identifier that
+ *        ends at it
+ *
+ * @param iter Iterator (updated; unchanged if no identifier ends at it)
+ */
+static void s_backward_word(GtkTextIter *iter)
+{
+    GtkTextIter prev = *iter;
+
+    while (gtk_text_iter_backward_char(&prev)) {
+        gunichar ch = gtk_text_iter_get_char(&prev);
+        if (!g_unichar_isalnum(ch) && ch != '_') {
+            break;
+        }
+        *iter = prev;
+    }
+}
+
+
+/**
+ * @brief Replace the word being completed in the query editor
+ *
+ * @param q    Query editor
+ * @param name Text replacing it
+ */
+static void s_query_replace_word(s_query_td *q, const char *name)
+{
+    GtkTextIter start, end;
+
+    gtk_text_buffer_get_iter_at_mark(q->sql, &start, q->word);
+    gtk_text_buffer_get_iter_at_mark(q->sql, &end,
+            gtk_text_buffer_get_insert(q->sql));
+    gtk_text_buffer_delete(q->sql, &start, &end);
+    gtk_text_buffer_insert(q->sql, &start, name, -1);
+}
+
+
+/**
+ * @brief Handler for the choice of a completion in the query editor
+ *
+ * @param item     Chosen menu item (holds the name as "name" data)
+ * @param userdata Query editor (@e s_query_td *)
+ */
+static void s_on_completion_chosen(GtkMenuItem *item, gpointer userdata)
+{
+    s_query_replace_word(userdata, g_object_get_data(G_OBJECT(item),
+                "name"));
+}
+
+
 /**
- * @brief Show a modal error dialog with a message
+ * @brief Describe the kinds of a completion, as "table, column"
  *
- * @param parent Parent window for the dialog (may be @c NULL)
- * @param msg    Null-terminated message text to display
+ * @param kinds Kinds (@e complete_kind_td bits)
+ * @param buf   Where to write the description
+ * @param len   Size of @e buf
  */
-static void s_show_error_dialog(GtkWindow *parent, const char *msg)
+static void s_describe_kinds(unsigned kinds, char *buf, size_t len)
 {
-    GtkWidget *d = gtk_message_dialog_new(parent, GTK_DIALOG_MODAL,
-            GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE, "%s", msg);
-    gtk_dialog_run(GTK_DIALOG(d));
-    gtk_widget_destroy(d);
+    static const char *names[] = {
+        "keyword", "function", "table", "view", "column"
+    };
+
+    buf[0] = '\0';
+    for (size_t k = 0; k < G_N_ELEMENTS(names); ++k) {
+        if (kinds & (1u << k)) {
+            g_strlcat(buf, (buf[0]) ? ", " : "", len);
+            g_strlcat(buf, names[k], len);
+        }
+    }
 }
 
 
 /**
- * @brief Show a modal informational dialog with a message
+ * @brief Complete the word before the cursor of the query editor
  *
- * @param parent Parent window for the dialog (may be @c NULL)
- * @param msg    Null-terminated message text to display
+ * A single match replaces the word; several extend it to their common
+ * prefix or, if they have none longer, are offered in a menu.  After
+ * @c table. only the columns of that table are offered.
+ *
+ * @param q    Query editor
+ * @param view SQL text view
+ * @param ev   Event that asked for the completion
+ *
+ * @return @c TRUE if there was a word to complete
  */
-static void s_show_info_dialog(GtkWindow *parent, const char *msg)
+static gboolean s_query_complete(s_query_td *q, GtkTextView *view,
+        GdkEvent *ev)
 {
-    GtkWidget *d = gtk_message_dialog_new(parent, GTK_DIALOG_MODAL,
-            GTK_MESSAGE_INFO, GTK_BUTTONS_CLOSE, "%s", msg);
-    gtk_dialog_run(GTK_DIALOG(d));
-    gtk_widget_destroy(d);
+    GtkTextIter start, end, dot;
+
+    gtk_text_buffer_get_iter_at_mark(q->sql, &end,
+            gtk_text_buffer_get_insert(q->sql));
+    start = end;
+    s_backward_word(&start);
+    char *prefix = gtk_text_buffer_get_text(q->sql, &start, &end, FALSE);
+    char *table = NULL;
+    dot = start;
+    if (gtk_text_iter_backward_char(&dot)
+            && gtk_text_iter_get_char(&dot) == '.') {
+        GtkTextIter tstart = dot;
+        s_backward_word(&tstart);
+        if (!gtk_text_iter_equal(&tstart, &dot)) {
+            table = gtk_text_buffer_get_text(q->sql, &tstart, &dot, FALSE);
+        }
+    }
+    if (!*prefix && !table) {
+        g_free(prefix);
+        return FALSE;
+    }
+
+    /* Cheap unless the schema changed since the last completion */
+    complete_refresh(q->s->names, q->s->db);
+    complete_match_td m[UI_COMPLETE_MAX];
+    int n = complete_lookup(q->s->names, table, prefix, UI_COMPLETE_MAX, m);
+    gtk_text_buffer_move_mark(q->sql, q->word, &start);
+
+    size_t common = (n > 0) ? strlen(m[0].name) : 0;
+    for (int i = 1; i < n; ++i) {
+        while (common > 0
+                && g_ascii_strncasecmp(m[0].name, m[i].name, common)) {
+            common--;
+        }
+    }
+    while (common > 0 && (m[0].name[common] & 0xC0) == 0x80) {
+        common--;   /* Do not split a UTF-8 character */
+    }
+
+    if (n == 0) {
+        gtk_widget_error_bell(GTK_WIDGET(view));
+    } else if (n == 1) {
+        s_query_replace_word(q, m[0].name);
+    } else if (common > strlen(prefix)) {
+        char *extended = g_strndup(m[0].name, common);
+        s_query_replace_word(q, extended);
+        g_free(extended);
+    } else {
+        if (q->menu) {
+            gtk_widget_destroy(q->menu);
+        }
+        q->menu = gtk_menu_new();
+        for (int i = 0; i < n; ++i) {
+            char kinds[64];
+            s_describe_kinds(m[i].kinds, kinds, sizeof(kinds));
+            char *label = g_strdup_printf("%s  (%s)", m[i].name, kinds);
+            GtkWidget *item = gtk_menu_item_new_with_label(label);
+            g_free(label);
+            g_object_set_data_full(G_OBJECT(item), "name",
+                    g_strdup(m[i].name), g_free);
+            g_signal_connect(item, "activate",
+                    G_CALLBACK(s_on_completion_chosen), q);
+            gtk_menu_shell_append(GTK_MENU_SHELL(q->menu), item);
+        }
+        gtk_widget_show_all(q->menu);
+
+        GdkRectangle rect;
+        gtk_text_view_get_iter_location(view, &end, &rect);
+        gtk_text_view_buffer_to_window_coords(view, GTK_TEXT_WINDOW_WIDGET,
+                rect.x, rect.y, &rect.x, &rect.y);
+        gtk_menu_popup_at_rect(GTK_MENU(q->menu),
+                gtk_widget_get_window(GTK_WIDGET(view)), &rect,
+                GDK_GRAVITY_SOUTH_WEST, GDK_GRAVITY_NORTH_WEST, ev);
+        gtk_menu_shell_select_first(GTK_MENU_SHELL(q->menu), TRUE);
+    }
+    g_free(table);
+    g_free(prefix);
+
+    return TRUE;
 }
 
 
 /**
- * @brief Handler for the "edited" signal of a @e GtkCellRendererText
- * 
- * Reads the @e rowid from the model using the provided path, updates
- * the corresponding cell in the database via @a db_apply_update_cell(),
- * and on success updates the list store cell value.
+ * @brief Handler for key presses in the SQL of the query editor:
+ *        Ctrl+Enter runs it, Tab and Ctrl+Space complete names
  *
- * @param cell      The @e GtkCellRendererText that emitted the signal
- * @param path      String path identifying the row in the @e GtkTreeModel
- * @param new_text  New text value entered by the user
- * @param user_data Pointer to the application context (@e context_td *)
+ * @param w        The SQL text view
+ * @param ev       Key event
+ * @param userdata Query editor (@e s_query_td *)
  *
- * @note Shows an error dialog if the update fails
+ * @return @c TRUE if the key was handled
  */
-static void s_on_cell_edited(GtkCellRendererText *cell,
-        const gchar *path, const gchar *new_text, gpointer user_data)
+static gboolean s_on_query_key(GtkWidget *w, GdkEventKey *ev,
+        gpointer userdata)
 {
-    context_td *s = user_data;
-    if (!s) {
-        return;
+    guint mods = ev->state & (GDK_CONTROL_MASK | GDK_SHIFT_MASK
+            | GDK_MOD1_MASK);
+
+    if ((ev->state & GDK_CONTROL_MASK) && (ev->keyval == GDK_KEY_Return
+                || ev->keyval == GDK_KEY_KP_Enter)) {
+        s_on_query_run(w, userdata);
+        return TRUE;
+    }
+    if (mods == GDK_CONTROL_MASK && ev->keyval == GDK_KEY_space) {
+        s_query_complete(userdata, GTK_TEXT_VIEW(w), (GdkEvent*) ev);
+        return TRUE;
+    }
+    if (mods == 0 && ev->keyval == GDK_KEY_Tab) {
+        /* Without a word before the cursor, Tab inserts a tab */
+        return s_query_complete(userdata, GTK_TEXT_VIEW(w),
+                (GdkEvent*) ev);
     }
-    gpointer p = g_object_get_data(G_OBJECT(cell), "col-index");
-    int colidx = GPOINTER_TO_INT(p);
 
-    GtkTreeModel *model =
-        gtk_tree_view_get_model(GTK_TREE_VIEW(s->rows_view));
+    return FALSE;
+}
+
+
+/**
+ * @brief Handler for changes of the search text of the query history
+ *
+ * @param entry    Search entry
+ * @param userdata Store of the found runs (@e GtkListStore *)
+ */
+static void s_on_history_search(GtkSearchEntry *entry, gpointer userdata)
+{
+    history_td *h = g_object_get_data(G_OBJECT(entry), "history");
+
+    history_search(h, gtk_entry_get_text(GTK_ENTRY(entry)),
+            UI_HISTORY_LIMIT, userdata);
+}
+
+
+/**
+ * @brief Handler for selection changes in the query history: show the
+ *        SQL and plan of the selected run
+ *
+ * @param sel      Selection of the runs list
+ * @param userdata Text buffer showing the run (@e GtkTextBuffer *)
+ */
+static void s_on_history_selected(GtkTreeSelection *sel,
+        gpointer userdata)
+{
+    GtkTreeModel *model = NULL;
     GtkTreeIter iter;
-    if (!gtk_tree_model_get_iter_from_string(model, &iter, path)) {
+    gchar *sql = NULL;
+    gchar *plan = NULL;
+
+    if (!gtk_tree_selection_get_selected(sel, &model, &iter)) {
+        gtk_text_buffer_set_text(userdata, "", -1);
         return;
     }
-    gchar *rowid_text = NULL;
-    gtk_tree_model_get(model, &iter, 0, &rowid_text, -1);
-    if (!rowid_text) {
+    gtk_tree_model_get(model, &iter, HISTORY_COL_SQL, &sql,
+            HISTORY_COL_PLAN, &plan, -1);
+    char *text = g_strdup_printf("%s\n\n%s", (sql) ? sql : "",
+            (plan && *plan) ? plan : "(no plan)");
+    gtk_text_buffer_set_text(userdata, text, -1);
+    g_free(text);
+    g_free(plan);
+    g_free(sql);
+}
+
+
+/**
+ * @brief Handler for activation of a run in the query history: use it
+ *
+ * @param tv       Runs list (unused)
+ * @param path     Activated row (unused)
+ * @param col      Activated column (unused)
+ * @param userdata History dialog (@e GtkDialog *)
+ */
+static void s_on_history_activated(GtkTreeView *tv, GtkTreePath *path,
+        GtkTreeViewColumn *col, gpointer userdata)
+{
+    (void) tv;
+    (void) path;
+    (void) col;
+
+    gtk_dialog_response(GTK_DIALOG(userdata), GTK_RESPONSE_ACCEPT);
+}
+
+
+/**
+ * @brief Show the query history and copy a chosen run into the editor
+ *
+ * Runs are listed newest first with their time, the change since the
+ * previous run of the same SQL on the same file and whether its plan
+ * changed (see @a history_search()).
+ *
+ * @param w        The widget that triggered the action (unused)
+ * @param userdata Query editor (@e s_query_td *)
+ */
+static void s_on_query_history(GtkWidget *w, gpointer userdata)
+{
+    (void) w;
+    s_query_td *q = userdata;
+    if (!q->s->history) {
+        s_show_info_dialog(GTK_WINDOW(q->dlg),
+                "The query history is not available.");
         return;
     }
 
-    int rc = db_apply_update_cell(s, colidx, rowid_text, new_text);
-    if (rc != SQLITE_OK) {
-        const char *errmsg = s->db
-            ? sqlite3_errmsg(s->db)
-            : "Unknown DB error";
-        char msg[1024];
-        snprintf(msg, sizeof(msg), "Failed to update cell: %s", errmsg);
-        s_show_error_dialog(GTK_WINDOW(s->win), msg);
-        g_free(rowid_text);
-        return;
+    GtkWidget *dlg = gtk_dialog_new_with_buttons("Query history",
+            GTK_WINDOW(q->dlg), GTK_DIALOG_MODAL,
+            "_Close", GTK_RESPONSE_CLOSE,
+            "_Use", GTK_RESPONSE_ACCEPT, NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dlg), 820, 560);
+    GtkWidget *area = gtk_dialog_get_content_area(GTK_DIALOG(dlg));
+
+    GtkListStore *store = history_store_new();
+    GtkWidget *search = gtk_search_entry_new();
+    g_object_set_data(G_OBJECT(search), "history", q->s->history);
+    g_signal_connect(search, "search-changed",
+            G_CALLBACK(s_on_history_search), store);
+    gtk_box_pack_start(GTK_BOX(area), search, FALSE, FALSE, 0);
+
+    GtkWidget *tv = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+    g_object_unref(store);
+    const char *titles[] = { "When", "ms", "Change", "Rows", "VM steps",
+        "SQL" };
+    const int cols[] = { HISTORY_COL_WHEN, HISTORY_COL_MS,
+        HISTORY_COL_CHANGE, HISTORY_COL_ROWS, HISTORY_COL_STEPS,
+        HISTORY_COL_SQL };
+    for (size_t i = 0; i < G_N_ELEMENTS(cols); ++i) {
+        GtkCellRenderer *r = gtk_cell_renderer_text_new();
+        g_object_set(r, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+        GtkTreeViewColumn *col = gtk_tree_view_column_new_with_attributes(
+                titles[i], r, "text", cols[i], NULL);
+        gtk_tree_view_column_set_resizable(col, TRUE);
+        gtk_tree_view_column_set_expand(col, cols[i] == HISTORY_COL_SQL);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(tv), col);
     }
+    GtkWidget *paned = gtk_paned_new(GTK_ORIENTATION_VERTICAL);
+    GtkWidget *sc = gtk_scrolled_window_new(NULL, NULL);
+    gtk_widget_set_size_request(sc, -1, 260);
+    gtk_container_add(GTK_CONTAINER(sc), tv);
+    gtk_paned_pack1(GTK_PANED(paned), sc, TRUE, FALSE);
 
-    gtk_list_store_set(GTK_LIST_STORE(model), &iter, colidx,
-            new_text, -1);
-    g_free(rowid_text);
+    GtkWidget *plan = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(plan), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(plan), TRUE);
+    sc = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(sc), plan);
+    gtk_paned_pack2(GTK_PANED(paned), sc, TRUE, FALSE);
+    gtk_box_pack_start(GTK_BOX(area), paned, TRUE, TRUE, 0);
+
+    GtkTreeSelection *sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(tv));
+    g_signal_connect(sel, "changed", G_CALLBACK(s_on_history_selected),
+            gtk_text_view_get_buffer(GTK_TEXT_VIEW(plan)));
+    g_signal_connect(tv, "row-activated",
+            G_CALLBACK(s_on_history_activated), dlg);
+    s_on_history_search(GTK_SEARCH_ENTRY(search), store);
+
+    gtk_widget_show_all(dlg);
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT) {
+        GtkTreeModel *model = NULL;
+        GtkTreeIter iter;
+        if (gtk_tree_selection_get_selected(sel, &model, &iter)) {
+            gchar *sql = NULL;
+            gtk_tree_model_get(model, &iter, HISTORY_COL_SQL, &sql, -1);
+            gtk_text_buffer_set_text(q->sql, (sql) ? sql : "", -1);
+            g_free(sql);
+        }
+    }
+    gtk_widget_destroy(dlg);
 }
 
 
 /**
- * @brief Handler for table selection changes in the tables list
+ * @brief Show the query editor for ad-hoc SQL on the open database
  *
- * When a table is selected, populate the rows view from the database
- * via @a db_populate_rows().  For each text cell renderer in the new
- * columns set the "editable" property and connect the "edited" signal
- * to @a s_on_cell_edited.
-
- * @param sel      The @e GtkTreeSelection that changed
+ * Each run is timed and stored, with its row count, VM steps and query
+ * plan, in the query history (see @e history.h).  If the SQL changed
+ * rows, the current table is reloaded when the editor closes.
+ *
+ * @param w        The widget that triggered the action (unused)
  * @param userdata Pointer to the application context (@e context_td *)
  */
-static void s_on_table_selected(GtkTreeSelection *sel,
-        gpointer userdata)
+static void s_on_query(GtkWidget *w, gpointer userdata)
 {
+    (void) w;
     context_td *s = userdata;
-    GtkTreeIter iter;
-    GtkTreeModel *model;
-    if (gtk_tree_selection_get_selected(sel, &model, &iter)) {
-        gchar *tname = NULL;
-        gtk_tree_model_get(model, &iter, 0, &tname, -1);
-        if (tname) {
-            int rc = db_populate_rows(s, tname);
-            if (rc != SQLITE_OK) {
-                const char *errmsg = s->db
-                    ? sqlite3_errmsg(s->db)
-                    : "Unknown DB error";
-                char msg[1024];
-                snprintf(msg, sizeof(msg),
-                        "Failed to populate rows: %s", errmsg);
-                s_show_error_dialog(GTK_WINDOW(s->win), msg);
-            } else {
-                GtkTreeView *tv = GTK_TREE_VIEW(s->rows_view);
-                GList *cols = gtk_tree_view_get_columns(tv);
-                int pos = 0;
-
-                for (GList *l = cols; l; l = l->next, ++pos) {
-                    GtkTreeViewColumn *col =
-                        GTK_TREE_VIEW_COLUMN(l->data);
-                    GList *renderers =
-                        gtk_cell_layout_get_cells(GTK_CELL_LAYOUT(col));
-                    if (renderers) {
-                        for (GList *r = renderers; r; r = r->next) {
-                            GtkCellRenderer *renderer =
-                                GTK_CELL_RENDERER(r->data);
-                            if (GTK_IS_CELL_RENDERER_TEXT(renderer)) {
-
-                                g_object_set(renderer, "editable",
-                                        (pos == 0) ? FALSE : TRUE,
-                                        NULL);
-                                g_object_set_data(G_OBJECT(renderer),
-                                        "col-index",
-                                        GINT_TO_POINTER(pos));
-                                g_signal_connect(renderer, "edited",
-                                        G_CALLBACK(s_on_cell_edited),
-                                        s);
-                            }
-                        } /* ! for (GList) */
-                        g_list_free(renderers);
-                    } /* ! if (renderers) */
-                } /* ! for (GList) */
-                g_list_free(cols);
-            }
-            g_free(tname);
-        } /* ! if (tname) */
-    } /* ! if (gtk_tree_selection_get_selected) */
+    if (!s->db) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "Open a database first.");
+        return;
+    }
+
+    s_query_td q;
+    memset(&q, 0, sizeof(q));
+    q.s = s;
+    q.dlg = gtk_dialog_new_with_buttons("Query", GTK_WINDOW(s->win),
+            GTK_DIALOG_MODAL, "_Close", GTK_RESPONSE_CLOSE, NULL);
+    gtk_window_set_default_size(GTK_WINDOW(q.dlg), 820, 600);
+    GtkWidget *area = gtk_dialog_get_content_area(GTK_DIALOG(q.dlg));
+    GtkWidget *paned = gtk_paned_new(GTK_ORIENTATION_VERTICAL);
+    gtk_box_pack_start(GTK_BOX(area), paned, TRUE, TRUE, 0);
+
+    /* Top: SQL */
+    GtkWidget *editor = gtk_text_view_new();
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(editor), TRUE);
+    q.sql = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+    GtkTextIter iter;
+    gtk_text_buffer_get_start_iter(q.sql, &iter);
+    q.word = gtk_text_buffer_create_mark(q.sql, NULL, &iter, TRUE);
+    if (!s->names) {
+        s->names = complete_new();
+    }
+    g_signal_connect(editor, "key-press-event",
+            G_CALLBACK(s_on_query_key), &q);
+    GtkWidget *sc = gtk_scrolled_window_new(NULL, NULL);
+    gtk_widget_set_size_request(sc, -1, 160);
+    gtk_container_add(GTK_CONTAINER(sc), editor);
+    gtk_paned_pack1(GTK_PANED(paned), sc, FALSE, FALSE);
+
+    /* Bottom: actions, outcome and result */
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *run_btn = gtk_button_new_with_label("Run (Ctrl+Enter)");
+    g_signal_connect(run_btn, "clicked", G_CALLBACK(s_on_query_run), &q);
+    gtk_box_pack_start(GTK_BOX(hbox), run_btn, FALSE, FALSE, 0);
+    GtkWidget *history_btn = gtk_button_new_with_label("History");
+    g_signal_connect(history_btn, "clicked",
+            G_CALLBACK(s_on_query_history), &q);
+    gtk_box_pack_start(GTK_BOX(hbox), history_btn, FALSE, FALSE, 0);
+    q.status = GTK_LABEL(gtk_label_new(NULL));
+    gtk_label_set_ellipsize(q.status, PANGO_ELLIPSIZE_END);
+    gtk_box_pack_start(GTK_BOX(hbox), GTK_WIDGET(q.status), TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
+
+    q.result = GTK_TREE_VIEW(gtk_tree_view_new());
+    sc = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(sc), GTK_WIDGET(q.result));
+    gtk_box_pack_start(GTK_BOX(vbox), sc, TRUE, TRUE, 0);
+    gtk_paned_pack2(GTK_PANED(paned), vbox, TRUE, FALSE);
+
+    int changes = sqlite3_total_changes(s->db);
+    gtk_widget_show_all(q.dlg);
+    gtk_widget_grab_focus(editor);
+    gtk_dialog_run(GTK_DIALOG(q.dlg));
+    if (q.menu) {
+        gtk_widget_destroy(q.menu);
+    }
+    gtk_widget_destroy(q.dlg);
+    result_free(q.rows);
+    g_free(q.order);
+
+    if (sqlite3_total_changes(s->db) != changes && s->current_tablename) {
+        char *tname = g_strdup(s->current_tablename);
+        s_show_table(s, tname);
+        g_free(tname);
+    }
 }
 
 
 /**
- * @brief Show an "Open DB" file chooser, open the selected SQLite DB
- *        and list tables
+ * @brief Handler for the "value-changed" signal of the page number
+ *        spin button: decode the page into the text view
+ *
+ * @param spin     The spin button holding the page number
+ * @param userdata Text view showing the page (@e GtkTextView *)
+ */
+static void s_on_page_changed(GtkSpinButton *spin, gpointer userdata)
+{
+    inspect_td *in = g_object_get_data(G_OBJECT(spin), "inspector");
+    GtkTextBuffer *buf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(userdata));
+    unsigned pgno = (unsigned) gtk_spin_button_get_value_as_int(spin);
+    char *text = NULL;
+
+    if (inspect_describe_page(in, pgno, &text) == SQLITE_OK) {
+        gtk_text_buffer_set_text(buf, text, -1);
+    } else {
+        gtk_text_buffer_set_text(buf, "Cannot decode page", -1);
+    }
+    sqlite3_free(text);
+}
+
+
+/**
+ * @brief Show the raw page inspector for the open database file
  *
  * @param w        The widget that triggered the action (unused)
  * @param userdata Pointer to the application context (@e context_td *)
  *
- * @note Displays error or info dialogs on failure
- * @note Uses @a db_is_sqlite(), @a db_open() and @a db_fill_table_list()
+ * @note Uses @a inspect_open(); pages are decoded one at a time
  */
-static void s_on_open(GtkWidget *w, gpointer userdata)
+static void s_on_inspect_pages(GtkWidget *w, gpointer userdata)
 {
     (void) w;
     context_td *s = userdata;
-    GtkWidget *dlg = gtk_file_chooser_dialog_new("Open SQLite DB",
-            GTK_WINDOW(s->win), GTK_FILE_CHOOSER_ACTION_OPEN,
-            "_Cancel", GTK_RESPONSE_CANCEL,
-            "_Open", GTK_RESPONSE_ACCEPT, NULL);
+    if (!s->filename) {
+        s_show_info_dialog(GTK_WINDOW(s->win), "Open a database first.");
+        return;
+    }
 
-    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT) {
-        char *filename =
-            gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dlg));
-        if (filename) {
-            if (!db_is_sqlite(filename)) {
-                char msg[1024];
-                snprintf(msg, sizeof(msg),
-                        "Cannot open file '%s': not an SQLite database", 
-                        filename);
-                s_show_error_dialog(GTK_WINDOW(s->win), msg);
-                g_free(filename);
-                gtk_widget_destroy(dlg);
-                return;
-            }
-            int rc = db_open(s, filename);
-            if (rc != SQLITE_OK) {
-                const char *errmsg = s->db
-                    ? sqlite3_errmsg(s->db)
-                    : sqlite3_errstr(rc);
-                char msg[1024];
-                snprintf(msg, sizeof(msg),
-                        "Failed to open database: %s", errmsg);
-                s_show_error_dialog(GTK_WINDOW(s->win), msg);
-                db_close(s);
-                g_free(filename);
-                gtk_widget_destroy(dlg);
-                return;
-            }
-            rc = db_fill_table_list(s);
-            if (rc != SQLITE_OK) {
-                const char *errmsg = s->db
-                    ? sqlite3_errmsg(s->db)
-                    : sqlite3_errstr(rc);
-                char msg[1024];
-                snprintf(msg, sizeof(msg),
-                        "Opened database but failed to list tables: %s",
-                        errmsg);
-                s_show_info_dialog(GTK_WINDOW(s->win), msg);
-            }
-            g_free(filename);
-        }
+    inspect_td *in = NULL;
+    int rc = inspect_open(s->filename, &in);
+    if (rc != SQLITE_OK) {
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Cannot inspect '%s': %s",
+                s->filename, sqlite3_errstr(rc));
+        s_show_error_dialog(GTK_WINDOW(s->win), msg);
+        return;
     }
+
+    GtkWidget *dlg = gtk_dialog_new_with_buttons("Inspect pages",
+            GTK_WINDOW(s->win), GTK_DIALOG_MODAL,
+            "_Close", GTK_RESPONSE_CLOSE, NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dlg), 760, 520);
+    GtkWidget *area = gtk_dialog_get_content_area(GTK_DIALOG(dlg));
+
+    GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_pack_start(GTK_BOX(hbox), gtk_label_new("Page:"),
+            FALSE, FALSE, 0);
+    GtkWidget *spin = gtk_spin_button_new_with_range(1,
+            inspect_page_count(in), 1);
+    gtk_box_pack_start(GTK_BOX(hbox), spin, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(area), hbox, FALSE, FALSE, 0);
+
+    GtkWidget *tv = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(tv), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(tv), TRUE);
+    GtkWidget *sc = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(sc), tv);
+    gtk_box_pack_start(GTK_BOX(area), sc, TRUE, TRUE, 0);
+
+    g_object_set_data(G_OBJECT(spin), "inspector", in);
+    g_signal_connect(spin, "value-changed",
+            G_CALLBACK(s_on_page_changed), tv);
+    s_on_page_changed(GTK_SPIN_BUTTON(spin), tv);
+
+    gtk_widget_show_all(dlg);
+    gtk_dialog_run(GTK_DIALOG(dlg));
     gtk_widget_destroy(dlg);
+    inspect_close(in);
 }
 
 
@@ -247,6 +3422,38 @@ static void s_on_quit(GtkWidget *w, gpointer userdata)
 }
 
 
+/**
+ * @brief Handler for scrolling of the rows view: record the first
+ *        visible row when recording a session
+ *
+ * @param adj      Vertical adjustment of the rows view
+ * @param userdata Pointer to the application context (@e context_td *)
+ */
+static void s_on_rows_scrolled(GtkAdjustment *adj, gpointer userdata)
+{
+    context_td *s = userdata;
+    GtkTreePath *start = NULL;
+
+    if (!s->session || !gtk_tree_view_get_visible_range(
+                GTK_TREE_VIEW(s->rows_view), &start, NULL)) {
+        return;
+    }
+    int first = gtk_tree_path_get_indices(start)[0];
+    gtk_tree_path_free(start);
+
+    /* Only log row changes, not every pixel */
+    int last = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(adj),
+                "first-row")) - 1;
+    if (first != last) {
+        char row[16];
+        snprintf(row, sizeof(row), "%d", first);
+        session_log(s->session, "scroll", row, NULL);
+        g_object_set_data(G_OBJECT(adj), "first-row",
+                GINT_TO_POINTER(first + 1));
+    }
+}
+
+
 /* Build the main UI and connect signals */
 void ui_build(context_td *s)
 {
@@ -263,6 +3470,73 @@ void ui_build(context_td *s)
     g_signal_connect(open_btn, "clicked", G_CALLBACK(s_on_open), s);
     gtk_box_pack_start(GTK_BOX(toolbar), open_btn, FALSE, FALSE, 0);
 
+    GtkWidget *dup_btn = gtk_button_new_with_label("Find duplicates");
+    g_signal_connect(dup_btn, "clicked",
+            G_CALLBACK(s_on_find_duplicates), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), dup_btn, FALSE, FALSE, 0);
+
+    GtkWidget *extract_btn = gtk_button_new_with_label("Extract BLOBs");
+    g_signal_connect(extract_btn, "clicked",
+            G_CALLBACK(s_on_extract_blobs), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), extract_btn, FALSE, FALSE, 0);
+
+    GtkWidget *import_btn = gtk_button_new_with_label("Import file");
+    g_signal_connect(import_btn, "clicked",
+            G_CALLBACK(s_on_import_file), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), import_btn, FALSE, FALSE, 0);
+
+    GtkWidget *script_btn = gtk_button_new_with_label("Run SQL file");
+    g_signal_connect(script_btn, "clicked",
+            G_CALLBACK(s_on_run_script), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), script_btn, FALSE, FALSE, 0);
+
+    GtkWidget *insert_btn = gtk_button_new_with_label("Insert row");
+    g_signal_connect(insert_btn, "clicked",
+            G_CALLBACK(s_on_insert_row), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), insert_btn, FALSE, FALSE, 0);
+
+    GtkWidget *delete_btn = gtk_button_new_with_label("Delete rows");
+    g_signal_connect(delete_btn, "clicked",
+            G_CALLBACK(s_on_delete_rows), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), delete_btn, FALSE, FALSE, 0);
+
+    GtkWidget *overlay_btn = gtk_toggle_button_new_with_label(
+            "Overlay edits");
+    gtk_widget_set_tooltip_text(overlay_btn, "Open files read-only and "
+            "keep cell edits aside until applied");
+    g_signal_connect(overlay_btn, "toggled",
+            G_CALLBACK(s_on_overlay_toggled), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), overlay_btn, FALSE, FALSE, 0);
+
+    GtkWidget *apply_btn = gtk_button_new_with_label("Apply edits");
+    g_signal_connect(apply_btn, "clicked",
+            G_CALLBACK(s_on_apply_overlay), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), apply_btn, FALSE, FALSE, 0);
+
+    GtkWidget *form_btn = gtk_button_new_with_label("Record form");
+    g_signal_connect(form_btn, "clicked",
+            G_CALLBACK(s_on_record_form), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), form_btn, FALSE, FALSE, 0);
+
+    GtkWidget *json_btn = gtk_button_new_with_label("Explore JSON");
+    g_signal_connect(json_btn, "clicked",
+            G_CALLBACK(s_on_explore_json), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), json_btn, FALSE, FALSE, 0);
+
+    GtkWidget *spatial_btn = gtk_button_new_with_label("Spatial view");
+    g_signal_connect(spatial_btn, "clicked",
+            G_CALLBACK(s_on_spatial_view), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), spatial_btn, FALSE, FALSE, 0);
+
+    GtkWidget *query_btn = gtk_button_new_with_label("Query");
+    g_signal_connect(query_btn, "clicked", G_CALLBACK(s_on_query), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), query_btn, FALSE, FALSE, 0);
+
+    GtkWidget *pages_btn = gtk_button_new_with_label("Inspect pages");
+    g_signal_connect(pages_btn, "clicked",
+            G_CALLBACK(s_on_inspect_pages), s);
+    gtk_box_pack_start(GTK_BOX(toolbar), pages_btn, FALSE, FALSE, 0);
+
     GtkWidget *quit_btn = gtk_button_new_with_label("Quit");
     g_signal_connect(quit_btn, "clicked", G_CALLBACK(s_on_quit), s);
     gtk_box_pack_start(GTK_BOX(toolbar), quit_btn, FALSE, FALSE, 0);
@@ -285,11 +3559,54 @@ void ui_build(context_td *s)
     gtk_container_add(GTK_CONTAINER(left_sc), s->tables_view);
     gtk_paned_pack1(GTK_PANED(paned), left_sc, FALSE, TRUE);
 
-    /* Right: rows view */
+    /* Right: timeline strip (for tables with one), filter and rows view */
+    GtkWidget *right = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    s->timeline_area = gtk_drawing_area_new();
+    gtk_widget_set_size_request(s->timeline_area, -1, 48);
+    gtk_widget_add_events(s->timeline_area, GDK_BUTTON_PRESS_MASK);
+    gtk_widget_set_has_tooltip(s->timeline_area, TRUE);
+    gtk_widget_set_no_show_all(s->timeline_area, TRUE);
+    g_signal_connect(s->timeline_area, "draw",
+            G_CALLBACK(s_on_timeline_draw), s);
+    g_signal_connect(s->timeline_area, "button-press-event",
+            G_CALLBACK(s_on_timeline_button), s);
+    g_signal_connect(s->timeline_area, "query-tooltip",
+            G_CALLBACK(s_on_timeline_tooltip), s);
+    gtk_box_pack_start(GTK_BOX(right), s->timeline_area, FALSE, FALSE, 0);
+
+    GtkWidget *filter_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    s->filter_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(s->filter_entry),
+            "Filter rows (SQL condition)");
+    g_signal_connect(s->filter_entry, "changed",
+            G_CALLBACK(s_on_filter_changed), s);
+    g_signal_connect(s->filter_entry, "activate",
+            G_CALLBACK(s_on_filter_activate), s);
+    gtk_box_pack_start(GTK_BOX(filter_box), s->filter_entry, TRUE, TRUE, 0);
+    s->estimate_label = gtk_label_new(NULL);
+    gtk_label_set_ellipsize(GTK_LABEL(s->estimate_label),
+            PANGO_ELLIPSIZE_END);
+    gtk_box_pack_start(GTK_BOX(filter_box), s->estimate_label, FALSE, FALSE,
+            0);
+    gtk_box_pack_start(GTK_BOX(right), filter_box, FALSE, FALSE, 0);
+
     s->rows_view = gtk_tree_view_new();
+    gtk_tree_selection_set_mode(gtk_tree_view_get_selection(
+                GTK_TREE_VIEW(s->rows_view)), GTK_SELECTION_MULTIPLE);
+    s->thumbs = thumb_cache_new(s_on_thumbs_ready, s);
     GtkWidget *right_sc = gtk_scrolled_window_new(NULL, NULL);
     gtk_container_add(GTK_CONTAINER(right_sc), s->rows_view);
-    gtk_paned_pack2(GTK_PANED(paned), right_sc, TRUE, TRUE);
+    g_signal_connect(gtk_scrolled_window_get_vadjustment(
+                GTK_SCROLLED_WINDOW(right_sc)), "value-changed",
+            G_CALLBACK(s_on_rows_scrolled), s);
+    gtk_box_pack_start(GTK_BOX(right), right_sc, TRUE, TRUE, 0);
+    s->rows_stats_label = gtk_label_new(NULL);
+    gtk_label_set_ellipsize(GTK_LABEL(s->rows_stats_label),
+            PANGO_ELLIPSIZE_END);
+    gtk_label_set_xalign(GTK_LABEL(s->rows_stats_label), 0.0f);
+    gtk_box_pack_start(GTK_BOX(right), s->rows_stats_label, FALSE, FALSE,
+            0);
+    gtk_paned_pack2(GTK_PANED(paned), right, TRUE, TRUE);
 
     /* Selection handler */
     GtkTreeSelection *sel =
@@ -302,9 +3619,16 @@ void ui_build(context_td *s)
 }
 
 
-/* Shutdown UI and release any resources (currently no-op) */
+/* Shutdown UI and release any resources */
 void ui_shutdown(context_td *s)
 {
-    /* Clear UI if needed */
-    (void) s;
+    s->timeline_area = NULL;    /* Destroyed with the window */
+    s->filter_entry = NULL;
+    s->estimate_label = NULL;
+    s->rows_stats_label = NULL;
+    if (s->estimate_timer) {
+        g_source_remove(s->estimate_timer);
+        s->estimate_timer = 0;
+    }
+    s_timeline_release(s);
 }
@@ -0,0 +1,634 @@
+/**
+ * @file workload.c
+ *
+ * @brief Implementation of the concurrent replay of SQL statement logs
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* System includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project includes */
+#include <db.h>
+
+/* Local includes */
+#include <workload.h>
+
+
+#define WORKLOAD_SQL_SHOWN (40)     /**< SQL characters in the report */
+
+
+/**
+ * @struct s_param_td
+ *
+ * @brief Bound parameter of a logged statement
+ */
+typedef struct {
+    int type;           /**< @e SQLITE_INTEGER, @e SQLITE_TEXT, etc. */
+    sqlite3_int64 i;    /**< Integer value */
+    double r;           /**< Real value */
+    char *bytes;        /**< Text or BLOB value */
+    int n;              /**< Bytes in @e bytes */
+} s_param_td;
+
+/**
+ * @struct s_event_td
+ *
+ * @brief Logged statement and the outcome of its replay
+ */
+typedef struct {
+    gint64 at;          /**< Recorded start (us since the first one) */
+    int line;           /**< Line in the log */
+    int conn;           /**< Connection that runs it */
+    char *sql;          /**< Statement text */
+    s_param_td *params; /**< Bound parameters */
+    int nparams;        /**< Entries in @e params */
+    gint64 due;         /**< Monotonic time it was due to start */
+    gint64 lag;         /**< Delay of the start past @e due (us) */
+    gint64 latency;     /**< Run time (us) */
+    gint64 busy_us;     /**< Time spent waiting on locks (us) */
+    int retries;        /**< Busy handler invocations */
+    int rc;             /**< Outcome */
+} s_event_td;
+
+/**
+ * @struct s_conn_td
+ *
+ * @brief Replay connection and the thread that drives it
+ */
+typedef struct {
+    sqlite3 *db;            /**< Connection to the copy */
+    GAsyncQueue *queue;     /**< Statements released to it */
+    GHashTable *stmts;      /**< Prepared statements by SQL text */
+    s_event_td *cur;        /**< Statement being run */
+    gint64 busy_start;      /**< Start of the current lock wait */
+    GThread *thread;        /**< Thread running the statements */
+} s_conn_td;
+
+/**
+ * @struct s_stat_td
+ *
+ * @brief Aggregated outcome of one statement text
+ */
+typedef struct {
+    const char *sql;    /**< Statement text */
+    GArray *latencies;  /**< Run times of the successful runs (us) */
+    int count;          /**< Runs */
+    int errors;         /**< Runs that failed */
+    int locked;         /**< Runs failed with BUSY or LOCKED */
+    int retries;        /**< Busy handler invocations */
+    gint64 busy_us;     /**< Time spent waiting on locks (us) */
+} s_stat_td;
+
+
+/** Marker pushed to a connection queue after its last statement */
+static int s_stop;
+
+
+/**
+ * @brief Free the values of a statement log
+ *
+ * @param events Statements (@e s_event_td)
+ */
+static void s_free_events(GArray *events)
+{
+    for (guint i = 0; i < events->len; ++i) {
+        s_event_td *ev = &g_array_index(events, s_event_td, i);
+        for (int j = 0; j < ev->nparams; ++j) {
+            g_free(ev->params[j].bytes);
+        }
+        g_free(ev->params);
+        g_free(ev->sql);
+    }
+    g_array_free(events, TRUE);
+}
+
+
+/**
+ * @brief Parse a typed parameter of the log
+ *
+ * @param field Unescaped field (e.g. @c i:42)
+ * @param p     Where to store the parameter
+ *
+ * @return @e SQLITE_OK on success or @e SQLITE_FORMAT if malformed
+ */
+static int s_parse_param(const char *field, s_param_td *p)
+{
+    char *end = NULL;
+
+    memset(p, 0, sizeof(*p));
+    if (strcmp(field, "null") == 0) {
+        p->type = SQLITE_NULL;
+        return SQLITE_OK;
+    }
+    if (strlen(field) < 2 || field[1] != ':') {
+        return SQLITE_FORMAT;
+    }
+
+    const char *v = field + 2;
+    switch (field[0]) {
+        case 'i':
+            p->type = SQLITE_INTEGER;
+            p->i = g_ascii_strtoll(v, &end, 10);
+            return (*v && !*end) ? SQLITE_OK : SQLITE_FORMAT;
+        case 'r':
+            p->type = SQLITE_FLOAT;
+            p->r = g_ascii_strtod(v, &end);
+            return (*v && !*end) ? SQLITE_OK : SQLITE_FORMAT;
+        case 't':
+            p->type = SQLITE_TEXT;
+            p->n = (int) strlen(v);
+            p->bytes = g_strdup(v);
+            return SQLITE_OK;
+        case 'x':
+            p->type = SQLITE_BLOB;
+            p->n = (int) strlen(v) / 2;
+            p->bytes = g_malloc((gsize) p->n + 1);
+            for (int i = 0; i < p->n; ++i) {
+                int hi = g_ascii_xdigit_value(v[2 * i]);
+                int lo = g_ascii_xdigit_value(v[2 * i + 1]);
+                if (hi < 0 || lo < 0) {
+                    return SQLITE_FORMAT;
+                }
+                p->bytes[i] = (char) (hi * 16 + lo);
+            }
+            return (strlen(v) % 2 == 0) ? SQLITE_OK : SQLITE_FORMAT;
+        default:
+            return SQLITE_FORMAT;
+    }
+}
+
+
+/**
+ * @brief Parse one line of the log
+ *
+ * @param line     Line without its end of line
+ * @param sessions Connection of every session seen so far (updated)
+ * @param ev       Where to store the statement
+ *
+ * @return @e SQLITE_OK on success or @e SQLITE_FORMAT if malformed
+ */
+static int s_parse_line(const char *line, GHashTable *sessions,
+        s_event_td *ev)
+{
+    char **fields = g_strsplit(line, "\t", -1);
+    int nfields = (int) g_strv_length(fields);
+    char *end = NULL;
+    int rc = SQLITE_OK;
+
+    if (nfields < 3) {
+        g_strfreev(fields);
+        return SQLITE_FORMAT;
+    }
+
+    ev->at = g_ascii_strtoll(fields[0], &end, 10) * 1000;
+    if (!*fields[0] || *end) {
+        rc = SQLITE_FORMAT;
+    }
+
+    /* Sessions get connections in order of appearance, one each */
+    char *session = g_strcompress(fields[1]);
+    gpointer conn = NULL;
+    if (g_hash_table_lookup_extended(sessions, session, NULL, &conn)) {
+        g_free(session);
+    } else {
+        conn = GINT_TO_POINTER((int) g_hash_table_size(sessions));
+        g_hash_table_insert(sessions, session, conn);
+    }
+    ev->conn = GPOINTER_TO_INT(conn);
+
+    ev->sql = g_strcompress(fields[2]);
+    ev->nparams = nfields - 3;
+    ev->params = g_new0(s_param_td, MAX(ev->nparams, 1));
+    for (int i = 0; rc == SQLITE_OK && i < ev->nparams; ++i) {
+        char *field = g_strcompress(fields[i + 3]);
+        rc = s_parse_param(field, &ev->params[i]);
+        g_free(field);
+    }
+    g_strfreev(fields);
+
+    return rc;
+}
+
+
+/**
+ * @brief Compare two statements by recorded time, then by line
+ *
+ * @param a First statement (@e s_event_td *)
+ * @param b Second statement (@e s_event_td *)
+ *
+ * @return Negative, zero or positive as @e a starts before, with or
+ *         after @e b
+ */
+static int s_cmp_event(const void *a, const void *b)
+{
+    const s_event_td *x = a;
+    const s_event_td *y = b;
+
+    if (x->at != y->at) {
+        return (x->at > y->at) - (x->at < y->at);
+    }
+
+    return x->line - y->line;
+}
+
+
+/**
+ * @brief Load a statement log
+ *
+ * @param log       Statement log
+ * @param nsessions Where to store the number of sessions
+ * @param out       Where to store the statements, sorted by time
+ *
+ * @return @e SQLITE_OK on success, @e SQLITE_CANTOPEN if the log
+ *         cannot be read or @e SQLITE_FORMAT if a line is malformed
+ */
+static int s_load_log(const char *log, int *nsessions, GArray **out)
+{
+    FILE *fp = fopen(log, "r");
+    if (!fp) {
+        return SQLITE_CANTOPEN;
+    }
+
+    GArray *events = g_array_new(FALSE, TRUE, sizeof(s_event_td));
+    GHashTable *sessions = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    char *line = NULL;
+    size_t cap = 0;
+    int rc = SQLITE_OK;
+    for (int lineno = 1; rc == SQLITE_OK && getline(&line, &cap, fp) > 0;
+            ++lineno) {
+        g_strchomp(line);
+        if (!*line || *line == '#') {
+            continue;
+        }
+        s_event_td ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.line = lineno;
+        rc = s_parse_line(line, sessions, &ev);
+        g_array_append_val(events, ev);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "%s:%d: malformed statement\n", log, lineno);
+        }
+    }
+    free(line);
+    fclose(fp);
+    *nsessions = (int) g_hash_table_size(sessions);
+    g_hash_table_destroy(sessions);
+
+    if (rc != SQLITE_OK) {
+        s_free_events(events);
+        return rc;
+    }
+
+    qsort(events->data, events->len, sizeof(s_event_td), s_cmp_event);
+    gint64 origin = (events->len > 0)
+        ? g_array_index(events, s_event_td, 0).at : 0;
+    for (guint i = 0; i < events->len; ++i) {
+        g_array_index(events, s_event_td, i).at -= origin;
+    }
+    *out = events;
+
+    return SQLITE_OK;
+}
+
+
+/**
+ * @brief Finalize a cached statement (for @a g_hash_table_new_full())
+ *
+ * @param stmt Prepared statement (@e sqlite3_stmt *)
+ */
+static void s_finalize(gpointer stmt)
+{
+    sqlite3_finalize(stmt);
+}
+
+
+/**
+ * @brief Busy handler counting the time a connection waits on locks
+ *
+ * Waits in 1 ms steps up to @e DB_JOB_BUSY_TIMEOUT, as the busy
+ * timeout of the job connections it replaces.
+ *
+ * @param userdata Replay connection (@e s_conn_td *)
+ * @param count    Times called before for the same lock
+ *
+ * @return Non-zero to retry, zero to fail with @e SQLITE_BUSY
+ */
+static int s_on_busy(void *userdata, int count)
+{
+    s_conn_td *c = userdata;
+    gint64 now = g_get_monotonic_time();
+
+    if (count == 0) {
+        c->busy_start = now;
+    }
+    if (now - c->busy_start >= (gint64) DB_JOB_BUSY_TIMEOUT * 1000) {
+        return 0;
+    }
+    sqlite3_sleep(1);
+    if (c->cur) {
+        c->cur->retries++;
+        c->cur->busy_us += g_get_monotonic_time() - now;
+    }
+
+    return 1;
+}
+
+
+/**
+ * @brief Run one statement of the log
+ *
+ * Statements are prepared once per connection and text, as an
+ * application with a statement cache would.
+ *
+ * @param c  Replay connection
+ * @param ev Statement to run
+ *
+ * @return @e SQLITE_OK on success or an SQLite error code on failure
+ */
+static int s_run(s_conn_td *c, s_event_td *ev)
+{
+    sqlite3_stmt *stmt = g_hash_table_lookup(c->stmts, ev->sql);
+    int rc = SQLITE_OK;
+
+    if (!stmt) {
+        rc = sqlite3_prepare_v3(c->db, ev->sql, -1,
+                SQLITE_PREPARE_PERSISTENT, &stmt, NULL);
+        if (rc != SQLITE_OK || !stmt) {
+            return (rc != SQLITE_OK) ? rc : SQLITE_MISUSE;
+        }
+        g_hash_table_insert(c->stmts, ev->sql, stmt);
+    }
+
+    for (int i = 0; rc == SQLITE_OK && i < ev->nparams; ++i) {
+        s_param_td *p = &ev->params[i];
+        switch (p->type) {
+            case SQLITE_INTEGER:
+                rc = sqlite3_bind_int64(stmt, i + 1, p->i);
+                break;
+            case SQLITE_FLOAT:
+                rc = sqlite3_bind_double(stmt, i + 1, p->r);
+                break;
+            case SQLITE_TEXT:
+                rc = sqlite3_bind_text(stmt, i + 1, p->bytes, p->n,
+                        SQLITE_STATIC);
+                break;
+            case SQLITE_BLOB:
+                rc = sqlite3_bind_blob(stmt, i + 1, p->bytes, p->n,
+                        SQLITE_STATIC);
+                break;
+            default:
+                rc = sqlite3_bind_null(stmt, i + 1);
+                break;
+        }
+    }
+
+    if (rc == SQLITE_OK) {
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            /* Rows are read and dropped */
+        }
+        rc = (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    return rc;
+}
+
+
+/**
+ * @brief Thread running the statements released to a connection
+ *
+ * @param userdata Replay connection (@e s_conn_td *)
+ *
+ * @return @c NULL
+ */
+static gpointer s_conn_thread(gpointer userdata)
+{
+    s_conn_td *c = userdata;
+
+    for (;;) {
+        s_event_td *ev = g_async_queue_pop(c->queue);
+        if ((void*) ev == (void*) &s_stop) {
+            break;
+        }
+        gint64 start = g_get_monotonic_time();
+        c->cur = ev;
+        ev->lag = start - ev->due;
+        ev->rc = s_run(c, ev);
+        ev->latency = g_get_monotonic_time() - start;
+        c->cur = NULL;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Get a percentile of sorted durations
+ *
+ * @param a   Sorted durations (@e gint64)
+ * @param pct Percentile (0 to 100)
+ *
+ * @return The duration in milliseconds, or 0 if @e a is empty
+ */
+static double s_percentile(GArray *a, int pct)
+{
+    if (a->len == 0) {
+        return 0.0;
+    }
+
+    return (double) g_array_index(a, gint64,
+            (a->len - 1) * (guint) pct / 100) / 1000.0;
+}
+
+
+/**
+ * @brief Compare two durations (for @a g_array_sort())
+ *
+ * @param a First duration (@e gint64 *)
+ * @param b Second duration (@e gint64 *)
+ *
+ * @return Negative, zero or positive as @e a is less, equal or greater
+ */
+static gint s_cmp_time(gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64*) a;
+    gint64 y = *(const gint64*) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Write the report of a replay
+ *
+ * @param events Replayed statements
+ * @param nconns Number of connections
+ * @param wall   Wall time of the replay (us)
+ * @param out    Where to write the report
+ */
+static void s_report(GArray *events, int nconns, gint64 wall, FILE *out)
+{
+    GHashTable *by_sql = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray *stats = g_ptr_array_new();
+    GArray *lags = g_array_new(FALSE, FALSE, sizeof(gint64));
+    int locked = 0;
+    gint64 busy_us = 0;
+
+    for (guint i = 0; i < events->len; ++i) {
+        s_event_td *ev = &g_array_index(events, s_event_td, i);
+        s_stat_td *st = g_hash_table_lookup(by_sql, ev->sql);
+        if (!st) {
+            st = g_new0(s_stat_td, 1);
+            st->sql = ev->sql;
+            st->latencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+            g_hash_table_insert(by_sql, ev->sql, st);
+            g_ptr_array_add(stats, st);
+        }
+        int is_locked = ((ev->rc & 0xff) == SQLITE_BUSY
+                || (ev->rc & 0xff) == SQLITE_LOCKED);
+        st->count++;
+        st->errors += (ev->rc != SQLITE_OK);
+        st->locked += is_locked;
+        st->retries += ev->retries;
+        st->busy_us += ev->busy_us;
+        if (ev->rc == SQLITE_OK) {
+            g_array_append_val(st->latencies, ev->latency);
+        }
+        locked += is_locked;
+        busy_us += ev->busy_us;
+        g_array_append_val(lags, ev->lag);
+    }
+
+    fprintf(out, "%6s %5s %5s %9s %9s %9s %9s %9s  %s\n", "count",
+            "err", "lock", "p50", "p95", "p99", "max", "busy",
+            "statement");
+    for (guint i = 0; i < stats->len; ++i) {
+        s_stat_td *st = g_ptr_array_index(stats, i);
+        char *shown = g_strndup(st->sql, WORKLOAD_SQL_SHOWN);
+        g_strdelimit(shown, "\t\r\n", ' ');
+        g_array_sort(st->latencies, s_cmp_time);
+        fprintf(out, "%6d %5d %5d %9.3f %9.3f %9.3f %9.3f %9.3f  %s%s\n",
+                st->count, st->errors, st->locked,
+                s_percentile(st->latencies, 50),
+                s_percentile(st->latencies, 95),
+                s_percentile(st->latencies, 99),
+                s_percentile(st->latencies, 100),
+                (double) st->busy_us / 1000.0, shown,
+                (strlen(st->sql) > WORKLOAD_SQL_SHOWN) ? "..." : "");
+        g_free(shown);
+        g_array_free(st->latencies, TRUE);
+        g_free(st);
+    }
+
+    g_array_sort(lags, s_cmp_time);
+    fprintf(out, "\n%u statements on %d connections in %.3f s "
+            "(%.1f per second)\n", events->len, nconns,
+            (double) wall / 1e6,
+            (wall > 0) ? events->len * 1e6 / (double) wall : 0.0);
+    fprintf(out, "Lock errors: %d, lock wait: %.3f ms\n", locked,
+            (double) busy_us / 1000.0);
+    fprintf(out, "Dispatch lag: p50 %.3f ms, p95 %.3f ms, max %.3f ms\n",
+            s_percentile(lags, 50), s_percentile(lags, 95),
+            s_percentile(lags, 100));
+    fprintf(out, "(latencies, lag and busy wait in ms)\n");
+
+    g_array_free(lags, TRUE);
+    g_ptr_array_free(stats, TRUE);
+    g_hash_table_destroy(by_sql);
+}
+
+
+/* Replay a statement log on concurrent connections with timing */
+int workload_replay(const char *log, const char *filename, int nconns,
+        double speed, FILE *out)
+{
+    if (!log || !filename || !out || speed < 0.0) {
+        return SQLITE_MISUSE;
+    }
+
+    nconns = CLAMP(nconns, 1, WORKLOAD_MAX_CONNS);
+    GArray *events = NULL;
+    int nsessions = 0;
+    int rc = s_load_log(log, &nsessions, &events);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    /* Sharing a connection would mix the transactions of sessions */
+    if (nsessions > nconns) {
+        fprintf(stderr, "%s: %d sessions, more than the %d connections "
+                "allowed\n", log, nsessions, nconns);
+        s_free_events(events);
+        return SQLITE_RANGE;
+    }
+    nconns = nsessions;
+
+    char *copy = NULL;
+    s_conn_td conns[WORKLOAD_MAX_CONNS];
+    int nopen = 0;
+    memset(conns, 0, sizeof(conns));
+    rc = db_copy_to_temp(filename, &copy);
+    for (; rc == SQLITE_OK && nopen < nconns; ++nopen) {
+        rc = db_open_writer(copy, &conns[nopen].db);
+        if (rc != SQLITE_OK) {
+            break;
+        }
+        sqlite3_busy_handler(conns[nopen].db, s_on_busy, &conns[nopen]);
+        conns[nopen].queue = g_async_queue_new();
+        conns[nopen].stmts = g_hash_table_new_full(g_str_hash,
+                g_str_equal, NULL, s_finalize);
+    }
+
+    gint64 t0 = g_get_monotonic_time();
+    if (rc == SQLITE_OK) {
+        for (int i = 0; i < nconns; ++i) {
+            conns[i].thread = g_thread_new("replay", s_conn_thread,
+                    &conns[i]);
+        }
+
+        /* Release every statement at its (scaled) recorded time */
+        for (guint i = 0; i < events->len; ++i) {
+            s_event_td *ev = &g_array_index(events, s_event_td, i);
+            if (speed > 0.0) {
+                gint64 due = t0 + (gint64) ((double) ev->at / speed);
+                gint64 now = g_get_monotonic_time();
+                if (due > now) {
+                    g_usleep((gulong) (due - now));
+                }
+                ev->due = due;
+            } else {
+                ev->due = g_get_monotonic_time();
+            }
+            g_async_queue_push(conns[ev->conn].queue, ev);
+        }
+        for (int i = 0; i < nconns; ++i) {
+            g_async_queue_push(conns[i].queue, &s_stop);
+        }
+        for (int i = 0; i < nconns; ++i) {
+            g_thread_join(conns[i].thread);
+        }
+    }
+    gint64 wall = g_get_monotonic_time() - t0;
+
+    for (int i = 0; i < nopen; ++i) {
+        g_hash_table_destroy(conns[i].stmts);
+        g_async_queue_unref(conns[i].queue);
+        sqlite3_close(conns[i].db);
+    }
+    if (rc == SQLITE_OK) {
+        s_report(events, nconns, wall, out);
+    }
+    if (copy) {
+        remove(copy);
+        g_free(copy);
+    }
+    s_free_events(events);
+
+    return rc;
+}